@@ -0,0 +1,109 @@
+/*
+ *         emitter-bench.c -- Times the CPU simulation of a particle emitter.
+ *
+ * This runs particle_emitter_update() on an emitter that has no context or
+ * framebuffer, so only spawning, updating and removing particles is measured
+ * and no GPU is needed. The particles live for less time than the benchmark
+ * runs for and are created faster than they die, so once the emitter is full
+ * every tick destroys and replaces a share of its particles.
+ */
+#include "config.h"
+
+#include "particle-emitter.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Simulated seconds per tick */
+#define TICK_TIME (1.0 / 60.0)
+
+/* Ticks run before timing so that the emitter is full */
+#define WARMUP_TICKS 120
+
+#define DEFAULT_PARTICLE_COUNT 100000
+#define DEFAULT_TICKS 600
+
+static struct particle_emitter *create_emitter(int particle_count)
+{
+	struct particle_emitter *emitter = particle_emitter_new(NULL, NULL);
+
+	emitter->particle_count = particle_count;
+
+	emitter->particle_lifespan.value = 1.0f;
+	emitter->particle_lifespan.variance = 0.5f;
+	emitter->particle_lifespan.type = DOUBLE_VARIANCE_PROPORTIONAL;
+
+	emitter->particle_position.variance[0] = 10.0f;
+	emitter->particle_position.variance[1] = 10.0f;
+	emitter->particle_position.variance[2] = 10.0f;
+	emitter->particle_position.type = VECTOR_VARIANCE_LINEAR;
+
+	emitter->particle_direction.value[1] = -1.0f;
+	emitter->particle_direction.variance[0] = 0.5f;
+	emitter->particle_direction.variance[1] = 0.5f;
+	emitter->particle_direction.variance[2] = 0.5f;
+	emitter->particle_direction.type = VECTOR_VARIANCE_IRWIN_HALL;
+
+	emitter->particle_speed.value = 14;
+	emitter->particle_speed.variance = 5;
+	emitter->particle_speed.type = FLOAT_VARIANCE_IRWIN_HALL;
+
+	emitter->particle_color.hue.value = 236.0f;
+	emitter->particle_color.hue.variance = 0.05f;
+	emitter->particle_color.hue.type = FLOAT_VARIANCE_PROPORTIONAL;
+	emitter->particle_color.saturation.value = 1.0f;
+	emitter->particle_color.saturation.type = FLOAT_VARIANCE_NONE;
+	emitter->particle_color.luminance.value = 0.9f;
+	emitter->particle_color.luminance.type = FLOAT_VARIANCE_NONE;
+
+	emitter->acceleration[1] = 14;
+
+	return emitter;
+}
+
+int main(int argc, char **argv)
+{
+	int particle_count = argc > 1 ? atoi(argv[1]) : DEFAULT_PARTICLE_COUNT;
+	int n_ticks = argc > 2 ? atoi(argv[2]) : DEFAULT_TICKS;
+	int max_new_particles;
+	struct particle_emitter *emitter;
+	GTimer *timer;
+	gdouble elapsed;
+	gint64 n_updated = 0;
+	int i;
+
+	if (particle_count <= 0 || n_ticks <= 0) {
+		fprintf(stderr, "usage: %s [PARTICLE_COUNT] [TICKS]\n",
+			argv[0]);
+		return 1;
+	}
+
+	emitter = create_emitter(particle_count);
+
+	/* Particles live for about a second so offering twice as many new
+	 * particles per tick as die keeps the emitter full */
+	max_new_particles = MAX(particle_count * TICK_TIME * 2, 1);
+
+	for (i = 0; i < WARMUP_TICKS; i++)
+		particle_emitter_update(emitter, TICK_TIME, max_new_particles);
+
+	timer = g_timer_new();
+
+	for (i = 0; i < n_ticks; i++)
+		n_updated += particle_emitter_update(emitter, TICK_TIME,
+						     max_new_particles);
+
+	elapsed = g_timer_elapsed(timer, NULL);
+
+	printf("%d particles, %d ticks: %.3f ms per tick, "
+	       "%.1f ns per live particle\n",
+	       particle_count, n_ticks,
+	       elapsed * 1000.0 / n_ticks,
+	       n_updated ? elapsed * 1e9 / n_updated : 0.0);
+
+	g_timer_destroy(timer);
+	particle_emitter_free(emitter);
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ *         motion-check.c -- Checks the ballistic particle motion.
+ *
+ * This compares the CPU evaluation of the closed form motion that ballistic
+ * particle engines draw with on the GPU against trajectories worked out by
+ * hand, and against a particle stepped forward in small increments of time.
+ * It doesn't need a GPU. The exit status is non-zero if any check fails.
+ */
+#include "config.h"
+
+#include "particle-motion.h"
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+
+#define EPSILON 1e-4f
+
+struct expected_state {
+	float time;
+	CoglBool alive;
+	float position[3];
+	float color[4];
+};
+
+/* Launched from (1, 2, 3) at time 2 with gravity pulling down the y axis,
+ * fading from red to transparent blue over 4 seconds. */
+static const struct particle_spawn spawn = {
+	.birth_time = 2.0f,
+	.lifespan = 4.0f,
+	.position = { 1.0f, 2.0f, 3.0f },
+	.velocity = { 1.0f, 10.0f, -2.0f },
+	.acceleration = { 0.0f, -10.0f, 0.0f },
+	.start_color = { 1.0f, 0.0f, 0.0f, 1.0f },
+	.end_color = { 0.0f, 0.0f, 1.0f, 0.0f },
+};
+
+static const struct expected_state expected[] = {
+	/* Not born yet */
+	{ .time = 1.0f, .alive = FALSE },
+	{ 2.0f, TRUE, { 1.0f, 2.0f, 3.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+	/* The top of the arc */
+	{ 3.0f, TRUE, { 2.0f, 7.0f, 1.0f }, { 0.75f, 0.0f, 0.25f, 0.75f } },
+	{ 4.0f, TRUE, { 3.0f, 2.0f, -1.0f }, { 0.5f, 0.0f, 0.5f, 0.5f } },
+	{ 5.0f, TRUE, { 4.0f, -13.0f, -3.0f }, { 0.25f, 0.0f, 0.75f, 0.25f } },
+	/* Dead at the end of its lifespan */
+	{ .time = 6.0f, .alive = FALSE },
+	{ .time = 7.0f, .alive = FALSE },
+};
+
+static CoglBool check_components(const char *name, float time,
+				 const float *value, const float *expected,
+				 int n_components, float epsilon)
+{
+	int i;
+
+	for (i = 0; i < n_components; i++) {
+		if (fabsf(value[i] - expected[i]) > epsilon) {
+			fprintf(stderr,
+				"%s at time %f: component %i is %f, "
+				"expected %f\n",
+				name, time, i, value[i], expected[i]);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static CoglBool check_expected_states(void)
+{
+	CoglBool passed = TRUE;
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(expected); i++) {
+		const struct expected_state *state = &expected[i];
+		float position[3], color[4];
+		CoglBool alive = particle_motion_evaluate(&spawn, state->time,
+							  position, color);
+
+		if (alive != state->alive) {
+			fprintf(stderr, "particle at time %f is %s, "
+				"expected %s\n", state->time,
+				alive ? "alive" : "dead",
+				state->alive ? "alive" : "dead");
+			passed = FALSE;
+			continue;
+		}
+
+		if (!alive)
+			continue;
+
+		passed &= check_components("position", state->time,
+					   position, state->position,
+					   3, EPSILON);
+		passed &= check_components("color", state->time,
+					   color, state->color,
+					   4, EPSILON);
+	}
+
+	return passed;
+}
+
+/*
+ * Steps the particle forward with the velocity Verlet method, which is exact
+ * for a constant acceleration up to rounding, and checks that the closed form
+ * stays on the same trajectory.
+ */
+static CoglBool check_integrated_trajectory(void)
+{
+	const int n_steps = 1000;
+	const float dt = spawn.lifespan / n_steps;
+	float position[3], velocity[3];
+	int step, i;
+
+	for (i = 0; i < 3; i++) {
+		position[i] = spawn.position[i];
+		velocity[i] = spawn.velocity[i];
+	}
+
+	for (step = 1; step < n_steps; step++) {
+		float time = spawn.birth_time + step * dt;
+		float evaluated[3], color[4];
+
+		for (i = 0; i < 3; i++) {
+			position[i] += velocity[i] * dt +
+				0.5f * spawn.acceleration[i] * dt * dt;
+			velocity[i] += spawn.acceleration[i] * dt;
+		}
+
+		if (!particle_motion_evaluate(&spawn, time,
+					      evaluated, color)) {
+			fprintf(stderr, "particle died early at time %f\n",
+				time);
+			return FALSE;
+		}
+
+		/* The integration accumulates rounding errors so allow a
+		 * little more slack than for the worked out states */
+		if (!check_components("integrated position", time,
+				      evaluated, position, 3, 1e-2f))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+	CoglBool passed = TRUE;
+
+	passed &= check_expected_states();
+	passed &= check_integrated_trajectory();
+
+	printf("%s\n", passed ? "PASS" : "FAIL");
+
+	return passed ? 0 : 1;
+}
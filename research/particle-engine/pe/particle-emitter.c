@@ -28,20 +28,28 @@
 #include <math.h>
 #include <string.h>
 
-struct particle {
-	/* Whether the particle is active or not. */
-	CoglBool active;
+/*
+ * The state of the particles is stored as a structure of arrays. Live
+ * particles are packed at the start of each array so that updating and
+ * uploading them only touches active_particles_count elements, no matter
+ * how many particles the emitter can hold. When a particle dies the last
+ * live particle is moved into its slot.
+ */
+struct particles {
+	float (*position)[3];
 
 	/* Particle velocity */
-	float velocity[3];
+	float (*velocity)[3];
+
+	CoglColor *color;
 
-	/* The maximum age of this particle in seconds. The particle will linearly
+	/* The maximum age of a particle in seconds. The particle will linearly
 	 * fade out until this age */
-	gdouble max_age;
+	gdouble *max_age;
 
 	/* Time to live. This value represents the age of the particle. When it
 	 * reaches zero, the particle ist destroyed. */
-	gdouble ttl;
+	gdouble *ttl;
 };
 
 struct particle_emitter_priv {
@@ -49,9 +57,13 @@ struct particle_emitter_priv {
 	gdouble current_time;
 	gdouble last_update_time;
 
-	struct particle *particles;
+	struct particles particles;
 	int active_particles_count;
 
+	/* For ballistic emitters, the slot that the next particle will be
+	 * created in. Slots are reused in the order they were spawned. */
+	int next_spawn;
+
 	GRand *rand;
 
 	CoglContext *ctx;
@@ -59,13 +71,51 @@ struct particle_emitter_priv {
 	struct particle_engine *engine;
 };
 
-static void create_resources(struct particle_emitter *emitter)
+/*
+ * The particle state is allocated separately from the engine so that the
+ * simulation can be run without a GPU.
+ */
+static void create_particles(struct particle_emitter *emitter)
 {
 	struct particle_emitter_priv *priv = emitter->priv;
+	struct particles *particles = &priv->particles;
+	int particle_count = emitter->particle_count;
 
 	priv->active_particles_count = 0;
 
-	priv->particles = g_new0(struct particle, emitter->particle_count);
+	particles->position = g_malloc_n(particle_count, sizeof(float[3]));
+	particles->velocity = g_malloc_n(particle_count, sizeof(float[3]));
+	particles->color = g_new(CoglColor, particle_count);
+	particles->max_age = g_new(gdouble, particle_count);
+	particles->ttl = g_new(gdouble, particle_count);
+}
+
+static void free_particles(struct particle_emitter *emitter)
+{
+	struct particles *particles = &emitter->priv->particles;
+
+	g_free(particles->position);
+	g_free(particles->velocity);
+	g_free(particles->color);
+	g_free(particles->max_age);
+	g_free(particles->ttl);
+}
+
+static void create_resources(struct particle_emitter *emitter)
+{
+	struct particle_emitter_priv *priv = emitter->priv;
+
+	if (emitter->ballistic) {
+		priv->active_particles_count = 0;
+		priv->next_spawn = 0;
+		priv->engine = particle_engine_new_ballistic(priv->ctx, priv->fb,
+							     emitter->particle_count,
+							     emitter->particle_size);
+		return;
+	}
+
+	if (!priv->particles.position)
+		create_particles(emitter);
 
 	priv->engine = particle_engine_new(priv->ctx, priv->fb,
 					   emitter->particle_count,
@@ -76,14 +126,12 @@ static void create_particle(struct particle_emitter *emitter,
 			    int index)
 {
 	struct particle_emitter_priv *priv = emitter->priv;
-	struct particle *particle = &priv->particles[index];
-	float *position, initial_speed, mag;
-	CoglColor *color;
+	struct particles *particles = &priv->particles;
+	float *position = particles->position[index];
+	float *velocity = particles->velocity[index];
+	float initial_speed, mag;
 	unsigned int i;
 
-	position = particle_engine_get_particle_position(priv->engine, index);
-	color = particle_engine_get_particle_color(priv->engine, index);
-
 	/* Get position */
 	fuzzy_vector_get_real_value(&emitter->particle_position,
 				    emitter->priv->rand, position);
@@ -93,43 +141,47 @@ static void create_particle(struct particle_emitter *emitter,
 
 	/* Get direction */
 	fuzzy_vector_get_real_value(&emitter->particle_direction,
-				    emitter->priv->rand,
-				    &particle->velocity[0]);
+				    emitter->priv->rand, velocity);
 
 	/* Get direction unit vector magnitude */
-	mag = sqrt((particle->velocity[0] * particle->velocity[0]) +
-		   (particle->velocity[1] * particle->velocity[1]) +
-		   (particle->velocity[2] * particle->velocity[2]));
+	mag = sqrt((velocity[0] * velocity[0]) +
+		   (velocity[1] * velocity[1]) +
+		   (velocity[2] * velocity[2]));
 
 	/* Scale velocity from unit vector */
 	for (i = 0; i < 3; i++)
-		particle->velocity[i] *= initial_speed / mag;
+		velocity[i] *= initial_speed / mag;
 
 	/* Set initial color */
 	fuzzy_color_get_cogl_color(&emitter->particle_color,
-				   emitter->priv->rand, color);
+				   emitter->priv->rand,
+				   &particles->color[index]);
 
-	particle->max_age = fuzzy_double_get_real_value(&emitter->particle_lifespan,
-							emitter->priv->rand);
-	particle->ttl = particle->max_age;
-	particle->active = TRUE;
+	particles->max_age[index] =
+		fuzzy_double_get_real_value(&emitter->particle_lifespan,
+					    emitter->priv->rand);
+	particles->ttl[index] = particles->max_age[index];
 }
 
 static void destroy_particle(struct particle_emitter *emitter,
 			     int index)
 {
 	struct particle_emitter_priv *priv = emitter->priv;
-	struct particle *particle = &priv->particles[index];
-	float *position = particle_engine_get_particle_position(priv->engine,
-								index);
-	CoglColor *color = particle_engine_get_particle_color(priv->engine,
-							      index);
-
-	particle->active = FALSE;
-
-	/* Zero the particle */
-	memset(position, 0, sizeof(float) * 3);
-	cogl_color_init_from_4f(color, 0, 0, 0, 0);
+	struct particles *particles = &priv->particles;
+	int last = --priv->active_particles_count;
+
+	/* Keep the live particles packed by moving the last one into the
+	 * dead particle's slot */
+	if (index == last)
+		return;
+
+	memcpy(particles->position[index], particles->position[last],
+	       sizeof(particles->position[0]));
+	memcpy(particles->velocity[index], particles->velocity[last],
+	       sizeof(particles->velocity[0]));
+	particles->color[index] = particles->color[last];
+	particles->max_age[index] = particles->max_age[last];
+	particles->ttl[index] = particles->ttl[last];
 }
 
 static void update_particle(struct particle_emitter *emitter,
@@ -137,22 +189,21 @@ static void update_particle(struct particle_emitter *emitter,
 			    gdouble tick_time)
 {
 	struct particle_emitter_priv *priv = emitter->priv;
-	struct particle *particle = &priv->particles[index];
-	float *position = particle_engine_get_particle_position(priv->engine,
-								index);
-	CoglColor *color = particle_engine_get_particle_color(priv->engine,
-							      index);
+	struct particles *particles = &priv->particles;
+	float *position = particles->position[index];
+	float *velocity = particles->velocity[index];
+	CoglColor *color = &particles->color[index];
 	float t, r, g, b, a;
 	unsigned int i;
 
 	/* Update position, using v = u + at */
 	for (i = 0; i < 3; i++) {
-		particle->velocity[i] += emitter->acceleration[i] * tick_time;
-		position[i] += particle->velocity[i];
+		velocity[i] += emitter->acceleration[i] * tick_time;
+		position[i] += velocity[i];
 	}
 
 	/* Fade color over time */
-	t = tick_time / particle->max_age;
+	t = tick_time / particles->max_age[index];
 	r = cogl_color_get_red(color) - t;
 	g = cogl_color_get_green(color) - t;
 	b = cogl_color_get_blue(color) - t;
@@ -161,16 +212,156 @@ static void update_particle(struct particle_emitter *emitter,
 	cogl_color_init_from_4f(color, r, g, b, a);
 }
 
-static void tick(struct particle_emitter *emitter)
+int particle_emitter_update(struct particle_emitter *emitter,
+			    gdouble tick_time,
+			    int max_new_particles)
 {
 	struct particle_emitter_priv *priv = emitter->priv;
+	gdouble *ttl;
+	int i, free_particles;
+
+	if (!priv->particles.position)
+		create_particles(emitter);
+
+	ttl = priv->particles.ttl;
+
+	i = 0;
+	while (i < priv->active_particles_count) {
+		if (ttl[i] > 0) {
+			/* Update the particle's position and color */
+			update_particle(emitter, i, tick_time);
+
+			/* Age the particle */
+			ttl[i] -= tick_time;
+
+			i++;
+		} else {
+			/* If a particle has expired, remove it. This moves an
+			 * unvisited particle into slot i so we don't advance */
+			destroy_particle(emitter, i);
+		}
+	}
+
+	free_particles = emitter->particle_count - priv->active_particles_count;
+	if (max_new_particles > free_particles)
+		max_new_particles = free_particles;
+
+	for (i = 0; i < max_new_particles; i++)
+		create_particle(emitter, priv->active_particles_count++);
+
+	return priv->active_particles_count;
+}
+
+static void upload_particles(struct particle_emitter *emitter)
+{
+	struct particle_emitter_priv *priv = emitter->priv;
+	struct particles *particles = &priv->particles;
 	struct particle_engine *engine = priv->engine;
-	int i, updated_particles = 0, destroyed_particles = 0;
-	int new_particles = 0, max_new_particles;
+	int i;
+
+	for (i = 0; i < priv->active_particles_count; i++) {
+		memcpy(particle_engine_get_particle_position(engine, i),
+		       particles->position[i], sizeof(particles->position[0]));
+		*particle_engine_get_particle_color(engine, i) =
+			particles->color[i];
+	}
+
+	/* Only the live particles are written to the attribute buffer */
+	particle_engine_upload_particles(engine,
+					 priv->active_particles_count);
+}
+
+static void spawn_particle(struct particle_emitter *emitter,
+			   struct particle_spawn *spawn)
+{
+	struct particle_emitter_priv *priv = emitter->priv;
+	float initial_speed, mag;
+	CoglColor color;
+	unsigned int i;
+
+	spawn->birth_time = priv->current_time;
+	spawn->lifespan = fuzzy_double_get_real_value(&emitter->particle_lifespan,
+						      priv->rand);
+
+	fuzzy_vector_get_real_value(&emitter->particle_position,
+				    priv->rand, spawn->position);
+
+	initial_speed = fuzzy_float_get_real_value(&emitter->particle_speed,
+						   priv->rand);
+
+	fuzzy_vector_get_real_value(&emitter->particle_direction,
+				    priv->rand, spawn->velocity);
+
+	mag = sqrt((spawn->velocity[0] * spawn->velocity[0]) +
+		   (spawn->velocity[1] * spawn->velocity[1]) +
+		   (spawn->velocity[2] * spawn->velocity[2]));
+
+	for (i = 0; i < 3; i++) {
+		spawn->velocity[i] *= initial_speed / mag;
+		spawn->acceleration[i] = emitter->acceleration[i];
+	}
+
+	fuzzy_color_get_cogl_color(&emitter->particle_color, priv->rand, &color);
+
+	spawn->start_color[0] = cogl_color_get_red(&color);
+	spawn->start_color[1] = cogl_color_get_green(&color);
+	spawn->start_color[2] = cogl_color_get_blue(&color);
+	spawn->start_color[3] = cogl_color_get_alpha(&color);
+
+	/* Fade out over the particle's lifespan */
+	memset(spawn->end_color, 0, sizeof(spawn->end_color));
+}
+
+/*
+ * Ballistic particles are never updated after they are created. New
+ * particles replace the oldest ones, as long as those have expired, and are
+ * uploaded as one or two consecutive ranges of the buffer.
+ */
+static void tick_ballistic(struct particle_emitter *emitter,
+			   int max_new_particles)
+{
+	struct particle_emitter_priv *priv = emitter->priv;
+	struct particle_engine *engine = priv->engine;
+	int first = priv->next_spawn;
+	int n_new = 0, n_wrapped;
+
+	if (max_new_particles > emitter->particle_count)
+		max_new_particles = emitter->particle_count;
+
+	while (n_new < max_new_particles) {
+		int index = (first + n_new) % emitter->particle_count;
+		struct particle_spawn *spawn =
+			particle_engine_get_particle_spawn(engine, index);
+
+		/* Stop if the oldest particle is still alive */
+		if (priv->current_time < spawn->birth_time + spawn->lifespan)
+			break;
+
+		spawn_particle(emitter, spawn);
+		n_new++;
+	}
+
+	n_wrapped = first + n_new - emitter->particle_count;
+	if (n_wrapped > 0) {
+		particle_engine_upload_spawns(engine, first, n_new - n_wrapped);
+		particle_engine_upload_spawns(engine, 0, n_wrapped);
+	} else {
+		particle_engine_upload_spawns(engine, first, n_new);
+	}
+
+	priv->next_spawn = (first + n_new) % emitter->particle_count;
+
+	particle_engine_set_time(engine, priv->current_time);
+}
+
+static void tick(struct particle_emitter *emitter)
+{
+	struct particle_emitter_priv *priv = emitter->priv;
+	int max_new_particles;
 	gdouble tick_time;
 
 	/* Create resources as necessary */
-	if (!engine)
+	if (!priv->engine)
 		create_resources(emitter);
 
 	/* Update the clocks */
@@ -185,52 +376,14 @@ static void tick(struct particle_emitter *emitter)
 	max_new_particles = emitter->active ?
 		tick_time * emitter->new_particles_per_ms : 0;
 
-	/* We must first map the particle engine's buffer before reading or
-	 * writing particle data.
-	 */
-	particle_engine_push_buffer(priv->engine,
-				    COGL_BUFFER_ACCESS_READ_WRITE, 0);
-
-	/* Iterate over every particle and update/destroy/create as
-	 * necessary.
-	 */
-	for (i = 0; i < emitter->particle_count; i++) {
-		struct particle *particle = &priv->particles[i];
-
-		/* Break early if there's nothing left to do */
-		if (updated_particles >= priv->active_particles_count &&
-		    new_particles >= max_new_particles) {
-			break;
-		}
-
-		if (particle->active) {
-			if (particle->ttl > 0) {
-				/* Update the particle's position and color */
-				update_particle(emitter, i, tick_time);
-
-				/* Age the particle */
-				particle->ttl -= tick_time;
-			} else {
-				/* If a particle has expired, remove it */
-				destroy_particle(emitter, i);
-				destroyed_particles++;
-			}
-
-			updated_particles++;
-		} else if (new_particles < max_new_particles) {
-			/* Create a particle */
-			create_particle(emitter, i);
-			new_particles++;
-		}
+	if (emitter->ballistic) {
+		tick_ballistic(emitter, max_new_particles);
+		return;
 	}
 
-	/* We can safely unmap the changes we have made to the particle buffer
-	 * now.
-	 */
-	particle_engine_pop_buffer(priv->engine);
+	particle_emitter_update(emitter, tick_time, max_new_particles);
 
-	/* Update particle count */
-	priv->active_particles_count += new_particles - destroyed_particles;
+	upload_particles(emitter);
 }
 
 struct particle_emitter* particle_emitter_new(CoglContext *ctx,
@@ -241,8 +394,10 @@ struct particle_emitter* particle_emitter_new(CoglContext *ctx,
 
 	emitter->active = TRUE;
 
-	priv->ctx = cogl_object_ref(ctx);
-	priv->fb = cogl_object_ref(fb);
+	if (ctx)
+		priv->ctx = cogl_object_ref(ctx);
+	if (fb)
+		priv->fb = cogl_object_ref(fb);
 
 	priv->timer = g_timer_new();
 	priv->rand = g_rand_new();
@@ -256,13 +411,18 @@ void particle_emitter_free(struct particle_emitter *emitter)
 {
 	struct particle_emitter_priv *priv = emitter->priv;
 
-	cogl_object_unref(priv->ctx);
-	cogl_object_unref(priv->fb);
+	if (priv->ctx)
+		cogl_object_unref(priv->ctx);
+	if (priv->fb)
+		cogl_object_unref(priv->fb);
 
 	g_rand_free(priv->rand);
 	g_timer_destroy(priv->timer);
 
-	particle_engine_free(priv->engine);
+	free_particles(emitter);
+
+	if (priv->engine)
+		particle_engine_free(priv->engine);
 
 	g_slice_free(struct particle_emitter_priv, priv);
 	g_slice_free(struct particle_emitter, emitter);
@@ -94,14 +94,38 @@ struct particle_emitter {
 	 */
 	float acceleration[3];
 
+	/*
+	 * Controls whether particles follow simple ballistic trajectories that
+	 * are evaluated on the GPU. Each particle is then only uploaded once,
+	 * when it is created, and the CPU doesn't need to touch it again. In
+	 * this mode particle_speed is in units per second rather than units per
+	 * frame. This must be set before the emitter is first painted.
+	 */
+	CoglBool ballistic;
+
 	/* <priv> */
 	struct particle_emitter_priv *priv;
 };
 
+/*
+ * ctx and fb may be NULL for an emitter that is only ever updated with
+ * particle_emitter_update() and never painted.
+ */
 struct particle_emitter *particle_emitter_new(CoglContext *ctx, CoglFramebuffer *fb);
 
 void particle_emitter_free(struct particle_emitter *emitter);
 
 void particle_emitter_paint(struct particle_emitter *emitter);
 
+/*
+ * Runs one step of the CPU simulation of a non-ballistic emitter: ages the
+ * live particles by tick_time seconds, removes the ones that have expired and
+ * then creates up to max_new_particles in the free slots. Nothing is uploaded
+ * so this doesn't need a GPU. particle_emitter_paint() calls this with the
+ * time elapsed since the last paint. Returns the number of live particles.
+ */
+int particle_emitter_update(struct particle_emitter *emitter,
+			    gdouble tick_time,
+			    int max_new_particles);
+
 #endif /* _PARTICLE_EMITTER_H_ */
@@ -22,6 +22,8 @@
 
 #include "particle-engine.h"
 
+#include "particle-motion.h"
+
 struct particle_engine {
 	CoglContext *ctx;
 	CoglFramebuffer *fb;
@@ -29,8 +31,18 @@ struct particle_engine {
 	CoglPrimitive *primitive;
 	CoglAttributeBuffer *attribute_buffer;
 
+	/* Points at the mapped attribute buffer between push_buffer() and
+	 * pop_buffer() and at local_vertices otherwise. */
 	struct vertex *vertices;
 
+	/* A copy of the vertices in system memory which can be uploaded with
+	 * particle_engine_upload_particles() instead of mapping the buffer. */
+	struct vertex *local_vertices;
+
+	/* Only used by ballistic engines, in place of the vertices. */
+	struct particle_spawn *spawns;
+	int time_location;
+
 	/* The number of particles in the engine. */
 	int particle_count;
 
@@ -62,7 +74,8 @@ struct particle_engine *particle_engine_new(CoglContext *ctx,
 	engine->fb = cogl_object_ref(fb);
 
 	engine->pipeline = cogl_pipeline_new(engine->ctx);
-	engine->vertices = g_new0(struct vertex, engine->particle_count);
+	engine->local_vertices = g_new0(struct vertex, engine->particle_count);
+	engine->vertices = engine->local_vertices;
 
 	engine->attribute_buffer =
 		cogl_attribute_buffer_new(engine->ctx,
@@ -98,6 +111,137 @@ struct particle_engine *particle_engine_new(CoglContext *ctx,
 	return engine;
 }
 
+struct particle_engine *particle_engine_new_ballistic(CoglContext *ctx,
+						      CoglFramebuffer *fb,
+						      int particle_count,
+						      float particle_size)
+{
+	struct particle_engine *engine;
+	CoglAttribute *attributes[6];
+	CoglSnippet *snippet;
+	char *declarations;
+	unsigned int i;
+
+	engine = g_slice_new0(struct particle_engine);
+
+	engine->particle_count = particle_count;
+	engine->particle_size = particle_size;
+
+	engine->ctx = cogl_object_ref(ctx);
+	engine->fb = cogl_object_ref(fb);
+
+	engine->pipeline = cogl_pipeline_new(engine->ctx);
+
+	/* A lifespan of zero means that none of the particles are alive until
+	 * they are spawned */
+	engine->spawns = g_new0(struct particle_spawn, engine->particle_count);
+
+	engine->attribute_buffer =
+		cogl_attribute_buffer_new(engine->ctx,
+					  sizeof(struct particle_spawn) *
+					  engine->particle_count, engine->spawns);
+
+	attributes[0] = cogl_attribute_new(engine->attribute_buffer,
+					   "cogl_position_in",
+					   sizeof(struct particle_spawn),
+					   G_STRUCT_OFFSET(struct particle_spawn,
+							   position),
+					   3, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+	attributes[1] = cogl_attribute_new(engine->attribute_buffer,
+					   "cogl_color_in",
+					   sizeof(struct particle_spawn),
+					   G_STRUCT_OFFSET(struct particle_spawn,
+							   start_color),
+					   4, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+	/* birth_time and lifespan */
+	attributes[2] = cogl_attribute_new(engine->attribute_buffer,
+					   "particle_time",
+					   sizeof(struct particle_spawn),
+					   G_STRUCT_OFFSET(struct particle_spawn,
+							   birth_time),
+					   2, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+	attributes[3] = cogl_attribute_new(engine->attribute_buffer,
+					   "particle_velocity",
+					   sizeof(struct particle_spawn),
+					   G_STRUCT_OFFSET(struct particle_spawn,
+							   velocity),
+					   3, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+	attributes[4] = cogl_attribute_new(engine->attribute_buffer,
+					   "particle_acceleration",
+					   sizeof(struct particle_spawn),
+					   G_STRUCT_OFFSET(struct particle_spawn,
+							   acceleration),
+					   3, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+	attributes[5] = cogl_attribute_new(engine->attribute_buffer,
+					   "particle_end_color",
+					   sizeof(struct particle_spawn),
+					   G_STRUCT_OFFSET(struct particle_spawn,
+							   end_color),
+					   4, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+	engine->primitive =
+		cogl_primitive_new_with_attributes(COGL_VERTICES_MODE_POINTS,
+						   engine->particle_count,
+						   attributes,
+						   G_N_ELEMENTS(attributes));
+
+	for (i = 0; i < G_N_ELEMENTS(attributes); i++)
+		cogl_object_unref(attributes[i]);
+
+	declarations = g_strconcat("attribute vec2 particle_time;\n"
+				   "attribute vec3 particle_velocity;\n"
+				   "attribute vec3 particle_acceleration;\n"
+				   "attribute vec4 particle_end_color;\n"
+				   "uniform float particle_engine_time;\n",
+				   particle_motion_glsl,
+				   NULL);
+
+	/* The position and color of every particle are evaluated from its
+	 * spawn parameters and the current time so nothing needs to be
+	 * uploaded per frame. */
+	snippet = cogl_snippet_new(COGL_SNIPPET_HOOK_VERTEX,
+				   declarations,
+				   "vec3 position;\n"
+				   "vec4 color;\n"
+				   "\n"
+				   "if (particle_motion_evaluate (particle_time.x,\n"
+				   "                              particle_time.y,\n"
+				   "                              cogl_position_in.xyz,\n"
+				   "                              particle_velocity,\n"
+				   "                              particle_acceleration,\n"
+				   "                              cogl_color_in,\n"
+				   "                              particle_end_color,\n"
+				   "                              particle_engine_time,\n"
+				   "                              position,\n"
+				   "                              color)) {\n"
+				   "  cogl_position_out =\n"
+				   "    cogl_modelview_projection_matrix *\n"
+				   "    vec4 (position, 1.0);\n"
+				   "  cogl_color_out = color;\n"
+				   "} else {\n"
+				   "  /* Move dead particles outside of the clip volume */\n"
+				   "  cogl_position_out = vec4 (0.0, 0.0, 2.0, 1.0);\n"
+				   "  cogl_color_out = vec4 (0.0);\n"
+				   "}\n");
+	cogl_pipeline_add_snippet(engine->pipeline, snippet);
+	cogl_object_unref(snippet);
+	g_free(declarations);
+
+	engine->time_location =
+		cogl_pipeline_get_uniform_location(engine->pipeline,
+						   "particle_engine_time");
+
+	cogl_pipeline_set_point_size(engine->pipeline, engine->particle_size);
+	cogl_primitive_set_n_vertices(engine->primitive, engine->particle_count);
+
+	return engine;
+}
+
 void particle_engine_free(struct particle_engine *engine)
 {
 	cogl_object_unref(engine->ctx);
@@ -106,8 +250,9 @@ void particle_engine_free(struct particle_engine *engine)
 	cogl_object_unref(engine->primitive);
 	cogl_object_unref(engine->attribute_buffer);
 
-	g_free(engine->vertices);
-	g_free(engine);
+	g_free(engine->local_vertices);
+	g_free(engine->spawns);
+	g_slice_free(struct particle_engine, engine);
 }
 
 inline void particle_engine_push_buffer(struct particle_engine *engine,
@@ -128,6 +273,58 @@ inline void particle_engine_push_buffer(struct particle_engine *engine,
 inline void particle_engine_pop_buffer(struct particle_engine *engine)
 {
 	cogl_buffer_unmap(COGL_BUFFER(engine->attribute_buffer));
+
+	engine->vertices = engine->local_vertices;
+}
+
+void particle_engine_upload_particles(struct particle_engine *engine,
+				      int n_particles)
+{
+	CoglError *error = NULL;
+
+	if (n_particles > 0 &&
+	    !cogl_buffer_set_data(COGL_BUFFER(engine->attribute_buffer), 0,
+				  engine->local_vertices,
+				  sizeof(struct vertex) * n_particles,
+				  &error)) {
+		g_error(G_STRLOC " failed to upload particles: %s",
+			error->message);
+		return;
+	}
+
+	cogl_primitive_set_n_vertices(engine->primitive, n_particles);
+}
+
+struct particle_spawn *particle_engine_get_particle_spawn(struct particle_engine *engine,
+							 int index)
+{
+	return &engine->spawns[index];
+}
+
+void particle_engine_upload_spawns(struct particle_engine *engine,
+				   int first_particle,
+				   int n_particles)
+{
+	CoglError *error = NULL;
+
+	if (n_particles > 0 &&
+	    !cogl_buffer_set_data(COGL_BUFFER(engine->attribute_buffer),
+				  sizeof(struct particle_spawn) * first_particle,
+				  &engine->spawns[first_particle],
+				  sizeof(struct particle_spawn) * n_particles,
+				  &error)) {
+		g_error(G_STRLOC " failed to upload particles: %s",
+			error->message);
+		return;
+	}
+}
+
+void particle_engine_set_time(struct particle_engine *engine,
+			      float time)
+{
+	cogl_pipeline_set_uniform_1f(engine->pipeline,
+				     engine->time_location,
+				     time);
 }
 
 inline float *particle_engine_get_particle_position(struct particle_engine *engine,
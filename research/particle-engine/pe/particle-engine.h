@@ -25,6 +25,8 @@
 
 #include <cogl/cogl.h>
 
+#include "particle-motion.h"
+
 /*
  * The particle engine is an opaque data structure
  */
@@ -38,6 +40,19 @@ struct particle_engine *particle_engine_new(CoglContext *ctx,
 					    int particle_count,
 					    float particle_size);
 
+/*
+ * Create and return a new particle engine for ballistic particles. Instead of
+ * positions and colors, the particles of a ballistic engine are described by
+ * their spawn parameters. These are evaluated on the GPU from the time given
+ * to particle_engine_set_time() so only particles that are spawned need to
+ * be uploaded. The buffer mapping and position/color functions can't be used
+ * with a ballistic engine.
+ */
+struct particle_engine *particle_engine_new_ballistic(CoglContext *ctx,
+						      CoglFramebuffer *fb,
+						      int particle_count,
+						      float particle_size);
+
 /*
  * Destroy a particle engine and free associated resources.
  */
@@ -57,6 +72,16 @@ inline void particle_engine_push_buffer(struct particle_engine *engine,
  */
 inline void particle_engine_pop_buffer(struct particle_engine *engine);
 
+/*
+ * Writes the first n_particles vertices from the engine's local copy of the
+ * particles to the attribute buffer and only draws those from then on. This
+ * can be used instead of mapping the buffer when only some of the particles
+ * are alive. Outside of push_buffer()/pop_buffer() the position and color
+ * getters below return pointers into the local copy.
+ */
+void particle_engine_upload_particles(struct particle_engine *engine,
+				      int n_particles);
+
 /*
  * Returns a pointer to the given particle's position as an array of floats [x, y, z].
  */
@@ -67,6 +92,29 @@ inline float *particle_engine_get_particle_position(struct particle_engine *engi
  */
 inline CoglColor *particle_engine_get_particle_color(struct particle_engine *engine, int index);
 
+/*
+ * Returns a pointer to the given particle's spawn parameters in a ballistic
+ * engine. Changes are only seen once they have been uploaded with
+ * particle_engine_upload_spawns().
+ */
+struct particle_spawn *particle_engine_get_particle_spawn(struct particle_engine *engine,
+							 int index);
+
+/*
+ * Uploads the spawn parameters of n_particles consecutive particles of a
+ * ballistic engine, starting from first_particle.
+ */
+void particle_engine_upload_spawns(struct particle_engine *engine,
+				   int first_particle,
+				   int n_particles);
+
+/*
+ * Sets the time (in seconds) at which the particles of a ballistic engine
+ * are evaluated when painting.
+ */
+void particle_engine_set_time(struct particle_engine *engine,
+			      float time);
+
 /*
  * Paint function.
  */
@@ -0,0 +1,103 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "particle-motion.h"
+
+/*
+ * The closed form of the motion is written once as expressions that are
+ * valid both in C, where they are applied to each component in turn, and in
+ * GLSL, where they are applied to whole vectors. They are expanded as C code
+ * by particle_motion_evaluate() and stringified into particle_motion_glsl so
+ * the two can't drift apart. Constants must be written without a suffix so
+ * that they are also valid GLSL.
+ */
+
+#define PARTICLE_MOTION_AGE(birth_time, time) \
+	((time) - (birth_time))
+
+#define PARTICLE_MOTION_IS_ALIVE(age, lifespan) \
+	((age) >= 0.0 && (age) < (lifespan))
+
+/* s = s0 + ut + ½at² */
+#define PARTICLE_MOTION_POSITION(position, velocity, acceleration, age) \
+	((position) + \
+	 (velocity) * (age) + \
+	 0.5 * (acceleration) * (age) * (age))
+
+#define PARTICLE_MOTION_COLOR(start_color, end_color, age, lifespan) \
+	((start_color) + \
+	 ((end_color) - (start_color)) * ((age) / (lifespan)))
+
+#define STRINGIFY(x) #x
+#define GLSL(x) STRINGIFY(x)
+
+CoglBool particle_motion_evaluate(const struct particle_spawn *spawn,
+				  float time,
+				  float position[3],
+				  float color[4])
+{
+	float age = PARTICLE_MOTION_AGE(spawn->birth_time, time);
+	unsigned int i;
+
+	if (!PARTICLE_MOTION_IS_ALIVE(age, spawn->lifespan))
+		return FALSE;
+
+	for (i = 0; i < 3; i++)
+		position[i] = PARTICLE_MOTION_POSITION(spawn->position[i],
+						       spawn->velocity[i],
+						       spawn->acceleration[i],
+						       age);
+
+	for (i = 0; i < 4; i++)
+		color[i] = PARTICLE_MOTION_COLOR(spawn->start_color[i],
+						 spawn->end_color[i],
+						 age, spawn->lifespan);
+
+	return TRUE;
+}
+
+const char *particle_motion_glsl =
+	"bool\n"
+	"particle_motion_evaluate (float birth_time, float lifespan,\n"
+	"                          vec3 position, vec3 velocity,\n"
+	"                          vec3 acceleration,\n"
+	"                          vec4 start_color, vec4 end_color,\n"
+	"                          float time,\n"
+	"                          out vec3 position_out,\n"
+	"                          out vec4 color_out)\n"
+	"{\n"
+	"  float age =\n"
+	"    " GLSL(PARTICLE_MOTION_AGE(birth_time, time)) ";\n"
+	"\n"
+	"  if (!" GLSL(PARTICLE_MOTION_IS_ALIVE(age, lifespan)) ")\n"
+	"    return false;\n"
+	"\n"
+	"  position_out =\n"
+	"    " GLSL(PARTICLE_MOTION_POSITION(position, velocity,
+					    acceleration, age)) ";\n"
+	"\n"
+	"  color_out =\n"
+	"    " GLSL(PARTICLE_MOTION_COLOR(start_color, end_color,
+					 age, lifespan)) ";\n"
+	"\n"
+	"  return true;\n"
+	"}\n";
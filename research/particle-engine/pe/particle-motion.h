@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _PARTICLE_MOTION_H_
+#define _PARTICLE_MOTION_H_
+
+#include <cogl/cogl.h>
+
+/*
+ * The immutable description of a ballistic particle. The state of the
+ * particle at any later time can be evaluated directly from these
+ * parameters so once they have been uploaded the particle doesn't need to be
+ * touched again until it is replaced.
+ */
+struct particle_spawn {
+	/* The time (in seconds) at which the particle was created. */
+	float birth_time;
+
+	/* How long (in seconds) the particle exists for. */
+	float lifespan;
+
+	float position[3];
+
+	/* Units per second */
+	float velocity[3];
+
+	/* Units per second per second */
+	float acceleration[3];
+
+	/* The color of the particle is linearly interpolated from start_color
+	 * at birth to end_color at the end of its lifespan. */
+	float start_color[4];
+	float end_color[4];
+};
+
+/*
+ * Evaluates the position and color of a particle at the given time. Returns
+ * FALSE if the particle isn't alive at that time, in which case position and
+ * color are left untouched.
+ *
+ * This is the CPU reference for the GLSL function of the same name in
+ * particle_motion_glsl, which is what is actually used to draw the particles.
+ * Both are generated from the same expressions.
+ */
+CoglBool particle_motion_evaluate(const struct particle_spawn *spawn,
+				  float time,
+				  float position[3],
+				  float color[4]);
+
+/*
+ * GLSL declarations defining:
+ *
+ *   bool particle_motion_evaluate(float birth_time, float lifespan,
+ *                                 vec3 position, vec3 velocity,
+ *                                 vec3 acceleration,
+ *                                 vec4 start_color, vec4 end_color,
+ *                                 float time,
+ *                                 out vec3 position_out,
+ *                                 out vec4 color_out);
+ */
+extern const char *particle_motion_glsl;
+
+#endif /* _PARTICLE_MOTION_H_ */
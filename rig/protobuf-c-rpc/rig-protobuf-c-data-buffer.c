@@ -42,17 +42,28 @@
 static inline int
 rig_protobuf_c_data_buffer_fragment_avail (ProtobufCDataBufferFragment *frag)
 {
+  /* We never append into foreign fragments */
+  if (frag->foreign_data)
+    return 0;
   return PROTOBUF_C_FRAGMENT_DATA_SIZE - frag->buf_start - frag->buf_length;
 }
 static inline uint8_t *
+rig_protobuf_c_data_buffer_fragment_data (ProtobufCDataBufferFragment *frag)
+{
+  if (frag->foreign_data)
+    return (uint8_t *) frag->foreign_data;
+  return PROTOBUF_C_FRAGMENT_DATA(frag);
+}
+static inline uint8_t *
 rig_protobuf_c_data_buffer_fragment_start (ProtobufCDataBufferFragment *frag)
 {
-  return PROTOBUF_C_FRAGMENT_DATA(frag) + frag->buf_start;
+  return rig_protobuf_c_data_buffer_fragment_data (frag) + frag->buf_start;
 }
 static inline uint8_t *
 rig_protobuf_c_data_buffer_fragment_end (ProtobufCDataBufferFragment *frag)
 {
-  return PROTOBUF_C_FRAGMENT_DATA(frag) + frag->buf_start + frag->buf_length;
+  return rig_protobuf_c_data_buffer_fragment_data (frag) +
+    frag->buf_start + frag->buf_length;
 }
 
 /* --- ProtobufCDataBufferFragment recycling --- */
@@ -81,6 +92,9 @@ new_native_fragment(ProtobufCAllocator *allocator)
 #endif	/* !GSK_DEBUG_BUFFER_ALLOCATIONS */
   frag->buf_start = frag->buf_length = 0;
   frag->next = 0;
+  frag->foreign_data = NULL;
+  frag->destroy = NULL;
+  frag->destroy_data = NULL;
   return frag;
 }
 
@@ -97,6 +111,21 @@ recycle(ProtobufCDataBufferFragment* frag,
 }
 #endif	/* !GSK_DEBUG_BUFFER_ALLOCATIONS */
 
+static void
+free_fragment (ProtobufCAllocator *allocator,
+               ProtobufCDataBufferFragment *frag)
+{
+  /* Foreign fragments are only a header so they never get recycled */
+  if (frag->foreign_data)
+    {
+      if (frag->destroy)
+        frag->destroy (frag->destroy_data);
+      allocator->free (allocator, frag);
+    }
+  else
+    recycle (allocator, frag);
+}
+
 /* --- Global public methods --- */
 /**
  * rig_protobuf_c_data_buffer_cleanup_recycling_bin:
@@ -196,6 +225,48 @@ rig_protobuf_c_data_buffer_append(ProtobufCDataBuffer *buffer,
   CHECK_INTEGRITY (buffer);
 }
 
+/**
+ * rig_protobuf_c_data_buffer_append_foreign:
+ * @buffer: the buffer to add data to.  Data is put at the end of the buffer.
+ * @data: binary data to reference from the buffer.
+ * @length: length of @data.
+ * @destroy: function to call once the buffer no longer needs @data.
+ * @destroy_data: data to pass to @destroy.
+ *
+ * Append data into the buffer without copying it. This is useful
+ * for sending the same large message to multiple streams.
+ */
+void
+rig_protobuf_c_data_buffer_append_foreign (ProtobufCDataBuffer *buffer,
+                                           const void *data,
+                                           size_t length,
+                                           void (*destroy) (void *),
+                                           void *destroy_data)
+{
+  ProtobufCDataBufferFragment *frag;
+
+  CHECK_INTEGRITY (buffer);
+
+  frag = buffer->allocator->alloc (buffer->allocator,
+                                   sizeof (ProtobufCDataBufferFragment));
+  frag->next = NULL;
+  frag->buf_start = 0;
+  frag->buf_length = length;
+  frag->foreign_data = data;
+  frag->destroy = destroy;
+  frag->destroy_data = destroy_data;
+
+  if (buffer->last_frag)
+    buffer->last_frag->next = frag;
+  else
+    buffer->first_frag = frag;
+  buffer->last_frag = frag;
+
+  buffer->size += length;
+
+  CHECK_INTEGRITY (buffer);
+}
+
 void
 rig_protobuf_c_data_buffer_append_repeated_char (ProtobufCDataBuffer *buffer,
                                                  char character,
@@ -318,7 +389,7 @@ rig_protobuf_c_data_buffer_read(ProtobufCDataBuffer *buffer,
 	  buffer->first_frag = first->next;
 	  if (!buffer->first_frag)
 	    buffer->last_frag = NULL;
-	  recycle (buffer->allocator, first);
+	  free_fragment (buffer->allocator, first);
 	}
       else
 	{
@@ -520,7 +591,7 @@ rig_protobuf_c_data_buffer_discard (ProtobufCDataBuffer *buffer,
 	  buffer->first_frag = first->next;
 	  if (!buffer->first_frag)
 	    buffer->last_frag = NULL;
-	  recycle (buffer->allocator, first);
+	  free_fragment (buffer->allocator, first);
 	}
       else
 	{
@@ -685,7 +756,7 @@ rig_protobuf_c_data_buffer_reset(ProtobufCDataBuffer *to_destroy)
   while (at)
     {
       ProtobufCDataBufferFragment *next = at->next;
-      recycle (to_destroy->allocator, at);
+      free_fragment (to_destroy->allocator, at);
       at = next;
     }
   to_destroy->first_frag = to_destroy->last_frag = NULL;
@@ -700,7 +771,7 @@ rig_protobuf_c_data_buffer_clear(ProtobufCDataBuffer *to_destroy)
   while (at)
     {
       ProtobufCDataBufferFragment *next = at->next;
-      recycle (to_destroy->allocator, at);
+      free_fragment (to_destroy->allocator, at);
       at = next;
     }
 }
@@ -750,7 +821,7 @@ rig_protobuf_c_data_buffer_str_index_of (ProtobufCDataBuffer *buffer,
   size_t rv = 0;
   for (frag = buffer->first_frag; frag; frag = frag->next)
     {
-      const uint8_t *frag_at = PROTOBUF_C_FRAGMENT_DATA (frag);
+      const uint8_t *frag_at = rig_protobuf_c_data_buffer_fragment_start (frag);
       size_t frag_rem = frag->buf_length;
       while (frag_rem > 0)
         {
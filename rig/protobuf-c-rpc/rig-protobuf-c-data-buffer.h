@@ -53,6 +53,13 @@ struct _ProtobufCDataBufferFragment
   ProtobufCDataBufferFragment *next;
   unsigned buf_start;	/* offset in buf of valid data */
   unsigned buf_length;	/* length of valid data in buf */
+
+  /* Foreign fragments reference externally owned data instead of
+   * storing it inline. @destroy is called once the fragment has been
+   * consumed. */
+  const uint8_t *foreign_data;
+  void (*destroy) (void *destroy_data);
+  void *destroy_data;
 };
 
 struct _ProtobufCDataBuffer
@@ -92,6 +99,14 @@ int      rig_protobuf_c_data_buffer_index_of(ProtobufCDataBuffer *buffer,
 void     rig_protobuf_c_data_buffer_append (ProtobufCDataBuffer    *buffer,
                                             const void   *data,
                                             size_t        length);
+/* Append data without copying it. The data must stay valid until
+ * @destroy is called with @destroy_data which happens once all of
+ * the data has been read or discarded from the buffer. */
+void     rig_protobuf_c_data_buffer_append_foreign (ProtobufCDataBuffer    *buffer,
+                                                    const void   *data,
+                                                    size_t        length,
+                                                    void        (*destroy) (void *),
+                                                    void         *destroy_data);
 void     rig_protobuf_c_data_buffer_append_string (ProtobufCDataBuffer    *buffer,
                                                    const char   *string);
 void     rig_protobuf_c_data_buffer_append_char (ProtobufCDataBuffer    *buffer,
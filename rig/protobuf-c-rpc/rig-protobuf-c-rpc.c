@@ -700,12 +700,18 @@ grow_closure_array (PB_RPC_Client *client)
   client->info.connected.closures_alloced = new_size;
 }
 
+/* If @destroy is non-NULL then the packed data is referenced by the
+ * outgoing stream instead of being copied and @destroy will be called
+ * with @destroy_data once it has been written */
 static void
-enqueue_request (PB_RPC_Client *client,
-                 unsigned method_index,
-                 const ProtobufCMessage *input,
-                 ProtobufCClosure closure,
-                 void *closure_data)
+enqueue_packed_request (PB_RPC_Client *client,
+                        unsigned method_index,
+                        const uint8_t *packed_data,
+                        size_t packed_size,
+                        void (*destroy) (void *),
+                        void *destroy_data,
+                        ProtobufCClosure closure,
+                        void *closure_data)
 {
   uint32_t request_id;
   struct {
@@ -713,16 +719,11 @@ enqueue_request (PB_RPC_Client *client,
     uint32_t packed_size;
     uint32_t request_id;
   } header;
-  size_t packed_size;
-  uint8_t *packed_data;
   Closure *cl;
   const ProtobufCServiceDescriptor *desc = client->service.descriptor;
   const ProtobufCMethodDescriptor *method = desc->methods + method_index;
   int had_outgoing = (client->stream->outgoing.size > 0);
 
-  g_return_if_fail (client->state == PB_RPC_CLIENT_STATE_CONNECTED);
-  g_return_if_fail (method_index < desc->n_methods);
-
   /* Allocate request_id */
   if (client->info.connected.first_free_request_id == 0)
     grow_closure_array (client);
@@ -731,26 +732,19 @@ enqueue_request (PB_RPC_Client *client,
   client->info.connected.first_free_request_id =
     GPOINTER_TO_UINT (cl->closure_data);
 
-  /* Pack message */
-  packed_size = protobuf_c_message_get_packed_size (input);
-  if (packed_size < client->allocator->max_alloca)
-    packed_data = alloca (packed_size);
-  else
-    packed_data = client->allocator->alloc (client->allocator, packed_size);
-  protobuf_c_message_pack (input, packed_data);
-
   /* Append to buffer */
   g_assert (sizeof (header) == 12);
   header.method_index = uint32_to_le (method_index);
   header.packed_size = uint32_to_le (packed_size);
   header.request_id = request_id;
   rig_protobuf_c_data_buffer_append (&client->stream->outgoing, &header, 12);
-  rig_protobuf_c_data_buffer_append (&client->stream->outgoing,
-                                     packed_data, packed_size);
-
-  /* Clean up if not using alloca() */
-  if (packed_size >= client->allocator->max_alloca)
-    client->allocator->free (client->allocator, packed_data);
+  if (destroy)
+    rig_protobuf_c_data_buffer_append_foreign (&client->stream->outgoing,
+                                               packed_data, packed_size,
+                                               destroy, destroy_data);
+  else
+    rig_protobuf_c_data_buffer_append (&client->stream->outgoing,
+                                       packed_data, packed_size);
 
   /* Add closure to request-tree */
   cl->response_type = method->output;
@@ -762,6 +756,38 @@ enqueue_request (PB_RPC_Client *client,
     update_stream_fd_watch (client->stream);
 }
 
+static void
+enqueue_request (PB_RPC_Client *client,
+                 unsigned method_index,
+                 const ProtobufCMessage *input,
+                 ProtobufCClosure closure,
+                 void *closure_data)
+{
+  size_t packed_size;
+  uint8_t *packed_data;
+  const ProtobufCServiceDescriptor *desc = client->service.descriptor;
+
+  g_return_if_fail (client->state == PB_RPC_CLIENT_STATE_CONNECTED);
+  g_return_if_fail (method_index < desc->n_methods);
+
+  /* Pack message */
+  packed_size = protobuf_c_message_get_packed_size (input);
+  if (packed_size < client->allocator->max_alloca)
+    packed_data = alloca (packed_size);
+  else
+    packed_data = client->allocator->alloc (client->allocator, packed_size);
+  protobuf_c_message_pack (input, packed_data);
+
+  enqueue_packed_request (client, method_index,
+                          packed_data, packed_size,
+                          NULL, NULL, /* copy */
+                          closure, closure_data);
+
+  /* Clean up if not using alloca() */
+  if (packed_size >= client->allocator->max_alloca)
+    client->allocator->free (client->allocator, packed_data);
+}
+
 static void
 invoke_client_rpc (ProtobufCService *service,
                    unsigned method_index,
@@ -790,6 +816,32 @@ invoke_client_rpc (ProtobufCService *service,
     }
 }
 
+void
+rig_pb_rpc_client_invoke_packed (PB_RPC_Client *client,
+                                 unsigned method_index,
+                                 const uint8_t *packed_data,
+                                 size_t packed_size,
+                                 void (*destroy) (void *),
+                                 void *destroy_data,
+                                 ProtobufCClosure closure,
+                                 void *closure_data)
+{
+  g_return_if_fail (destroy != NULL);
+  g_return_if_fail (method_index < client->service.descriptor->n_methods);
+
+  if (client->state != PB_RPC_CLIENT_STATE_CONNECTED)
+    {
+      destroy (destroy_data);
+      closure (NULL, closure_data);
+      return;
+    }
+
+  enqueue_packed_request (client, method_index,
+                          packed_data, packed_size,
+                          destroy, destroy_data,
+                          closure, closure_data);
+}
+
 static void
 trivial_sync_libc_resolver (RigProtobufCDispatch *dispatch,
                             const char *name,
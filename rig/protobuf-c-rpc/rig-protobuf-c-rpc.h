@@ -104,6 +104,22 @@ rig_pb_rpc_client_set_autoreconnect_period (PB_RPC_Client *client,
 bool
 rig_pb_rpc_client_is_connected (PB_RPC_Client *client);
 
+/* Queues a request whose input message has already been packed so
+   that the same packed data can be sent to multiple clients without
+   repacking or copying it. The data is referenced by the client's
+   outgoing stream until @destroy is called with @destroy_data. If the
+   client isn't connected then @destroy is called immediately and the
+   closure is invoked with a NULL message. */
+void
+rig_pb_rpc_client_invoke_packed (PB_RPC_Client *client,
+                                 unsigned method_index,
+                                 const uint8_t *packed_data,
+                                 size_t packed_size,
+                                 void (*destroy) (void *),
+                                 void *destroy_data,
+                                 ProtobufCClosure closure,
+                                 void *closure_data);
+
 /* NOTE: we don't actually start connecting til the main-loop runs,
    so you may configure the client immediately after creation */
 
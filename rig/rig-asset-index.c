@@ -0,0 +1,338 @@
+/*
+ * Rig
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <stdint.h>
+
+#include "rig-asset-index.h"
+
+struct _RigAssetIndex
+{
+  /* All of the indexed assets in the order they were added */
+  GPtrArray *assets;
+  GHashTable *indexed;
+
+  /* These map an interned tag or a path trigram to a GPtrArray of
+   * all the assets with that tag or trigram in their path */
+  GHashTable *tags;
+  GHashTable *trigrams;
+};
+
+#define TRIGRAM_KEY(STR) \
+  GUINT_TO_POINTER ((uint32_t)(uint8_t)(STR)[0] | \
+                    ((uint32_t)(uint8_t)(STR)[1] << 8) | \
+                    ((uint32_t)(uint8_t)(STR)[2] << 16))
+
+RigAssetIndex *
+rig_asset_index_new (void)
+{
+  RigAssetIndex *index = g_slice_new (RigAssetIndex);
+
+  index->assets = g_ptr_array_new ();
+  index->indexed = g_hash_table_new (NULL, NULL);
+  index->tags = g_hash_table_new_full (NULL, NULL, NULL,
+                                       (GDestroyNotify)g_ptr_array_unref);
+  index->trigrams = g_hash_table_new_full (NULL, NULL, NULL,
+                                           (GDestroyNotify)g_ptr_array_unref);
+
+  return index;
+}
+
+void
+rig_asset_index_free (RigAssetIndex *index)
+{
+  g_ptr_array_free (index->assets, TRUE);
+  g_hash_table_destroy (index->indexed);
+  g_hash_table_destroy (index->tags);
+  g_hash_table_destroy (index->trigrams);
+
+  g_slice_free (RigAssetIndex, index);
+}
+
+void
+rig_asset_index_clear (RigAssetIndex *index)
+{
+  g_ptr_array_set_size (index->assets, 0);
+  g_hash_table_remove_all (index->indexed);
+  g_hash_table_remove_all (index->tags);
+  g_hash_table_remove_all (index->trigrams);
+}
+
+static void
+add_posting (GHashTable *postings, void *key, RutAsset *asset)
+{
+  GPtrArray *list = g_hash_table_lookup (postings, key);
+
+  if (!list)
+    {
+      list = g_ptr_array_new ();
+      g_hash_table_insert (postings, key, list);
+    }
+
+  /* Since assets are indexed one at a time then if the asset is
+   * already in the list it can only be at the end. (E.g. if a path
+   * contains the same trigram twice) */
+  if (list->len &&
+      g_ptr_array_index (list, list->len - 1) == asset)
+    return;
+
+  g_ptr_array_add (list, asset);
+}
+
+void
+rig_asset_index_add (RigAssetIndex *index,
+                     RutAsset *asset)
+{
+  const GList *l;
+  const char *path;
+
+  if (g_hash_table_lookup (index->indexed, asset))
+    return;
+
+  g_hash_table_insert (index->indexed, asset, asset);
+  g_ptr_array_add (index->assets, asset);
+
+  for (l = rut_asset_get_inferred_tags (asset); l; l = l->next)
+    add_posting (index->tags, (char *)g_intern_string (l->data), asset);
+
+  path = rut_asset_get_path (asset);
+  if (path)
+    {
+      int len = strlen (path);
+      int i;
+
+      for (i = 0; i + 3 <= len; i++)
+        add_posting (index->trigrams, TRIGRAM_KEY (path + i), asset);
+    }
+}
+
+static void
+remove_posting (GHashTable *postings, void *key, RutAsset *asset)
+{
+  GPtrArray *list = g_hash_table_lookup (postings, key);
+
+  /* NB: g_ptr_array_remove() preserves the order of the remaining
+   * assets */
+  if (list && g_ptr_array_remove (list, asset) && list->len == 0)
+    g_hash_table_remove (postings, key);
+}
+
+void
+rig_asset_index_remove (RigAssetIndex *index,
+                        RutAsset *asset)
+{
+  const GList *l;
+  const char *path;
+
+  if (!g_hash_table_remove (index->indexed, asset))
+    return;
+
+  g_ptr_array_remove (index->assets, asset);
+
+  for (l = rut_asset_get_inferred_tags (asset); l; l = l->next)
+    remove_posting (index->tags, (char *)g_intern_string (l->data), asset);
+
+  path = rut_asset_get_path (asset);
+  if (path)
+    {
+      int len = strlen (path);
+      int i;
+
+      for (i = 0; i + 3 <= len; i++)
+        remove_posting (index->trigrams, TRIGRAM_KEY (path + i), asset);
+    }
+}
+
+static GPtrArray *
+lookup_tag (RigAssetIndex *index, const char *tag)
+{
+  /* NB: We don't want to intern arbitrary search strings and if the
+   * string hasn't been interned then no asset can have that tag */
+  GQuark quark = g_quark_try_string (tag);
+
+  if (!quark)
+    return NULL;
+
+  return g_hash_table_lookup (index->tags, g_quark_to_string (quark));
+}
+
+/* Returns the shortest list of assets that could possibly contain
+ * @search in their path, or NULL if no asset can match. */
+static GPtrArray *
+lookup_path_candidates (RigAssetIndex *index, const char *search)
+{
+  int len = strlen (search);
+  GPtrArray *shortest = NULL;
+  int i;
+
+  if (len < 3)
+    return index->assets;
+
+  for (i = 0; i + 3 <= len; i++)
+    {
+      GPtrArray *list =
+        g_hash_table_lookup (index->trigrams, TRIGRAM_KEY (search + i));
+
+      if (!list)
+        return NULL;
+
+      if (!shortest || list->len < shortest->len)
+        shortest = list;
+    }
+
+  return shortest;
+}
+
+/* Returns the shortest list of assets that could possibly have all
+ * of the given tags, or NULL if no asset can match. */
+static GPtrArray *
+lookup_tag_candidates (RigAssetIndex *index, char **words)
+{
+  GPtrArray *shortest = NULL;
+  int i;
+
+  if (!words[0])
+    return index->assets;
+
+  for (i = 0; words[i]; i++)
+    {
+      GPtrArray *list = lookup_tag (index, words[i]);
+
+      if (!list)
+        return NULL;
+
+      if (!shortest || list->len < shortest->len)
+        shortest = list;
+    }
+
+  return shortest;
+}
+
+static bool
+asset_matches (RutAsset *asset,
+               const GList *required_tags,
+               const char *search,
+               char **words)
+{
+  const GList *l;
+  const char *path;
+  int i;
+
+  if (required_tags)
+    {
+      for (l = required_tags; l; l = l->next)
+        if (rut_asset_has_tag (asset, l->data))
+          break;
+
+      if (!l)
+        return false;
+    }
+
+  if (!search)
+    return true;
+
+  path = rut_asset_get_path (asset);
+  if (path && strstr (path, search))
+    return true;
+
+  for (i = 0; words[i]; i++)
+    if (!rut_asset_has_tag (asset, words[i]))
+      return false;
+
+  return true;
+}
+
+bool
+rig_asset_index_search (RigAssetIndex *index,
+                        const GList *required_tags,
+                        const char *search,
+                        RigAssetIndexCallback callback,
+                        void *user_data)
+{
+  GPtrArray *candidates[2];
+  int n_candidates = 0;
+  GHashTable *seen = NULL;
+  char **words = NULL;
+  bool found = false;
+  int i, j;
+
+  if (search)
+    {
+      words = g_strsplit_set (search, " \t", 0);
+
+      candidates[0] = lookup_path_candidates (index, search);
+      if (candidates[0])
+        n_candidates++;
+
+      if (candidates[0] != index->assets)
+        {
+          candidates[n_candidates] = lookup_tag_candidates (index, words);
+          if (candidates[n_candidates])
+            n_candidates++;
+        }
+    }
+  else if (required_tags && !required_tags->next)
+    {
+      candidates[0] = lookup_tag (index, required_tags->data);
+      if (candidates[0])
+        n_candidates++;
+    }
+  else
+    candidates[n_candidates++] = index->assets;
+
+  /* An asset may be in both the path and tag candidates but we only
+   * want to report it once */
+  if (n_candidates > 1 && candidates[0] != candidates[1])
+    seen = g_hash_table_new (NULL, NULL);
+  else if (n_candidates > 1)
+    n_candidates = 1;
+
+  for (i = 0; i < n_candidates; i++)
+    {
+      GPtrArray *list = candidates[i];
+
+      for (j = 0; j < list->len; j++)
+        {
+          RutAsset *asset = g_ptr_array_index (list, j);
+
+          if (seen)
+            {
+              if (g_hash_table_lookup (seen, asset))
+                continue;
+              g_hash_table_insert (seen, asset, asset);
+            }
+
+          if (!asset_matches (asset, required_tags, search, words))
+            continue;
+
+          found = true;
+          callback (asset, user_data);
+        }
+    }
+
+  if (seen)
+    g_hash_table_destroy (seen);
+
+  g_strfreev (words);
+
+  return found;
+}
@@ -0,0 +1,83 @@
+/*
+ * Rig
+ *
+ * Copyright (C) 2013 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RIG_ASSET_INDEX_H_
+#define _RIG_ASSET_INDEX_H_
+
+#include <glib.h>
+
+#include "rut-asset.h"
+
+/*
+ * An inverted index for searching the assets shown in the editor's
+ * asset panel. Assets are indexed by their (interned) inferred tags
+ * and by the trigrams of their path so that a search only needs to
+ * consider the assets in the shortest matching posting list instead
+ * of every asset.
+ *
+ * The index doesn't take a reference on the assets so they must be
+ * removed via rig_asset_index_remove() or rig_asset_index_clear()
+ * before they are freed.
+ */
+typedef struct _RigAssetIndex RigAssetIndex;
+
+RigAssetIndex *
+rig_asset_index_new (void);
+
+void
+rig_asset_index_free (RigAssetIndex *index);
+
+/* Adding an asset that is already indexed is a NOP */
+void
+rig_asset_index_add (RigAssetIndex *index,
+                     RutAsset *asset);
+
+/* Removing an asset that isn't indexed is a NOP */
+void
+rig_asset_index_remove (RigAssetIndex *index,
+                        RutAsset *asset);
+
+void
+rig_asset_index_clear (RigAssetIndex *index);
+
+typedef void (*RigAssetIndexCallback) (RutAsset *asset, void *user_data);
+
+/*
+ * rig_asset_index_search:
+ * @index: A #RigAssetIndex
+ * @required_tags: A list of tags of which the asset must have at
+ *                 least one, or %NULL
+ * @search: The lowercase search text, or %NULL to match all assets
+ * @callback: Called once for each matching asset
+ * @user_data: Private data passed to @callback
+ *
+ * An asset matches @search if its path contains @search or if every
+ * whitespace separated word of @search is one of the asset's tags.
+ *
+ * Returns: %TRUE if any asset matched
+ */
+bool
+rig_asset_index_search (RigAssetIndex *index,
+                        const GList *required_tags,
+                        const char *search,
+                        RigAssetIndexCallback callback,
+                        void *user_data);
+
+#endif /* _RIG_ASSET_INDEX_H_ */
@@ -346,21 +346,28 @@ _rut_camera_view_paint (RutObject *object,
 
       rut_dof_effect_set_framebuffer_size (engine->dof, width, height);
 
-      pass_fb = rut_dof_effect_get_depth_pass_fb (engine->dof);
-      rut_camera_set_framebuffer (camera_component, pass_fb);
-      rut_camera_set_viewport (camera_component, 0, 0, width, height);
-
-      rut_camera_flush (camera_component);
-      cogl_framebuffer_clear4f (pass_fb,
-                                COGL_BUFFER_BIT_COLOR|COGL_BUFFER_BIT_DEPTH,
-                                1, 1, 1, 1);
-      rut_camera_end_frame (camera_component);
-
-      rig_paint_ctx->pass = RIG_PASS_DOF_DEPTH;
-      rig_paint_camera_entity (camera, rig_paint_ctx, NULL);
+      /* If the depth buffer of the color pass can be sampled then the
+       * blend factors are derived from that and the scene only needs
+       * to be painted once */
+      if (!rut_dof_effect_get_depth_from_color_pass (engine->dof))
+        {
+          pass_fb = rut_dof_effect_get_depth_pass_fb (engine->dof);
+          rut_camera_set_framebuffer (camera_component, pass_fb);
+          rut_camera_set_viewport (camera_component, 0, 0, width, height);
+
+          rut_camera_flush (camera_component);
+          cogl_framebuffer_clear4f (pass_fb,
+                                    COGL_BUFFER_BIT_COLOR|COGL_BUFFER_BIT_DEPTH,
+                                    1, 1, 1, 1);
+          rut_camera_end_frame (camera_component);
+
+          rig_paint_ctx->pass = RIG_PASS_DOF_DEPTH;
+          rig_paint_camera_entity (camera, rig_paint_ctx, NULL);
+        }
 
       pass_fb = rut_dof_effect_get_color_pass_fb (engine->dof);
       rut_camera_set_framebuffer (camera_component, pass_fb);
+      rut_camera_set_viewport (camera_component, 0, 0, width, height);
 
       rut_camera_flush (camera_component);
       cogl_framebuffer_clear4f (pass_fb,
@@ -377,6 +384,12 @@ _rut_camera_view_paint (RutObject *object,
       rig_paint_ctx->pass = RIG_PASS_COLOR_BLENDED;
       rig_paint_camera_entity (camera, rig_paint_ctx, NULL);
 
+      rut_dof_effect_set_focal_parameters (
+                        engine->dof,
+                        rut_camera_get_projection (camera_component),
+                        rut_camera_get_focal_distance (camera_component),
+                        rut_camera_get_depth_of_field (camera_component));
+
       rut_camera_set_framebuffer (camera_component, fb);
       rut_camera_set_viewport (camera_component,
                                save_viewport_x,
@@ -1362,9 +1375,14 @@ entitygraph_pre_pick_cb (RutObject *object,
                                                RUT_COMPONENT_TYPE_GEOMETRY);
         }
 
-      /* Get a model we can pick against */
-      if (!(geometry &&
-            rut_object_is (geometry, RUT_INTERFACE_ID_MESHABLE) &&
+      if (!geometry)
+        return RUT_TRAVERSE_VISIT_CONTINUE;
+
+      /* Shapes and nine-slices are picked analytically, otherwise get
+       * a model we can pick against */
+      if (rut_object_get_type (geometry) != &rut_shape_type &&
+          rut_object_get_type (geometry) != &rut_nine_slice_type &&
+          !(rut_object_is (geometry, RUT_INTERFACE_ID_MESHABLE) &&
             (mesh = rut_meshable_get_mesh (geometry))))
         return RUT_TRAVERSE_VISIT_CONTINUE;
 
@@ -1382,11 +1400,28 @@ entitygraph_pre_pick_cb (RutObject *object,
                      transformed_ray_direction);
 
       /* intersect the transformed ray with the model engine */
-      hit = rut_util_intersect_mesh (mesh,
+      if (rut_object_get_type (geometry) == &rut_shape_type)
+        {
+          hit = rut_shape_pick (geometry,
+                                transformed_ray_origin,
+                                transformed_ray_direction,
+                                &distance);
+          index = 0;
+        }
+      else if (rut_object_get_type (geometry) == &rut_nine_slice_type)
+        {
+          hit = rut_nine_slice_pick (geometry,
                                      transformed_ray_origin,
                                      transformed_ray_direction,
-                                     &index,
                                      &distance);
+          index = 0;
+        }
+      else
+        hit = rut_util_intersect_mesh (mesh,
+                                       transformed_ray_origin,
+                                       transformed_ray_direction,
+                                       &index,
+                                       &distance);
 
       if (hit)
         {
@@ -93,6 +93,9 @@ static RutPropertySpec _rig_engine_prop_specs[] = {
 static void
 rig_load_asset_list (RigEngine *engine);
 
+static void
+free_asset_monitor (GFileMonitor *monitor);
+
 static RigObjectsSelection *
 _rig_objects_selection_new (RigEngine *engine);
 
@@ -102,6 +105,8 @@ bool _rig_in_editor_mode = FALSE;
 
 bool _rig_in_simulator_mode = FALSE;
 
+bool _rig_debug_input_events = FALSE;
+
 static RutTraverseVisitFlags
 scenegraph_pre_paint_cb (RutObject *object,
                          int depth,
@@ -200,6 +205,9 @@ rig_engine_paint (RigEngine *engine)
 
   rut_camera_set_framebuffer (engine->camera, fb);
 
+  rut_image_source_present_videos (engine->ctx);
+  rut_asset_process_thumbnails (engine->ctx);
+
   cogl_framebuffer_clear4f (fb,
                             COGL_BUFFER_BIT_COLOR|COGL_BUFFER_BIT_DEPTH,
                             0.9, 0.9, 0.9, 1);
@@ -218,6 +226,9 @@ rig_engine_paint (RigEngine *engine)
   rut_camera_end_frame (engine->camera);
 
   cogl_onscreen_swap_buffers (COGL_ONSCREEN (fb));
+
+  rut_asset_collect_textures (engine->ctx);
+  rut_render_target_collect (engine->ctx);
 }
 
 void
@@ -884,15 +895,46 @@ typedef struct _ResultInputClosure
   RigEngine *engine;
 } ResultInputClosure;
 
+/* A labelled group of search results such as "Images". The results
+ * are shown with a virtualised flow layout so that widgets only
+ * need to exist for the results that are scrolled into view. */
+struct _RigSearchSection
+{
+  RigEngine *engine;
+  RutBoxLayout *vbox;
+  RutFlowLayout *flow;
+
+  /* The results currently matched for this section in order. Each
+   * result is referenced by the array. */
+  GPtrArray *results;
+
+  /* Maps the widgets created for the flow layout to their
+   * ResultItem so they can be rebound to other results when
+   * they are recycled */
+  GHashTable *items;
+};
+
+typedef struct _ResultItem
+{
+  RutBin *bin;
+  RutDragBin *drag_bin;
+  RutBin *content_bin;
+  ResultInputClosure closure;
+
+  /* The texture shown when the result was bound so we can tell
+   * when an asset's thumbnail has changed */
+  CoglTexture *texture;
+} ResultItem;
+
 static void
-free_result_input_closures (RigEngine *engine)
+result_item_free (void *user_data)
 {
-  GList *l;
+  ResultItem *item = user_data;
+
+  if (item->texture)
+    cogl_object_unref (item->texture);
 
-  for (l = engine->result_input_closures; l; l = l->next)
-    g_slice_free (ResultInputClosure, l->data);
-  g_list_free (engine->result_input_closures);
-  engine->result_input_closures = NULL;
+  g_slice_free (ResultItem, item);
 }
 
 static void
@@ -1328,157 +1370,23 @@ result_input_cb (RutInputRegion *region,
   return status;
 }
 
-static CoglBool
-asset_matches_search (RigEngine *engine,
-                      RutAsset *asset,
-                      const char *search)
-{
-  GList *l;
-  bool found = false;
-  const GList *inferred_tags;
-  char **tags;
-  const char *path;
-  int i;
-
-  for (l = engine->required_search_tags; l; l = l->next)
-    {
-      if (rut_asset_has_tag (asset, l->data))
-        {
-          found = true;
-          break;
-        }
-    }
-
-  if (engine->required_search_tags && found == false)
-    return FALSE;
-
-  if (!search)
-    return TRUE;
-
-  inferred_tags = rut_asset_get_inferred_tags (asset);
-  tags = g_strsplit_set (search, " \t", 0);
-
-  path = rut_asset_get_path (asset);
-  if (path)
-    {
-      if (strstr (path, search))
-        return TRUE;
-    }
-
-  for (i = 0; tags[i]; i++)
-    {
-      const GList *l;
-      CoglBool found = FALSE;
-
-      for (l = inferred_tags; l; l = l->next)
-        {
-          if (strcmp (tags[i], l->data) == 0)
-            {
-              found = TRUE;
-              break;
-            }
-        }
-
-      if (!found)
-        {
-          g_strfreev (tags);
-          return FALSE;
-        }
-    }
-
-  g_strfreev (tags);
-  return TRUE;
-}
-
-static RutFlowLayout *
-add_results_flow (RutContext *ctx,
-                  const char *label,
-                  RutBoxLayout *vbox)
-{
-  RutFlowLayout *flow =
-    rut_flow_layout_new (ctx, RUT_FLOW_LAYOUT_PACKING_LEFT_TO_RIGHT);
-  RutText *text = rut_text_new_with_text (ctx, "Bold Sans 15px", label);
-  CoglColor color;
-  RutBin *label_bin = rut_bin_new (ctx);
-  RutBin *flow_bin = rut_bin_new (ctx);
-
-  rut_bin_set_left_padding (label_bin, 10);
-  rut_bin_set_top_padding (label_bin, 10);
-  rut_bin_set_bottom_padding (label_bin, 10);
-  rut_bin_set_child (label_bin, text);
-  rut_refable_unref (text);
-
-  rut_color_init_from_uint32 (&color, 0xffffffff);
-  rut_text_set_color (text, &color);
-
-  rut_box_layout_add (vbox, FALSE, label_bin);
-  rut_refable_unref (label_bin);
-
-  rut_flow_layout_set_x_padding (flow, 5);
-  rut_flow_layout_set_y_padding (flow, 5);
-  rut_flow_layout_set_max_child_height (flow, 100);
-
-  //rut_bin_set_left_padding (flow_bin, 5);
-  rut_bin_set_child (flow_bin, flow);
-  rut_refable_unref (flow);
-
-  rut_box_layout_add (vbox, TRUE, flow_bin);
-  rut_refable_unref (flow_bin);
-
-  return flow;
-}
-
-static void
-add_search_result (RigEngine *engine,
-                   RutObject *result)
+static RutObject *
+create_result_content (RigEngine *engine,
+                       RutObject *result,
+                       CoglTexture *texture)
 {
-  ResultInputClosure *closure;
-  RutStack *stack;
-  RutBin *bin;
-  CoglTexture *texture;
-  RutInputRegion *region;
-  RutDragBin *drag_bin;
-
-  closure = g_slice_new (ResultInputClosure);
-  closure->result = result;
-  closure->engine = engine;
-
-  bin = rut_bin_new (engine->ctx);
-
-  drag_bin = rut_drag_bin_new (engine->ctx);
-  rut_drag_bin_set_payload (drag_bin, result);
-  rut_bin_set_child (bin, drag_bin);
-  rut_refable_unref (drag_bin);
-
-  stack = rut_stack_new (engine->ctx, 0, 0);
-  rut_drag_bin_set_child (drag_bin, stack);
-  rut_refable_unref (stack);
-
-  region = rut_input_region_new_rectangle (0, 0, 100, 100,
-                                           result_input_cb,
-                                           closure);
-  rut_stack_add (stack, region);
-  rut_refable_unref (region);
-
   if (rut_object_get_type (result) == &rut_asset_type)
     {
       RutAsset *asset = result;
 
-      texture = rut_asset_get_texture (asset);
-
       if (texture)
-        {
-          RutImage *image = rut_image_new (engine->ctx, texture);
-          rut_stack_add (stack, image);
-          rut_refable_unref (image);
-        }
+        return rut_image_new (engine->ctx, texture);
       else
         {
           char *basename = g_path_get_basename (rut_asset_get_path (asset));
           RutText *text = rut_text_new_with_text (engine->ctx, NULL, basename);
-          rut_stack_add (stack, text);
-          rut_refable_unref (text);
           g_free (basename);
+          return text;
         }
     }
   else if (rut_object_get_type (result) == &rut_entity_type)
@@ -1490,9 +1398,6 @@ add_search_result (RigEngine *engine,
       RutImage *image;
       RutText *text;
 
-      rut_stack_add (stack, vbox);
-      rut_refable_unref (vbox);
-
 #warning "Create a sensible icon to represent entities"
       texture = rut_load_texture_from_data_file (engine->ctx,
                                                  "transparency-grid.png", NULL);
@@ -1505,8 +1410,10 @@ add_search_result (RigEngine *engine,
       text = rut_text_new_with_text (engine->ctx, NULL, entity->label);
       rut_box_layout_add (vbox, false, text);
       rut_refable_unref (text);
+
+      return vbox;
     }
-  else if (rut_object_get_type (result) == &rig_controller_type)
+  else
     {
       RigController *controller = result;
       RutBoxLayout *vbox =
@@ -1515,9 +1422,6 @@ add_search_result (RigEngine *engine,
       RutImage *image;
       RutText *text;
 
-      rut_stack_add (stack, vbox);
-      rut_refable_unref (vbox);
-
 #warning "Create a sensible icon to represent controllers"
       texture = rut_load_texture_from_data_file (engine->ctx,
                                                  "transparency-grid.png", NULL);
@@ -1530,7 +1434,170 @@ add_search_result (RigEngine *engine,
       text = rut_text_new_with_text (engine->ctx, NULL, controller->label);
       rut_box_layout_add (vbox, FALSE, text);
       rut_refable_unref (text);
+
+      return vbox;
+    }
+}
+
+static ResultItem *
+create_result_item (RigSearchSection *section)
+{
+  RigEngine *engine = section->engine;
+  ResultItem *item = g_slice_new0 (ResultItem);
+  RutStack *stack;
+  RutInputRegion *region;
+
+  item->closure.engine = engine;
+
+  item->bin = rut_bin_new (engine->ctx);
+
+  item->drag_bin = rut_drag_bin_new (engine->ctx);
+  rut_bin_set_child (item->bin, item->drag_bin);
+  rut_refable_unref (item->drag_bin);
+
+  stack = rut_stack_new (engine->ctx, 0, 0);
+  rut_drag_bin_set_child (item->drag_bin, stack);
+  rut_refable_unref (stack);
+
+  region = rut_input_region_new_rectangle (0, 0, 100, 100,
+                                           result_input_cb,
+                                           &item->closure);
+  rut_stack_add (stack, region);
+  rut_refable_unref (region);
+
+  item->content_bin = rut_bin_new (engine->ctx);
+  rut_stack_add (stack, item->content_bin);
+  rut_refable_unref (item->content_bin);
+
+  g_hash_table_insert (section->items, item->bin, item);
+
+  return item;
+}
+
+static void
+bind_result_item (RigSearchSection *section,
+                  ResultItem *item,
+                  RutObject *result)
+{
+  CoglTexture *texture = NULL;
+  RutObject *content;
+
+  /* NB: asset data is loaded lazily so this is the point where an
+   * asset's texture is first loaded */
+  if (rut_object_get_type (result) == &rut_asset_type)
+    texture = rut_asset_get_texture (result);
+
+  if (item->closure.result == result && item->texture == texture)
+    return;
+
+  item->closure.result = result;
+  rut_drag_bin_set_payload (item->drag_bin, result);
+
+  if (item->texture)
+    cogl_object_unref (item->texture);
+  item->texture = texture ? cogl_object_ref (texture) : NULL;
+
+  content = create_result_content (section->engine, result, texture);
+  rut_bin_set_child (item->content_bin, content);
+  rut_refable_unref (content);
+}
+
+static RutObject *
+result_item_cb (RutFlowLayout *flow,
+                int index,
+                RutObject *recycle_widget,
+                void *user_data)
+{
+  RigSearchSection *section = user_data;
+  RutObject *result = g_ptr_array_index (section->results, index);
+  ResultItem *item;
+
+  if (recycle_widget)
+    {
+      item = g_hash_table_lookup (section->items, recycle_widget);
+      rut_refable_ref (item->bin);
     }
+  else
+    item = create_result_item (section);
+
+  bind_result_item (section, item, result);
+
+  return item->bin;
+}
+
+static RigSearchSection *
+add_results_section (RigEngine *engine,
+                     const char *label)
+{
+  RutContext *ctx = engine->ctx;
+  RigSearchSection *section = g_slice_new (RigSearchSection);
+  RutBoxLayout *vbox =
+    rut_box_layout_new (ctx, RUT_BOX_LAYOUT_PACKING_TOP_TO_BOTTOM);
+  RutFlowLayout *flow =
+    rut_flow_layout_new (ctx, RUT_FLOW_LAYOUT_PACKING_LEFT_TO_RIGHT);
+  RutText *text = rut_text_new_with_text (ctx, "Bold Sans 15px", label);
+  CoglColor color;
+  RutBin *label_bin = rut_bin_new (ctx);
+  RutBin *flow_bin = rut_bin_new (ctx);
+
+  section->engine = engine;
+  section->results =
+    g_ptr_array_new_with_free_func ((GDestroyNotify)rut_refable_unref);
+  section->items = g_hash_table_new_full (NULL, NULL,
+                                          NULL, result_item_free);
+
+  rut_bin_set_left_padding (label_bin, 10);
+  rut_bin_set_top_padding (label_bin, 10);
+  rut_bin_set_bottom_padding (label_bin, 10);
+  rut_bin_set_child (label_bin, text);
+  rut_refable_unref (text);
+
+  rut_color_init_from_uint32 (&color, 0xffffffff);
+  rut_text_set_color (text, &color);
+
+  rut_box_layout_add (vbox, FALSE, label_bin);
+  rut_refable_unref (label_bin);
+
+  rut_flow_layout_set_x_padding (flow, 5);
+  rut_flow_layout_set_y_padding (flow, 5);
+  rut_flow_layout_set_data_source (flow, 100, 100, result_item_cb, section);
+  rut_flow_layout_set_viewport (flow, engine->search_vp);
+
+  //rut_bin_set_left_padding (flow_bin, 5);
+  rut_bin_set_child (flow_bin, flow);
+  rut_refable_unref (flow);
+
+  rut_box_layout_add (vbox, TRUE, flow_bin);
+  rut_refable_unref (flow_bin);
+
+  rut_box_layout_add (engine->search_results_vbox, TRUE, vbox);
+  rut_refable_unref (vbox);
+
+  section->vbox = vbox;
+  section->flow = flow;
+
+  return section;
+}
+
+static void
+free_search_section (RigSearchSection **section)
+{
+  if (*section)
+    {
+      g_ptr_array_free ((*section)->results, TRUE);
+      g_hash_table_destroy ((*section)->items);
+      g_slice_free (RigSearchSection, *section);
+      *section = NULL;
+    }
+}
+
+static RigSearchSection **
+get_result_section (RigEngine *engine,
+                    RutObject *result,
+                    const char **label_p)
+{
+  const char *label;
+  RigSearchSection **section;
 
   if (rut_object_get_type (result) == &rut_asset_type)
     {
@@ -1538,89 +1605,40 @@ add_search_result (RigEngine *engine,
 
       if (rut_asset_has_tag (asset, "geometry"))
         {
-          if (!engine->assets_geometry_results)
-            {
-              engine->assets_geometry_results =
-                add_results_flow (engine->ctx,
-                                  "Geometry",
-                                  engine->search_results_vbox);
-            }
-
-          rut_flow_layout_add (engine->assets_geometry_results, bin);
-          rut_refable_unref (bin);
+          section = &engine->assets_geometry_results;
+          label = "Geometry";
         }
       else if (rut_asset_has_tag (asset, "image"))
         {
-          if (!engine->assets_image_results)
-            {
-              engine->assets_image_results =
-                add_results_flow (engine->ctx,
-                                  "Images",
-                                  engine->search_results_vbox);
-            }
-
-          rut_flow_layout_add (engine->assets_image_results, bin);
-          rut_refable_unref (bin);
+          section = &engine->assets_image_results;
+          label = "Images";
         }
       else if (rut_asset_has_tag (asset, "video"))
         {
-          if (!engine->assets_video_results)
-            {
-              engine->assets_video_results =
-                add_results_flow (engine->ctx,
-                                  "Video",
-                                  engine->search_results_vbox);
-            }
-
-          rut_flow_layout_add (engine->assets_video_results, bin);
-          rut_refable_unref (bin);
+          section = &engine->assets_video_results;
+          label = "Video";
         }
       else
         {
-          if (!engine->assets_other_results)
-            {
-              engine->assets_other_results =
-                add_results_flow (engine->ctx,
-                                  "Other",
-                                  engine->search_results_vbox);
-            }
-
-          rut_flow_layout_add (engine->assets_other_results, bin);
-          rut_refable_unref (bin);
+          section = &engine->assets_other_results;
+          label = "Other";
         }
     }
   else if (rut_object_get_type (result) == &rut_entity_type)
     {
-      if (!engine->entity_results)
-        {
-          engine->entity_results =
-            add_results_flow (engine->ctx,
-                              "Entity",
-                              engine->search_results_vbox);
-        }
-
-      rut_flow_layout_add (engine->entity_results, bin);
-      rut_refable_unref (bin);
+      section = &engine->entity_results;
+      label = "Entity";
     }
-  else if (rut_object_get_type (result) == &rig_controller_type)
+  else
     {
-      if (!engine->controller_results)
-        {
-          engine->controller_results =
-            add_results_flow (engine->ctx,
-                              "Controllers",
-                              engine->search_results_vbox);
-        }
-
-      rut_flow_layout_add (engine->controller_results, bin);
-      rut_refable_unref (bin);
+      section = &engine->controller_results;
+      label = "Controllers";
     }
 
+  if (label_p)
+    *label_p = label;
 
-  /* XXX: It could be nicer to have some form of weak pointer
-   * mechanism to manage the lifetime of these closures... */
-  engine->result_input_closures = g_list_prepend (engine->result_input_closures,
-                                               closure);
+  return section;
 }
 
 static void
@@ -1628,8 +1646,24 @@ clear_search_results (RigEngine *engine)
 {
   if (engine->search_results_vbox)
     {
+      RigSearchSection **sections[] = {
+          &engine->entity_results,
+          &engine->controller_results,
+          &engine->assets_geometry_results,
+          &engine->assets_image_results,
+          &engine->assets_video_results,
+          &engine->assets_other_results
+      };
+      int i;
+
+      /* The viewport may be destroyed before the flow layouts */
+      for (i = 0; i < G_N_ELEMENTS (sections); i++)
+        {
+          if (*sections[i])
+            rut_flow_layout_set_viewport ((*sections[i])->flow, NULL);
+        }
+
       rut_fold_set_child (engine->search_results_fold, NULL);
-      free_result_input_closures (engine);
 
       /* NB: We don't maintain any additional references on asset
        * result widgets beyond the references for them being in the
@@ -1639,12 +1673,8 @@ clear_search_results (RigEngine *engine)
 
       engine->search_results_vbox = NULL;
 
-      engine->entity_results = NULL;
-      engine->controller_results = NULL;
-      engine->assets_geometry_results = NULL;
-      engine->assets_image_results = NULL;
-      engine->assets_video_results = NULL;
-      engine->assets_other_results = NULL;
+      for (i = 0; i < G_N_ELEMENTS (sections); i++)
+        free_search_section (sections[i]);
     }
 }
 
@@ -1652,6 +1682,7 @@ typedef struct _SearchState
 {
   RigEngine *engine;
   const char *search;
+  GPtrArray *results;
   bool found;
 } SearchState;
 
@@ -1668,7 +1699,7 @@ add_matching_entity_cb (RutObject *object,
       if (state->search == NULL)
         {
           state->found = true;
-          add_search_result (state->engine, entity);
+          g_ptr_array_add (state->results, entity);
         }
       else if (entity->label &&
                strncmp (entity->label, "rig:", 4) != 0)
@@ -1679,7 +1710,7 @@ add_matching_entity_cb (RutObject *object,
           if (strstr (entity_label, state->search))
             {
               state->found = true;
-              add_search_result (state->engine, entity);
+              g_ptr_array_add (state->results, entity);
             }
 
           g_free (entity_label);
@@ -1699,17 +1730,27 @@ add_matching_controller (RigController *controller,
       strstr (controller_label, state->search))
     {
       state->found = true;
-      add_search_result (state->engine, controller);
+      g_ptr_array_add (state->results, controller);
     }
 
   g_free (controller_label);
 }
 
+static void
+add_matching_asset_cb (RutAsset *asset, void *user_data)
+{
+  SearchState *state = user_data;
+
+  g_ptr_array_add (state->results, asset);
+}
+
+/* Collects the objects matching @user_search into @results */
 static bool
-rig_search_with_text (RigEngine *engine, const char *user_search)
+rig_search_with_text (RigEngine *engine,
+                      const char *user_search,
+                      GPtrArray *results)
 {
   GList *l;
-  int i;
   CoglBool found = FALSE;
   SearchState state;
   char *search;
@@ -1720,29 +1761,17 @@ rig_search_with_text (RigEngine *engine, const char *user_search)
     search = NULL;
 #warning "FIXME: handle non-ascii searches!"
 
-  clear_search_results (engine);
-
-  engine->search_results_vbox =
-    rut_box_layout_new (engine->ctx, RUT_BOX_LAYOUT_PACKING_TOP_TO_BOTTOM);
-  rut_fold_set_child (engine->search_results_fold,
-                      engine->search_results_vbox);
-  rut_refable_unref (engine->search_results_vbox);
-
-  for (l = engine->assets, i= 0; l; l = l->next, i++)
-    {
-      RutAsset *asset = l->data;
-
-      if (!asset_matches_search (engine, asset, search))
-        continue;
-
-      found = TRUE;
-      add_search_result (engine, asset);
-    }
-
   state.engine = engine;
   state.search = search;
+  state.results = results;
   state.found = FALSE;
 
+  found = rig_asset_index_search (engine->asset_index,
+                                  engine->required_search_tags,
+                                  search,
+                                  add_matching_asset_cb,
+                                  &state);
+
   if (!engine->required_search_tags ||
       rut_util_find_tag (engine->required_search_tags, "entity"))
     {
@@ -1776,18 +1805,119 @@ rig_search_with_text (RigEngine *engine, const char *user_search)
     }
 }
 
+/* Updates the result sections to match @results. Each section is a
+ * virtualised flow layout so this only needs to update the list of
+ * results for each section and the flow layout will then rebind the
+ * widgets that are visible. */
+static void
+update_search_results (RigEngine *engine,
+                       GPtrArray *results)
+{
+  RigSearchSection **sections[] = {
+      &engine->assets_geometry_results,
+      &engine->assets_image_results,
+      &engine->assets_video_results,
+      &engine->assets_other_results,
+      &engine->entity_results,
+      &engine->controller_results
+  };
+  const char *labels[G_N_ELEMENTS (sections)] = { NULL };
+  GPtrArray *section_results[G_N_ELEMENTS (sections)];
+  int i, j;
+
+  if (!engine->search_results_vbox)
+    {
+      engine->search_results_vbox =
+        rut_box_layout_new (engine->ctx,
+                            RUT_BOX_LAYOUT_PACKING_TOP_TO_BOTTOM);
+      rut_fold_set_child (engine->search_results_fold,
+                          engine->search_results_vbox);
+      rut_refable_unref (engine->search_results_vbox);
+    }
+
+  /* NB: the flow layouts only create widgets for the visible results
+   * so the sections need to keep the results alive in case they get
+   * deleted while they are still shown */
+  for (i = 0; i < G_N_ELEMENTS (sections); i++)
+    {
+      section_results[i] =
+        g_ptr_array_new_with_free_func ((GDestroyNotify)rut_refable_unref);
+    }
+
+  for (i = 0; i < results->len; i++)
+    {
+      RutObject *result = g_ptr_array_index (results, i);
+      const char *label;
+      RigSearchSection **section = get_result_section (engine, result, &label);
+
+      for (j = 0; sections[j] != section; j++)
+        ;
+
+      labels[j] = label;
+      g_ptr_array_add (section_results[j], rut_refable_ref (result));
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (sections); i++)
+    {
+      RigSearchSection **section = sections[i];
+
+      if (section_results[i]->len == 0)
+        {
+          /* Remove the whole section when it's empty so we don't
+           * leave behind a dangling label */
+          if (*section)
+            {
+              rut_flow_layout_set_viewport ((*section)->flow, NULL);
+              rut_box_layout_remove (engine->search_results_vbox,
+                                     (*section)->vbox);
+              free_search_section (section);
+            }
+
+          g_ptr_array_free (section_results[i], TRUE);
+          continue;
+        }
+
+      if (!*section)
+        *section = add_results_section (engine, labels[i]);
+
+      g_ptr_array_free ((*section)->results, TRUE);
+      (*section)->results = section_results[i];
+
+      rut_flow_layout_set_n_items ((*section)->flow,
+                                   section_results[i]->len);
+      rut_flow_layout_items_changed ((*section)->flow);
+    }
+}
+
 static void
 rig_run_search (RigEngine *engine)
 {
-  if (!rig_search_with_text (engine, rut_text_get_text (engine->search_text)))
-    rig_search_with_text (engine, NULL);
+  GPtrArray *results = g_ptr_array_new ();
+
+  if (!rig_search_with_text (engine,
+                             rut_text_get_text (engine->search_text),
+                             results))
+    {
+      g_ptr_array_set_size (results, 0);
+      rig_search_with_text (engine, NULL, results);
+    }
+
+  update_search_results (engine, results);
+
+  g_ptr_array_free (results, TRUE);
 }
 
 static void
-rig_refresh_thumbnails (RutAsset *video,
+rig_refresh_thumbnails (RutAsset *asset,
                         void *user_data)
 {
-  rig_run_search (user_data);
+  RigEngine *engine = user_data;
+  RigSearchSection *section = *get_result_section (engine, asset, NULL);
+
+  /* NB: only widgets whose asset's texture has changed will be
+   * rebound */
+  if (section)
+    rut_flow_layout_items_changed (section->flow);
 }
 
 static void
@@ -2932,8 +3062,6 @@ create_debug_gradient (RigEngine *engine)
 void
 rig_engine_handle_ui_update (RigEngine *engine)
 {
-  CoglTexture2D *color_buffer;
-
   rig_camera_view_set_scene (engine->main_camera_view, engine->scene);
 
   if (!_rig_in_simulator_mode)
@@ -2944,30 +3072,24 @@ rig_engine_handle_ui_update (RigEngine *engine)
 
       /* Setup the shadow map */
 
-      g_warn_if_fail (engine->shadow_color == NULL);
-
-      color_buffer = cogl_texture_2d_new_with_size (rut_cogl_context,
-                                                    engine->device_width * 2,
-                                                    engine->device_height * 2);
-
-      engine->shadow_color = color_buffer;
-
-      g_warn_if_fail (engine->shadow_fb == NULL);
+      g_warn_if_fail (engine->shadow_target == NULL);
 
       /* XXX: Right now there's no way to avoid allocating a color buffer. */
+      engine->shadow_target =
+        rut_render_target_acquire (engine->ctx,
+                                   engine->device_width * 2,
+                                   engine->device_height * 2,
+                                   COGL_TEXTURE_COMPONENTS_RGBA,
+                                   RUT_RENDER_TARGET_FLAG_DEPTH_TEXTURE);
+
       engine->shadow_fb =
-        cogl_offscreen_new_with_texture (color_buffer);
-      if (engine->shadow_fb == NULL)
-        g_critical ("could not create offscreen buffer");
+        rut_render_target_get_framebuffer (engine->shadow_target);
+      engine->shadow_color =
+        rut_render_target_get_texture (engine->shadow_target);
 
       /* retrieve the depth texture */
-      cogl_framebuffer_set_depth_texture_enabled (engine->shadow_fb,
-                                                  TRUE);
-
-      g_warn_if_fail (engine->shadow_map == NULL);
-
       engine->shadow_map =
-        cogl_framebuffer_get_depth_texture (engine->shadow_fb);
+        rut_render_target_get_depth_texture (engine->shadow_target);
 
       /* Note: we currently require having exactly one scene light and
        * play camera, so if we didn't already load them we create a default
@@ -3027,37 +3149,34 @@ rig_engine_free_ui (RigEngine *engine)
     }
 #endif
 
-  if (engine->shadow_color)
+  if (engine->shadow_target)
     {
-      cogl_object_unref (engine->shadow_color);
+      rut_render_target_release (engine->shadow_target);
+      engine->shadow_target = NULL;
+      engine->shadow_fb = NULL;
       engine->shadow_color = NULL;
-    }
-
-  if (engine->shadow_map)
-    {
-      cogl_object_unref (engine->shadow_map);
       engine->shadow_map = NULL;
     }
 
-  if (engine->shadow_fb)
-    {
-      cogl_object_unref (engine->shadow_fb);
-      engine->shadow_fb = NULL;
-    }
-
   for (l = engine->controllers; l; l = l->next)
     rut_refable_unref (l->data);
   g_list_free (engine->controllers);
   engine->controllers = NULL;
   engine->selected_controller = NULL;
 
+#ifdef RIG_EDITOR_ENABLED
+  /* NB: the monitors are removed first so that the assets list can't
+   * change while it's being freed */
+  g_hash_table_remove_all (engine->asset_monitors);
+  g_hash_table_remove_all (engine->assets_by_path);
+  rig_asset_index_clear (engine->asset_index);
+#endif
+
   for (l = engine->assets; l; l = l->next)
     rut_refable_unref (l->data);
   g_list_free (engine->assets);
   engine->assets = NULL;
 
-  free_result_input_closures (engine);
-
   /* NB: no extra reference is held on the light other than the
    * reference for it being in the scenegraph. */
   engine->light = NULL;
@@ -3113,6 +3232,10 @@ _rig_engine_free (void *object)
   RutShell *shell = engine->shell;
   int i;
 
+#ifdef RIG_EDITOR_ENABLED
+  rig_save_wait (engine);
+#endif
+
   if (!_rig_in_simulator_mode)
     {
       rig_renderer_fini (engine);
@@ -3176,6 +3299,12 @@ _rig_engine_free (void *object)
       engine->simulator = NULL;
     }
 
+#ifdef RIG_EDITOR_ENABLED
+  g_hash_table_destroy (engine->asset_monitors);
+  g_hash_table_destroy (engine->assets_by_path);
+  rig_asset_index_free (engine->asset_index);
+#endif
+
   rut_simple_introspectable_destroy (engine);
 
   g_slice_free (RigEngine, engine);
@@ -3224,6 +3353,9 @@ _rig_engine_new_full (RutShell *shell,
   engine->shell = shell;
   engine->ctx = rut_shell_get_context (shell);
 
+  _rig_debug_input_events =
+    rut_util_is_boolean_env_set ("RIG_DEBUG_INPUT_EVENTS");
+
   if (ui_filename)
     engine->ui_filename = g_strdup (ui_filename);
 
@@ -3302,6 +3434,15 @@ _rig_engine_new_full (RutShell *shell,
 
   engine->serialization_stack = rut_memory_stack_new (8192);
 
+#ifdef RIG_EDITOR_ENABLED
+  engine->asset_index = rig_asset_index_new ();
+  engine->assets_by_path = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                  g_free, NULL);
+  engine->asset_monitors =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free, (GDestroyNotify)free_asset_monitor);
+#endif
+
   engine->assets_registry = g_hash_table_new_full (g_str_hash,
                                                    g_str_equal,
                                                    g_free,
@@ -3644,26 +3785,323 @@ rig_load_asset (RigEngine *engine, GFileInfo *info, GFile *asset_file)
 
 #ifdef RIG_EDITOR_ENABLED
 
+static void
+track_asset (RigEngine *engine, RutAsset *asset)
+{
+  const char *path = rut_asset_get_path (asset);
+
+  /* NB: builtin asset paths don't correspond to files in the assets
+   * location */
+  if (rut_asset_get_type (asset) == RUT_ASSET_TYPE_BUILTIN)
+    return;
+
+  if (path && !g_hash_table_lookup (engine->assets_by_path, path))
+    g_hash_table_insert (engine->assets_by_path, g_strdup (path), asset);
+}
+
 static void
 add_asset (RigEngine *engine, GFileInfo *info, GFile *asset_file)
 {
   GFile *assets_dir = g_file_new_for_path (engine->ctx->assets_location);
   char *path = g_file_get_relative_path (assets_dir, asset_file);
-  GList *l;
   RutAsset *asset = NULL;
 
+  g_object_unref (assets_dir);
+
   /* Avoid loading duplicate assets... */
-  for (l = engine->assets; l; l = l->next)
+  if (!path || g_hash_table_lookup (engine->assets_by_path, path))
     {
-      RutAsset *existing = l->data;
-
-      if (strcmp (rut_asset_get_path (existing), path) == 0)
-        return;
+      g_free (path);
+      return;
     }
 
   asset = rig_load_asset (engine, info, asset_file);
   if (asset)
-    engine->assets = g_list_prepend (engine->assets, asset);
+    {
+      engine->assets = g_list_prepend (engine->assets, asset);
+      track_asset (engine, asset);
+      rig_asset_index_add (engine->asset_index, asset);
+    }
+
+  g_free (path);
+}
+
+static void
+remove_asset (RigEngine *engine, const char *path)
+{
+  RutAsset *asset = g_hash_table_lookup (engine->assets_by_path, path);
+
+  if (!asset)
+    return;
+
+  /* NB: the scene may still reference the asset in which case it
+   * will live on until it's no longer used */
+  rig_asset_index_remove (engine->asset_index, asset);
+  engine->assets = g_list_remove (engine->assets, asset);
+  g_hash_table_remove (engine->assets_by_path, path);
+  rut_refable_unref (asset);
+}
+
+void
+enumerate_file_info (RigEngine *engine, GFile *parent, GFileInfo *info);
+
+static void
+free_asset_monitor (GFileMonitor *monitor)
+{
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+typedef struct _ReplaceModelState
+{
+  RigEngine *engine;
+  RutObject *old_model;
+  RutObject *new_model;
+} ReplaceModelState;
+
+static RutTraverseVisitFlags
+replace_model_cb (RutObject *object,
+                  int depth,
+                  void *user_data)
+{
+  ReplaceModelState *state = user_data;
+  RutEntity *entity;
+
+  if (rut_object_get_type (object) != &rut_entity_type)
+    return RUT_TRAVERSE_VISIT_CONTINUE;
+
+  entity = object;
+
+  if (rut_entity_get_component (entity, RUT_COMPONENT_TYPE_GEOMETRY) ==
+      state->old_model)
+    {
+      rut_entity_remove_component (entity, state->old_model);
+      rut_entity_add_component (entity, state->new_model);
+      rut_renderer_notify_entity_changed (state->engine->renderer, entity);
+    }
+
+  return RUT_TRAVERSE_VISIT_CONTINUE;
+}
+
+/* Updates an asset that is already loaded after its file has been
+ * modified. Materials and image sources keep pointing at the same
+ * asset so they pick up the new data but the entities using a model
+ * have to be switched over to the reloaded model. */
+static bool
+reload_asset (RigEngine *engine, RutAsset *asset)
+{
+  RutObject *old_model = NULL;
+
+  if (rut_asset_get_type (asset) == RUT_ASSET_TYPE_PLY_MODEL)
+    old_model = rut_refable_ref (rut_asset_get_model (asset));
+
+  if (!rut_asset_reload (asset))
+    {
+      if (old_model)
+        rut_refable_unref (old_model);
+      return false;
+    }
+
+  if (old_model)
+    {
+      ReplaceModelState state;
+
+      state.engine = engine;
+      state.old_model = old_model;
+      state.new_model = rut_asset_get_model (asset);
+
+      rut_graphable_traverse (engine->scene,
+                              RUT_TRAVERSE_DEPTH_FIRST,
+                              replace_model_cb,
+                              NULL, /* post visit */
+                              &state);
+
+      rut_refable_unref (old_model);
+    }
+
+  if (_rig_in_editor_mode && rut_asset_needs_thumbnail (asset))
+    rut_asset_thumbnail (asset, rig_refresh_thumbnails, engine, NULL);
+
+  rut_shell_queue_redraw (engine->ctx->shell);
+
+  return true;
+}
+
+/* Called when a file in the assets location has been written or
+ * moved into place. If the file was already loaded as an asset then
+ * it is reloaded in place. */
+static void
+reload_asset_file (RigEngine *engine, GFile *file)
+{
+  GFile *assets_dir = g_file_new_for_path (engine->ctx->assets_location);
+  char *path = g_file_get_relative_path (assets_dir, file);
+  RutAsset *asset;
+  GFile *parent;
+  GFileInfo *info;
+
+  g_object_unref (assets_dir);
+
+  if (!path)
+    return;
+
+  asset = g_hash_table_lookup (engine->assets_by_path, path);
+  if (asset && reload_asset (engine, asset))
+    {
+      g_free (path);
+      return;
+    }
+
+  /* If it couldn't be reloaded then it's loaded again from scratch */
+  remove_asset (engine, path);
+  g_free (path);
+
+  info = g_file_query_info (file,
+                            "standard::*",
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+  if (!info)
+    return;
+
+  parent = g_file_get_parent (file);
+  enumerate_file_info (engine, parent, info);
+  g_object_unref (parent);
+
+  g_object_unref (info);
+}
+
+/* Called when a file or directory in the assets location has been
+ * deleted or moved away */
+static void
+remove_asset_file (RigEngine *engine, GFile *file)
+{
+  GFile *assets_dir = g_file_new_for_path (engine->ctx->assets_location);
+  char *path = g_file_get_relative_path (assets_dir, file);
+  char *abs_path = g_file_get_path (file);
+  char *prefix;
+  GHashTableIter iter;
+  void *key;
+  GPtrArray *removed;
+  int i;
+
+  g_object_unref (assets_dir);
+
+  if (!path)
+    {
+      g_free (abs_path);
+      return;
+    }
+
+  remove_asset (engine, path);
+
+  /* If it was a directory then everything beneath it has gone too */
+  if (g_hash_table_lookup (engine->asset_monitors, abs_path))
+    {
+      removed = g_ptr_array_new_with_free_func (g_free);
+
+      prefix = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
+      g_hash_table_iter_init (&iter, engine->assets_by_path);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          if (g_str_has_prefix (key, prefix))
+            g_ptr_array_add (removed, g_strdup (key));
+        }
+      g_free (prefix);
+
+      for (i = 0; i < removed->len; i++)
+        remove_asset (engine, g_ptr_array_index (removed, i));
+
+      g_hash_table_remove (engine->asset_monitors, abs_path);
+
+      prefix = g_strconcat (abs_path, G_DIR_SEPARATOR_S, NULL);
+      g_hash_table_iter_init (&iter, engine->asset_monitors);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        {
+          if (g_str_has_prefix (key, prefix))
+            g_hash_table_iter_remove (&iter);
+        }
+      g_free (prefix);
+
+      g_ptr_array_free (removed, TRUE);
+    }
+
+  g_free (abs_path);
+  g_free (path);
+}
+
+static void
+assets_dir_changed_cb (GFileMonitor *monitor,
+                       GFile *file,
+                       GFile *other_file,
+                       GFileMonitorEvent event_type,
+                       void *user_data)
+{
+  RigEngine *engine = user_data;
+
+  switch (event_type)
+    {
+    case G_FILE_MONITOR_EVENT_CREATED:
+      /* New files are only loaded once they have been completely
+       * written, as indicated by a CHANGES_DONE_HINT event, but new
+       * directories need to be enumerated and monitored straight
+       * away */
+      if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) !=
+          G_FILE_TYPE_DIRECTORY)
+        return;
+      reload_asset_file (engine, file);
+      break;
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+      reload_asset_file (engine, file);
+      break;
+    case G_FILE_MONITOR_EVENT_DELETED:
+      remove_asset_file (engine, file);
+      break;
+    case G_FILE_MONITOR_EVENT_MOVED:
+      remove_asset_file (engine, file);
+      if (other_file)
+        reload_asset_file (engine, other_file);
+      break;
+    default:
+      return;
+    }
+
+  /* Update the search results so that removed assets are no longer
+   * shown and reloaded assets are rebound */
+  rig_run_search (engine);
+}
+
+static void
+monitor_dir_for_assets (RigEngine *engine,
+                        GFile *directory)
+{
+  char *abs_path = g_file_get_path (directory);
+  GFileMonitor *monitor;
+  GError *error = NULL;
+
+  if (g_hash_table_lookup (engine->asset_monitors, abs_path))
+    {
+      g_free (abs_path);
+      return;
+    }
+
+  monitor = g_file_monitor_directory (directory,
+                                      G_FILE_MONITOR_SEND_MOVED,
+                                      NULL,
+                                      &error);
+  if (!monitor)
+    {
+      g_warning ("Failed to monitor assets dir %s: %s",
+                 abs_path, error->message);
+      g_error_free (error);
+      g_free (abs_path);
+      return;
+    }
+
+  g_signal_connect (monitor, "changed",
+                    G_CALLBACK (assets_dir_changed_cb), engine);
+
+  /* NB: the table takes ownership of abs_path */
+  g_hash_table_insert (engine->asset_monitors, abs_path, monitor);
 }
 
 #if 0
@@ -3830,6 +4268,10 @@ enumerate_dir_for_assets (RigEngine *engine,
   GError *error = NULL;
   GFileInfo *file_info;
 
+  /* NB: the monitor is added before enumerating so we don't miss any
+   * files that are added while enumerating */
+  monitor_dir_for_assets (engine, file);
+
   enumerator = g_file_enumerate_children (file,
                                           "standard::*",
                                           G_FILE_QUERY_INFO_NONE,
@@ -3850,6 +4292,7 @@ enumerate_dir_for_assets (RigEngine *engine,
                                                    &error)))
     {
       enumerate_file_info (engine, file, file_info);
+      g_object_unref (file_info);
     }
 
   g_object_unref (enumerator);
@@ -3860,6 +4303,12 @@ static void
 rig_load_asset_list (RigEngine *engine)
 {
   GFile *assets_dir = g_file_new_for_path (engine->ctx->assets_location);
+  GList *l;
+
+  /* NB: the assets list may already contain assets loaded as part
+   * of the UI */
+  for (l = engine->assets; l; l = l->next)
+    track_asset (engine, l->data);
 
   enumerate_dir_for_assets (engine, assets_dir);
 
@@ -3893,6 +4342,14 @@ rig_load_asset_list (RigEngine *engine)
 
   g_object_unref (assets_dir);
 
+  /* NB: This also indexes any assets that were loaded as part of
+   * the UI */
+  for (l = engine->assets; l; l = l->next)
+    {
+      track_asset (engine, l->data);
+      rig_asset_index_add (engine->asset_index, l->data);
+    }
+
   rig_run_search (engine);
 }
 #endif
@@ -3900,10 +4357,7 @@ rig_load_asset_list (RigEngine *engine)
 void
 rig_engine_sync_slaves (RigEngine *engine)
 {
-  GList *l;
-
-  for (l = engine->slave_masters; l; l = l->next)
-    rig_slave_master_sync_ui (l->data);
+  rig_slave_master_group_sync_ui (engine, engine->slave_masters);
 }
 
 void
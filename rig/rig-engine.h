@@ -44,6 +44,7 @@ typedef enum _RigToolID
 #include "rig-osx.h"
 #include "rig-split-view.h"
 #include "rig-camera-view.h"
+#include "rig-asset-index.h"
 
 enum {
   RIG_ENGINE_PROP_WIDTH,
@@ -108,6 +109,8 @@ typedef struct _RigSimulator
 
 extern RutType rig_engine_type;
 
+typedef struct _RigSearchSection RigSearchSection;
+
 struct _RigEngine
 {
   RutObjectProps _base;
@@ -144,8 +147,20 @@ struct _RigEngine
 #ifdef RIG_EDITOR_ENABLED
   RutMemoryStack *serialization_stack;
 
+  /* A save being written in the background by rig_save() */
+  struct _RigSaveState *pending_save;
+
   RutText *search_text;
   GList *required_search_tags;
+  RigAssetIndex *asset_index;
+
+  /* Maps the path of each asset in the assets list to the asset so
+   * that the asset monitors can find the asset for a file */
+  GHashTable *assets_by_path;
+
+  /* Maps the absolute path of each directory in the assets location
+   * to a GFileMonitor that keeps the assets list up to date */
+  GHashTable *asset_monitors;
 
   RutList tool_changed_cb_list;
 #endif
@@ -155,9 +170,11 @@ struct _RigEngine
   GList *undo_journal_stack;
   RigUndoJournal *undo_journal;
 
-  /* shadow mapping */
-  CoglOffscreen *shadow_fb;
-  CoglTexture2D *shadow_color;
+  /* shadow mapping. The framebuffer and textures belong to the
+   * shadow_target render target. */
+  RutRenderTarget *shadow_target;
+  CoglFramebuffer *shadow_fb;
+  CoglTexture *shadow_color;
   CoglTexture *shadow_map;
 
   float device_width;
@@ -215,12 +232,12 @@ struct _RigEngine
   RutUIViewport *search_vp;
   RutFold *search_results_fold;
   RutBoxLayout *search_results_vbox;
-  RutFlowLayout *entity_results;
-  RutFlowLayout *controller_results;
-  RutFlowLayout *assets_geometry_results;
-  RutFlowLayout *assets_image_results;
-  RutFlowLayout *assets_video_results;
-  RutFlowLayout *assets_other_results;
+  RigSearchSection *entity_results;
+  RigSearchSection *controller_results;
+  RigSearchSection *assets_geometry_results;
+  RigSearchSection *assets_image_results;
+  RigSearchSection *assets_video_results;
+  RigSearchSection *assets_other_results;
 
   RutAsset *text_builtin_asset;
   RutAsset *circle_builtin_asset;
@@ -229,7 +246,6 @@ struct _RigEngine
   RutAsset *pointalism_grid_builtin_asset;
   RutAsset *hair_builtin_asset;
   RutAsset *button_input_builtin_asset;
-  GList *result_input_closures;
   GList *asset_enumerators;
 
   RutUIViewport *tool_vp;
@@ -312,6 +328,9 @@ struct _RigEngine
   CoglSnippet *pointalism_halo_snippet;
   CoglSnippet *pointalism_opaque_snippet;
   CoglSnippet *cache_position_snippet;
+  CoglSnippet *stretch_geometry_snippet;
+  CoglSnippet *tex_coord_scale_globals_snippet;
+  CoglSnippet *tex_coord_scale_snippet;
   CoglSnippet *hair_simple_snippet;
   CoglSnippet *hair_material_snippet;
   CoglSnippet *hair_vertex_snippet;
@@ -347,6 +366,16 @@ extern bool _rig_in_editor_mode;
 
 extern bool _rig_in_simulator_mode;
 
+/* Set via the RIG_DEBUG_INPUT_EVENTS environment variable to log each
+ * input event as it gets serialized or handled */
+extern bool _rig_debug_input_events;
+
+#define RIG_INPUT_EVENT_NOTE(...) \
+  G_STMT_START { \
+    if (G_UNLIKELY (_rig_debug_input_events)) \
+      g_print (__VA_ARGS__); \
+  } G_STMT_END
+
 extern RutType rig_objects_selection_type;
 
 RigEngine *
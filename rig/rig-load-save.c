@@ -22,79 +22,437 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 
 #include "rig.pb-c.h"
 #include "rig-engine.h"
 #include "rig-pb.h"
 
+/*
+ * A .rig file starts with a RigFileHeader which is followed by the
+ * packed Rig__UI scene. Large binary data such as mesh buffers is
+ * stored out of line in a blob section after the scene so that it
+ * can be referenced directly from the mapped file when loading
+ * instead of being copied. This includes both mesh buffers and the
+ * original data of other assets such as images and videos so that
+ * rig_load() only needs to parse the scene and unused assets are
+ * never paged in. Each blob is aligned to RIG_FILE_BLOB_ALIGNMENT
+ * so the data can be uploaded directly to attribute buffers and
+ * blobs larger than a page are page aligned so that touching one
+ * blob doesn't fault in the tail of its neighbour. The blob
+ * directory at the end of the file lists the offset and size of
+ * each blob, indexed by blob id.
+ *
+ * All integers are stored little endian.
+ *
+ * Files without the header are assumed to be a plain packed Rig__UI
+ * as written by older versions of Rig.
+ */
+
+#define RIG_FILE_MAGIC "RIG\0FILE"
+#define RIG_FILE_VERSION 1
+#define RIG_FILE_BLOB_ALIGNMENT 16
+#define RIG_FILE_PAGE_ALIGNMENT 4096
+
+typedef struct _RigFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t n_blobs;
+  uint64_t scene_offset;
+  uint64_t scene_size;
+  uint64_t directory_offset;
+} RigFileHeader;
+
+typedef struct _RigFileBlobEntry
+{
+  uint64_t offset;
+  uint64_t size;
+} RigFileBlobEntry;
+
+/* rig_save() only serializes the scene into a tree of protobuf
+ * messages on the main thread. The tree, along with the memory stack
+ * it was allocated from, is handed over to a separate thread which
+ * sizes, packs and writes it. The blobs referenced by the scene are
+ * immutable buffers so the snapshot simply takes a reference on
+ * them. The file is written to a temporary
+ * file alongside the target which is only renamed over the target
+ * once everything has been written and synced so that a crash
+ * mid-save can never leave a truncated project behind. */
+typedef struct _RigSaveState
+{
+  RigEngine *engine;
+
+  char *path;
+  char *tmp_path;
+
+  /* Owned by the save until it has finished */
+  Rig__UI *ui;
+  RutMemoryStack *serialization_stack;
+
+  uint8_t *scene;
+  size_t scene_size;
+
+  GPtrArray *blobs;
+  GHashTable *blob_ids;
+
+  GThread *thread;
+  bool error;
+} RigSaveState;
+
 typedef struct _BufferedFile
 {
-  ProtobufCBuffer base;
   FILE *fp;
+  size_t offset;
   CoglBool error;
 } BufferedFile;
 
 static void
-append_to_file (ProtobufCBuffer *buffer,
-                unsigned len,
-                const unsigned char *engine)
+write_to_file (BufferedFile *buffered_file,
+               const void *data,
+               size_t len)
 {
-  BufferedFile *buffered_file = (BufferedFile *)buffer;
-
-  if (buffered_file->error)
+  if (buffered_file->error || len == 0)
     return;
 
-  if (fwrite (engine, len, 1, buffered_file->fp) != 1)
+  if (fwrite (data, len, 1, buffered_file->fp) != 1)
     buffered_file->error = TRUE;
+
+  buffered_file->offset += len;
 }
 
-void
-rig_save (RigEngine *engine, const char *path)
+static void
+align_file (BufferedFile *buffered_file, size_t alignment)
 {
-  RigPBSerializer *serializer;
-  struct stat sb;
-  Rig__UI *ui;
-  char *rig_filename;
-  FILE *fp;
+  static const uint8_t zeros[RIG_FILE_PAGE_ALIGNMENT] = { 0 };
+  size_t aligned =
+    (buffered_file->offset + alignment - 1) & ~(alignment - 1);
+
+  g_return_if_fail (alignment <= RIG_FILE_PAGE_ALIGNMENT);
+
+  write_to_file (buffered_file, zeros, aligned - buffered_file->offset);
+}
+
+static uint32_t
+save_blob_cb (RutBuffer *blob, void *user_data)
+{
+  RigSaveState *state = user_data;
+  void *id;
+
+  /* Assets and meshes that were loaded from the previous file will
+   * be views into that file which we can reuse directly, but
+   * multiple references to the same buffer should still only be
+   * written once */
+  if (g_hash_table_lookup_extended (state->blob_ids, blob, NULL, &id))
+    return GPOINTER_TO_UINT (id);
+
+  g_ptr_array_add (state->blobs, rut_refable_ref (blob));
+  id = GUINT_TO_POINTER (state->blobs->len - 1);
+  g_hash_table_insert (state->blob_ids, blob, id);
+
+  return GPOINTER_TO_UINT (id);
+}
+
+static void
+write_file (RigSaveState *state, FILE *fp)
+{
+  GPtrArray *blobs = state->blobs;
+  RigFileHeader header;
+  RigFileBlobEntry *directory;
+  uint64_t scene_offset;
+  uint64_t directory_offset;
+  int i;
 
   BufferedFile buffered_file = {
-    { append_to_file },
-    NULL, /* file pointer */
+    fp,
+    0, /* offset */
     FALSE
   };
 
-  rig_filename = g_strdup (path);
+  /* The header is written last once we know all the offsets */
+  memset (&header, 0, sizeof (header));
+  write_to_file (&buffered_file, &header, sizeof (header));
+
+  scene_offset = buffered_file.offset;
+  write_to_file (&buffered_file, state->scene, state->scene_size);
 
-  fp = fopen (rig_filename, "w");
-  g_free (rig_filename);
+  directory = g_new (RigFileBlobEntry, blobs->len);
 
+  for (i = 0; i < blobs->len; i++)
+    {
+      RutBuffer *blob = g_ptr_array_index (blobs, i);
+
+      if (blob->size >= RIG_FILE_PAGE_ALIGNMENT)
+        align_file (&buffered_file, RIG_FILE_PAGE_ALIGNMENT);
+      else
+        align_file (&buffered_file, RIG_FILE_BLOB_ALIGNMENT);
+
+      directory[i].offset = GUINT64_TO_LE (buffered_file.offset);
+      directory[i].size = GUINT64_TO_LE (blob->size);
+
+      write_to_file (&buffered_file, blob->data, blob->size);
+    }
+
+  align_file (&buffered_file, RUT_UTIL_ALIGNOF (RigFileBlobEntry));
+  directory_offset = buffered_file.offset;
+  write_to_file (&buffered_file,
+                 directory, sizeof (RigFileBlobEntry) * blobs->len);
+
+  g_free (directory);
+
+  memcpy (header.magic, RIG_FILE_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (RIG_FILE_VERSION);
+  header.n_blobs = GUINT32_TO_LE (blobs->len);
+  header.scene_offset = GUINT64_TO_LE (scene_offset);
+  header.scene_size = GUINT64_TO_LE (state->scene_size);
+  header.directory_offset = GUINT64_TO_LE (directory_offset);
+
+  if (fseek (fp, 0, SEEK_SET) != 0)
+    buffered_file.error = TRUE;
+  write_to_file (&buffered_file, &header, sizeof (header));
+
+  if (buffered_file.error)
+    state->error = true;
+}
+
+static CoglBool
+save_finish_cb (void *user_data);
+
+static void *
+save_thread_cb (void *user_data)
+{
+  RigSaveState *state = user_data;
+  int fd;
+  FILE *fp;
+
+  state->scene_size = rig__ui__get_packed_size (state->ui);
+  state->scene = g_malloc (state->scene_size);
+  rig__ui__pack (state->ui, state->scene);
+
+  fd = g_mkstemp_full (state->tmp_path, O_WRONLY, 0666);
+  if (fd == -1)
+    {
+      g_warning ("Failed to create %s: %s",
+                 state->tmp_path, g_strerror (errno));
+      g_free (state->tmp_path);
+      state->tmp_path = NULL;
+      state->error = true;
+      goto done;
+    }
+
+  fp = fdopen (fd, "w");
   if (!fp)
     {
-      g_warning ("Failed to open %s for saving", rig_filename);
-      return;
+      close (fd);
+      state->error = true;
+      goto done;
     }
 
-  buffered_file.fp = fp;
+  write_file (state, fp);
+
+  /* Make sure the data has really hit the disk before the rename
+   * replaces the previous file */
+  if (fflush (fp) != 0 || fsync (fd) != 0)
+    state->error = true;
+
+  if (fclose (fp) != 0)
+    state->error = true;
+
+  if (!state->error && rename (state->tmp_path, state->path) != 0)
+    state->error = true;
+
+done:
+
+#ifndef __ANDROID__
+  g_idle_add (save_finish_cb, state);
+#endif
+
+  return NULL;
+}
+
+static void
+save_state_free (RigSaveState *state)
+{
+  if (state->error)
+    {
+      g_warning ("Failed to write %s", state->path);
+
+      if (state->tmp_path)
+        unlink (state->tmp_path);
+    }
+
+  /* NB: The blobs are only unreferenced here on the main thread
+   * since ref counting isn't thread safe */
+  g_ptr_array_free (state->blobs, TRUE);
+
+  rig_pb_serialized_ui_destroy (state->ui);
+  rut_memory_stack_free (state->serialization_stack);
+
+  g_free (state->scene);
+  g_free (state->tmp_path);
+  g_free (state->path);
+
+  g_slice_free (RigSaveState, state);
+}
+
+static CoglBool
+save_finish_cb (void *user_data)
+{
+  RigSaveState *state = user_data;
+  RigEngine *engine = state->engine;
+
+  g_thread_join (state->thread);
+
+  engine->pending_save = NULL;
+
+  save_state_free (state);
+
+  return FALSE;
+}
+
+void
+rig_save_wait (RigEngine *engine)
+{
+  RigSaveState *state = engine->pending_save;
+
+  if (!state)
+    return;
+
+  /* NB: once the thread has been joined then it will have queued
+   * save_finish_cb() which we need to remove before finishing the
+   * save directly */
+  g_thread_join (state->thread);
+
+#ifndef __ANDROID__
+  g_source_remove_by_user_data (state);
+#endif
+
+  engine->pending_save = NULL;
+
+  save_state_free (state);
+}
+
+void
+rig_save (RigEngine *engine, const char *path)
+{
+  RigPBSerializer *serializer;
+  RigSaveState *state;
+  struct stat sb;
+
+  /* Only one save can be in flight at a time */
+  rig_save_wait (engine);
 
   if (stat (engine->ctx->assets_location, &sb) == -1)
     mkdir (engine->ctx->assets_location, 0777);
 
-  serializer = rig_pb_serializer_new (engine);
+  state = g_slice_new0 (RigSaveState);
+  state->engine = engine;
+  state->path = g_strdup (path);
+  state->tmp_path = g_strdup_printf ("%s.XXXXXX", path);
+  state->blobs = g_ptr_array_new_with_free_func (rut_refable_unref);
+  state->blob_ids = g_hash_table_new (NULL, NULL);
 
-  ui = rig_pb_serialize_ui (serializer);
+  serializer = rig_pb_serializer_new (engine);
 
-  rig__ui__pack_to_buffer (ui, &buffered_file.base );
+  rig_pb_serializer_set_blob_callback (serializer, save_blob_cb, state);
 
-  rig_pb_serialized_ui_destroy (ui);
+  state->ui = rig_pb_serialize_ui (serializer);
 
   rig_pb_serializer_destroy (serializer);
 
-  fclose (fp);
+  g_hash_table_destroy (state->blob_ids);
+  state->blob_ids = NULL;
+
+  /* The serialized UI is allocated from the engine's serialization
+   * stack so the save takes over that stack to keep the UI alive
+   * while it is packed and the engine gets a new one */
+  state->serialization_stack = engine->serialization_stack;
+  engine->serialization_stack = rut_memory_stack_new (8192);
+
+#ifdef __ANDROID__
+  save_thread_cb (state);
+  save_state_free (state);
+#else
+  engine->pending_save = state;
+  state->thread = g_thread_new ("rig-save", save_thread_cb, state);
+#endif
+}
+
+typedef struct _LoadState
+{
+  RutBuffer *file_buffer;
+  const uint8_t *directory;
+  uint32_t n_blobs;
+} LoadState;
+
+static RutBuffer *
+lookup_blob_cb (uint32_t blob_id, void *user_data)
+{
+  LoadState *state = user_data;
+  RutBuffer *file_buffer = state->file_buffer;
+  RigFileBlobEntry entry;
+  uint64_t offset, size;
+
+  if (blob_id >= state->n_blobs)
+    return NULL;
+
+  memcpy (&entry,
+          state->directory + sizeof (RigFileBlobEntry) * blob_id,
+          sizeof (entry));
+  offset = GUINT64_FROM_LE (entry.offset);
+  size = GUINT64_FROM_LE (entry.size);
+
+  if (offset > file_buffer->size || size > file_buffer->size - offset)
+    return NULL;
+
+  /* NB: The blob references the mapped file directly and keeps it
+   * alive for as long as it's needed */
+  return rut_buffer_new_for_data (file_buffer->data + offset,
+                                  size,
+                                  file_buffer);
+}
+
+static bool
+parse_file_header (LoadState *state,
+                   const uint8_t **scene,
+                   size_t *scene_size)
+{
+  RutBuffer *file_buffer = state->file_buffer;
+  RigFileHeader header;
+  uint64_t offset, size, directory_offset;
+
+  memcpy (&header, file_buffer->data, sizeof (header));
+
+  if (GUINT32_FROM_LE (header.version) > RIG_FILE_VERSION)
+    {
+      g_warning ("Can't load .rig file with unsupported version %u",
+                 GUINT32_FROM_LE (header.version));
+      return false;
+    }
+
+  offset = GUINT64_FROM_LE (header.scene_offset);
+  size = GUINT64_FROM_LE (header.scene_size);
+  if (offset > file_buffer->size || size > file_buffer->size - offset)
+    return false;
+
+  *scene = file_buffer->data + offset;
+  *scene_size = size;
+
+  state->n_blobs = GUINT32_FROM_LE (header.n_blobs);
+  directory_offset = GUINT64_FROM_LE (header.directory_offset);
+  if (directory_offset > file_buffer->size ||
+      ((file_buffer->size - directory_offset) / sizeof (RigFileBlobEntry) <
+       state->n_blobs))
+    return false;
+
+  state->directory = file_buffer->data + directory_offset;
+
+  return true;
 }
 
 static void
@@ -106,14 +464,12 @@ ignore_free (void *allocator_data, void *ptr)
 void
 rig_load (RigEngine *engine, const char *file)
 {
-  struct stat sb;
-  int fd;
-  uint8_t *contents;
-  size_t len;
   GError *error = NULL;
-  gboolean needs_munmap = FALSE;
   RigPBUnSerializer *unserializer;
   Rig__UI *ui;
+  LoadState state;
+  const uint8_t *scene;
+  size_t scene_size;
 
   /* We use a special allocator while unpacking protocol buffers
    * that lets us use the serialization_stack. This means much
@@ -136,35 +492,54 @@ rig_load (RigEngine *engine, const char *file)
       return;
     }
 
-  fd = open (file, O_CLOEXEC);
-  if (fd > 0 &&
-      fstat (fd, &sb) == 0 &&
-      (contents = mmap (NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0)))
-    {
-      len = sb.st_size;
-      needs_munmap = TRUE;
-    }
-  else if (!g_file_get_contents (file,
-                                 (gchar **)&contents,
-                                 &len,
-                                 &error))
+  memset (&state, 0, sizeof (state));
+
+  state.file_buffer = rut_buffer_new_from_file (file, &error);
+  if (!state.file_buffer)
     {
       g_warning ("Failed to load ui description: %s", error->message);
+      g_error_free (error);
       return;
     }
 
   unserializer = rig_pb_unserializer_new (engine);
 
-  ui = rig__ui__unpack (&protobuf_c_allocator, len, contents);
+  if (state.file_buffer->size >= sizeof (RigFileHeader) &&
+      memcmp (state.file_buffer->data, RIG_FILE_MAGIC,
+              sizeof (((RigFileHeader *)0)->magic)) == 0)
+    {
+      if (!parse_file_header (&state, &scene, &scene_size))
+        {
+          g_warning ("Failed to load ui description: corrupt .rig file");
+          goto done;
+        }
+
+      rig_pb_unserializer_set_blob_lookup (unserializer,
+                                           lookup_blob_cb,
+                                           &state);
+    }
+  else
+    {
+      scene = state.file_buffer->data;
+      scene_size = state.file_buffer->size;
+    }
+
+  ui = rig__ui__unpack (&protobuf_c_allocator, scene_size, scene);
+  if (!ui)
+    {
+      g_warning ("Failed to load ui description: failed to unpack scene");
+      goto done;
+    }
 
   rig_pb_unserialize_ui (unserializer, ui, false);
 
   rig__ui__free_unpacked (ui, &protobuf_c_allocator);
 
-  if (needs_munmap)
-    munmap (contents, len);
-  else
-    g_free (contents);
+done:
 
   rig_pb_unserializer_destroy (unserializer);
+
+  /* NB: Any buffers referencing the file will have taken their own
+   * reference on it */
+  rut_refable_unref (state.file_buffer);
 }
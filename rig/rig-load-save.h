@@ -22,9 +22,14 @@
 
 #include "rig-engine.h"
 
+/* NB: The file is written asynchronously. rig_save_wait() can be
+ * used to block until any pending save has completed. */
 void
 rig_save (RigEngine *engine, const char *path);
 
+void
+rig_save_wait (RigEngine *engine);
+
 void
 rig_load (RigEngine *engine, const char *file);
 
@@ -33,6 +33,9 @@ struct _RigPBSerializer
   RigPBAssetFilter asset_filter;
   void *asset_filter_data;
 
+  RigPBBlobCallback blob_callback;
+  void *blob_callback_data;
+
   GList *required_assets;
 
   int n_pb_entities;
@@ -65,6 +68,25 @@ pb_new (RigEngine *engine,
   return msg;
 }
 
+/* Strings in a serialized UI are copied into the serialization stack
+ * so that the UI stays valid even if the objects it was serialized
+ * from change before it is packed */
+static char *
+pb_strdup (RigEngine *engine, const char *string)
+{
+  size_t len;
+  char *copy;
+
+  if (!string)
+    return NULL;
+
+  len = strlen (string) + 1;
+  copy = rut_memory_stack_alloc (engine->serialization_stack, len);
+  memcpy (copy, string, len);
+
+  return copy;
+}
+
 static Rig__Color *
 pb_color_new (RigEngine *engine, const CoglColor *color)
 {
@@ -236,11 +258,24 @@ pb_path_new (RigEngine *engine, RigPath *path)
   return pb_path;
 }
 
+static uint64_t
+register_serializer_object (RigPBSerializer *serializer,
+                            void *object);
+
 static uint64_t
 serializer_lookup_object_id (RigPBSerializer *serializer, void *object)
 {
   uint64_t *id = g_hash_table_lookup (serializer->id_map, object);
 
+  /* An asset referenced by the scene may have been dropped from the
+   * engine's asset list if its file was deleted or modified while
+   * editing, so such assets are registered on demand */
+  if (!id && rut_object_get_type (object) == &rut_asset_type)
+    {
+      register_serializer_object (serializer, object);
+      id = g_hash_table_lookup (serializer->id_map, object);
+    }
+
   g_warn_if_fail (id);
 
   if (rut_object_get_type (object) == &rut_asset_type)
@@ -299,7 +334,7 @@ pb_property_value_new (RigPBSerializer *serializer,
       break;
 
     case RUT_PROPERTY_TYPE_TEXT:
-      pb_value->text_value = value->d.text_val;
+      pb_value->text_value = pb_strdup (engine, value->d.text_val);
       break;
 
     case RUT_PROPERTY_TYPE_QUATERNION:
@@ -627,8 +662,8 @@ serialize_component_cb (RutComponent *component,
 
       color = rut_text_get_color (text);
 
-      pb_text->text = (char *)rut_text_get_text (text);
-      pb_text->font = (char *)rut_text_get_font_name (text);
+      pb_text->text = pb_strdup (engine, rut_text_get_text (text));
+      pb_text->font = pb_strdup (engine, rut_text_get_font_name (text));
       pb_text->color = pb_color_new (engine, color);
     }
   else if (type == &rut_camera_type)
@@ -770,7 +805,7 @@ _rut_entitygraph_pre_serialize_cb (RutObject *object,
 
   if (label && *label)
     {
-      pb_entity->label = (char *)label;
+      pb_entity->label = pb_strdup (engine, label);
     }
 
   q = rut_entity_get_rotation (entity);
@@ -896,6 +931,15 @@ rig_pb_serializer_set_asset_filter (RigPBSerializer *serializer,
   serializer->asset_filter_data = user_data;
 }
 
+void
+rig_pb_serializer_set_blob_callback (RigPBSerializer *serializer,
+                                     RigPBBlobCallback callback,
+                                     void *user_data)
+{
+  serializer->blob_callback = callback;
+  serializer->blob_callback_data = user_data;
+}
+
 void
 rig_pb_serializer_destroy (RigPBSerializer *serializer)
 {
@@ -917,6 +961,14 @@ serialize_buffer (RigPBSerializer *serializer, RutBuffer *buffer)
   pb_buffer->id =
     register_serializer_object (serializer, buffer);
 
+  if (serializer->blob_callback)
+    {
+      pb_buffer->has_blob_id = true;
+      pb_buffer->blob_id =
+        serializer->blob_callback (buffer, serializer->blob_callback_data);
+      return pb_buffer;
+    }
+
   /* NB: The serialized asset points directly to the RutMesh
    * data to avoid copying it... */
   pb_buffer->has_data = true;
@@ -942,15 +994,16 @@ serialize_mesh_asset (RigPBSerializer *serializer, RutAsset *asset)
 
   pb_asset = pb_new (engine, sizeof (Rig__Asset), rig__asset__init);
 
-  pb_asset->path = (char *)rut_asset_get_path (asset);
+  pb_asset->path = pb_strdup (engine, rut_asset_get_path (asset));
 
   pb_asset->has_type = true;
   pb_asset->type = RUT_ASSET_TYPE_PLY_MODEL;
 
   /* The maximum number of pb_buffers we may need = n_attributes plus 1 in case
-   * there is an index buffer... */
+   * there is an index buffer plus 1 for each level of detail... */
   pb_buffers = rut_memory_stack_alloc (engine->serialization_stack,
-                                       sizeof (void *) * (mesh->n_attributes + 1));
+                                       sizeof (void *) *
+                                       (mesh->n_attributes + 1 + mesh->n_lods));
 
   buffers = g_alloca (sizeof (void *) * mesh->n_attributes);
   attribute_buffers_map = g_alloca (sizeof (void *) * mesh->n_attributes);
@@ -964,7 +1017,7 @@ serialize_mesh_asset (RigPBSerializer *serializer, RutAsset *asset)
     {
       int j;
 
-      for (j = 0; i < n_buffers; j++)
+      for (j = 0; j < n_buffers; j++)
         if (buffers[j] == mesh->attributes[i]->buffer)
           break;
 
@@ -1000,7 +1053,7 @@ serialize_mesh_asset (RigPBSerializer *serializer, RutAsset *asset)
       pb_attribute->has_buffer_id = true;
       pb_attribute->buffer_id = attribute_buffers_map[i]->id;
 
-      pb_attribute->name = (char *)mesh->attributes[i]->name;
+      pb_attribute->name = pb_strdup (engine, mesh->attributes[i]->name);
 
       pb_attribute->has_stride = true;
       pb_attribute->stride = mesh->attributes[i]->stride;
@@ -1008,6 +1061,8 @@ serialize_mesh_asset (RigPBSerializer *serializer, RutAsset *asset)
       pb_attribute->offset = mesh->attributes[i]->offset;
       pb_attribute->has_n_components = true;
       pb_attribute->n_components = mesh->attributes[i]->n_components;
+      pb_attribute->has_normalized = true;
+      pb_attribute->normalized = mesh->attributes[i]->normalized;
       pb_attribute->has_type = true;
 
       switch (mesh->attributes[i]->type)
@@ -1092,6 +1147,30 @@ serialize_mesh_asset (RigPBSerializer *serializer, RutAsset *asset)
 
       pb_mesh->has_indices_buffer_id = true;
       pb_mesh->indices_buffer_id = pb_buffers[n_buffers - 1]->id;
+
+      pb_mesh->n_lods = mesh->n_lods;
+      pb_mesh->lods =
+        rut_memory_stack_alloc (engine->serialization_stack,
+                                sizeof (void *) * mesh->n_lods);
+
+      for (i = 0; i < mesh->n_lods; i++)
+        {
+          Rig__MeshLod *pb_lod =
+            pb_new (engine, sizeof (Rig__MeshLod), rig__mesh_lod__init);
+          Rig__Buffer *pb_buffer =
+            serialize_buffer (serializer, mesh->lods[i].indices_buffer);
+
+          pb_buffers[n_buffers++] = pb_buffer;
+
+          pb_lod->has_n_indices = true;
+          pb_lod->n_indices = mesh->lods[i].n_indices;
+          pb_lod->has_indices_buffer_id = true;
+          pb_lod->indices_buffer_id = pb_buffer->id;
+
+          pb_mesh->lods[i] = pb_lod;
+        }
+
+      pb_mesh->n_buffers = n_buffers;
     }
 
   return pb_asset;
@@ -1109,6 +1188,7 @@ serialize_asset (RigPBSerializer *serializer, RutAsset *asset)
   const char *path = rut_asset_get_path (asset);
   char *full_path;
   Rig__Asset *pb_asset;
+  RutBuffer *buffer;
   GError *error = NULL;
   char *contents;
   size_t len;
@@ -1117,23 +1197,9 @@ serialize_asset (RigPBSerializer *serializer, RutAsset *asset)
   if (rut_asset_get_type (asset) == RUT_ASSET_TYPE_PLY_MODEL)
     return serialize_mesh_asset (serializer, asset);
 
-  full_path = g_build_filename (ctx->assets_location, path, NULL);
-  if (!g_file_get_contents (full_path,
-                            &contents,
-                            &len,
-                            &error))
-    {
-      g_warning ("Failed to read contents of asset: %s", error->message);
-      g_error_free (error);
-      g_free (full_path);
-      return NULL;
-    }
-
-  g_free (full_path);
-
   pb_asset = pb_new (engine, sizeof (Rig__Asset), rig__asset__init);
 
-  pb_asset->path = (char *)path;
+  pb_asset->path = pb_strdup (engine, path);
 
   pb_asset->has_type = TRUE;
   pb_asset->type = rut_asset_get_type (asset);
@@ -1141,6 +1207,61 @@ serialize_asset (RigPBSerializer *serializer, RutAsset *asset)
   pb_asset->has_is_video = true;
   pb_asset->is_video = rut_asset_get_is_video (asset);
 
+  /* If the asset was itself loaded from a packed UI then we already
+   * have its data and there may not be a corresponding file in the
+   * assets directory */
+  buffer = rut_asset_get_buffer (asset);
+
+  if (serializer->blob_callback)
+    {
+      if (buffer)
+        rut_refable_ref (buffer);
+      else
+        {
+          full_path = g_build_filename (ctx->assets_location, path, NULL);
+          buffer = rut_buffer_new_from_file (full_path, &error);
+          g_free (full_path);
+
+          if (!buffer)
+            {
+              g_warning ("Failed to read contents of asset: %s",
+                         error->message);
+              g_error_free (error);
+              return NULL;
+            }
+        }
+
+      pb_asset->has_blob_id = true;
+      pb_asset->blob_id =
+        serializer->blob_callback (buffer, serializer->blob_callback_data);
+
+      rut_refable_unref (buffer);
+
+      return pb_asset;
+    }
+
+  if (buffer)
+    {
+      contents = g_memdup (buffer->data, buffer->size);
+      len = buffer->size;
+    }
+  else
+    {
+      full_path = g_build_filename (ctx->assets_location, path, NULL);
+      if (!g_file_get_contents (full_path,
+                                &contents,
+                                &len,
+                                &error))
+        {
+          g_warning ("Failed to read contents of asset: %s", error->message);
+          g_error_free (error);
+          g_free (full_path);
+          return NULL;
+        }
+
+      g_free (full_path);
+    }
+
   pb_asset->has_data = true;
   pb_asset->data.data = (uint8_t *)contents;
   pb_asset->data.len = len;
@@ -1170,6 +1291,12 @@ rig_pb_serialize_ui (RigPBSerializer *serializer)
 
   ui->device = device;
 
+  /* When a blob callback is given then asset data and mesh buffers
+   * are referenced by blob id instead of being inlined */
+  ui->has_mode = true;
+  ui->mode = serializer->blob_callback ?
+    RIG__UI__MODE__PACKED : RIG__UI__MODE__FULL;
+
   device->has_width = TRUE;
   device->width = engine->device_width;
   device->has_height = TRUE;
@@ -1220,7 +1347,7 @@ rig_pb_serialize_ui (RigPBSerializer *serializer)
           pb_controller->has_id = TRUE;
           pb_controller->id = serializer_lookup_object_id (serializer, controller);
 
-          pb_controller->name = controller->label;
+          pb_controller->name = pb_strdup (engine, controller->label);
 
           serialize_instrospectable_properties (controller,
                                                 &pb_controller->n_controller_properties,
@@ -1315,7 +1442,7 @@ rig_pb_serialize_input_events (RigEngine *engine,
             switch (action)
               {
               case RUT_MOTION_EVENT_ACTION_MOVE:
-                g_print ("Serialize move\n");
+                RIG_INPUT_EVENT_NOTE ("Serialize move\n");
                 pb_event->type = RIG__EVENT__TYPE__POINTER_MOVE;
                 pb_event->pointer_move =
                   pb_new (engine, sizeof (Rig__Event__PointerMove),
@@ -1327,11 +1454,11 @@ rig_pb_serialize_input_events (RigEngine *engine,
                 pb_event->pointer_move->y = rut_motion_event_get_y (event);
                 break;
               case RUT_MOTION_EVENT_ACTION_DOWN:
-                g_print ("Serialize pointer down\n");
+                RIG_INPUT_EVENT_NOTE ("Serialize pointer down\n");
                 pb_event->type = RIG__EVENT__TYPE__POINTER_DOWN;
                 break;
               case RUT_MOTION_EVENT_ACTION_UP:
-                g_print ("Serialize pointer up\n");
+                RIG_INPUT_EVENT_NOTE ("Serialize pointer up\n");
                 pb_event->type = RIG__EVENT__TYPE__POINTER_UP;
                 break;
               }
@@ -1359,11 +1486,11 @@ rig_pb_serialize_input_events (RigEngine *engine,
             switch (action)
               {
               case RUT_KEY_EVENT_ACTION_DOWN:
-                g_print ("Serialize key down\n");
+                RIG_INPUT_EVENT_NOTE ("Serialize key down\n");
                 pb_event->type = RIG__EVENT__TYPE__KEY_DOWN;
                 break;
               case RUT_KEY_EVENT_ACTION_UP:
-                g_print ("Serialize key down\n");
+                RIG_INPUT_EVENT_NOTE ("Serialize key up\n");
                 pb_event->type = RIG__EVENT__TYPE__KEY_UP;
                 break;
               }
@@ -1403,6 +1530,9 @@ struct _RigPBUnSerializer
   RutEntity *light;
   GList *controllers;
 
+  RigPBBlobLookup blob_lookup;
+  void *blob_lookup_data;
+
   GHashTable *id_map;
 };
 
@@ -2387,7 +2517,28 @@ unserialize_assets (RigPBUnSerializer *unserializer,
       if (!pb_asset->path)
         continue;
 
-      if (pb_asset->has_data)
+      if (pb_asset->has_blob_id && unserializer->blob_lookup)
+        {
+          RutBuffer *buffer =
+            unserializer->blob_lookup (pb_asset->blob_id,
+                                       unserializer->blob_lookup_data);
+          if (!buffer)
+            {
+              collect_error (unserializer,
+                             "Invalid blob id for asset id %d",
+                             (int)id);
+              continue;
+            }
+
+          /* NB: The asset data isn't decoded until it's first used */
+          asset = rut_asset_new_from_buffer (engine->ctx,
+                                             pb_asset->path,
+                                             pb_asset->type,
+                                             pb_asset->is_video,
+                                             buffer);
+          rut_refable_unref (buffer);
+        }
+      else if (pb_asset->has_data)
         {
           asset = rut_asset_new_from_data (engine->ctx,
                                            pb_asset->path,
@@ -2836,6 +2987,15 @@ rig_pb_unserializer_new (RigEngine *engine)
   return unserializer;
 }
 
+void
+rig_pb_unserializer_set_blob_lookup (RigPBUnSerializer *unserializer,
+                                     RigPBBlobLookup lookup,
+                                     void *user_data)
+{
+  unserializer->blob_lookup = lookup;
+  unserializer->blob_lookup_data = user_data;
+}
+
 void
 rig_pb_unserializer_destroy (RigPBUnSerializer *unserializer)
 {
@@ -2923,13 +3083,25 @@ rig_pb_unserialize_mesh (RigPBUnSerializer *unserializer,
       Rig__Buffer *pb_buffer = pb_mesh->buffers[i];
       RutBuffer *buffer;
 
-      if (!pb_buffer->has_id || !pb_buffer->has_data)
+      if (!pb_buffer->has_id)
+        goto ERROR;
+
+      /* Out of line data can be referenced directly without copying */
+      if (pb_buffer->has_blob_id && unserializer->blob_lookup)
         {
-          goto ERROR;
+          buffer = unserializer->blob_lookup (pb_buffer->blob_id,
+                                              unserializer->blob_lookup_data);
+          if (!buffer)
+            goto ERROR;
+        }
+      else if (pb_buffer->has_data)
+        {
+          buffer = rut_buffer_new (pb_buffer->data.len);
+          memcpy (buffer->data, pb_buffer->data.data, pb_buffer->data.len);
         }
+      else
+        goto ERROR;
 
-      buffer = rut_buffer_new (pb_buffer->data.len);
-      memcpy (buffer->data, pb_buffer->data.data, pb_buffer->data.len);
       named_buffers[i].id = pb_buffer->id;
       named_buffers[i].buffer = buffer;
       n_buffers++;
@@ -3070,6 +3242,29 @@ rig_pb_unserialize_mesh (RigPBUnSerializer *unserializer,
                             indices_type,
                             buffer,
                             pb_mesh->n_indices);
+
+      for (i = 0; i < pb_mesh->n_lods && i < RUT_MESH_MAX_LODS; i++)
+        {
+          Rig__MeshLod *pb_lod = pb_mesh->lods[i];
+
+          if (!pb_lod->has_n_indices ||
+              !pb_lod->has_indices_buffer_id)
+            goto ERROR;
+
+          buffer = NULL;
+          for (j = 0; j < pb_mesh->n_buffers; j++)
+            {
+              if (named_buffers[j].id == pb_lod->indices_buffer_id)
+                {
+                  buffer = named_buffers[j].buffer;
+                  break;
+                }
+            }
+          if (!buffer)
+            goto ERROR;
+
+          rut_mesh_add_lod (mesh, buffer, pb_lod->n_indices);
+        }
     }
 
   /* The mesh will take references on the attributes */
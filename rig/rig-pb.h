@@ -42,6 +42,16 @@ rig_pb_serializer_set_asset_filter (RigPBSerializer *serializer,
                                     RigPBAssetFilter filter,
                                     void *user_data);
 
+/* Used to store large binary data, such as mesh buffers, outside of
+ * the serialized messages. The callback should return an id for the
+ * blob which is what will be referenced by the serialized message. */
+typedef uint32_t (*RigPBBlobCallback) (RutBuffer *blob, void *user_data);
+
+void
+rig_pb_serializer_set_blob_callback (RigPBSerializer *serializer,
+                                     RigPBBlobCallback callback,
+                                     void *user_data);
+
 void
 rig_pb_serializer_destroy (RigPBSerializer *serializer);
 
@@ -59,6 +69,16 @@ rig_pb_serialize_input_events (RigEngine *engine,
 RigPBUnSerializer *
 rig_pb_unserializer_new (RigEngine *engine);
 
+/* Should return a new reference to the data for a blob that was
+ * stored out of line via a RigPBBlobCallback or NULL if the id isn't
+ * valid. */
+typedef RutBuffer *(*RigPBBlobLookup) (uint32_t blob_id, void *user_data);
+
+void
+rig_pb_unserializer_set_blob_lookup (RigPBUnSerializer *unserializer,
+                                     RigPBBlobLookup lookup,
+                                     void *user_data);
+
 void
 rig_pb_unserializer_destroy (RigPBUnSerializer *unserializer);
 
@@ -20,6 +20,8 @@
 
 #include <config.h>
 
+#include <math.h>
+
 #include <rut.h>
 
 #include "rig-engine.h"
@@ -91,6 +93,17 @@ typedef enum _GetPipelineFlags
 #define N_IMAGE_SOURCE_CACHE_SLOTS 3
 #define N_PRIMITIVE_CACHE_SLOTS 1
 
+/* Models are drawn with the least detailed level of detail that still
+ * has roughly one triangle for this many pixels that they cover. Each
+ * level of detail has about half the triangles of the previous one
+ * so the level is chosen on a log2 scale. Shadows are drawn with a
+ * coarser level and a level is only changed once the ideal level is
+ * outside of the current one by the hysteresis to avoid flickering
+ * between levels when the size is close to a threshold. */
+#define LOD_PIXELS_PER_TRIANGLE 4.0f
+#define LOD_SHADOW_BIAS 1.0f
+#define LOD_HYSTERESIS 0.25f
+
 typedef struct _RigRendererPriv
 {
   RigRenderer *renderer;
@@ -99,6 +112,10 @@ typedef struct _RigRendererPriv
   RutImageSource *image_source_caches[N_IMAGE_SOURCE_CACHE_SLOTS];
   CoglPrimitive *primitive_caches[N_PRIMITIVE_CACHE_SLOTS];
 
+  /* The current level of detail for the color and shadow passes */
+  int color_lod;
+  int shadow_lod;
+
   RutClosure *preferred_size_closure;
 } RigRendererPriv;
 
@@ -333,6 +350,7 @@ reshape_cb (RutShape *shape, void *user_data)
     rut_object_get_properties (shape, RUT_INTERFACE_ID_COMPONENTABLE);
   RutEntity *entity = componentable->entity;
   dirty_entity_pipelines (entity);
+  dirty_entity_geometry (entity);
 }
 
 static void
@@ -341,7 +359,9 @@ nine_slice_changed_cb (RutNineSlice *nine_slice, void *user_data)
   RutComponentableProps *componentable =
     rut_object_get_properties (nine_slice, RUT_INTERFACE_ID_COMPONENTABLE);
   RutEntity *entity = componentable->entity;
-  _rig_renderer_notify_entity_changed (entity);
+
+  /* Nine-slices are sized with a uniform so only a change of borders
+   * will give us a different primitive */
   dirty_entity_geometry (entity);
 }
 
@@ -573,6 +593,34 @@ rig_renderer_init (RigEngine *engine)
                       "varying vec4 pos;\n",
                       "pos = cogl_position_in;\n");
 
+  /* Shapes and nine-slices share their geometry between all sizes.
+   * Each vertex has a fixed offset and the fraction of the size it
+   * should be offset by. See rut_shape_get_geometry_size() */
+  engine->stretch_geometry_snippet =
+    cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX_TRANSFORM,
+                      "attribute vec2 stretch_in;\n"
+                      "uniform vec2 geometry_size;\n",
+
+                      "pos.xy += stretch_in * geometry_size;\n"
+                      "cogl_position_out =\n"
+                      "  cogl_modelview_projection_matrix * pos;\n");
+
+  /* The image layers of a shaped shape are scaled around the center
+   * of the texture to fit the shape mask. The uniform is declared
+   * with the _GLOBALS hook because Cogl emits the layer snippets
+   * before the declarations of the other vertex hooks. See
+   * rut_shape_get_tex_coord_scale() */
+  engine->tex_coord_scale_globals_snippet =
+    cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX_GLOBALS,
+                      "uniform vec2 tex_coord_scale;\n",
+                      NULL);
+
+  engine->tex_coord_scale_snippet =
+    cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_COORD_TRANSFORM,
+                      NULL,
+                      "cogl_tex_coord.st =\n"
+                      "  (cogl_tex_coord.st - 0.5) * tex_coord_scale + 0.5;\n");
+
   engine->pointalism_vertex_snippet =
     cogl_snippet_new (COGL_SNIPPET_HOOK_VERTEX_TRANSFORM,
     "attribute vec2 cell_xy;\n"
@@ -915,6 +963,38 @@ rig_renderer_fini (RigEngine *engine)
   cogl_object_unref (engine->pointalism_halo_snippet);
   cogl_object_unref (engine->pointalism_opaque_snippet);
   cogl_object_unref (engine->cache_position_snippet);
+  cogl_object_unref (engine->stretch_geometry_snippet);
+  cogl_object_unref (engine->tex_coord_scale_globals_snippet);
+  cogl_object_unref (engine->tex_coord_scale_snippet);
+}
+
+static CoglBool
+add_tex_coord_scale_snippet_cb (CoglPipeline *pipeline,
+                                int layer_index,
+                                void *user_data)
+{
+  RigEngine *engine = user_data;
+
+  /* Only the image source and hair layers sample with the texture
+   * coordinates that a shape scales */
+  if (layer_index == 1 || layer_index == 4 ||
+      layer_index == 7 || layer_index == 11)
+    cogl_pipeline_add_layer_snippet (pipeline, layer_index,
+                                     engine->tex_coord_scale_snippet);
+
+  return TRUE;
+}
+
+/* This should be called once all the layers of the pipeline for a
+ * shaped shape have been added */
+static void
+add_shaped_tex_coord_snippets (CoglPipeline *pipeline,
+                               RigEngine *engine)
+{
+  cogl_pipeline_add_snippet (pipeline, engine->tex_coord_scale_globals_snippet);
+  cogl_pipeline_foreach_layer (pipeline,
+                               add_tex_coord_scale_snippet_cb,
+                               engine);
 }
 
 static void
@@ -1006,6 +1086,7 @@ get_entity_mask_pipeline (RigEngine *engine,
   else if (rut_object_get_type (geometry) == &rut_shape_type)
     {
       pipeline = cogl_pipeline_copy (engine->dof_unshaped_pipeline);
+      cogl_pipeline_add_snippet (pipeline, engine->stretch_geometry_snippet);
 
       if (rut_shape_get_shaped (geometry))
         {
@@ -1017,10 +1098,14 @@ get_entity_mask_pipeline (RigEngine *engine,
 
       if (material)
         add_material_for_mask (pipeline, engine, material, sources);
+
+      if (rut_shape_get_shaped (geometry))
+        add_shaped_tex_coord_snippets (pipeline, engine);
     }
   else if (rut_object_get_type (geometry) == &rut_nine_slice_type)
     {
       pipeline = cogl_pipeline_copy (engine->dof_unshaped_pipeline);
+      cogl_pipeline_add_snippet (pipeline, engine->stretch_geometry_snippet);
 
       if (material)
         add_material_for_mask (pipeline, engine, material, sources);
@@ -1176,6 +1261,8 @@ get_entity_color_pipeline (RigEngine *engine,
 
   if (rut_object_get_type (geometry) == &rut_nine_slice_type)
     {
+      cogl_pipeline_add_snippet (pipeline, engine->stretch_geometry_snippet);
+
 #warning "FIXME: This is going to leak closures, if we've already registered a callback!"
       rut_nine_slice_add_update_callback ((RutNineSlice *)geometry,
                                           nine_slice_changed_cb,
@@ -1186,6 +1273,8 @@ get_entity_color_pipeline (RigEngine *engine,
     {
       CoglTexture *shape_texture;
 
+      cogl_pipeline_add_snippet (pipeline, engine->stretch_geometry_snippet);
+
       if (rut_shape_get_shaped (geometry))
         {
           shape_texture =
@@ -1303,6 +1392,10 @@ get_entity_color_pipeline (RigEngine *engine,
                                  engine->shadow_mapping_fragment_snippet);
     }
 
+  if (rut_object_get_type (geometry) == &rut_shape_type &&
+      rut_shape_get_shaped (geometry))
+    add_shaped_tex_coord_snippets (pipeline, engine);
+
   cogl_pipeline_add_snippet (pipeline, engine->premultiply_snippet);
 
   if (hair)
@@ -1421,7 +1514,10 @@ image_source_ready_cb (RutImageSource *source,
       dependant->set_image_size (geometry, width, height);
     }
   else if (rut_object_get_type (geometry) == &rut_shape_type)
-    rut_shape_set_texture_size (geometry, width, height);
+    {
+      rut_shape_set_texture_size (geometry, width, height);
+      dirty_entity_geometry (entity);
+    }
   else if (rut_object_get_type (geometry) == &rut_diamond_type)
     {
       RutDiamond *diamond = geometry;
@@ -1452,6 +1548,29 @@ image_source_ready_cb (RutImageSource *source,
     }
 }
 
+static void
+image_source_texture_evicted_cb (RutImageSource *source,
+                                 void *user_data)
+{
+  RutEntity *entity = user_data;
+
+  /* The cached pipelines reference the texture so they need to be
+   * dropped for the memory to be freed. They will be recreated with
+   * a reloaded texture if the entity is drawn again. */
+  dirty_entity_pipelines (entity);
+}
+
+static void
+mark_material_textures_used (RutMaterial *material)
+{
+  if (material->color_source_asset)
+    rut_asset_mark_texture_used (material->color_source_asset);
+  if (material->alpha_mask_asset)
+    rut_asset_mark_texture_used (material->alpha_mask_asset);
+  if (material->normal_map_asset)
+    rut_asset_mark_texture_used (material->normal_map_asset);
+}
+
 static CoglPipeline *
 get_entity_pipeline (RigEngine *engine,
                      RutEntity *entity,
@@ -1504,6 +1623,11 @@ get_entity_pipeline (RigEngine *engine,
                                                 image_source_changed_cb,
                                                 engine,
                                                 NULL);
+      rut_image_source_add_texture_evicted_callback (
+                                                sources[SOURCE_TYPE_COLOR],
+                                                image_source_texture_evicted_cb,
+                                                entity,
+                                                NULL);
 
       rut_image_source_set_first_layer (sources[SOURCE_TYPE_COLOR], 1);
     }
@@ -1526,6 +1650,11 @@ get_entity_pipeline (RigEngine *engine,
                                                 image_source_changed_cb,
                                                 engine,
                                                 NULL);
+      rut_image_source_add_texture_evicted_callback (
+                                                sources[SOURCE_TYPE_ALPHA_MASK],
+                                                image_source_texture_evicted_cb,
+                                                entity,
+                                                NULL);
 
       rut_image_source_set_first_layer (sources[SOURCE_TYPE_ALPHA_MASK], 4);
       rut_image_source_set_default_sample (sources[SOURCE_TYPE_ALPHA_MASK],
@@ -1550,6 +1679,11 @@ get_entity_pipeline (RigEngine *engine,
                                                 image_source_changed_cb,
                                                 engine,
                                                 NULL);
+      rut_image_source_add_texture_evicted_callback (
+                                                sources[SOURCE_TYPE_NORMAL_MAP],
+                                                image_source_texture_evicted_cb,
+                                                entity,
+                                                NULL);
 
       rut_image_source_set_first_layer (sources[SOURCE_TYPE_NORMAL_MAP], 7);
       rut_image_source_set_default_sample (sources[SOURCE_TYPE_NORMAL_MAP],
@@ -1614,6 +1748,99 @@ ensure_renderer_priv (RutEntity *entity, RigRenderer *renderer)
     }
 }
 
+/* Returns the radius in pixels of the model's bounding sphere when
+ * drawn with the given modelview matrix or G_MAXFLOAT if the sphere
+ * crosses the near plane */
+static float
+get_projected_model_radius (RutCamera *camera,
+                            const CoglMatrix *modelview,
+                            RutModel *model)
+{
+  const CoglMatrix *projection = rut_camera_get_projection (camera);
+  const float *viewport = rut_camera_get_viewport (camera);
+  float dx = model->max_x - model->min_x;
+  float dy = model->max_y - model->min_y;
+  float dz = model->max_z - model->min_z;
+  float radius = sqrtf (dx * dx + dy * dy + dz * dz) / 2.0f;
+  float x = (model->min_x + model->max_x) / 2.0f;
+  float y = (model->min_y + model->max_y) / 2.0f;
+  float z = (model->min_z + model->max_z) / 2.0f;
+  float w = 1;
+  float edge_x, edge_y, edge_z, edge_w = 1;
+  float scale;
+
+  /* Account for any scale in the modelview matrix by measuring the
+   * longest transformed axis */
+  scale = MAX (sqrtf (modelview->xx * modelview->xx +
+                      modelview->yx * modelview->yx +
+                      modelview->zx * modelview->zx),
+               MAX (sqrtf (modelview->xy * modelview->xy +
+                           modelview->yy * modelview->yy +
+                           modelview->zy * modelview->zy),
+                    sqrtf (modelview->xz * modelview->xz +
+                           modelview->yz * modelview->yz +
+                           modelview->zz * modelview->zz)));
+  radius *= scale;
+
+  cogl_matrix_transform_point (modelview, &x, &y, &z, &w);
+
+  edge_x = x;
+  edge_y = y + radius;
+  edge_z = z;
+
+  cogl_matrix_transform_point (projection, &x, &y, &z, &w);
+  cogl_matrix_transform_point (projection,
+                               &edge_x, &edge_y, &edge_z, &edge_w);
+
+  if (w <= 0 || edge_w <= 0)
+    return G_MAXFLOAT;
+
+  return fabsf (edge_y / edge_w - y / w) * viewport[3] / 2.0f;
+}
+
+static int
+select_model_lod (RigRendererPriv *priv,
+                  RigPaintContext *paint_ctx,
+                  const CoglMatrix *modelview,
+                  RutModel *model)
+{
+  RutMesh *mesh = model->mesh;
+  int *current_lod = (paint_ctx->pass == RIG_PASS_SHADOW ?
+                      &priv->shadow_lod : &priv->color_lod);
+  int n_triangles;
+  float radius;
+  float ideal_triangles;
+  float level;
+
+  if (!mesh)
+    return 0;
+
+  n_triangles = (mesh->indices_buffer ?
+                 mesh->n_indices : mesh->n_vertices) / 3;
+
+  radius = get_projected_model_radius (paint_ctx->_parent.camera,
+                                       modelview,
+                                       model);
+  if (radius == G_MAXFLOAT)
+    {
+      *current_lod = 0;
+      return 0;
+    }
+
+  ideal_triangles = MAX (G_PI * radius * radius / LOD_PIXELS_PER_TRIANGLE,
+                         1.0f);
+  level = log2f (MAX (n_triangles / ideal_triangles, 1.0f));
+
+  if (paint_ctx->pass == RIG_PASS_SHADOW)
+    level += LOD_SHADOW_BIAS;
+
+  if (level < *current_lod - LOD_HYSTERESIS ||
+      level >= *current_lod + 1 + LOD_HYSTERESIS)
+    *current_lod = CLAMP ((int)floorf (level), 0, RUT_MESH_MAX_LODS);
+
+  return *current_lod;
+}
+
 static void
 rig_renderer_flush_journal (RigRenderer *renderer,
                             RigPaintContext *paint_ctx)
@@ -1661,6 +1888,7 @@ rig_renderer_flush_journal (RigRenderer *renderer,
       RutMaterial *material;
       CoglPipeline *fin_pipeline = NULL;
       RutHair *hair;
+      int lod = 0;
 
       if (rut_object_get_type (geometry) == &rut_text_type &&
           paint_ctx->pass == RIG_PASS_COLOR_BLENDED)
@@ -1684,12 +1912,25 @@ rig_renderer_flush_journal (RigRenderer *renderer,
 
       material = rut_entity_get_component (entity, RUT_COMPONENT_TYPE_MATERIAL);
 
+      /* Keep the textures of visible entities from being evicted */
+      if (material)
+        mark_material_textures_used (material);
+
+      if (rut_object_get_type (geometry) == &rut_model_type)
+        lod = select_model_lod (entity->renderer_priv,
+                                paint_ctx,
+                                &entry->matrix,
+                                geometry);
+
       hair  = rut_entity_get_component (entity, RUT_COMPONENT_TYPE_HAIR);
       if (hair)
         {
           rut_hair_update_state (hair);
 
-          if (rut_object_get_type (geometry) == &rut_model_type)
+          /* Hair models don't have simplified levels of detail but
+           * the fins are only worth drawing at full detail */
+          if (rut_object_get_type (geometry) == &rut_model_type &&
+              lod == 0)
             {
               if (paint_ctx->pass == RIG_PASS_COLOR_BLENDED)
                 {
@@ -1768,15 +2009,58 @@ rig_renderer_flush_journal (RigRenderer *renderer,
             }
         }
 
+      /* Shapes and nine-slices share their primitive between all
+       * sizes so the size is given to the stretch_geometry_snippet */
+      if (rut_object_get_type (geometry) == &rut_shape_type ||
+          rut_object_get_type (geometry) == &rut_nine_slice_type)
+        {
+          float size[2];
+          int location;
+
+          if (rut_object_get_type (geometry) == &rut_shape_type)
+            rut_shape_get_geometry_size (geometry, &size[0], &size[1]);
+          else
+            rut_nine_slice_get_size (geometry, &size[0], &size[1]);
+
+          location = cogl_pipeline_get_uniform_location (pipeline,
+                                                         "geometry_size");
+          cogl_pipeline_set_uniform_float (pipeline, location,
+                                           2, /* n_components */
+                                           1, /* count */
+                                           size);
+
+          /* The texture coordinates of a shaped quad also depend on
+           * the aspect ratio of the shape */
+          if (rut_object_get_type (geometry) == &rut_shape_type &&
+              rut_shape_get_shaped (geometry))
+            {
+              float scale[2];
+
+              rut_shape_get_tex_coord_scale (geometry, &scale[0], &scale[1]);
+
+              location = cogl_pipeline_get_uniform_location (pipeline,
+                                                             "tex_coord_scale");
+              cogl_pipeline_set_uniform_float (pipeline, location,
+                                               2, /* n_components */
+                                               1, /* count */
+                                               scale);
+            }
+        }
+
       /*
        * Draw Primitive...
        */
 
-      primitive = get_entity_primitive_cache (entity, 0);
-      if (!primitive)
+      if (lod > 0 && rut_model_get_n_lods (geometry) > 0)
+        primitive = rut_model_get_lod_primitive (geometry, lod);
+      else
         {
-          primitive = rut_primable_get_primitive (geometry);
-          set_entity_primitive_cache (entity, 0, primitive);
+          primitive = get_entity_primitive_cache (entity, 0);
+          if (!primitive)
+            {
+              primitive = rut_primable_get_primitive (geometry);
+              set_entity_primitive_cache (entity, 0, primitive);
+            }
         }
 
       cogl_framebuffer_set_modelview_matrix (fb, &entry->matrix);
@@ -86,8 +86,8 @@ simulator__run_frame (Rig__Simulator_Service *service,
 
   g_return_if_fail (setup != NULL);
 
-  g_print ("Simulator: Run Frame Request: n_events = %d\n",
-           setup->n_events);
+  RIG_INPUT_EVENT_NOTE ("Simulator: Run Frame Request: n_events = %d\n",
+                        setup->n_events);
 
   if (setup->has_width && setup->has_height &&
       (engine->width != setup->width ||
@@ -99,7 +99,7 @@ simulator__run_frame (Rig__Simulator_Service *service,
   for (i = 0; i < setup->n_events; i++)
     {
       Rig__Event *pb_event = setup->events[i];
-      RutStreamEvent *event;
+      RutStreamEvent event;
 
       if (!pb_event->has_type)
         {
@@ -107,29 +107,30 @@ simulator__run_frame (Rig__Simulator_Service *service,
           continue;
         }
 
-      event = g_slice_new (RutStreamEvent);
-
+      /* NB: the shell copies the event into its own per-frame arena
+       * (coalescing consecutive pointer moves) so we can build it on
+       * the stack here. */
 
       switch (pb_event->type)
         {
         case RIG__EVENT__TYPE__POINTER_MOVE:
-          event->pointer_move.state = simulator->button_state;
+          event.pointer_move.state = simulator->button_state;
           break;
 
         case RIG__EVENT__TYPE__POINTER_DOWN:
         case RIG__EVENT__TYPE__POINTER_UP:
 
-          event->pointer_button.state = simulator->button_state;
+          event.pointer_button.state = simulator->button_state;
 
-          event->pointer_button.x = simulator->last_pointer_x;
-          event->pointer_button.y = simulator->last_pointer_y;
+          event.pointer_button.x = simulator->last_pointer_x;
+          event.pointer_button.y = simulator->last_pointer_y;
 
           if (pb_event->pointer_button->has_button)
-            event->pointer_button.button = pb_event->pointer_button->button;
+            event.pointer_button.button = pb_event->pointer_button->button;
           else
             {
               g_warn_if_reached ();
-              event->pointer_button.button = RUT_BUTTON_STATE_1;
+              event.pointer_button.button = RUT_BUTTON_STATE_1;
             }
           break;
 
@@ -137,19 +138,19 @@ simulator__run_frame (Rig__Simulator_Service *service,
         case RIG__EVENT__TYPE__KEY_UP:
 
           if (pb_event->key->has_keysym)
-            event->key.keysym = pb_event->key->keysym;
+            event.key.keysym = pb_event->key->keysym;
           else
             {
               g_warn_if_reached ();
-              event->key.keysym = RUT_KEY_a;
+              event.key.keysym = RUT_KEY_a;
             }
 
           if (pb_event->key->has_mod_state)
-            event->key.mod_state = pb_event->key->mod_state;
+            event.key.mod_state = pb_event->key->mod_state;
           else
             {
               g_warn_if_reached ();
-              event->key.mod_state = 0;
+              event.key.mod_state = 0;
             }
           break;
         }
@@ -157,53 +158,53 @@ simulator__run_frame (Rig__Simulator_Service *service,
       switch (pb_event->type)
         {
         case RIG__EVENT__TYPE__POINTER_MOVE:
-          event->type = RUT_STREAM_EVENT_POINTER_MOVE;
+          event.type = RUT_STREAM_EVENT_POINTER_MOVE;
 
           if (pb_event->pointer_move->has_x)
-            event->pointer_move.x = pb_event->pointer_move->x;
+            event.pointer_move.x = pb_event->pointer_move->x;
           else
             {
               g_warn_if_reached ();
-              event->pointer_move.x = 0;
+              event.pointer_move.x = 0;
             }
 
           if (pb_event->pointer_move->has_y)
-            event->pointer_move.y = pb_event->pointer_move->y;
+            event.pointer_move.y = pb_event->pointer_move->y;
           else
             {
               g_warn_if_reached ();
-              event->pointer_move.y = 0;
+              event.pointer_move.y = 0;
             }
 
-          simulator->last_pointer_x = event->pointer_move.x;
-          simulator->last_pointer_y = event->pointer_move.y;
+          simulator->last_pointer_x = event.pointer_move.x;
+          simulator->last_pointer_y = event.pointer_move.y;
 
-          g_print ("Event: Pointer move (%f, %f)\n",
-                   event->pointer_move.x, event->pointer_move.y);
+          RIG_INPUT_EVENT_NOTE ("Event: Pointer move (%f, %f)\n",
+                                event.pointer_move.x, event.pointer_move.y);
           break;
         case RIG__EVENT__TYPE__POINTER_DOWN:
-          event->type = RUT_STREAM_EVENT_POINTER_DOWN;
-          simulator->button_state |= event->pointer_button.button;
-          event->pointer_button.state |= event->pointer_button.button;
-          g_print ("Event: Pointer down\n");
+          event.type = RUT_STREAM_EVENT_POINTER_DOWN;
+          simulator->button_state |= event.pointer_button.button;
+          event.pointer_button.state |= event.pointer_button.button;
+          RIG_INPUT_EVENT_NOTE ("Event: Pointer down\n");
           break;
         case RIG__EVENT__TYPE__POINTER_UP:
-          event->type = RUT_STREAM_EVENT_POINTER_UP;
-          simulator->button_state &= ~event->pointer_button.button;
-          event->pointer_button.state &= ~event->pointer_button.button;
-          g_print ("Event: Pointer up\n");
+          event.type = RUT_STREAM_EVENT_POINTER_UP;
+          simulator->button_state &= ~event.pointer_button.button;
+          event.pointer_button.state &= ~event.pointer_button.button;
+          RIG_INPUT_EVENT_NOTE ("Event: Pointer up\n");
           break;
         case RIG__EVENT__TYPE__KEY_DOWN:
-          event->type = RUT_STREAM_EVENT_KEY_DOWN;
-          g_print ("Event: Key down\n");
+          event.type = RUT_STREAM_EVENT_KEY_DOWN;
+          RIG_INPUT_EVENT_NOTE ("Event: Key down\n");
           break;
         case RIG__EVENT__TYPE__KEY_UP:
-          event->type = RUT_STREAM_EVENT_KEY_UP;
-          g_print ("Event: Key up\n");
+          event.type = RUT_STREAM_EVENT_KEY_UP;
+          RIG_INPUT_EVENT_NOTE ("Event: Key up\n");
           break;
         }
 
-      rut_shell_handle_stream_event (engine->shell, event);
+      rut_shell_handle_stream_event (engine->shell, &event);
     }
 
   rut_shell_queue_redraw (engine->shell);
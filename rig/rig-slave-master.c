@@ -34,11 +34,33 @@
 
 #include "rig.pb-c.h"
 
+static void
+send_packed_ui (RigSlaveMaster *master, RutBuffer *packed_ui);
+
 static void
 handle_load_response (const Rig__LoadResult *result,
                       void *closure_data)
 {
-  g_print ("UI loaded by slave\n");
+  RigSlaveMaster *master = closure_data;
+
+  if (result)
+    g_print ("UI loaded by slave\n");
+
+  master->ui_load_pending = false;
+
+  /* If the UI changed again while the slave was busy then we skip
+   * straight to the latest version */
+  if (master->queued_ui)
+    {
+      RutBuffer *packed_ui = master->queued_ui;
+
+      master->queued_ui = NULL;
+
+      if (master->connected)
+        send_packed_ui (master, packed_ui);
+
+      rut_refable_unref (packed_ui);
+    }
 }
 
 void
@@ -47,6 +69,8 @@ slave_master_connected (PB_RPC_Client *pb_client,
 {
   RigSlaveMaster *master = user_data;
 
+  master->connected = TRUE;
+
   rig_slave_master_sync_ui (master);
 
   g_print ("XXXXXXXXXXXX Slave Connected and serialized UI sent!");
@@ -60,12 +84,22 @@ destroy_slave_master (RigSlaveMaster *master)
   if (!master->rpc_client)
     return;
 
+  /* NB: disconnecting invokes the closure of any pending Load
+   * request so we make sure handle_load_response() won't try to
+   * send a queued UI to the client we are tearing down */
+  master->connected = FALSE;
+
+  master->ui_load_pending = false;
+  if (master->queued_ui)
+    {
+      rut_refable_unref (master->queued_ui);
+      master->queued_ui = NULL;
+    }
+
   rig_rpc_client_disconnect (master->rpc_client);
   rut_refable_unref (master->rpc_client);
   master->rpc_client = NULL;
 
-  master->connected = FALSE;
-
   engine->slave_masters = g_list_remove (engine->slave_masters, master);
 
   rut_refable_unref (master);
@@ -161,24 +195,95 @@ rig_connect_to_slave (RigEngine *engine, RigSlaveAddress *slave_address)
   engine->slave_masters = g_list_prepend (engine->slave_masters, slave_master);
 }
 
-void
-rig_slave_master_sync_ui (RigSlaveMaster *master)
+static RutBuffer *
+serialize_packed_ui (RigEngine *engine)
 {
   RigPBSerializer *serializer;
-  RigEngine *engine = master->engine;
-  ProtobufCService *service =
-    rig_pb_rpc_client_get_service (master->rpc_client->pb_rpc_client);
   Rig__UI *ui;
-
-  g_warn_if_fail (master->required_assets == NULL);
+  RutBuffer *packed_ui;
 
   serializer = rig_pb_serializer_new (engine);
 
   ui = rig_pb_serialize_ui (serializer);
 
-  rig__slave__load (service, ui, handle_load_response, NULL);
+  packed_ui = rut_buffer_new (rig__ui__get_packed_size (ui));
+  rig__ui__pack (ui, packed_ui->data);
 
   rig_pb_serialized_ui_destroy (ui);
 
   rig_pb_serializer_destroy (serializer);
+
+  return packed_ui;
+}
+
+static void
+send_packed_ui (RigSlaveMaster *master, RutBuffer *packed_ui)
+{
+  PB_RPC_Client *pb_client = master->rpc_client->pb_rpc_client;
+  const ProtobufCMethodDescriptor *load_method =
+    protobuf_c_service_descriptor_get_method_by_name (&rig__slave__descriptor,
+                                                      "Load");
+
+  master->ui_load_pending = true;
+
+  /* NB: The outgoing stream references the packed data directly and
+   * drops its reference once the data has been written */
+  rig_pb_rpc_client_invoke_packed (pb_client,
+                                   load_method - rig__slave__descriptor.methods,
+                                   packed_ui->data,
+                                   packed_ui->size,
+                                   rut_refable_unref,
+                                   rut_refable_ref (packed_ui),
+                                   (ProtobufCClosure)handle_load_response,
+                                   master);
+}
+
+static void
+queue_packed_ui (RigSlaveMaster *master, RutBuffer *packed_ui)
+{
+  g_warn_if_fail (master->required_assets == NULL);
+
+  if (master->ui_load_pending)
+    {
+      if (master->queued_ui)
+        rut_refable_unref (master->queued_ui);
+      master->queued_ui = rut_refable_ref (packed_ui);
+      return;
+    }
+
+  send_packed_ui (master, packed_ui);
+}
+
+void
+rig_slave_master_group_sync_ui (RigEngine *engine,
+                                GList *slave_masters)
+{
+  RutBuffer *packed_ui = NULL;
+  GList *l;
+
+  for (l = slave_masters; l; l = l->next)
+    {
+      RigSlaveMaster *master = l->data;
+
+      /* Newly connected slaves will be synced by slave_master_connected() */
+      if (!master->connected)
+        continue;
+
+      /* Lazily serialize so nothing is done without any connected slaves */
+      if (!packed_ui)
+        packed_ui = serialize_packed_ui (engine);
+
+      queue_packed_ui (master, packed_ui);
+    }
+
+  if (packed_ui)
+    rut_refable_unref (packed_ui);
+}
+
+void
+rig_slave_master_sync_ui (RigSlaveMaster *master)
+{
+  GList link = { .data = master, .next = NULL, .prev = NULL };
+
+  rig_slave_master_group_sync_ui (master->engine, &link);
 }
@@ -44,6 +44,12 @@ typedef struct _RigSlaveMaster
 
   GList *required_assets;
 
+  /* TRUE while the slave is still busy loading the last UI we sent */
+  bool ui_load_pending;
+  /* The latest packed UI that was synced while a load was pending.
+   * Older snapshots are simply dropped in favour of this one. */
+  RutBuffer *queued_ui;
+
 } RigSlaveMaster;
 
 void
@@ -52,4 +58,13 @@ rig_connect_to_slave (RigEngine *engine, RigSlaveAddress *slave_address);
 void
 rig_slave_master_sync_ui (RigSlaveMaster *master);
 
+/*
+ * Sends the current UI to all of the given slave masters. The UI is
+ * only serialized and packed once and the same packed buffer is
+ * shared by the outgoing stream of each slave.
+ */
+void
+rig_slave_master_group_sync_ui (RigEngine *engine,
+                                GList *slave_masters);
+
 #endif /* __RIG_SLAVE_MASTER__ */
@@ -21,12 +21,14 @@
 #include <config.h>
 
 #include <math.h>
+#include <string.h>
 
 #include "rut-global.h"
 #include "rut-types.h"
 #include "rut-geometry.h"
 #include "rut-mesh.h"
 #include "rut-mesh-ply.h"
+#include "rut-mesh-optimize.h"
 #include "rut-meshable.h"
 
 #include "components/rut-model.h"
@@ -96,14 +98,64 @@ rut_model_get_primitive (RutObject *object)
     {
       if (model->mesh)
         {
+          /* The model's mesh is kept as floats for the processing
+           * done on the CPU but the copy uploaded to the GPU can
+           * use more compact attributes */
+          RutMesh *gpu_mesh =
+            rut_mesh_optimize (model->mesh, RUT_MESH_OPTIMIZE_QUANTIZE);
+
           model->primitive =
-            rut_mesh_create_primitive (model->ctx, model->mesh);
+            rut_mesh_create_primitive (model->ctx, gpu_mesh);
+
+          rut_refable_unref (gpu_mesh);
         }
     }
 
   return model->primitive;
 }
 
+int
+rut_model_get_n_lods (RutModel *model)
+{
+  return model->mesh ? model->mesh->n_lods : 0;
+}
+
+CoglPrimitive *
+rut_model_get_lod_primitive (RutModel *model,
+                             int lod)
+{
+  RutMesh *mesh = model->mesh;
+  CoglPrimitive *primitive = rut_model_get_primitive (model);
+  RutMeshLod *mesh_lod;
+
+  lod = MIN (lod, rut_model_get_n_lods (model));
+  if (lod <= 0)
+    return primitive;
+
+  if (model->lod_primitives[lod - 1])
+    return model->lod_primitives[lod - 1];
+
+  /* NB: the levels of detail share the vertices of the full mesh so
+   * we only need to replace the indices */
+  mesh_lod = &mesh->lods[lod - 1];
+  if (primitive)
+    {
+      CoglIndices *indices =
+        cogl_indices_new (model->ctx->cogl_context,
+                          mesh->indices_type,
+                          mesh_lod->indices_buffer->data,
+                          mesh_lod->n_indices);
+
+      primitive = cogl_primitive_copy (primitive);
+      cogl_primitive_set_indices (primitive, indices, mesh_lod->n_indices);
+      cogl_object_unref (indices);
+
+      model->lod_primitives[lod - 1] = primitive;
+    }
+
+  return primitive;
+}
+
 CoglPrimitive *
 rut_model_get_fin_primitive (RutObject *object)
 {
@@ -116,10 +168,17 @@ static void
 _rut_model_free (void *object)
 {
   RutModel *model = object;
+  int i;
 
   if (model->primitive)
     cogl_object_unref (model->primitive);
 
+  for (i = 0; i < RUT_MESH_MAX_LODS; i++)
+    {
+      if (model->lod_primitives[i])
+        cogl_object_unref (model->lod_primitives[i]);
+    }
+
   if (model->mesh)
     rut_refable_unref (model->mesh);
 
@@ -431,14 +490,96 @@ generate_cylindrical_uv_coordinates (Vertex *vertex,
   vertex->t0 = tex[1];
 }
 
+/* Below this many items it's not worth the cost of starting threads */
+#define PARALLEL_MIN_ITEMS 32768
+#define PARALLEL_MAX_JOBS 8
+
+typedef void (*ParallelCallback) (int job, int start, int end, void *user_data);
+
+typedef struct _ParallelJob
+{
+  ParallelCallback callback;
+  int job;
+  int start;
+  int end;
+  void *user_data;
+} ParallelJob;
+
+static void *
+parallel_thread_cb (void *user_data)
+{
+  ParallelJob *job = user_data;
+
+  job->callback (job->job, job->start, job->end, job->user_data);
+
+  return NULL;
+}
+
+static int
+get_n_parallel_jobs (int n_items)
+{
+  int n_jobs;
+
+  if (n_items < PARALLEL_MIN_ITEMS)
+    return 1;
+
+  n_jobs = CLAMP (g_get_num_processors (), 1, PARALLEL_MAX_JOBS);
+
+  return MIN (n_jobs, n_items / (PARALLEL_MIN_ITEMS / 4));
+}
+
+/* Splits the range [0, n_items) into contiguous chunks and calls
+ * @callback for each chunk with the job number that should be used
+ * to index any per-job results. The calling thread handles the last
+ * chunk itself and all the chunks have been processed by the time
+ * this returns. */
+static void
+run_parallel (ParallelCallback callback, int n_items, void *user_data)
+{
+  int n_jobs = get_n_parallel_jobs (n_items);
+  ParallelJob *jobs;
+  GThread **threads;
+  int i;
+
+  if (n_jobs <= 1)
+    {
+      callback (0, 0, n_items, user_data);
+      return;
+    }
+
+  jobs = g_alloca (sizeof (ParallelJob) * n_jobs);
+  threads = g_alloca (sizeof (GThread *) * n_jobs);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      jobs[i].callback = callback;
+      jobs[i].job = i;
+      jobs[i].start = (int64_t)n_items * i / n_jobs;
+      jobs[i].end = (int64_t)n_items * (i + 1) / n_jobs;
+      jobs[i].user_data = user_data;
+    }
+
+  for (i = 0; i < n_jobs - 1; i++)
+    threads[i] = g_thread_new ("rut-model", parallel_thread_cb, &jobs[i]);
+
+  parallel_thread_cb (&jobs[n_jobs - 1]);
+
+  for (i = 0; i < n_jobs - 1; i++)
+    g_thread_join (threads[i]);
+}
+
+/* NB: each polygon always adds 6 fin polygons and 12 fin vertices
+ * so the fins for a polygon are written at a fixed position which
+ * means polygons can be processed in any order */
 static void
 add_polygon_fins (RutModel *model,
-                  Polygon *polygon)
+                  int polygon_index)
 {
+  Polygon *polygon = &model->priv->polygons[polygon_index];
   Vertex *fin_verts[12];
   Polygon *fin_polys[6];
-  int poly_iter = model->priv->n_fin_polygons;
-  int vert_iter = model->priv->n_fin_vertices;
+  int poly_iter = polygon_index * 6;
+  int vert_iter = polygon_index * 12;
   int edges[3][2];
   int i, j;
 
@@ -530,9 +671,16 @@ add_polygon_fins (RutModel *model,
 
       j += 2;
     }
+}
+
+static void
+add_fins_range_cb (int job, int start, int end, void *user_data)
+{
+  RutModel *model = user_data;
+  int i;
 
-  model->priv->n_fin_polygons += 6;
-  model->priv->n_fin_vertices += 12;
+  for (i = start; i < end; i++)
+    add_polygon_fins (model, i);
 }
 
 static void
@@ -851,6 +999,231 @@ measure_mesh_xyz_cb (void **attribute_data,
   return TRUE;
 }
 
+/* The preprocessing above visits every triangle with
+ * rut_mesh_foreach_triangle() which is inherently serial because
+ * shared vertices are written by every triangle that references
+ * them, with the last triangle winning. For the common case of float
+ * attributes we instead first find the last triangle that references
+ * each vertex so that every vertex can then be processed
+ * independently in contiguous, parallel ranges without changing the
+ * results. */
+
+typedef struct _PreprocessState
+{
+  RutModel *model;
+
+  RutAttributeView positions;
+  RutAttributeView normals;
+  RutAttributeView tangents;
+  RutAttributeView tex_coords;
+
+  /* NULL for meshes without indices */
+  uint32_t *indices;
+
+  /* The last triangle referencing each vertex or -1 if none do. NULL
+   * for meshes without indices where this is simply vertex / 3 */
+  int *last_triangle;
+
+  int n_vertices;
+  int n_triangles;
+
+  float bounds[PARALLEL_MAX_JOBS][6];
+} PreprocessState;
+
+static bool
+get_float_view (RutMesh *mesh,
+                const char *name,
+                int min_components,
+                RutAttributeView *view)
+{
+  return (rut_mesh_get_attribute_view (mesh, name, view) &&
+          view->type == RUT_ATTRIBUTE_TYPE_FLOAT &&
+          view->n_components >= min_components);
+}
+
+static int
+get_vertex_triangle (PreprocessState *state, int vertex)
+{
+  if (state->last_triangle)
+    return state->last_triangle[vertex];
+  else
+    return vertex / 3 < state->n_triangles ? vertex / 3 : -1;
+}
+
+static void
+measure_range_cb (int job, int start, int end, void *user_data)
+{
+  PreprocessState *state = user_data;
+  float min_x = G_MAXFLOAT, min_y = G_MAXFLOAT, min_z = G_MAXFLOAT;
+  float max_x = -G_MAXFLOAT, max_y = -G_MAXFLOAT, max_z = -G_MAXFLOAT;
+  int i;
+
+  for (i = start; i < end; i++)
+    {
+      float *pos;
+
+      /* Unindexed vertices are all measured, whether or not they
+       * make up a whole triangle, to match rut_mesh_foreach_vertex() */
+      if (state->last_triangle && state->last_triangle[i] < 0)
+        continue;
+
+      pos = rut_attribute_view_get_floats (&state->positions, i);
+
+      min_x = MIN (min_x, pos[0]);
+      max_x = MAX (max_x, pos[0]);
+      min_y = MIN (min_y, pos[1]);
+      max_y = MAX (max_y, pos[1]);
+      min_z = MIN (min_z, pos[2]);
+      max_z = MAX (max_z, pos[2]);
+    }
+
+  state->bounds[job][0] = min_x;
+  state->bounds[job][1] = max_x;
+  state->bounds[job][2] = min_y;
+  state->bounds[job][3] = max_y;
+  state->bounds[job][4] = min_z;
+  state->bounds[job][5] = max_z;
+}
+
+static void
+generate_properties_range_cb (int job, int start, int end, void *user_data)
+{
+  PreprocessState *state = user_data;
+  RutModel *model = state->model;
+  int i;
+
+  for (i = start; i < end; i++)
+    {
+      int triangle = get_vertex_triangle (state, i);
+      float *positions[3];
+      float *tex_coords[3];
+      float generated_tex_coords[3][2];
+      int corner = 0;
+      int j;
+
+      if (triangle < 0)
+        continue;
+
+      for (j = 0; j < 3; j++)
+        {
+          int v = state->indices ?
+            state->indices[triangle * 3 + j] : triangle * 3 + j;
+
+          if (v == i)
+            corner = j;
+
+          positions[j] =
+            rut_attribute_view_get_floats (&state->positions, v);
+
+          /* Generated coordinates are only written for the vertex
+           * being processed so the other vertices of the triangle
+           * are derived from their positions locally */
+          if (model->builtin_tex_coords)
+            tex_coords[j] =
+              rut_attribute_view_get_floats (&state->tex_coords, v);
+          else
+            {
+              tex_coords[j] = generated_tex_coords[j];
+              calculate_cylindrical_uv_coordinates (model,
+                                                    positions[j],
+                                                    tex_coords[j]);
+            }
+        }
+
+      if (!model->builtin_tex_coords)
+        {
+          float *tex =
+            rut_attribute_view_get_floats (&state->tex_coords, i);
+
+          tex[0] = generated_tex_coords[corner][0];
+          tex[1] = generated_tex_coords[corner][1];
+        }
+
+      if (!model->builtin_normals)
+        {
+          float *normal =
+            rut_attribute_view_get_floats (&state->normals, i);
+          calculate_normals (positions[0], positions[1], positions[2],
+                             normal, normal, normal);
+        }
+
+      {
+        float *tangent = rut_attribute_view_get_floats (&state->tangents, i);
+        calculate_tangents (positions[0], positions[1], positions[2],
+                            tex_coords[0], tex_coords[1], tex_coords[2],
+                            tangent, tangent, tangent);
+      }
+    }
+}
+
+static bool
+preprocess_triangles_in_parallel (RutModel *model)
+{
+  RutMesh *mesh = model->mesh;
+  PreprocessState state;
+  int n_jobs;
+  int i;
+
+  if (mesh->mode != COGL_VERTICES_MODE_TRIANGLES)
+    return false;
+
+  if (!get_float_view (mesh, "cogl_position_in", 3, &state.positions) ||
+      !get_float_view (mesh, "cogl_normal_in", 3, &state.normals) ||
+      !get_float_view (mesh, "tangent_in", 3, &state.tangents) ||
+      !get_float_view (mesh, "cogl_tex_coord0_in", 2, &state.tex_coords))
+    return false;
+
+  state.model = model;
+  state.n_vertices = mesh->n_vertices;
+  state.n_triangles = rut_mesh_get_n_triangles (mesh);
+  state.indices = NULL;
+  state.last_triangle = NULL;
+
+  if (mesh->indices_buffer)
+    {
+      state.indices = g_new (uint32_t, state.n_triangles * 3);
+      rut_mesh_get_triangles (mesh, 0, state.n_triangles, state.indices);
+
+      state.last_triangle = g_new (int, state.n_vertices);
+      memset (state.last_triangle, 0xff, sizeof (int) * state.n_vertices);
+
+      for (i = 0; i < state.n_triangles * 3; i++)
+        {
+          uint32_t v = state.indices[i];
+
+          if (G_UNLIKELY (v >= state.n_vertices))
+            {
+              g_free (state.indices);
+              g_free (state.last_triangle);
+              return false;
+            }
+
+          state.last_triangle[v] = i / 3;
+        }
+    }
+
+  n_jobs = get_n_parallel_jobs (state.n_vertices);
+
+  run_parallel (measure_range_cb, state.n_vertices, &state);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      model->min_x = MIN (model->min_x, state.bounds[i][0]);
+      model->max_x = MAX (model->max_x, state.bounds[i][1]);
+      model->min_y = MIN (model->min_y, state.bounds[i][2]);
+      model->max_y = MAX (model->max_y, state.bounds[i][3]);
+      model->min_z = MIN (model->min_z, state.bounds[i][4]);
+      model->max_z = MAX (model->max_z, state.bounds[i][5]);
+    }
+
+  run_parallel (generate_properties_range_cb, state.n_vertices, &state);
+
+  g_free (state.indices);
+  g_free (state.last_triangle);
+
+  return true;
+}
+
 /* Gets the angle between 2 vectors relative to a rotation axis (usually their
  * cross product). This function takes the "direction" of the angle / rotation
  * into consideration and adjusts the angle accordingly, avoiding clockwise
@@ -1372,6 +1745,9 @@ rut_model_new_from_asset_mesh (RutContext *ctx,
   model->builtin_normals = !needs_normals;
   model->builtin_tex_coords = !needs_tex_coords;
 
+  if (preprocess_triangles_in_parallel (model))
+    goto done;
+
   if (attribute->n_components == 1)
     {
       model->min_y = model->max_y = 0;
@@ -1403,6 +1779,7 @@ rut_model_new_from_asset_mesh (RutContext *ctx,
                              "cogl_tex_coord0_in",
                              NULL);
 
+done:
   /* When rendering we expect that every model has a specific set of
    * texture coordinate attributes that may be required depending
    * on the material state used in conjunction with the model.
@@ -1540,8 +1917,9 @@ rut_model_new_for_hair (RutModel *base)
 
   model->patched_mesh = create_patched_mesh_from_model (model);
 
-  for (i = 0; i < model->priv->n_polygons; i++)
-    add_polygon_fins (model, &model->priv->polygons[i]);
+  run_parallel (add_fins_range_cb, model->priv->n_polygons, model);
+  model->priv->n_fin_polygons = model->priv->n_polygons * 6;
+  model->priv->n_fin_vertices = model->priv->n_polygons * 12;
 
   model->fin_mesh = create_fin_mesh_from_model (model);
 
@@ -63,6 +63,9 @@ struct _RutModel
 
   CoglPrimitive *primitive;
 
+  /* Created lazily for each of the mesh's levels of detail */
+  CoglPrimitive *lod_primitives[RUT_MESH_MAX_LODS];
+
   CoglBool builtin_normals;
   CoglBool builtin_tex_coords;
 
@@ -114,6 +117,17 @@ rut_model_get_primitive (RutObject *object);
 CoglPrimitive *
 rut_model_get_fin_primitive (RutObject *object);
 
+int
+rut_model_get_n_lods (RutModel *model);
+
+/* Returns a primitive for the given level of detail where 0 is the
+ * full mesh and 1 to rut_model_get_n_lods() are increasingly
+ * simplified. Levels beyond the last level of detail return the most
+ * simplified primitive. */
+CoglPrimitive *
+rut_model_get_lod_primitive (RutModel *model,
+                             int lod);
+
 float
 rut_model_get_default_hair_length (RutObject *object);
 
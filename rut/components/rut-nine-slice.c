@@ -30,7 +30,34 @@
 #include "rut-camera-private.h"
 #include "rut-nine-slice.h"
 #include "rut-closure.h"
-#include "rut-meshable.h"
+#include "rut-util.h"
+
+/* Everything that affects the vertices of a nine-slice apart from its
+ * size */
+typedef struct _RutNineSliceGeometryKey
+{
+  float left;
+  float right;
+  float top;
+  float bottom;
+  float tex_width;
+  float tex_height;
+} RutNineSliceGeometryKey;
+
+/* The topology of a nine-slice for a set of borders which is shared
+ * between all the nine-slices with the same borders, regardless of
+ * their size. The cache in RutContext::nine_slice_geometries doesn't
+ * hold a reference; the geometry removes itself when it is freed. */
+typedef struct _RutNineSliceGeometry
+{
+  int ref_count;
+
+  RutContext *ctx;
+  RutNineSliceGeometryKey key;
+
+  RutMesh *mesh;
+  CoglPrimitive *primitive;
+} RutNineSliceGeometry;
 
 enum {
   RUT_NINE_SLICE_PROP_WIDTH,
@@ -71,7 +98,7 @@ struct _RutNineSlice
   float width;
   float height;
 
-  RutMesh *mesh;
+  RutNineSliceGeometry *geometry;
 
   RutGraphableProps graphable;
   RutPaintableProps paintable;
@@ -137,6 +164,7 @@ static RutPropertySpec _rut_nine_slice_prop_specs[] = {
 typedef struct _VertexP2T2T2
 {
   float x, y, s0, t0, s1, t1;
+  float stretch_x, stretch_y;
 
   /* TODO: support constant attributes in RutMesh, and also ensure
    * Mesa'a support for constant attributes gets fixed */
@@ -150,7 +178,7 @@ mesh_new_p2t2t2 (CoglVerticesMode mode,
                  VertexP2T2T2 *vertices)
 {
   RutMesh *mesh;
-  RutAttribute *attributes[8];
+  RutAttribute *attributes[9];
   RutBuffer *vertex_buffer;
   RutBuffer *index_buffer;
 
@@ -217,7 +245,14 @@ mesh_new_p2t2t2 (CoglVerticesMode mode,
                                      3,
                                      RUT_ATTRIBUTE_TYPE_FLOAT);
 
-  mesh = rut_mesh_new (mode, n_vertices, attributes, 8);
+  attributes[8] = rut_attribute_new (vertex_buffer,
+                                     "stretch_in",
+                                     sizeof (VertexP2T2T2),
+                                     offsetof (VertexP2T2T2, stretch_x),
+                                     2,
+                                     RUT_ATTRIBUTE_TYPE_FLOAT);
+
+  mesh = rut_mesh_new (mode, n_vertices, attributes, 9);
   rut_mesh_set_indices (mesh,
                         COGL_INDICES_TYPE_UNSIGNED_BYTE,
                         index_buffer,
@@ -227,79 +262,85 @@ mesh_new_p2t2t2 (CoglVerticesMode mode,
   return mesh;
 }
 
-static void
-create_mesh (RutNineSlice *nine_slice)
+static unsigned int
+geometry_key_hash (const void *key)
 {
-  float tex_width = nine_slice->tex_width;
-  float tex_height = nine_slice->tex_height;
-  float width = nine_slice->width;
-  float height = nine_slice->height;
-  float left = nine_slice->left;
-  float right = nine_slice->right;
-  float top = nine_slice->top;
-  float bottom = nine_slice->bottom;
+  return rut_util_one_at_a_time_hash (0, key,
+                                      sizeof (RutNineSliceGeometryKey));
+}
+
+static gboolean
+geometry_key_equal (const void *a, const void *b)
+{
+  return memcmp (a, b, sizeof (RutNineSliceGeometryKey)) == 0;
+}
+
+static RutMesh *
+create_mesh (const RutNineSliceGeometryKey *key)
+{
+  float tex_width = key->tex_width;
+  float tex_height = key->tex_height;
+  float left = key->left;
+  float right = key->right;
+  float top = key->top;
+  float bottom = key->bottom;
   int n_vertices;
 
-  /* x0,y0,x1,y1 and s0,t0,s1,t1 define the postion and texture
-   * coordinates for the center rectangle... */
-  float x0 = left;
-  float y0 = top;
-  float x1 = width - right;
-  float y1 = height - bottom;
-
-  /* tex coords 0 */
-  float s0_1 = left / tex_width;
-  float t0_1 = top / tex_height;
-  float s1_1 = (tex_width - right) / tex_width;
-  float t1_1 = (tex_height - bottom) / tex_height;
-
-  /* tex coords 1 */
-  float s0_0 = left / width;
-  float t0_0 = top / height;
-  float s1_0 = (width - right) / width;
-  float t1_0 = (height - bottom) / height;
+  /* texture coordinates of the borders */
+  float s0 = left / tex_width;
+  float t0 = top / tex_height;
+  float s1 = (tex_width - right) / tex_width;
+  float t1 = (tex_height - bottom) / tex_height;
 
   int i;
 
-  /*
-   * 0,0      x0,0      x1,0      width,0
-   * 0,0      s0,0      s1,0      1,0
-   * 0        1         2         3
+  /* The position of each vertex is the fixed offset of its border
+   * plus the size of the nine-slice multiplied by the stretch_in
+   * attribute so the same vertices can be used for any size:
+   *
+   * 0,0          left,0          -right,0          0,0
+   * (0,0)        (0,0)           (1,0)             (1,0)
+   * 0            1               2                 3
+   *
+   * 0,top        left,top        -right,top        0,top
+   * (0,0)        (0,0)           (1,0)             (1,0)
+   * 4            5               6                 7
    *
-   * 0,y0     x0,y0     x1,y0     width,y0
-   * 0,t0     s0,t0     s1,t0     1,t0
-   * 4        5         6         7
+   * 0,-bottom    left,-bottom    -right,-bottom    0,-bottom
+   * (0,1)        (0,1)           (1,1)             (1,1)
+   * 8            9               10                11
    *
-   * 0,y1     x0,y1     x1,y1     width,y1
-   * 0,t1     s0,t1     s1,t1     1,t1
-   * 8        9         10        11
+   * 0,0          left,0          -right,0          0,0
+   * (0,1)        (0,1)           (1,1)             (1,1)
+   * 12           13              14                15
    *
-   * 0,height x0,height x1,height width,height
-   * 0,1      s0,1      s1,1      1,1
-   * 12       13        14        15
+   * Tex coords 0 used to be relative to the size of the nine-slice
+   * but nothing samples layer 0 of a nine-slice so they're now the
+   * same as tex coords 1, which matches the old coordinates whenever
+   * the image size is the same as the nine-slice's size.
    */
 
   VertexP2T2T2 vertices[] =
     {
-        { 0,     0, 0,    0, 0,    0},
-        { x0,    0, s0_0, 0, s0_1, 0},
-        { x1,    0, s1_0, 0, s1_1, 0},
-        { width, 0, 1,    0, 1,    0},
-
-        { 0,     y0, 0,    t0_0, 0,    t0_1},
-        { x0,    y0, s0_0, t0_0, s0_1, t0_1},
-        { x1,    y0, s1_0, t0_0, s1_1, t0_1},
-        { width, y0, 1,    t0_0, 1,    t0_1},
-
-        { 0,     y1, 0,    t1_0, 0,    t1_1},
-        { x0,    y1, s0_0, t1_0, s0_1, t1_1},
-        { x1,    y1, s1_0, t1_0, s1_1, t1_1},
-        { width, y1, 1,    t1_0, 1,    t1_1},
-
-        { 0,     height, 0,    1, 0,    1},
-        { x0,    height, s0_0, 1, s0_1, 1},
-        { x1,    height, s1_0, 1, s1_1, 1},
-        { width, height, 1,    1, 1,    1},
+        { 0,      0,       0,  0,  0,  0,  0, 0 },
+        { left,   0,       s0, 0,  s0, 0,  0, 0 },
+        { -right, 0,       s1, 0,  s1, 0,  1, 0 },
+        { 0,      0,       1,  0,  1,  0,  1, 0 },
+
+        { 0,      top,     0,  t0, 0,  t0, 0, 0 },
+        { left,   top,     s0, t0, s0, t0, 0, 0 },
+        { -right, top,     s1, t0, s1, t0, 1, 0 },
+        { 0,      top,     1,  t0, 1,  t0, 1, 0 },
+
+        { 0,      -bottom, 0,  t1, 0,  t1, 0, 1 },
+        { left,   -bottom, s0, t1, s0, t1, 0, 1 },
+        { -right, -bottom, s1, t1, s1, t1, 1, 1 },
+        { 0,      -bottom, 1,  t1, 1,  t1, 1, 1 },
+
+        { 0,      0,       0,  1,  0,  1,  0, 1 },
+        { left,   0,       s0, 1,  s0, 1,  0, 1 },
+        { -right, 0,       s1, 1,  s1, 1,  1, 1 },
+        { 0,      0,       1,  1,  1,  1,  1, 1 },
     };
 
   /* TODO: support constant attributes in RutMesh, and also ensure
@@ -316,19 +357,77 @@ create_mesh (RutNineSlice *nine_slice)
       vertices[i].Tz = 0;
     }
 
-  nine_slice->mesh = mesh_new_p2t2t2 (COGL_VERTICES_MODE_TRIANGLES,
-                                      n_vertices,
-                                      vertices);
+  return mesh_new_p2t2t2 (COGL_VERTICES_MODE_TRIANGLES,
+                          n_vertices,
+                          vertices);
 }
 
-static void
-free_mesh (RutNineSlice *nine_slice)
+static RutNineSliceGeometry *
+get_geometry (RutNineSlice *nine_slice)
 {
-  if (nine_slice->mesh)
+  RutContext *ctx = nine_slice->ctx;
+  RutNineSliceGeometryKey key;
+  RutNineSliceGeometry *geometry;
+
+  if (nine_slice->geometry)
+    return nine_slice->geometry;
+
+  /* NB: the key is hashed and compared bytewise so make sure there
+   * is no uninitialized padding */
+  memset (&key, 0, sizeof (key));
+  key.left = nine_slice->left;
+  key.right = nine_slice->right;
+  key.top = nine_slice->top;
+  key.bottom = nine_slice->bottom;
+  key.tex_width = nine_slice->tex_width;
+  key.tex_height = nine_slice->tex_height;
+
+  if (!ctx->nine_slice_geometries)
+    ctx->nine_slice_geometries = g_hash_table_new (geometry_key_hash,
+                                                   geometry_key_equal);
+
+  geometry = g_hash_table_lookup (ctx->nine_slice_geometries, &key);
+  if (geometry)
+    geometry->ref_count++;
+  else
     {
-      rut_refable_unref (nine_slice->mesh);
-      nine_slice->mesh = NULL;
+      geometry = g_slice_new (RutNineSliceGeometry);
+      geometry->ref_count = 1;
+      geometry->ctx = ctx;
+      geometry->key = key;
+      geometry->mesh = create_mesh (&key);
+      geometry->primitive = NULL;
+
+      g_hash_table_insert (ctx->nine_slice_geometries,
+                           &geometry->key,
+                           geometry);
     }
+
+  nine_slice->geometry = geometry;
+
+  return geometry;
+}
+
+static void
+free_geometry (RutNineSlice *nine_slice)
+{
+  RutNineSliceGeometry *geometry = nine_slice->geometry;
+
+  if (!geometry)
+    return;
+
+  nine_slice->geometry = NULL;
+
+  if (--geometry->ref_count)
+    return;
+
+  g_hash_table_remove (geometry->ctx->nine_slice_geometries, &geometry->key);
+
+  rut_refable_unref (geometry->mesh);
+  if (geometry->primitive)
+    cogl_object_unref (geometry->primitive);
+
+  g_slice_free (RutNineSliceGeometry, geometry);
 }
 
 static void
@@ -344,7 +443,7 @@ _rut_nine_slice_free (void *object)
   if (nine_slice->pipeline)
     cogl_object_unref (nine_slice->pipeline);
 
-  free_mesh (nine_slice);
+  free_geometry (nine_slice);
 
   rut_graphable_destroy (nine_slice);
 
@@ -516,10 +615,6 @@ _rut_nine_slice_init_type (void)
       .get_primitive = rut_nine_slice_get_primitive
   };
 
-  static RutMeshableVTable meshable_vtable = {
-      .get_mesh = rut_nine_slice_get_pick_mesh
-  };
-
   static RutSizableVTable sizable_vtable = {
       rut_nine_slice_set_size,
       rut_nine_slice_get_size,
@@ -564,10 +659,6 @@ _rut_nine_slice_init_type (void)
                           RUT_INTERFACE_ID_PRIMABLE,
                           0, /* no associated properties */
                           &primable_vtable);
-  rut_type_add_interface (type,
-                          RUT_INTERFACE_ID_MESHABLE,
-                          0, /* no associated properties */
-                          &meshable_vtable);
   rut_type_add_interface (type,
                           RUT_INTERFACE_ID_SIZABLE,
                           0, /* no implied properties */
@@ -619,7 +710,7 @@ rut_nine_slice_new (RutContext *ctx,
   nine_slice->width = width;
   nine_slice->height = height;
 
-  nine_slice->mesh = NULL;
+  nine_slice->geometry = NULL;
 
   nine_slice->texture = NULL;
   nine_slice->pipeline = NULL;
@@ -651,7 +742,7 @@ rut_nine_slice_set_texture (RutNineSlice *nine_slice,
   if (nine_slice->texture == texture)
     return;
 
-  free_mesh (nine_slice);
+  free_geometry (nine_slice);
 
   if (nine_slice->texture)
     cogl_object_unref (nine_slice->texture);
@@ -688,7 +779,7 @@ rut_nine_slice_set_image_size (RutObject *self,
       nine_slice->tex_height == height)
     return;
 
-  free_mesh (nine_slice);
+  free_geometry (nine_slice);
 
   nine_slice->tex_width = width;
   nine_slice->tex_height = height;
@@ -708,8 +799,6 @@ rut_nine_slice_set_size (RutObject *self,
   if (nine_slice->width == width && nine_slice->height == height)
     return;
 
-  free_mesh (nine_slice);
-
   nine_slice->width = width;
   nine_slice->height = height;
 
@@ -743,22 +832,28 @@ CoglPrimitive *
 rut_nine_slice_get_primitive (RutObject *object)
 {
   RutNineSlice *nine_slice = object;
+  RutNineSliceGeometry *geometry = get_geometry (nine_slice);
 
-  if (!nine_slice->mesh)
-    create_mesh (nine_slice);
+  if (!geometry->primitive)
+    geometry->primitive = rut_mesh_create_primitive (nine_slice->ctx,
+                                                     geometry->mesh);
 
-  return rut_mesh_create_primitive (nine_slice->ctx, nine_slice->mesh);
+  return geometry->primitive;
 }
 
-RutMesh *
-rut_nine_slice_get_pick_mesh (RutObject *object)
+bool
+rut_nine_slice_pick (RutNineSlice *nine_slice,
+                     float ray_origin[3],
+                     float ray_direction[3],
+                     float *t_out)
 {
-  RutNineSlice *nine_slice = object;
+  float x, y;
 
-  if (!nine_slice->mesh)
-    create_mesh (nine_slice);
+  if (!rut_util_intersect_z_plane (ray_origin, ray_direction, &x, &y, t_out))
+    return FALSE;
 
-  return nine_slice->mesh;
+  return (x >= 0 && x <= nine_slice->width &&
+          y >= 0 && y <= nine_slice->height);
 }
 
 RutClosure *
@@ -782,7 +877,10 @@ rut_nine_slice_set_ ## PROP_LC (RutObject *obj, float PROP_LC) \
   if (nine_slice->PROP_LC == PROP_LC) \
     return; \
   nine_slice->PROP_LC = PROP_LC; \
-  free_mesh (nine_slice); \
+  /* The geometry is shared between all sizes */ \
+  if (RUT_NINE_SLICE_PROP_ ## PROP_UC != RUT_NINE_SLICE_PROP_WIDTH && \
+      RUT_NINE_SLICE_PROP_ ## PROP_UC != RUT_NINE_SLICE_PROP_HEIGHT) \
+    free_geometry (nine_slice); \
   rut_property_dirty (&nine_slice->ctx->property_ctx, \
                       &nine_slice->properties[RUT_NINE_SLICE_PROP_ ## PROP_UC]); \
   rut_closure_list_invoke (&nine_slice->updated_cb_list, \
@@ -64,11 +64,20 @@ rut_nine_slice_set_texture (RutNineSlice *nine_slice,
 CoglPipeline *
 rut_nine_slice_get_pipeline (RutNineSlice *nine_slice);
 
+/* The primitive is shared with other nine-slices that have the same
+ * borders and image size so when drawing it the vertices need to be
+ * offset by their stretch_in attribute multiplied by the size of the
+ * nine-slice. */
 CoglPrimitive *
 rut_nine_slice_get_primitive (RutObject *object);
 
-RutMesh *
-rut_nine_slice_get_pick_mesh (RutObject *object);
+/* Intersects a ray in the nine-slice's coordinate space with the
+ * rectangle covered by the nine-slice. */
+bool
+rut_nine_slice_pick (RutNineSlice *nine_slice,
+                     float ray_origin[3],
+                     float ray_direction[3],
+                     float *t_out);
 
 typedef void (* RutNineSliceUpdateCallback) (RutNineSlice *nine_slice,
                                              void *user_data);
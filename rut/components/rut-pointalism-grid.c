@@ -22,10 +22,12 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "rut-pointalism-grid.h"
 #include "rut-global.h"
 #include "rut-meshable.h"
+#include "rut-util.h"
 
 #define MESA_CONST_ATTRIB_BUG_WORKAROUND
 
@@ -80,7 +82,12 @@ _pointalism_grid_slice_free (void *object)
 {
   RutPointalismGridSlice *pointalism_grid_slice = object;
 
+  g_hash_table_remove (pointalism_grid_slice->ctx->pointalism_grid_slices,
+                       &pointalism_grid_slice->key);
+
   rut_refable_unref (pointalism_grid_slice->mesh);
+  if (pointalism_grid_slice->primitive)
+    cogl_object_unref (pointalism_grid_slice->primitive);
 
   g_slice_free (RutPointalismGridSlice, object);
 }
@@ -109,110 +116,122 @@ _rut_pointalism_grid_slice_init_type (void)
 #undef TYPE
 }
 
+/* Every cell of the grid is a quad with its own copy of the cell's
+ * origin and texture coordinates. Ideally the quad would be shared
+ * and the per-cell data would be instanced but Cogl doesn't expose
+ * instanced drawing so instead the per-vertex data is kept as
+ * compact as possible: everything except the positions is stored
+ * as normalized integers. */
 typedef struct _GridVertex
 {
   float x0, y0;
   float x1, y1;
-  float s0, t0;
-  float s1, s2, t1, t2;
-  float s3, t3;
+  uint16_t s1, s2, t1, t2;
+  uint16_t s3, t3;
+  uint8_t s0, t0, pad0[2];
 #ifdef MESA_CONST_ATTRIB_BUG_WORKAROUND
-  float nx, ny, nz;
-  float tx, ty, tz;
+  int8_t nx, ny, nz, pad1;
+  int8_t tx, ty, tz, pad2;
 #endif
 } GridVertex;
 
+static RutAttribute *
+grid_attribute_new (RutBuffer *vertex_buffer,
+                    const char *name,
+                    size_t offset,
+                    int n_components,
+                    RutAttributeType type)
+{
+  RutAttribute *attribute = rut_attribute_new (vertex_buffer,
+                                               name,
+                                               sizeof (GridVertex),
+                                               offset,
+                                               n_components,
+                                               type);
+
+  if (type != RUT_ATTRIBUTE_TYPE_FLOAT)
+    rut_attribute_set_normalized (attribute, true);
+
+  return attribute;
+}
+
 static RutMesh *
 mesh_new_grid (CoglVerticesMode mode,
                int n_vertices,
                int n_indices,
                GridVertex *vertices,
-               unsigned int *indices)
+               CoglIndicesType indices_type,
+               void *indices)
 {
   RutMesh *mesh;
   RutAttribute *attributes[10];
   RutBuffer *vertex_buffer;
   RutBuffer *index_buffer;
+  size_t index_size = (indices_type == COGL_INDICES_TYPE_UNSIGNED_SHORT ?
+                       sizeof (uint16_t) : sizeof (uint32_t));
+  int n_attributes = 0;
 
   vertex_buffer = rut_buffer_new (sizeof (GridVertex) * n_vertices);
-  index_buffer = rut_buffer_new (sizeof (unsigned int) * n_indices);
+  index_buffer = rut_buffer_new (index_size * n_indices);
 
   memcpy (vertex_buffer->data, vertices, sizeof (GridVertex) * n_vertices);
-  memcpy (index_buffer->data, indices, sizeof (unsigned int) * n_indices);
-
-  attributes[0] = rut_attribute_new (vertex_buffer,
-                                     "cogl_position_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, x0),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[1] = rut_attribute_new (vertex_buffer,
-                                     "cogl_tex_coord0_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, s0),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[2] = rut_attribute_new (vertex_buffer,
-                                     "cogl_tex_coord1_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, s3),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[3] = rut_attribute_new (vertex_buffer,
-                                     "cogl_tex_coord4_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, s3),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[4] = rut_attribute_new (vertex_buffer,
-                                     "cogl_tex_coord7_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, s3),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[5] = rut_attribute_new (vertex_buffer,
-                                     "cogl_tex_coord11_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, s0),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[6] = rut_attribute_new (vertex_buffer,
-                                     "cogl_normal_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, nx),
-                                     3,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[7] = rut_attribute_new (vertex_buffer,
-                                     "tangent_in",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, tx),
-                                     3,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[8] = rut_attribute_new (vertex_buffer,
-                                     "cell_xy",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, x1),
-                                     2,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  attributes[9] = rut_attribute_new (vertex_buffer,
-                                     "cell_st",
-                                     sizeof (GridVertex),
-                                     offsetof (GridVertex, s1),
-                                     4,
-                                     RUT_ATTRIBUTE_TYPE_FLOAT);
-
-  mesh = rut_mesh_new (mode, n_vertices, attributes, 10);
+  memcpy (index_buffer->data, indices, index_size * n_indices);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_position_in",
+                        offsetof (GridVertex, x0), 2,
+                        RUT_ATTRIBUTE_TYPE_FLOAT);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_tex_coord0_in",
+                        offsetof (GridVertex, s0), 2,
+                        RUT_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_tex_coord1_in",
+                        offsetof (GridVertex, s3), 2,
+                        RUT_ATTRIBUTE_TYPE_UNSIGNED_SHORT);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_tex_coord4_in",
+                        offsetof (GridVertex, s3), 2,
+                        RUT_ATTRIBUTE_TYPE_UNSIGNED_SHORT);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_tex_coord7_in",
+                        offsetof (GridVertex, s3), 2,
+                        RUT_ATTRIBUTE_TYPE_UNSIGNED_SHORT);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_tex_coord11_in",
+                        offsetof (GridVertex, s0), 2,
+                        RUT_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
+
+#ifdef MESA_CONST_ATTRIB_BUG_WORKAROUND
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cogl_normal_in",
+                        offsetof (GridVertex, nx), 3,
+                        RUT_ATTRIBUTE_TYPE_BYTE);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "tangent_in",
+                        offsetof (GridVertex, tx), 3,
+                        RUT_ATTRIBUTE_TYPE_BYTE);
+#endif
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cell_xy",
+                        offsetof (GridVertex, x1), 2,
+                        RUT_ATTRIBUTE_TYPE_FLOAT);
+
+  attributes[n_attributes++] =
+    grid_attribute_new (vertex_buffer, "cell_st",
+                        offsetof (GridVertex, s1), 4,
+                        RUT_ATTRIBUTE_TYPE_UNSIGNED_SHORT);
+
+  mesh = rut_mesh_new (mode, n_vertices, attributes, n_attributes);
   rut_mesh_set_indices (mesh,
-                        COGL_INDICES_TYPE_UNSIGNED_INT,
+                        indices_type,
                         index_buffer,
                         n_indices);
 
@@ -222,21 +241,72 @@ mesh_new_grid (CoglVerticesMode mode,
   return mesh;
 }
 
-void
-pointalism_generate_grid (RutPointalismGridSlice *slice,
-                          int tex_width,
-                          int tex_height,
-                          float size)
+/* Maps a texture coordinate in the range [0,1] to a normalized
+ * unsigned short */
+static uint16_t
+grid_coord (int cell, int n_cells)
+{
+  return (uint16_t)(((uint32_t)cell * 65535 + n_cells / 2) / n_cells);
+}
+
+static void
+set_grid_vertex (GridVertex *vertex,
+                 float x, float y,
+                 float cell_x, float cell_y,
+                 int column, int row,
+                 int columns, int rows,
+                 int corner_s, int corner_t)
+{
+  vertex->x0 = x;
+  vertex->y0 = y;
+  vertex->x1 = cell_x;
+  vertex->y1 = cell_y;
+  vertex->s1 = grid_coord (column, columns);
+  vertex->s2 = grid_coord (column + 1, columns);
+  vertex->t1 = grid_coord (row, rows);
+  vertex->t2 = grid_coord (row + 1, rows);
+  vertex->s3 = grid_coord (column + corner_s, columns);
+  vertex->t3 = grid_coord (row + corner_t, rows);
+  vertex->s0 = corner_s ? 255 : 0;
+  vertex->t0 = corner_t ? 255 : 0;
+#ifdef MESA_CONST_ATTRIB_BUG_WORKAROUND
+  vertex->nx = 0;
+  vertex->ny = 0;
+  vertex->nz = 127;
+  vertex->tx = 127;
+  vertex->ty = 0;
+  vertex->tz = 0;
+#endif
+}
+
+static RutMesh *
+pointalism_generate_grid (const RutPointalismGridKey *key)
 {
-  int columns = abs (tex_width / size);
-  int rows = abs (tex_height / size);
+  int columns = key->columns;
+  int rows = key->rows;
+  float size = key->cell_size;
+  float half_size = size / 2;
+  int n_vertices = (columns * rows) * 4;
+  int n_indices = (columns * rows) * 6;
   int i, j, k, l;
-  float cell_s = 1.0 / columns;
-  float cell_t = 1.0 / rows;
   float start_x = -1.0 * ((size * columns) / 2.0);
   float start_y = -1.0 * ((size * rows) / 2.0);
-  GridVertex *vertices = g_new (GridVertex, (columns * rows) * 4);
-  unsigned int *indices = g_new (unsigned int, (columns * rows) * 6);
+  GridVertex *vertices = g_new0 (GridVertex, n_vertices);
+  CoglIndicesType indices_type;
+  uint16_t *short_indices = NULL;
+  uint32_t *int_indices = NULL;
+
+  /* Most grids are small enough to be indexed with shorts */
+  if (n_vertices <= 65536)
+    {
+      indices_type = COGL_INDICES_TYPE_UNSIGNED_SHORT;
+      short_indices = g_new (uint16_t, n_indices);
+    }
+  else
+    {
+      indices_type = COGL_INDICES_TYPE_UNSIGNED_INT;
+      int_indices = g_new (uint32_t, n_indices);
+    }
 
   k = 0;
   l = 0;
@@ -245,125 +315,94 @@ pointalism_generate_grid (RutPointalismGridSlice *slice,
   {
     for (j = 0; j < columns; j++)
     {
-      float x = start_x + (size / 2);
-      float y = start_y + (size / 2);
-
-      vertices[k].x0 = -1 * (size / 2);
-      vertices[k].y0 = -1 * (size / 2);
-      vertices[k].s0 = 0;
-      vertices[k].t0 = 0;
-      vertices[k].x1 = x;
-      vertices[k].y1 = y;
-      vertices[k].s1 = j * cell_s;
-      vertices[k].t1 = i * cell_t;
-      vertices[k].s2 = (j + 1) * cell_s;
-      vertices[k].t2 = (i + 1) * cell_t;
-      vertices[k].s3 = j * cell_s;
-      vertices[k].t3 = i * cell_t;
-      vertices[k].nx = 0;
-      vertices[k].ny = 0;
-      vertices[k].nz = 1;
-      vertices[k].tx = 1;
-      vertices[k].ty = 0;
-      vertices[k].tz = 0;
-      k++;
-
-      vertices[k].x0 = size / 2;
-      vertices[k].y0 = -1 * (size / 2);
-      vertices[k].s0 = 1;
-      vertices[k].t0 = 0;
-      vertices[k].x1 = x;
-      vertices[k].y1 = y;
-      vertices[k].s1 = j * cell_s;
-      vertices[k].t1 = i * cell_t;
-      vertices[k].s2 = (j + 1) * cell_s;
-      vertices[k].t2 = (i + 1) * cell_t;
-      vertices[k].s3 = (j + 1) * cell_s;
-      vertices[k].t3 = i * cell_t;
-      vertices[k].nx = 0;
-      vertices[k].ny = 0;
-      vertices[k].nz = 1;
-      vertices[k].tx = 1;
-      vertices[k].ty = 0;
-      vertices[k].tz = 0;
-      k++;
-
-      vertices[k].x0 = size / 2;
-      vertices[k].y0 = size / 2;
-      vertices[k].s0 = 1;
-      vertices[k].t0 = 1;
-      vertices[k].x1 = x;
-      vertices[k].y1 = y;
-      vertices[k].s1 = j * cell_s;
-      vertices[k].t1 = i * cell_t;
-      vertices[k].s2 = (j + 1) * cell_s;
-      vertices[k].t2 = (i + 1) * cell_t;
-      vertices[k].s3 = (j + 1) * cell_s;
-      vertices[k].t3 = (i + 1) * cell_t;
-      vertices[k].nx = 0;
-      vertices[k].ny = 0;
-      vertices[k].nz = 1;
-      vertices[k].tx = 1;
-      vertices[k].ty = 0;
-      vertices[k].tz = 0;
-      k++;
-
-      vertices[k].x0 = -1 * (size / 2);
-      vertices[k].y0 = size / 2;
-      vertices[k].s0 = 0;
-      vertices[k].t0 = 1;
-      vertices[k].x1 = x;
-      vertices[k].y1 = y;
-      vertices[k].s1 = j * cell_s;
-      vertices[k].t1 = i * cell_t;
-      vertices[k].s2 = (j + 1) * cell_s;
-      vertices[k].t2 = (i + 1) * cell_t;
-      vertices[k].s3 = j * cell_s;
-      vertices[k].t3 = (i + 1) * cell_t;
-      vertices[k].nx = 0;
-      vertices[k].ny = 0;
-      vertices[k].nz = 1;
-      vertices[k].tx = 1;
-      vertices[k].ty = 0;
-      vertices[k].tz = 0;
-      k++;
-
-      indices[l] = k;
-      indices[l + 1] = k + 1;
-      indices[l + 2] = k + 2;
-      indices[l + 3] = k + 2;
-      indices[l + 4] = k + 3;
-      indices[l + 5] = k;
-
-      l += 6;
+      float x = start_x + half_size;
+      float y = start_y + half_size;
+      int quad[6] = { k, k + 1, k + 2, k + 2, k + 3, k };
+      int m;
+
+      set_grid_vertex (&vertices[k++], -half_size, -half_size, x, y,
+                       j, i, columns, rows, 0, 0);
+      set_grid_vertex (&vertices[k++], half_size, -half_size, x, y,
+                       j, i, columns, rows, 1, 0);
+      set_grid_vertex (&vertices[k++], half_size, half_size, x, y,
+                       j, i, columns, rows, 1, 1);
+      set_grid_vertex (&vertices[k++], -half_size, half_size, x, y,
+                       j, i, columns, rows, 0, 1);
+
+      for (m = 0; m < 6; m++, l++)
+        {
+          if (short_indices)
+            short_indices[l] = quad[m];
+          else
+            int_indices[l] = quad[m];
+        }
+
       start_x += size;
     }
     start_x = -1.0 * ((size * columns) / 2.0);
     start_y += size;
   }
 
-  if (slice->mesh)
-    rut_refable_unref (slice->mesh);
+  return mesh_new_grid (COGL_VERTICES_MODE_TRIANGLES,
+                        n_vertices,
+                        n_indices,
+                        vertices,
+                        indices_type,
+                        short_indices ?
+                        (void *)short_indices : (void *)int_indices);
+}
 
-  slice->mesh = mesh_new_grid (COGL_VERTICES_MODE_TRIANGLES,
-                               (columns * rows) * 4,
-                               (columns * rows) * 6,
-                               vertices, indices);
+static unsigned int
+grid_key_hash (const void *key)
+{
+  return rut_util_one_at_a_time_hash (0, key, sizeof (RutPointalismGridKey));
+}
+
+static gboolean
+grid_key_equal (const void *a, const void *b)
+{
+  return memcmp (a, b, sizeof (RutPointalismGridKey)) == 0;
 }
 
+/* The grid only depends on the number of cells and their size so
+ * grids for textures that divide into the same number of cells share
+ * their geometry. The cache in RutContext::pointalism_grid_slices
+ * doesn't hold a reference; a slice removes itself when freed. */
 static RutPointalismGridSlice *
-pointalism_grid_slice_new (int tex_width,
+pointalism_grid_slice_get (RutContext *ctx,
+                           int tex_width,
                            int tex_height,
                            float size)
 {
-  RutPointalismGridSlice *grid_slice = g_slice_new (RutPointalismGridSlice);
+  RutPointalismGridSlice *grid_slice;
+  RutPointalismGridKey key;
+
+  memset (&key, 0, sizeof (key));
+  key.columns = abs (tex_width / size);
+  key.rows = abs (tex_height / size);
+  key.cell_size = size;
+
+  if (!ctx->pointalism_grid_slices)
+    ctx->pointalism_grid_slices = g_hash_table_new (grid_key_hash,
+                                                    grid_key_equal);
+
+  grid_slice = g_hash_table_lookup (ctx->pointalism_grid_slices, &key);
+  if (grid_slice)
+    return rut_refable_ref (grid_slice);
+
+  grid_slice = g_slice_new (RutPointalismGridSlice);
 
   rut_object_init (&grid_slice->_parent, &rut_pointalism_grid_slice_type);
 
   grid_slice->ref_count = 1;
-  grid_slice->mesh = NULL;
+  grid_slice->ctx = ctx;
+  grid_slice->key = key;
+  grid_slice->mesh = pointalism_generate_grid (&key);
+  grid_slice->primitive = NULL;
 
-  pointalism_generate_grid (grid_slice, tex_width, tex_height, size);
+  g_hash_table_insert (ctx->pointalism_grid_slices,
+                       &grid_slice->key,
+                       grid_slice);
 
   return grid_slice;
 }
@@ -375,7 +414,8 @@ _rut_pointalism_grid_free (void *object)
 
   rut_closure_list_disconnect_all (&grid->updated_cb_list);
 
-  rut_refable_unref (grid->slice);
+  if (grid->slice)
+    rut_refable_unref (grid->slice);
   rut_refable_unref (grid->pick_mesh);
 
   rut_simple_introspectable_destroy (grid);
@@ -392,7 +432,6 @@ _rut_pointalism_grid_copy (RutObject *object)
                                                      grid->tex_width,
                                                      grid->tex_height);
 
-#warning "FIXME: make sure the pointalism grid mesh is generated lazily"
   rut_introspectable_copy_properties (&grid->ctx->property_ctx,
                                       grid,
                                       copy);
@@ -488,9 +527,6 @@ rut_pointalism_grid_new (RutContext *ctx,
 
   rut_list_init (&grid->updated_cb_list);
 
-  grid->slice = pointalism_grid_slice_new (tex_width, tex_height,
-                                           size);
-
   half_tex_width = tex_width / 2.0f;
   half_tex_height = tex_height / 2.0f;
 
@@ -523,9 +559,20 @@ CoglPrimitive *
 rut_pointalism_grid_get_primitive (RutObject *object)
 {
   RutPointalismGrid *grid = object;
-  CoglPrimitive *primitive = rut_mesh_create_primitive (grid->ctx,
-                                                        grid->slice->mesh);
-  return primitive;
+  RutPointalismGridSlice *slice;
+
+  if (!grid->slice)
+    grid->slice = pointalism_grid_slice_get (grid->ctx,
+                                             grid->tex_width,
+                                             grid->tex_height,
+                                             grid->cell_size);
+
+  slice = grid->slice;
+
+  if (!slice->primitive)
+    slice->primitive = rut_mesh_create_primitive (grid->ctx, slice->mesh);
+
+  return slice->primitive;
 }
 
 RutMesh *
@@ -642,8 +689,12 @@ rut_pointalism_grid_set_cell_size (RutObject *obj,
   entity = grid->component.entity;
   ctx = rut_entity_get_context (entity);
 
-  pointalism_generate_grid (grid->slice, grid->tex_width,
-                            grid->tex_height, grid->cell_size);
+  /* The grid for the new cell size is looked up lazily */
+  if (grid->slice)
+    {
+      rut_refable_unref (grid->slice);
+      grid->slice = NULL;
+    }
 
   rut_property_dirty (&ctx->property_ctx,
                       &grid->properties[RUT_POINTALISM_GRID_PROP_CELL_SIZE]);
@@ -34,11 +34,23 @@ enum {
   RUT_POINTALISM_GRID_N_PROPS
 };
 
+typedef struct _RutPointalismGridKey
+{
+  int columns;
+  int rows;
+  float cell_size;
+} RutPointalismGridKey;
+
 struct _RutPointalismGridSlice
 {
   RutObjectProps _parent;
   int ref_count;
+
+  RutContext *ctx;
+  RutPointalismGridKey key;
+
   RutMesh *mesh;
+  CoglPrimitive *primitive;
 };
 
 void
@@ -60,6 +72,8 @@ struct _RutPointalismGrid
 
   RutList updated_cb_list;
 
+  /* Shared with other grids of the same dimensions. Looked up lazily
+   * by rut_pointalism_grid_get_primitive() */
   RutPointalismGridSlice *slice;
 
   RutMesh *pick_mesh;
@@ -24,7 +24,7 @@
 
 #include "rut-shape.h"
 #include "rut-global.h"
-#include "rut-meshable.h"
+#include "rut-util.h"
 
 #define MESA_CONST_ATTRIB_BUG_WORKAROUND
 
@@ -62,9 +62,13 @@ _shape_model_free (void *object)
 {
   RutShapeModel *shape_model = object;
 
+  g_hash_table_remove (shape_model->ctx->shape_models,
+                       GUINT_TO_POINTER (shape_model->key));
+
   cogl_object_unref (shape_model->shape_texture);
-  rut_refable_unref (shape_model->pick_mesh);
   rut_refable_unref (shape_model->shape_mesh);
+  if (shape_model->primitive)
+    cogl_object_unref (shape_model->primitive);
 
   g_slice_free (RutShapeModel, object);
 }
@@ -96,6 +100,7 @@ _rut_shape_model_init_type (void)
 typedef struct _VertexP2T2T2
 {
   float x, y, s0, t0, s1, t1;
+  float stretch_x, stretch_y;
 #ifdef MESA_CONST_ATTRIB_BUG_WORKAROUND
   float Nx, Ny, Nz;
   float Tx, Ty, Tz;
@@ -108,7 +113,7 @@ mesh_new_p2t2t2 (CoglVerticesMode mode,
                  const VertexP2T2T2 *data)
 {
   RutMesh *mesh;
-  RutAttribute *attributes[8];
+  RutAttribute *attributes[9];
   RutBuffer *vertex_buffer;
 
   vertex_buffer = rut_buffer_new (sizeof (VertexP2T2T2) * n_vertices);
@@ -170,62 +175,52 @@ mesh_new_p2t2t2 (CoglVerticesMode mode,
                                      3,
                                      RUT_ATTRIBUTE_TYPE_FLOAT);
 
-  mesh = rut_mesh_new (mode, n_vertices, attributes, 8);
+  attributes[8] = rut_attribute_new (vertex_buffer,
+                                     "stretch_in",
+                                     sizeof (VertexP2T2T2),
+                                     offsetof (VertexP2T2T2, stretch_x),
+                                     2,
+                                     RUT_ATTRIBUTE_TYPE_FLOAT);
+
+  mesh = rut_mesh_new (mode, n_vertices, attributes, 9);
 
   return mesh;
 }
 
+/* The geometry of a shape is a unit quad centered on the origin that
+ * is shared between all shapes. Each vertex has a position of zero
+ * and the fraction of the size it should be offset by in the
+ * stretch_in attribute so the renderer can stretch the quad to the
+ * size of the shape with a vertex snippet instead of rebuilding the
+ * geometry whenever the shape is resized. The texture coordinates of
+ * a shaped quad are likewise scaled by the renderer to fit the aspect
+ * ratio of the shape. See rut_shape_get_geometry_size() and
+ * rut_shape_get_tex_coord_scale().
+ *
+ * The models are only keyed on whether they are shaped because the
+ * shape texture belongs to the model.
+ */
+#define SHAPED_MODEL_KEY 1
+#define UNSHAPED_MODEL_KEY 0
+
+static uint32_t
+get_model_key (CoglBool shaped)
+{
+  return shaped ? SHAPED_MODEL_KEY : UNSHAPED_MODEL_KEY;
+}
+
 static RutShapeModel *
 shape_model_new (RutContext *ctx,
-                 CoglBool shaped,
-                 float width,
-                 float height)
+                 CoglBool shaped)
 {
   RutShapeModel *shape_model = g_slice_new (RutShapeModel);
-  RutBuffer *buffer = rut_buffer_new (sizeof (CoglVertexP3) * 6);
-  RutMesh *pick_mesh = rut_mesh_new_from_buffer_p3 (COGL_VERTICES_MODE_TRIANGLES,
-                                                    6,
-                                                    buffer);
-  CoglVertexP3 *pick_vertices = (CoglVertexP3 *)buffer->data;
-  CoglMatrix matrix;
-  float tex_aspect;
-  float size_x;
-  float size_y;
-  float half_size_x;
-  float half_size_y;
-  float geom_size_x;
-  float geom_size_y;
-  float half_geom_size_x;
-  float half_geom_size_y;
 
   rut_object_init (&shape_model->_parent, &rut_shape_model_type);
 
   shape_model->ref_count = 1;
-
-  if (shaped)
-    {
-      /* In this case we are using a shape mask texture which is has a
-       * square size and is padded with transparent pixels to provide
-       * antialiasing. The shape mask is half the size of the texture
-       * itself so we make the geometry twice as large to compensate.
-       */
-      size_x = MIN (width, height);
-      size_y = size_x;
-      geom_size_x = size_x * 2.0;
-      geom_size_y = geom_size_x;
-    }
-  else
-    {
-      size_x = width;
-      size_y = height;
-      geom_size_x = width;
-      geom_size_y = height;
-    }
-
-  half_size_x = size_x / 2.0;
-  half_size_y = size_y / 2.0;
-  half_geom_size_x = geom_size_x / 2.0;
-  half_geom_size_y = geom_size_y / 2.0;
+  shape_model->ctx = ctx;
+  shape_model->key = get_model_key (shaped);
+  shape_model->primitive = NULL;
 
     {
       int n_vertices;
@@ -233,55 +228,18 @@ shape_model_new (RutContext *ctx,
 
       VertexP2T2T2 vertices[] =
         {
-          { -half_geom_size_x, -half_geom_size_y, 0, 0, 0, 0 },
-          { -half_geom_size_x,  half_geom_size_y, 0, 1, 0, 1 },
-          {  half_geom_size_x,  half_geom_size_y, 1, 1, 1, 1 },
+          { 0, 0, 0, 0, 0, 0, -0.5, -0.5 },
+          { 0, 0, 0, 1, 0, 1, -0.5,  0.5 },
+          { 0, 0, 1, 1, 1, 1,  0.5,  0.5 },
 
-          { -half_geom_size_x, -half_geom_size_y, 0, 0, 0, 0 },
-          {  half_geom_size_x,  half_geom_size_y, 1, 1, 1, 1 },
-          {  half_geom_size_x, -half_geom_size_y, 1, 0, 1, 0 },
+          { 0, 0, 0, 0, 0, 0, -0.5, -0.5 },
+          { 0, 0, 1, 1, 1, 1,  0.5,  0.5 },
+          { 0, 0, 1, 0, 1, 0,  0.5, -0.5 },
         };
 
-      cogl_matrix_init_identity (&matrix);
-      tex_aspect = (float)width / (float)height;
-
-      if (shaped)
-        {
-          float s_scale, t_scale;
-          float s0, t0;
-
-          /* NB: The circle mask texture has a centered circle that is
-           * half the width of the texture itself. We want the primary
-           * texture to be mapped to this center circle. */
-
-          s_scale = 2;
-          t_scale = 2;
-
-          if (tex_aspect < 1) /* taller than it is wide */
-            t_scale *= tex_aspect;
-          else /* wider than it is tall */
-            {
-              float inverse_aspect = 1.0f / tex_aspect;
-              s_scale *= inverse_aspect;
-            }
-
-          s0 = 0.5 - (s_scale / 2.0);
-          t0 = 0.5 - (t_scale / 2.0);
-
-          cogl_matrix_translate (&matrix, s0, t0, 0);
-          cogl_matrix_scale (&matrix, s_scale, t_scale, 1);
-        }
-
       n_vertices = sizeof (vertices) / sizeof (VertexP2T2T2);
       for (i = 0; i < n_vertices; i++)
         {
-          float z = 0, w = 1;
-
-          cogl_matrix_transform_point (&matrix,
-                                       &vertices[i].s1,
-                                       &vertices[i].t1,
-                                       &z,
-                                       &w);
           vertices[i].Nx = 0;
           vertices[i].Ny = 0;
           vertices[i].Nz = 1;
@@ -297,19 +255,11 @@ shape_model_new (RutContext *ctx,
 
   shape_model->shape_texture = cogl_object_ref (ctx->circle_texture);
 
-  pick_vertices[0].x = -half_size_x;
-  pick_vertices[0].y = -half_size_y;
-  pick_vertices[1].x = -half_size_x;
-  pick_vertices[1].y = half_size_y;
-  pick_vertices[2].x = half_size_x;
-  pick_vertices[2].y = half_size_y;
-  pick_vertices[3] = pick_vertices[0];
-  pick_vertices[4] = pick_vertices[2];
-  pick_vertices[5].x = half_size_x;
-  pick_vertices[5].y = -half_size_y;
-
-  shape_model->pick_mesh = pick_mesh;
-
+  /* NB: the cache doesn't hold a reference on the model. The model
+   * removes itself from the cache when it is freed. */
+  g_hash_table_insert (ctx->shape_models,
+                       GUINT_TO_POINTER (shape_model->key),
+                       shape_model);
 
   return shape_model;
 }
@@ -362,10 +312,6 @@ _rut_shape_init_type (void)
     .get_primitive = rut_shape_get_primitive
   };
 
-  static RutMeshableVTable meshable_vtable = {
-    .get_mesh = rut_shape_get_pick_mesh
-  };
-
   static RutIntrospectableVTable introspectable_vtable = {
     rut_simple_introspectable_lookup_property,
     rut_simple_introspectable_foreach_property
@@ -396,10 +342,6 @@ _rut_shape_init_type (void)
                           RUT_INTERFACE_ID_PRIMABLE,
                           0, /* no associated properties */
                           &primable_vtable);
-  rut_type_add_interface (type,
-                          RUT_INTERFACE_ID_MESHABLE,
-                          0, /* no associated properties */
-                          &meshable_vtable);
   rut_type_add_interface (type,
                           RUT_INTERFACE_ID_INTROSPECTABLE,
                           0, /* no implied properties */
@@ -451,10 +393,19 @@ rut_shape_get_model (RutShape *shape)
 {
   if (!shape->model)
     {
-      shape->model = shape_model_new (shape->ctx,
-                                      shape->shaped,
-                                      shape->width,
-                                      shape->height);
+      RutContext *ctx = shape->ctx;
+      uint32_t key = get_model_key (shape->shaped);
+      RutShapeModel *model;
+
+      if (!ctx->shape_models)
+        ctx->shape_models = g_hash_table_new (NULL, NULL);
+
+      model = g_hash_table_lookup (ctx->shape_models, GUINT_TO_POINTER (key));
+
+      if (model)
+        shape->model = rut_refable_ref (model);
+      else
+        shape->model = shape_model_new (ctx, shape->shaped);
     }
 
   return shape->model;
@@ -465,10 +416,12 @@ rut_shape_get_primitive (RutObject *object)
 {
   RutShape *shape = object;
   RutShapeModel *model = rut_shape_get_model (shape);
-  CoglPrimitive *primitive = rut_mesh_create_primitive (shape->ctx,
-                                                        model->shape_mesh);
 
-  return primitive;
+  if (!model->primitive)
+    model->primitive = rut_mesh_create_primitive (shape->ctx,
+                                                  model->shape_mesh);
+
+  return model->primitive;
 }
 
 CoglTexture *
@@ -479,12 +432,83 @@ rut_shape_get_shape_texture (RutShape *shape)
   return model->shape_texture;
 }
 
-RutMesh *
-rut_shape_get_pick_mesh (RutObject *self)
+void
+rut_shape_get_geometry_size (RutShape *shape,
+                             float *width,
+                             float *height)
 {
-  RutShape *shape = self;
-  RutShapeModel *model = rut_shape_get_model (shape);
-  return model->pick_mesh;
+  if (shape->shaped)
+    {
+      /* In this case we are using a shape mask texture which is has a
+       * square size and is padded with transparent pixels to provide
+       * antialiasing. The shape mask is half the size of the texture
+       * itself so we make the geometry twice as large to compensate.
+       */
+      *width = MIN (shape->width, shape->height) * 2.0f;
+      *height = *width;
+    }
+  else
+    {
+      *width = shape->width;
+      *height = shape->height;
+    }
+}
+
+void
+rut_shape_get_tex_coord_scale (RutShape *shape,
+                               float *s_scale,
+                               float *t_scale)
+{
+  *s_scale = 1;
+  *t_scale = 1;
+
+  if (shape->shaped)
+    {
+      float tex_aspect = (float)shape->width / (float)shape->height;
+
+      /* NB: The circle mask texture has a centered circle that is
+       * half the width of the texture itself. We want the primary
+       * texture to be mapped to this center circle. */
+
+      *s_scale = 2;
+      *t_scale = 2;
+
+      if (tex_aspect < 1) /* taller than it is wide */
+        *t_scale *= tex_aspect;
+      else /* wider than it is tall */
+        {
+          float inverse_aspect = 1.0f / tex_aspect;
+          *s_scale *= inverse_aspect;
+        }
+    }
+}
+
+bool
+rut_shape_pick (RutShape *shape,
+                float ray_origin[3],
+                float ray_direction[3],
+                float *t_out)
+{
+  float x, y, t;
+
+  if (!rut_util_intersect_z_plane (ray_origin, ray_direction, &x, &y, &t))
+    return FALSE;
+
+  if (shape->shaped)
+    {
+      float radius = MIN (shape->width, shape->height) / 2.0f;
+
+      if (x * x + y * y > radius * radius)
+        return FALSE;
+    }
+  else if (fabsf (x) > shape->width / 2.0f ||
+           fabsf (y) > shape->height / 2.0f)
+    return FALSE;
+
+  if (t_out)
+    *t_out = t;
+
+  return TRUE;
 }
 
 static void
@@ -549,7 +573,6 @@ rut_shape_set_texture_size (RutShape *shape,
 
   shape->width = width;
   shape->height = height;
-
 }
 
 void
@@ -568,12 +591,6 @@ rut_shape_set_size (RutObject *self,
 
   rut_property_dirty (&ctx->property_ctx, &shape->properties[RUT_SHAPE_PROP_WIDTH]);
   rut_property_dirty (&ctx->property_ctx, &shape->properties[RUT_SHAPE_PROP_HEIGHT]);
-
-  free_model (shape);
-
-  rut_closure_list_invoke (&shape->reshaped_cb_list,
-                           RutShapeReShapedCallback,
-                           shape);
 }
 
 void
@@ -593,13 +610,8 @@ rut_shape_set_width (RutObject *obj, float width)
   if (shape->width == width)
     return;
   shape->width = width;
-  free_model (shape);
   rut_property_dirty (&shape->ctx->property_ctx,
-                      &shape->properties[RUT_SHAPE_PROP_WIDTH]);
-  rut_closure_list_invoke (&shape->reshaped_cb_list,
-                           RutShapeReShapedCallback,
-                           shape);
-}
+                      &shape->properties[RUT_SHAPE_PROP_WIDTH]);}
 
 void
 rut_shape_set_height (RutObject *obj, float height)
@@ -608,10 +620,5 @@ rut_shape_set_height (RutObject *obj, float height)
   if (shape->height == height)
     return;
   shape->height = height;
-  free_model (shape);
   rut_property_dirty (&shape->ctx->property_ctx,
-                      &shape->properties[RUT_SHAPE_PROP_HEIGHT]);
-  rut_closure_list_invoke (&shape->reshaped_cb_list,
-                           RutShapeReShapedCallback,
-                           shape);
-}
+                      &shape->properties[RUT_SHAPE_PROP_HEIGHT]);}
@@ -31,15 +31,14 @@ struct _RutShapeModel
   RutObjectProps _parent;
   int ref_count;
 
+  RutContext *ctx;
+  uint32_t key;
+
   /* TODO: Allow this to be an asset */
   CoglTexture *shape_texture;
 
-  RutMesh *mesh;
-
-  /* TODO: optionally copy the shape texture into a cpu cached buffer
-   * and pick by sampling into that instead of using geometry. */
-  RutMesh *pick_mesh;
   RutMesh *shape_mesh;
+  CoglPrimitive *primitive;
 };
 
 void
@@ -97,8 +96,32 @@ rut_shape_get_primitive (RutObject *object);
 CoglTexture *
 rut_shape_get_shape_texture (RutShape *shape);
 
-RutMesh *
-rut_shape_get_pick_mesh (RutObject *self);
+/* The primitive is a unit quad that is shared with other shapes so
+ * when drawing it the vertices need to be offset by their stretch_in
+ * attribute multiplied by this size. */
+void
+rut_shape_get_geometry_size (RutShape *shape,
+                             float *width,
+                             float *height);
+
+/* The texture coordinates of the image layers of the primitive span
+ * the whole quad so when drawing it they need to be scaled by this
+ * amount around the center of the texture. This is only not 1 for a
+ * shaped shape where the image is fitted to the circle of the mask
+ * texture. */
+void
+rut_shape_get_tex_coord_scale (RutShape *shape,
+                               float *s_scale,
+                               float *t_scale);
+
+/* Intersects a ray in the shape's coordinate space with the shape.
+ * This is an analytic rectangle or circle test so there's no pick
+ * mesh to update when the shape is resized. */
+bool
+rut_shape_pick (RutShape *shape,
+                float ray_origin[3],
+                float ray_direction[3],
+                float *t_out);
 
 void
 rut_shape_set_shaped (RutObject *shape,
@@ -650,6 +650,11 @@ int ply_close(p_ply ply) {
 /* ----------------------------------------------------------------------
  * Query support functions
  * ---------------------------------------------------------------------- */
+e_ply_storage_mode ply_get_storage_mode(p_ply ply) {
+    assert(ply);
+    return ply->storage_mode;
+}
+
 p_ply_element ply_get_next_element(p_ply ply,
         p_ply_element last) {
     assert(ply);
@@ -165,6 +165,16 @@ double ply_get_argument_value(p_ply_argument argument);
  * ---------------------------------------------------------------------- */
 int ply_read(p_ply ply);
 
+/* ----------------------------------------------------------------------
+ * Queries the storage mode of a ply file. For files opened for reading
+ * this is only valid after ply_read_header has been called.
+ *
+ * ply: handle returned by ply_open
+ *
+ * Returns the storage mode of the file
+ * ---------------------------------------------------------------------- */
+e_ply_storage_mode ply_get_storage_mode(p_ply ply);
+
 /* ----------------------------------------------------------------------
  * Iterates over all elements by returning the next element.
  * Call with NULL to return handle to first element.
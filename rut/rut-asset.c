@@ -21,7 +21,9 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <cogl/cogl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -33,8 +35,21 @@
 #include "rut-asset.h"
 #include "rut-util.h"
 #include "rut-mesh-ply.h"
+#include "rut-mesh-optimize.h"
 #include "rut-mimable.h"
 
+/* Thumbnails are only shown at 100x100 in the editor */
+#define RUT_THUMBNAIL_SIZE 200
+
+/* Missing thumbnails are generated in the background by a queue that
+ * is processed once per frame. At most this many videos are decoded
+ * concurrently and model renders are limited to roughly this much
+ * time per frame. */
+#define RUT_THUMBNAIL_MAX_VIDEO_DECODERS 2
+#define RUT_THUMBNAIL_FRAME_BUDGET_US 4000
+
+typedef struct _RigThumbnailGenerator RigThumbnailGenerator;
+
 #if 0
 enum {
   ASSET_N_PROPS
@@ -62,16 +77,54 @@ struct _RutAsset
   uint8_t *data;
   size_t data_len;
 
+  /* If the asset was created from a buffer then the data is only
+   * decoded on demand by ensure_loaded(). For videos the data
+   * points into this buffer. */
+  RutBuffer *buffer;
+  bool loaded;
+
   CoglTexture *texture;
   RutMesh *mesh;
   RutModel *model;
   bool is_video;
 
+  /* Image textures that can be reloaded from texture_path or from
+   * the buffer can be evicted to stay within the context's texture
+   * budget. An evictable asset is linked into the context's LRU list
+   * whenever it holds a reference on its texture. */
+  bool texture_evictable;
+  char *texture_path;
+  RutList texture_lru_link;
+  unsigned int texture_last_used;
+  size_t texture_size;
+
+  /* A weak pointer to the last texture counted towards the budget.
+   * This stays valid after eviction for as long as something else
+   * still references the texture so it can be reused. */
+  CoglTexture *tracked_texture;
+
+  RutList texture_evicted_cb_list;
+
   GList *inferred_tags;
 
   RutList thumbnail_cb_list;
+
+  /* Where the thumbnail is cached on disk. This is NULL if the
+   * asset doesn't correspond to a file that can be stat()ed */
+  char *thumbnail_path;
+  bool thumbnail_ready;
+
+  /* If a thumbnail has been requested then this is the asset's link
+   * in the thumbnail queue until generation starts */
+  GList *thumbnail_link;
+  RigThumbnailGenerator *generator;
 };
 
+static CoglUserDataKey tracked_texture_key;
+
+static void
+rut_video_thumbnail_generator_free (RigThumbnailGenerator *generator);
+
 #if 0
 static RutPropertySpec _asset_prop_specs[] = {
   { 0 }
@@ -85,17 +138,210 @@ static RutIntrospectableVTable _asset_introspectable_vtable = {
 };
 #endif
 
+/* NB: textures are assumed to be 32 bits per pixel */
+static size_t
+get_texture_size (CoglTexture *texture)
+{
+  return ((size_t)cogl_texture_get_width (texture) *
+          cogl_texture_get_height (texture) * 4);
+}
+
+static void
+tracked_texture_destroyed_cb (void *user_data)
+{
+  RutAsset *asset = user_data;
+
+  asset->ctx->texture_memory -= asset->texture_size;
+  asset->tracked_texture = NULL;
+}
+
+static void
+untrack_texture (RutAsset *asset)
+{
+  if (!asset->tracked_texture)
+    return;
+
+  cogl_object_set_user_data (COGL_OBJECT (asset->tracked_texture),
+                             &tracked_texture_key,
+                             NULL, NULL);
+
+  /* NB: Cogl may have already called the destroy callback when
+   * replacing the user data */
+  if (asset->tracked_texture)
+    tracked_texture_destroyed_cb (asset);
+}
+
+static void
+track_texture (RutAsset *asset)
+{
+  RutAsset *other;
+
+  if (asset->tracked_texture == asset->texture)
+    return;
+
+  untrack_texture (asset);
+
+  /* Multiple assets for the same file share a texture but it should
+   * only be counted once */
+  other = cogl_object_get_user_data (COGL_OBJECT (asset->texture),
+                                     &tracked_texture_key);
+  if (other)
+    untrack_texture (other);
+
+  asset->tracked_texture = asset->texture;
+  asset->texture_size = get_texture_size (asset->texture);
+  asset->ctx->texture_memory += asset->texture_size;
+
+  cogl_object_set_user_data (COGL_OBJECT (asset->texture),
+                             &tracked_texture_key,
+                             asset,
+                             tracked_texture_destroyed_cb);
+}
+
+static void
+touch_texture (RutAsset *asset)
+{
+  RutContext *ctx = asset->ctx;
+
+  asset->texture_last_used = ctx->texture_frame;
+
+  rut_list_remove (&asset->texture_lru_link);
+  rut_list_insert (&ctx->texture_lru, &asset->texture_lru_link);
+}
+
+/* Called once an asset's image texture has been loaded from a file
+ * or buffer that it can be reloaded from */
+static void
+make_texture_evictable (RutAsset *asset)
+{
+  asset->texture_evictable = true;
+
+  rut_list_insert (&asset->ctx->texture_lru, &asset->texture_lru_link);
+  asset->texture_last_used = asset->ctx->texture_frame;
+
+  track_texture (asset);
+}
+
+static bool
+load_data (RutAsset *asset,
+           const uint8_t *data,
+           size_t len);
+
+static void
+ensure_texture_resident (RutAsset *asset)
+{
+  RutContext *ctx = asset->ctx;
+
+  if (!asset->texture_evictable || asset->texture)
+    return;
+
+  if (asset->tracked_texture)
+    {
+      /* Something else kept the texture alive since it was evicted */
+      asset->texture = cogl_object_ref (asset->tracked_texture);
+    }
+  else if (asset->texture_path)
+    {
+      CoglError *error = NULL;
+
+      asset->texture = rut_load_texture (ctx, asset->texture_path, &error);
+      if (!asset->texture)
+        {
+          g_warning ("Failed to reload asset texture: %s", error->message);
+          cogl_error_free (error);
+          return;
+        }
+
+      ctx->n_texture_reloads++;
+    }
+  else
+    {
+      if (!load_data (asset, asset->buffer->data, asset->buffer->size))
+        return;
+
+      ctx->n_texture_reloads++;
+    }
+
+  track_texture (asset);
+  rut_list_insert (&ctx->texture_lru, &asset->texture_lru_link);
+}
+
+/* Gives anything that has put the texture into a pipeline the chance
+ * to release it before dropping the asset's reference. The texture is
+ * loaded again the next time it's asked for. */
+static void
+drop_texture (RutAsset *asset)
+{
+  rut_closure_list_invoke (&asset->texture_evicted_cb_list,
+                           RutAssetTextureEvictedCallback,
+                           asset);
+
+  rut_list_remove (&asset->texture_lru_link);
+
+  cogl_object_unref (asset->texture);
+  asset->texture = NULL;
+}
+
+/* If something other than the asset still references the texture
+ * then dropping it doesn't free any memory. In that case the asset
+ * takes the texture back and it is marked as used so it won't be
+ * tried again until it has aged. */
+static void
+evict_texture (RutAsset *asset)
+{
+  RutContext *ctx = asset->ctx;
+
+  drop_texture (asset);
+
+  if (asset->tracked_texture)
+    {
+      asset->texture = cogl_object_ref (asset->tracked_texture);
+      rut_list_insert (&ctx->texture_lru, &asset->texture_lru_link);
+      asset->texture_last_used = ctx->texture_frame;
+      return;
+    }
+
+  ctx->n_texture_evictions++;
+}
+
 static void
 _rut_asset_free (void *object)
 {
   RutAsset *asset = object;
 
+  if (asset->thumbnail_link)
+    {
+      g_queue_delete_link (&asset->ctx->thumbnail_queue,
+                           asset->thumbnail_link);
+      asset->thumbnail_link = NULL;
+    }
+
+  if (asset->generator)
+    rut_video_thumbnail_generator_free (asset->generator);
+
+  rut_closure_list_disconnect_all (&asset->thumbnail_cb_list);
+  rut_closure_list_disconnect_all (&asset->texture_evicted_cb_list);
+
+  g_free (asset->thumbnail_path);
+
+  untrack_texture (asset);
+  g_free (asset->texture_path);
+
   if (asset->texture)
-    cogl_object_unref (asset->texture);
+    {
+      if (asset->texture_evictable)
+        rut_list_remove (&asset->texture_lru_link);
+      cogl_object_unref (asset->texture);
+    }
 
   if (asset->path)
     g_free (asset->path);
 
+  if (asset->buffer)
+    rut_refable_unref (asset->buffer);
+  else if (asset->data)
+    g_free (asset->data);
+
   //rut_simple_introspectable_destroy (asset);
 
   g_slice_free (RutAsset, asset);
@@ -233,22 +479,157 @@ static RutPLYAttribute ply_attributes[] =
   }
 };
 
-typedef struct _RigThumbnailGenerator
+struct _RigThumbnailGenerator
 {
-  CoglContext *ctx;
+  RutContext *ctx;
   CoglPipeline *cogl_pipeline;
   RutAsset *video;
   GstElement *pipeline;
   GstElement *bin;
   CoglGstVideoSink *sink;
+  unsigned int bus_watch_id;
+  unsigned long new_frame_handler;
   CoglBool seek_done;
-}RigThumbnailGenerator;
+};
+
+/* The key for a cached thumbnail combines the file's path with its
+ * modification time and size so that stale thumbnails are never
+ * used if the file changes. */
+static char *
+get_thumbnail_cache_path (const char *filename)
+{
+  GStatBuf st;
+  char *key;
+  char *checksum;
+  char *basename;
+  char *cache_path;
+
+  if (g_stat (filename, &st) != 0)
+    return NULL;
+
+  key = g_strdup_printf ("%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT,
+                         filename,
+                         (int64_t) st.st_mtime,
+                         (int64_t) st.st_size);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+  basename = g_strconcat (checksum, ".png", NULL);
+
+  cache_path = g_build_filename (g_get_user_cache_dir (),
+                                 "rig", "thumbnails", basename, NULL);
+
+  g_free (basename);
+  g_free (checksum);
+  g_free (key);
+
+  return cache_path;
+}
+
+static CoglTexture *
+load_cached_thumbnail (RutAsset *asset)
+{
+  if (!asset->thumbnail_path ||
+      !g_file_test (asset->thumbnail_path, G_FILE_TEST_IS_REGULAR))
+    return NULL;
+
+  /* NB: a corrupt cache entry simply results in the thumbnail being
+   * regenerated */
+  return rut_load_texture (asset->ctx, asset->thumbnail_path, NULL);
+}
+
+static void
+save_cached_thumbnail (RutAsset *asset)
+{
+  CoglTexture *texture = asset->texture;
+  int width = cogl_texture_get_width (texture);
+  int height = cogl_texture_get_height (texture);
+  int rowstride = width * 4;
+  uint8_t *pixels;
+  GdkPixbuf *pixbuf;
+  char *dir;
+  char *tmp_path;
+  GError *error = NULL;
+
+  if (!asset->thumbnail_path)
+    return;
+
+  dir = g_path_get_dirname (asset->thumbnail_path);
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      g_warning ("Failed to create thumbnail cache directory %s", dir);
+      g_free (dir);
+      return;
+    }
+  g_free (dir);
+
+  pixels = g_malloc (rowstride * height);
+  cogl_texture_get_data (texture, COGL_PIXEL_FORMAT_RGBA_8888,
+                         rowstride, pixels);
+
+  pixbuf = gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB, TRUE, 8,
+                                     width, height, rowstride,
+                                     NULL, NULL);
+
+  /* Write to a temporary file first so that another instance never
+   * sees a partially written thumbnail */
+  tmp_path = g_strdup_printf ("%s.%d.tmp", asset->thumbnail_path, getpid ());
+
+  if (!gdk_pixbuf_save (pixbuf, tmp_path, "png", &error, NULL))
+    {
+      g_warning ("Failed to save thumbnail for %s: %s",
+                 asset->path, error->message);
+      g_error_free (error);
+      g_unlink (tmp_path);
+    }
+  else if (g_rename (tmp_path, asset->thumbnail_path) != 0)
+    g_unlink (tmp_path);
+
+  g_free (tmp_path);
+  g_object_unref (pixbuf);
+  g_free (pixels);
+}
+
+static void
+thumbnail_ready (RutAsset *asset)
+{
+  asset->thumbnail_ready = true;
+
+  rut_closure_list_invoke (&asset->thumbnail_cb_list,
+                           RutThumbnailCallback,
+                           asset);
+}
+
+static void
+rut_video_thumbnail_generator_free (RigThumbnailGenerator *generator)
+{
+  g_signal_handler_disconnect (generator->sink, generator->new_frame_handler);
+
+  /* NB: the watch will already have been removed if it is the bus
+   * watch that is giving up */
+  if (generator->bus_watch_id)
+    g_source_remove (generator->bus_watch_id);
+
+  gst_element_set_state (generator->pipeline, GST_STATE_NULL);
+  gst_object_unref (generator->pipeline);
+  g_object_unref (generator->sink);
+
+  if (generator->video)
+    generator->video->generator = NULL;
+
+  /* A decoder has been freed up so any videos waiting for one can be
+   * started in the next frame */
+  generator->ctx->n_thumbnail_video_decoders--;
+  if (!g_queue_is_empty (&generator->ctx->thumbnail_queue))
+    rut_shell_queue_redraw (generator->ctx->shell);
+
+  g_free (generator);
+}
 
 static void
 rut_video_grab_thumbnail (void *instance,
                           void *user_data)
 {
   RigThumbnailGenerator *generator = user_data;
+  RutAsset *video = generator->video;
   CoglOffscreen *offscreen;
   CoglFramebuffer *fbo;
   int tex_width;
@@ -256,19 +637,19 @@ rut_video_grab_thumbnail (void *instance,
 
   generator->cogl_pipeline = cogl_gst_video_sink_get_pipeline (generator->sink);
 
-  tex_height = 200;
+  tex_height = RUT_THUMBNAIL_SIZE;
   tex_width = cogl_gst_video_sink_get_width_for_height (generator->sink,
                                                         tex_height);
 
-  if (generator->video->texture)
-    cogl_object_unref (generator->video->texture);
+  if (video->texture)
+    cogl_object_unref (video->texture);
 
-  generator->video->texture =
-    cogl_texture_2d_new_with_size (generator->ctx,
+  video->texture =
+    cogl_texture_2d_new_with_size (generator->ctx->cogl_context,
                                    tex_width,
                                    tex_height);
 
-  offscreen = cogl_offscreen_new_with_texture (generator->video->texture);
+  offscreen = cogl_offscreen_new_with_texture (video->texture);
   fbo = offscreen;
 
   cogl_framebuffer_clear4f (fbo, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 0);
@@ -278,14 +659,11 @@ rut_video_grab_thumbnail (void *instance,
                                             0, 0, 1, 1);
 
   cogl_object_unref (offscreen);
-  gst_element_set_state (generator->pipeline, GST_STATE_NULL);
-  g_object_unref (generator->sink);
 
-  rut_closure_list_invoke (&generator->video->thumbnail_cb_list,
-                           RutThumbnailCallback,
-                           generator->video);
+  rut_video_thumbnail_generator_free (generator);
 
-  g_free (generator);
+  save_cached_thumbnail (video);
+  thumbnail_ready (video);
 }
 
 static CoglBool
@@ -296,6 +674,23 @@ rut_thumbnail_generator_seek (GstBus *bus,
   RigThumbnailGenerator *generator = (RigThumbnailGenerator*) user_data;
   int64_t duration, seek;
 
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR)
+    {
+      GError *error = NULL;
+
+      gst_message_parse_error (msg, &error, NULL);
+      g_warning ("Failed to generate thumbnail for %s: %s",
+                 generator->video->path, error->message);
+      g_error_free (error);
+
+      /* Give up so that the decoder slot is freed up for other
+       * videos */
+      generator->bus_watch_id = 0;
+      generator->video->thumbnail_ready = true;
+      rut_video_thumbnail_generator_free (generator);
+      return FALSE;
+    }
+
   if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ASYNC_DONE && !generator->seek_done)
     {
       gst_element_query_duration (generator->bin, GST_FORMAT_TIME, &duration);
@@ -321,12 +716,19 @@ rut_video_generate_thumbnail (RutAsset *asset)
   GstBus *bus;
 
   generator->seek_done = FALSE;
-  generator->ctx = ctx->cogl_context;
+  generator->ctx = ctx;
   generator->video = asset;
   generator->sink = cogl_gst_video_sink_new (ctx->cogl_context);
   generator->pipeline = gst_pipeline_new ("thumbnailer");
   generator->bin = gst_element_factory_make ("playbin", NULL);
 
+  /* Keep our own reference on the sink since the playbin will take
+   * ownership of the floating reference */
+  gst_object_ref_sink (generator->sink);
+
+  asset->generator = generator;
+  ctx->n_thumbnail_video_decoders++;
+
   filename = g_build_filename (ctx->assets_location, asset->path, NULL);
   uri = gst_filename_to_uri (filename, NULL);
   g_free (filename);
@@ -339,10 +741,13 @@ rut_video_generate_thumbnail (RutAsset *asset)
   gst_element_set_state (generator->pipeline, GST_STATE_PAUSED);
 
   bus = gst_element_get_bus (generator->pipeline);
-  gst_bus_add_watch (bus, rut_thumbnail_generator_seek, generator);
+  generator->bus_watch_id =
+    gst_bus_add_watch (bus, rut_thumbnail_generator_seek, generator);
+  gst_object_unref (bus);
 
-  g_signal_connect (generator->sink, "new-frame",
-                    G_CALLBACK (rut_video_grab_thumbnail), generator);
+  generator->new_frame_handler =
+    g_signal_connect (generator->sink, "new-frame",
+                      G_CALLBACK (rut_video_grab_thumbnail), generator);
 
   g_free (uri);
 }
@@ -360,8 +765,8 @@ rut_model_get_thumbnail (RutContext *ctx,
   CoglSnippet *snippet;
   CoglDepthState depth_state;
   CoglMatrix view;
-  int tex_width = 800;
-  int tex_height = 800;
+  int tex_width = RUT_THUMBNAIL_SIZE;
+  int tex_height = RUT_THUMBNAIL_SIZE;
   float fovy = 60;
   float aspect = (float)tex_width / (float)tex_height;
   float z_near = 0.1;
@@ -370,7 +775,7 @@ rut_model_get_thumbnail (RutContext *ctx,
   float translate_x = 0;
   float translate_y = 0;
   float translate_z = 0;
-  float rec_scale = 800;
+  float rec_scale = RUT_THUMBNAIL_SIZE;
   float scale_facor = 1;
   float model_scale;
   float width = model->max_x - model->min_x;
@@ -528,6 +933,61 @@ rut_model_get_thumbnail (RutContext *ctx,
   return thumbnail;
 }
 
+/* Imported meshes are welded and reordered for the GPU's vertex
+ * cache before anything else sees them so that the optimized data,
+ * along with the levels of detail derived from it, is also what gets
+ * saved. */
+static void
+optimize_imported_mesh (RutAsset *asset)
+{
+  RutMesh *mesh = rut_mesh_optimize (asset->mesh, RUT_MESH_OPTIMIZE_LOSSLESS);
+
+  rut_refable_unref (asset->mesh);
+  asset->mesh = mesh;
+
+  rut_mesh_generate_lods (mesh);
+}
+
+/* Loads the mesh and model of a PLY asset from @filename. @name is
+ * only used for reporting errors. */
+static bool
+load_ply_file (RutAsset *asset,
+               const char *filename,
+               const char *name)
+{
+  RutPLYAttributeStatus padding_status[G_N_ELEMENTS (ply_attributes)];
+  GError *error = NULL;
+  CoglBool needs_normals = FALSE;
+  CoglBool needs_tex_coords = FALSE;
+
+  asset->mesh = rut_mesh_new_from_ply (asset->ctx,
+                                       filename,
+                                       ply_attributes,
+                                       G_N_ELEMENTS (ply_attributes),
+                                       padding_status,
+                                       &error);
+
+  if (!asset->mesh)
+    {
+      g_warning ("could not load model %s: %s", name, error->message);
+      g_error_free (error);
+      return false;
+    }
+
+  optimize_imported_mesh (asset);
+
+  if (padding_status[1] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
+    needs_normals = TRUE;
+
+  if (padding_status[2] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
+    needs_tex_coords = TRUE;
+
+  asset->model = rut_model_new_from_asset (asset->ctx, asset, needs_normals,
+                                           needs_tex_coords);
+
+  return true;
+}
+
 static RutAsset *
 rut_asset_new_full (RutContext *ctx,
                     const char *path,
@@ -564,6 +1024,10 @@ rut_asset_new_full (RutContext *ctx,
   asset->is_video = rut_util_find_tag (inferred_tags, "video");
 
   rut_list_init (&asset->thumbnail_cb_list);
+  rut_list_init (&asset->texture_evicted_cb_list);
+
+  if (type != RUT_ASSET_TYPE_BUILTIN)
+    asset->thumbnail_path = get_thumbnail_cache_path (real_path);
 
   switch (type)
     {
@@ -577,12 +1041,21 @@ rut_asset_new_full (RutContext *ctx,
         if (!asset->is_video)
           asset->texture = rut_load_texture (ctx, real_path, &error);
         else
-          asset->texture =
-            rut_load_texture (ctx,
-                              rut_find_data_file ("thumb-video.png"), &error);
+          {
+            asset->texture = load_cached_thumbnail (asset);
+
+            if (asset->texture)
+              asset->thumbnail_ready = true;
+            else
+              asset->texture =
+                rut_load_texture (ctx,
+                                  rut_find_data_file ("thumb-video.png"),
+                                  &error);
+          }
 
         if (!asset->texture)
           {
+            g_free (asset->thumbnail_path);
             g_slice_free (RutAsset, asset);
             g_warning ("Failed to load asset texture: %s", error->message);
             cogl_error_free (error);
@@ -590,40 +1063,31 @@ rut_asset_new_full (RutContext *ctx,
             goto DONE;
           }
 
+        /* Builtin assets are small icons used by the editor so they
+         * are left out of the texture budget */
+        if (type != RUT_ASSET_TYPE_BUILTIN && !asset->is_video)
+          {
+            asset->texture_path = g_strdup (real_path);
+            make_texture_evictable (asset);
+          }
+
         break;
       }
     case RUT_ASSET_TYPE_PLY_MODEL:
       {
-        RutPLYAttributeStatus padding_status[G_N_ELEMENTS (ply_attributes)];
-        GError *error = NULL;
-        CoglBool needs_normals = FALSE;
-        CoglBool needs_tex_coords = FALSE;
-
-        asset->mesh = rut_mesh_new_from_ply (ctx,
-                                             real_path,
-                                             ply_attributes,
-                                             G_N_ELEMENTS (ply_attributes),
-                                             padding_status,
-                                             &error);
-
-        if (!asset->mesh)
+        if (!load_ply_file (asset, real_path, path))
           {
+            g_free (asset->thumbnail_path);
             g_slice_free (RutAsset, asset);
-            g_warning ("could not load model %s: %s", path, error->message);
-            g_error_free (error);
             asset = NULL;
             goto DONE;
           }
 
-        if (padding_status[1] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
-          needs_normals = TRUE;
-
-        if (padding_status[2] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
-          needs_tex_coords = TRUE;
-
-        asset->model = rut_model_new_from_asset (ctx, asset, needs_normals,
-                                                 needs_tex_coords);
-        asset->texture = rut_model_get_thumbnail (ctx, asset->model);
+        /* If the thumbnail isn't cached then it's left to be
+         * generated in the background by rut_asset_thumbnail() */
+        asset->texture = load_cached_thumbnail (asset);
+        if (asset->texture)
+          asset->thumbnail_ready = true;
 
         break;
       }
@@ -702,13 +1166,135 @@ bitmap_new_from_pixbuf (CoglContext *ctx,
   return bmp;
 }
 
-RutAsset *
-rut_asset_new_from_data (RutContext *ctx,
-                         const char *name,
-                         RutAssetType type,
-                         bool is_video,
-                         const uint8_t *data,
-                         size_t len)
+/* Decodes the given data into a texture or mesh according to the
+ * asset type. This isn't used for videos which instead keep a
+ * pointer to the data to hand to gstreamer. */
+static bool
+load_data (RutAsset *asset,
+           const uint8_t *data,
+           size_t len)
+{
+  switch (asset->type)
+    {
+    case RUT_ASSET_TYPE_BUILTIN:
+    case RUT_ASSET_TYPE_TEXTURE:
+    case RUT_ASSET_TYPE_NORMAL_MAP:
+    case RUT_ASSET_TYPE_ALPHA_MASK:
+        {
+          GInputStream *istream =
+            g_memory_input_stream_new_from_data (data, len, NULL);
+          GError *error = NULL;
+          GdkPixbuf *pixbuf =
+            gdk_pixbuf_new_from_stream (istream, NULL, &error);
+          CoglBitmap *bitmap;
+          CoglError *cogl_error = NULL;
+
+          if (!pixbuf)
+            {
+              g_warning ("Failed to load asset texture: %s", error->message);
+              g_error_free (error);
+              return false;
+            }
+
+          g_object_unref (istream);
+
+          bitmap = bitmap_new_from_pixbuf (asset->ctx->cogl_context, pixbuf);
+
+          asset->texture = cogl_texture_2d_new_from_bitmap (bitmap);
+
+          /* Allocate now so we can simply free the data
+           * TODO: allow asynchronous upload. */
+          cogl_texture_allocate (asset->texture, NULL);
+
+          cogl_object_unref (bitmap);
+          g_object_unref (pixbuf);
+
+          if (!asset->texture)
+            {
+              g_warning ("Failed to load asset texture: %s",
+                         cogl_error->message);
+              cogl_error_free (cogl_error);
+              return false;
+            }
+
+          break;
+        }
+    case RUT_ASSET_TYPE_PLY_MODEL:
+        {
+          RutPLYAttributeStatus padding_status[G_N_ELEMENTS (ply_attributes)];
+          GError *error = NULL;
+          CoglBool needs_normals = FALSE;
+          CoglBool needs_tex_coords = FALSE;
+
+          asset->mesh =
+            rut_mesh_new_from_ply_data (asset->ctx,
+                                        data,
+                                        len,
+                                        ply_attributes,
+                                        G_N_ELEMENTS (ply_attributes),
+                                        padding_status,
+                                        &error);
+          if (!asset->mesh)
+            {
+              g_warning ("could not load model %s: %s",
+                         asset->path, error->message);
+              g_error_free (error);
+              return false;
+            }
+
+          optimize_imported_mesh (asset);
+
+          if (padding_status[1] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
+            needs_normals = TRUE;
+
+          if (padding_status[2] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
+            needs_tex_coords = TRUE;
+
+          asset->model = rut_model_new_from_asset (asset->ctx, asset,
+                                                   needs_normals,
+                                                   needs_tex_coords);
+          asset->texture = rut_model_get_thumbnail (asset->ctx,
+                                                    asset->model);
+
+          break;
+        }
+    }
+
+  return true;
+}
+
+/* Assets created from a buffer are decoded lazily the first time the
+ * texture, mesh or model is requested so that the data for assets
+ * that are never used doesn't get touched. Typically the buffer is a
+ * view into a mapped .rig file so this also avoids paging in the
+ * data. */
+static void
+ensure_loaded (RutAsset *asset)
+{
+  if (!asset->buffer || asset->loaded)
+    return;
+
+  /* NB: rut_model_new_from_asset() will query the asset's mesh so
+   * we mark the asset as loaded up front to avoid recursing */
+  asset->loaded = true;
+
+  if (!load_data (asset, asset->buffer->data, asset->buffer->size))
+    {
+      g_warning ("Failed to load asset %s", asset->path);
+      return;
+    }
+
+  /* Image data can be decoded again from the buffer if the texture
+   * gets evicted */
+  if (asset->type != RUT_ASSET_TYPE_PLY_MODEL)
+    make_texture_evictable (asset);
+}
+
+static RutAsset *
+asset_new_for_data (RutContext *ctx,
+                    const char *name,
+                    RutAssetType type,
+                    bool is_video)
 {
   RutAsset *asset = g_slice_new0 (RutAsset);
 
@@ -723,100 +1309,55 @@ rut_asset_new_from_data (RutContext *ctx,
   asset->path = g_strdup (name);
 
   asset->is_video = is_video;
+
+  rut_list_init (&asset->thumbnail_cb_list);
+  rut_list_init (&asset->texture_evicted_cb_list);
+
+  return asset;
+}
+
+RutAsset *
+rut_asset_new_from_data (RutContext *ctx,
+                         const char *name,
+                         RutAssetType type,
+                         bool is_video,
+                         const uint8_t *data,
+                         size_t len)
+{
+  RutAsset *asset = asset_new_for_data (ctx, name, type, is_video);
+
   if (is_video)
     {
       asset->data = g_memdup (data, len);
       asset->data_len = len;
     }
-  else
+  else if (!load_data (asset, data, len))
     {
-      asset->data = NULL;
+      rut_refable_unref (asset);
+      return NULL;
+    }
 
-      switch (type)
-        {
-        case RUT_ASSET_TYPE_BUILTIN:
-        case RUT_ASSET_TYPE_TEXTURE:
-        case RUT_ASSET_TYPE_NORMAL_MAP:
-        case RUT_ASSET_TYPE_ALPHA_MASK:
-            {
-              GInputStream *istream =
-                g_memory_input_stream_new_from_data (data, len, NULL);
-              GError *error = NULL;
-              GdkPixbuf *pixbuf =
-                gdk_pixbuf_new_from_stream (istream, NULL, &error);
-              CoglBitmap *bitmap;
-              CoglError *cogl_error = NULL;
-
-              if (!pixbuf)
-                {
-                  g_slice_free (RutAsset, asset);
-                  g_warning ("Failed to load asset texture: %s", error->message);
-                  g_error_free (error);
-                  return NULL;
-                }
-
-              g_object_unref (istream);
-
-              bitmap = bitmap_new_from_pixbuf (ctx->cogl_context, pixbuf);
-
-              asset->texture = cogl_texture_2d_new_from_bitmap (bitmap);
-
-              /* Allocate now so we can simply free the data
-               * TODO: allow asynchronous upload. */
-              cogl_texture_allocate (asset->texture, NULL);
-
-              cogl_object_unref (bitmap);
-              g_object_unref (pixbuf);
-
-              if (!asset->texture)
-                {
-                  g_slice_free (RutAsset, asset);
-                  g_warning ("Failed to load asset texture: %s",
-                             cogl_error->message);
-                  cogl_error_free (cogl_error);
-                  return NULL;
-                }
-
-              break;
-            }
-        case RUT_ASSET_TYPE_PLY_MODEL:
-            {
-              RutPLYAttributeStatus padding_status[G_N_ELEMENTS (ply_attributes)];
-              GError *error = NULL;
-              CoglBool needs_normals = FALSE;
-              CoglBool needs_tex_coords = FALSE;
-
-              asset->mesh =
-                rut_mesh_new_from_ply_data (ctx,
-                                            data,
-                                            len,
-                                            ply_attributes,
-                                            G_N_ELEMENTS (ply_attributes),
-                                            padding_status,
-                                            &error);
-              if (!asset->mesh)
-                {
-                  g_slice_free (RutAsset, asset);
-                  g_warning ("could not load model %s: %s",
-                             name, error->message);
-                  g_error_free (error);
-                  return NULL;
-                }
-
-              if (padding_status[1] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
-                needs_normals = TRUE;
-
-              if (padding_status[2] == RUT_PLY_ATTRIBUTE_STATUS_PADDED)
-                needs_tex_coords = TRUE;
-
-              asset->model = rut_model_new_from_asset (ctx, asset,
-                                                       needs_normals,
-                                                       needs_tex_coords);
-              asset->texture = rut_model_get_thumbnail (ctx, asset->model);
-
-              break;
-            }
-        }
+  return asset;
+}
+
+RutAsset *
+rut_asset_new_from_buffer (RutContext *ctx,
+                           const char *name,
+                           RutAssetType type,
+                           bool is_video,
+                           RutBuffer *buffer)
+{
+  RutAsset *asset = asset_new_for_data (ctx, name, type, is_video);
+
+  asset->buffer = rut_refable_ref (buffer);
+
+  /* Videos reference the buffer data directly instead of taking a
+   * copy */
+  if (is_video)
+    {
+      asset->data = buffer->data;
+      asset->data_len = buffer->size;
+      asset->loaded = true;
     }
 
   return asset;
@@ -839,6 +1380,9 @@ rut_asset_new_from_mesh (RutContext *ctx,
 
   asset->type = RUT_ASSET_TYPE_PLY_MODEL;
 
+  rut_list_init (&asset->thumbnail_cb_list);
+  rut_list_init (&asset->texture_evicted_cb_list);
+
   asset->mesh = rut_refable_ref (mesh);
 
   for (i = 0; i < mesh->n_attributes; i++)
@@ -931,18 +1475,184 @@ rut_asset_get_context (RutAsset *asset)
 CoglTexture *
 rut_asset_get_texture (RutAsset *asset)
 {
+  /* The texture is typically only queried for assets that are
+   * visible so we use this as a hint to generate the thumbnail
+   * sooner */
+  if (asset->thumbnail_link)
+    {
+      g_queue_unlink (&asset->ctx->thumbnail_queue, asset->thumbnail_link);
+      g_queue_push_head_link (&asset->ctx->thumbnail_queue,
+                              asset->thumbnail_link);
+    }
+
+  ensure_loaded (asset);
+
+  rut_asset_mark_texture_used (asset);
+
   return asset->texture;
 }
 
+void
+rut_asset_mark_texture_used (RutAsset *asset)
+{
+  if (!asset->texture_evictable)
+    return;
+
+  ensure_texture_resident (asset);
+
+  if (asset->texture)
+    touch_texture (asset);
+}
+
+RutClosure *
+rut_asset_add_texture_evicted_callback (RutAsset *asset,
+                                        RutAssetTextureEvictedCallback callback,
+                                        void *user_data,
+                                        RutClosureDestroyCallback destroy_cb)
+{
+  return rut_closure_list_add (&asset->texture_evicted_cb_list,
+                               callback,
+                               user_data,
+                               destroy_cb);
+}
+
+void
+rut_asset_set_texture_budget (RutContext *ctx,
+                              size_t budget,
+                              unsigned int eviction_age)
+{
+  ctx->texture_budget = budget;
+  ctx->texture_eviction_age = eviction_age;
+}
+
+void
+rut_asset_get_texture_stats (RutContext *ctx,
+                             RutTextureStats *stats)
+{
+  stats->budget = ctx->texture_budget;
+  stats->memory = ctx->texture_memory;
+  stats->n_resident = rut_list_length (&ctx->texture_lru);
+  stats->n_evictions = ctx->n_texture_evictions;
+  stats->n_reloads = ctx->n_texture_reloads;
+}
+
+void
+rut_asset_collect_textures (RutContext *ctx)
+{
+  RutAsset *asset, *tmp;
+
+  ctx->texture_frame++;
+
+  if (ctx->texture_budget == 0)
+    return;
+
+  /* The list is ordered from the most to the least recently used so
+   * we can stop at the first texture that was used too recently.
+   * Shared textures that can't be evicted are moved to the front of
+   * the list so we will also stop when we get back to them. */
+  rut_list_for_each_reverse_safe (asset, tmp, &ctx->texture_lru,
+                                  texture_lru_link)
+    {
+      if (ctx->texture_memory <= ctx->texture_budget)
+        break;
+
+      if (ctx->texture_frame - asset->texture_last_used <
+          ctx->texture_eviction_age)
+        break;
+
+      evict_texture (asset);
+    }
+}
+
+bool
+rut_asset_reload (RutAsset *asset)
+{
+  RutContext *ctx = asset->ctx;
+  char *full_path;
+  bool ret = true;
+
+  if (asset->type == RUT_ASSET_TYPE_BUILTIN ||
+      asset->buffer || asset->data || !asset->path)
+    return false;
+
+  full_path = g_build_filename (ctx->assets_location, asset->path, NULL);
+
+  /* The cached thumbnails are keyed on the modification time of the
+   * file so the old one won't be found again */
+  g_free (asset->thumbnail_path);
+  asset->thumbnail_path = get_thumbnail_cache_path (full_path);
+
+  switch (asset->type)
+    {
+    case RUT_ASSET_TYPE_BUILTIN:
+      break;
+    case RUT_ASSET_TYPE_TEXTURE:
+    case RUT_ASSET_TYPE_NORMAL_MAP:
+    case RUT_ASSET_TYPE_ALPHA_MASK:
+      if (asset->is_video)
+        {
+          /* The old thumbnail is shown until a new one has been
+           * generated */
+          asset->thumbnail_ready = false;
+        }
+      else if (asset->texture_evictable)
+        {
+          /* Users drop the old texture the same way as when it's
+           * evicted so the new image gets loaded the next time the
+           * texture is asked for */
+          if (asset->texture)
+            drop_texture (asset);
+
+          /* Make sure the old image isn't picked up again if
+           * something is still holding on to it */
+          untrack_texture (asset);
+        }
+      break;
+    case RUT_ASSET_TYPE_PLY_MODEL:
+      {
+        RutMesh *old_mesh = asset->mesh;
+        RutModel *old_model = asset->model;
+
+        if (!load_ply_file (asset, full_path, asset->path))
+          {
+            asset->mesh = old_mesh;
+            asset->model = old_model;
+            ret = false;
+            break;
+          }
+
+        /* NB: anything using the old model keeps its own reference */
+        rut_refable_unref (old_mesh);
+        rut_refable_unref (old_model);
+
+        if (asset->texture)
+          cogl_object_unref (asset->texture);
+
+        asset->texture = load_cached_thumbnail (asset);
+        asset->thumbnail_ready = asset->texture != NULL;
+
+        break;
+      }
+    }
+
+  g_free (full_path);
+
+  return ret;
+}
+
 RutMesh *
 rut_asset_get_mesh (RutAsset *asset)
 {
+  ensure_loaded (asset);
+
   return asset->mesh;
 }
 
 RutObject *
 rut_asset_get_model (RutAsset *asset)
 {
+  ensure_loaded (asset);
+
   return asset->model;
 }
 
@@ -1119,7 +1829,65 @@ rut_asset_add_inferred_tag (RutAsset *asset,
 bool
 rut_asset_needs_thumbnail (RutAsset *asset)
 {
-  return asset->is_video ? TRUE : FALSE;
+  if (asset->thumbnail_ready)
+    return false;
+
+  /* NB: models loaded from a buffer render their thumbnail when they
+   * are first loaded */
+  return asset->is_video || (asset->model && !asset->texture);
+}
+
+static void
+generate_model_thumbnail (RutAsset *asset)
+{
+  asset->texture = rut_model_get_thumbnail (asset->ctx, asset->model);
+
+  /* NB: reading back the thumbnail to save it waits for the GPU to
+   * finish rendering so the time spent here accounts for the GPU
+   * time too */
+  save_cached_thumbnail (asset);
+  thumbnail_ready (asset);
+}
+
+void
+rut_asset_process_thumbnails (RutContext *ctx)
+{
+  int64_t start = g_get_monotonic_time ();
+  bool over_budget = false;
+  GList *l, *next;
+
+  for (l = ctx->thumbnail_queue.head; l; l = next)
+    {
+      RutAsset *asset = l->data;
+      bool decoders_busy =
+        (ctx->n_thumbnail_video_decoders >=
+         RUT_THUMBNAIL_MAX_VIDEO_DECODERS);
+
+      over_budget =
+        g_get_monotonic_time () - start >= RUT_THUMBNAIL_FRAME_BUDGET_US;
+
+      next = l->next;
+
+      if (over_budget && decoders_busy)
+        break;
+
+      if (asset->is_video ? decoders_busy : over_budget)
+        continue;
+
+      g_queue_delete_link (&ctx->thumbnail_queue, l);
+      asset->thumbnail_link = NULL;
+
+      if (asset->is_video)
+        rut_video_generate_thumbnail (asset);
+      else
+        generate_model_thumbnail (asset);
+    }
+
+  /* If we ran out of time then carry on in the next frame. Videos
+   * that are only waiting for a decoder queue a redraw themselves
+   * when one is freed up. */
+  if (over_budget && !g_queue_is_empty (&ctx->thumbnail_queue))
+    rut_shell_queue_redraw (ctx->shell);
 }
 
 RutClosure *
@@ -1137,11 +1905,14 @@ rut_asset_thumbnail (RutAsset *asset,
                                   user_data,
                                   destroy_cb);
 
-  rut_video_generate_thumbnail (asset);
+  if (!asset->thumbnail_link && !asset->generator)
+    {
+      RutContext *ctx = asset->ctx;
 
-  /* Make sure the thumnail wasn't simply generated synchronously to
-   * make sure the closure is still valid. */
-  g_warn_if_fail (!rut_list_empty (&asset->thumbnail_cb_list));
+      g_queue_push_tail (&ctx->thumbnail_queue, asset);
+      asset->thumbnail_link = ctx->thumbnail_queue.tail;
+      rut_shell_queue_redraw (ctx->shell);
+    }
 
   return closure;
 }
@@ -1157,3 +1928,9 @@ rut_asset_get_data_len (RutAsset *asset)
 {
   return asset->data_len;
 }
+
+RutBuffer *
+rut_asset_get_buffer (RutAsset *asset)
+{
+  return asset->buffer;
+}
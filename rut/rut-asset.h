@@ -68,6 +68,16 @@ rut_asset_new_from_data (RutContext *ctx,
                          const uint8_t *data,
                          size_t len);
 
+/* Unlike rut_asset_new_from_data() this doesn't copy or decode the
+ * data up front. The asset keeps a reference on the buffer and only
+ * decodes it the first time the texture, mesh or model is queried. */
+RutAsset *
+rut_asset_new_from_buffer (RutContext *ctx,
+                           const char *path,
+                           RutAssetType type,
+                           bool is_video,
+                           RutBuffer *buffer);
+
 RutAsset *
 rut_asset_new_from_mesh (RutContext *ctx,
                          RutMesh *mesh);
@@ -84,6 +94,17 @@ rut_asset_get_context (RutAsset *asset);
 CoglTexture *
 rut_asset_get_texture (RutAsset *asset);
 
+/* Reloads the asset's data after its file in the assets location has
+ * been modified. Image textures are dropped as if they had been
+ * evicted so the new image is loaded the next time the texture is
+ * asked for. Models get a new mesh and model which anything still
+ * using the old model needs to be switched over to. Videos only need
+ * a new thumbnail, see rut_asset_needs_thumbnail(). Returns false if
+ * the asset wasn't loaded from a file or a model couldn't be loaded,
+ * in which case the asset is left as it was. */
+bool
+rut_asset_reload (RutAsset *asset);
+
 RutMesh *
 rut_asset_get_mesh (RutAsset *asset);
 
@@ -114,16 +135,83 @@ rut_asset_needs_thumbnail (RutAsset *asset);
 
 typedef void (*RutThumbnailCallback) (RutAsset *asset, void *user_data);
 
+/* Queues the asset's thumbnail to be generated in the background and
+ * calls @ready_callback once it's ready. Generated thumbnails are
+ * cached on disk keyed by the file's path, mtime and size so they
+ * only need to be generated once. Querying the texture of an asset
+ * whose thumbnail is queued moves it to the front of the queue. */
 RutClosure *
 rut_asset_thumbnail (RutAsset *asset,
                      RutThumbnailCallback ready_callback,
                      void *user_data,
                      RutClosureDestroyCallback destroy_cb);
 
+/* Generates queued thumbnails for up to a few milliseconds. Should
+ * be called once at the start of each frame. A redraw is queued
+ * while there are thumbnails left that can be generated. */
+void
+rut_asset_process_thumbnails (RutContext *ctx);
+
 void *
 rut_asset_get_data (RutAsset *asset);
 
 size_t
 rut_asset_get_data_len (RutAsset *asset);
 
+RutBuffer *
+rut_asset_get_buffer (RutAsset *asset);
+
+/* The default number of frames that a texture must go unused before
+ * it can be evicted */
+#define RUT_TEXTURE_EVICTION_AGE 60
+
+typedef struct _RutTextureStats
+{
+  size_t budget;
+  size_t memory;
+  int n_resident;
+  unsigned int n_evictions;
+  unsigned int n_reloads;
+} RutTextureStats;
+
+/* Textures of image assets that can be reloaded from a file or from
+ * the buffer they were created from count towards a per context
+ * memory budget. A @budget of 0 means there is no limit. Textures
+ * that haven't been used for at least @eviction_age frames are
+ * evicted in least recently used order while the budget is exceeded
+ * and they are transparently reloaded the next time they are
+ * used. Textures that are still referenced outside of the asset
+ * after the evicted callbacks have run are kept because evicting
+ * them wouldn't free any memory and they don't count as
+ * evictions. */
+void
+rut_asset_set_texture_budget (RutContext *ctx,
+                              size_t budget,
+                              unsigned int eviction_age);
+
+void
+rut_asset_get_texture_stats (RutContext *ctx,
+                             RutTextureStats *stats);
+
+/* Should be called once at the end of each frame */
+void
+rut_asset_collect_textures (RutContext *ctx);
+
+/* Marks the asset's texture as being used in the current frame so
+ * that it won't be evicted. rut_asset_get_texture() implies this. */
+void
+rut_asset_mark_texture_used (RutAsset *asset);
+
+typedef void (*RutAssetTextureEvictedCallback) (RutAsset *asset,
+                                                void *user_data);
+
+/* The callback is invoked just before the asset drops its reference
+ * on its texture so that any other references can be released too.
+ * The texture can be queried again afterwards to reload it. */
+RutClosure *
+rut_asset_add_texture_evicted_callback (RutAsset *asset,
+                                        RutAssetTextureEvictedCallback callback,
+                                        void *user_data,
+                                        RutClosureDestroyCallback destroy_cb);
+
 #endif /* _RUT_ASSET_H_ */
@@ -57,11 +57,13 @@ struct _RutColorPicker
   RutSimpleIntrospectableProps introspectable;
   RutProperty properties[RUT_COLOR_PICKER_N_PROPS];
 
-  CoglBool hs_pipeline_dirty;
+  /* The gradients are generated in the fragment shader from
+   * uniforms so they don't need to be updated on the CPU */
   CoglPipeline *hs_pipeline;
+  int hs_value_location;
 
-  CoglBool v_pipeline_dirty;
   CoglPipeline *v_pipeline;
+  int v_hue_saturation_location;
 
   int width, height;
 
@@ -109,8 +111,9 @@ RutType rut_color_picker_type;
 
 
 /* The portion of the edge of the HS circle to blend so that it is
- * nicely anti-aliased */
-#define RUT_COLOR_PICKER_HS_BLEND_EDGE 0.98f
+ * nicely anti-aliased. NB: this is also pasted into GLSL so it
+ * mustn't have a suffix */
+#define RUT_COLOR_PICKER_HS_BLEND_EDGE 0.98
 
 static RutPropertySpec
 _rut_color_picker_prop_specs[] =
@@ -157,64 +160,42 @@ RutRefableVTable _rut_color_picker_refable_vtable = {
   _rut_color_picker_free
 };
 
+/* NB: this is the same function as hsv_to_rgb_glsl below so that the
+ * picked color and the CPU reference functions match the gradients
+ * drawn by the shaders */
 static void
 hsv_to_rgb (const float hsv[3],
             float rgb[3])
 {
-  /* Based on Wikipedia:
+  /* This is equivalent to the piecewise conversion described by
+     Wikipedia, but written without branches so that it's cheap
+     to evaluate per fragment:
      http://en.wikipedia.org/wiki/HSL_and_HSV#From_HSV */
-  float h = hsv[0];
-  float s = hsv[1];
-  float v = hsv[2];
-  float hh = h * 6.0f / (2.0f * G_PI);
-  float c = v * s;
-  float x = c * (1.0f - fabsf (fmodf (hh, 2.0f) - 1.0f));
-  float r, g, b;
-  float m;
-
-  if (hh < 1.0f)
-    {
-      r = c;
-      g = x;
-      b = 0;
-    }
-  else if (hh < 2.0f)
-    {
-      r = x;
-      g = c;
-      b = 0;
-    }
-  else if (hh < 3.0f)
-    {
-      r = 0;
-      g = c;
-      b = x;
-    }
-  else if (hh < 4.0f)
-    {
-      r = 0;
-      g = x;
-      b = c;
-    }
-  else if (hh < 5.0f)
-    {
-      r = x;
-      g = 0;
-      b = c;
-    }
-  else
-    {
-      r = c;
-      g = 0;
-      b = x;
-    }
+  float hh = hsv[0] * 3.0f / G_PI;
+  float k[3];
+  int i;
+
+  k[0] = CLAMP (fabsf (hh - 3.0f) - 1.0f, 0.0f, 1.0f);
+  k[1] = CLAMP (2.0f - fabsf (hh - 2.0f), 0.0f, 1.0f);
+  k[2] = CLAMP (2.0f - fabsf (hh - 4.0f), 0.0f, 1.0f);
 
-  m = v - c;
-  rgb[0] = r + m;
-  rgb[1] = g + m;
-  rgb[2] = b + m;
+  for (i = 0; i < 3; i++)
+    rgb[i] = hsv[2] * (1.0f - hsv[1] + hsv[1] * k[i]);
 }
 
+static const char
+hsv_to_rgb_glsl[] =
+  "vec3\n"
+  "rut_color_picker_hsv_to_rgb (vec3 hsv)\n"
+  "{\n"
+  "  float hh = hsv.x * 3.0 / 3.14159265358979323846;\n"
+  "  vec3 k = clamp (vec3 (abs (hh - 3.0) - 1.0,\n"
+  "                        2.0 - abs (hh - 2.0),\n"
+  "                        2.0 - abs (hh - 4.0)),\n"
+  "                  0.0, 1.0);\n"
+  "  return hsv.z * (1.0 - hsv.y + hsv.y * k);\n"
+  "}\n";
+
 static void
 rgb_to_hsv (const float rgb[3],
             float hsv[3])
@@ -276,164 +257,49 @@ rgb_to_hsv (const float rgb[3],
   hsv[2] = v;
 }
 
-static void
-ensure_hs_pipeline (RutColorPicker *picker)
+void
+rut_color_picker_hs_reference (float value,
+                               float s,
+                               float t,
+                               float rgba[4])
 {
-  CoglBitmap *bitmap;
-  CoglPixelBuffer *buffer;
-  CoglPipeline *pipeline;
-  CoglTexture2D *texture;
-  int rowstride;
-  uint8_t *data, *p;
-  int x, y;
-
-  if (!picker->hs_pipeline_dirty)
-    return;
-
-  bitmap = cogl_bitmap_new_with_size (picker->context->cogl_context,
-                                      RUT_COLOR_PICKER_HS_SIZE,
-                                      RUT_COLOR_PICKER_HS_SIZE,
-                                      COGL_PIXEL_FORMAT_RGBA_8888_PRE);
-  rowstride = cogl_bitmap_get_rowstride (bitmap);
-  buffer = cogl_bitmap_get_buffer (bitmap);
-
-  data = cogl_buffer_map (buffer,
-                          COGL_BUFFER_ACCESS_WRITE,
-                          COGL_BUFFER_MAP_HINT_DISCARD,
-                          NULL);
-
-  p = data;
-
-  for (y = 0; y < RUT_COLOR_PICKER_HS_SIZE; y++)
-    {
-      for (x = 0; x < RUT_COLOR_PICKER_HS_SIZE; x++)
-        {
-          float dx = x * 2.0f / RUT_COLOR_PICKER_HS_SIZE - 1.0f;
-          float dy = y * 2.0f / RUT_COLOR_PICKER_HS_SIZE - 1.0f;
-          float hsv[3];
-
-          hsv[1] = sqrtf (dx * dx + dy * dy);
-
-          if (hsv[1] >= 1.0f)
-            {
-              /* Outside of the circle the texture will be fully
-               * transparent */
-              p[0] = 0;
-              p[1] = 0;
-              p[2] = 0;
-              p[3] = 0;
-            }
-          else
-            {
-              float rgb[3];
-              float alpha;
-
-              hsv[2] = picker->value;
-              hsv[0] = atan2f (dy, dx) + G_PI;
-
-              hsv_to_rgb (hsv, rgb);
-
-              /* Blend the edges of the circle a bit so that it
-               * looks anti-aliased */
-              if (hsv[1] >= RUT_COLOR_PICKER_HS_BLEND_EDGE)
-                alpha = (((RUT_COLOR_PICKER_HS_BLEND_EDGE - hsv[1]) /
-                          (1.0f - RUT_COLOR_PICKER_HS_BLEND_EDGE) +
-                          1.0f) *
-                         255.0f);
-              else
-                alpha = 255.0f;
-
-              p[0] = nearbyintf (rgb[0] * alpha);
-              p[1] = nearbyintf (rgb[1] * alpha);
-              p[2] = nearbyintf (rgb[2] * alpha);
-              p[3] = alpha;
-            }
-
-          p += 4;
-        }
-
-      p += rowstride - RUT_COLOR_PICKER_HS_SIZE * 4;
-    }
-
-  cogl_buffer_unmap (buffer);
+  float dx = s * 2.0f - 1.0f;
+  float dy = t * 2.0f - 1.0f;
+  float hsv[3];
+  float alpha;
 
-  texture = cogl_texture_2d_new_from_bitmap (bitmap);
+  hsv[0] = atan2f (dy, dx) + G_PI;
+  hsv[1] = sqrtf (dx * dx + dy * dy);
+  hsv[2] = value;
 
-  pipeline = cogl_pipeline_copy (picker->hs_pipeline);
-  cogl_pipeline_set_layer_texture (pipeline,
-                                   0, /* layer */
-                                   texture);
-  cogl_object_unref (picker->hs_pipeline);
-  picker->hs_pipeline = pipeline;
+  /* Blend the edges of the circle a bit so that it looks
+   * anti-aliased. Outside of the circle it is fully transparent */
+  alpha = CLAMP ((1.0f - hsv[1]) / (1.0f - RUT_COLOR_PICKER_HS_BLEND_EDGE),
+                 0.0f, 1.0f);
 
-  cogl_object_unref (texture);
-  cogl_object_unref (bitmap);
+  hsv_to_rgb (hsv, rgba);
 
-  picker->hs_pipeline_dirty = FALSE;
+  rgba[0] *= alpha;
+  rgba[1] *= alpha;
+  rgba[2] *= alpha;
+  rgba[3] = alpha;
 }
 
-static void
-ensure_v_pipeline (RutColorPicker *picker)
+void
+rut_color_picker_v_reference (float hue,
+                              float saturation,
+                              float t,
+                              float rgba[4])
 {
-  CoglBitmap *bitmap;
-  CoglPixelBuffer *buffer;
-  CoglPipeline *pipeline;
-  CoglTexture2D *texture;
-  int rowstride;
-  uint8_t *data, *p;
   float hsv[3];
-  int y;
-
-  if (!picker->v_pipeline_dirty)
-    return;
-
-  bitmap = cogl_bitmap_new_with_size (picker->context->cogl_context,
-                                      1, /* width */
-                                      RUT_COLOR_PICKER_V_HEIGHT,
-                                      COGL_PIXEL_FORMAT_RGB_888);
-  rowstride = cogl_bitmap_get_rowstride (bitmap);
-  buffer = cogl_bitmap_get_buffer (bitmap);
-
-  data = cogl_buffer_map (buffer,
-                          COGL_BUFFER_ACCESS_WRITE,
-                          COGL_BUFFER_MAP_HINT_DISCARD,
-                          NULL);
-
-  p = data;
-
-  hsv[0] = picker->hue;
-  hsv[1] = picker->saturation;
-
-  for (y = 0; y < RUT_COLOR_PICKER_HS_SIZE; y++)
-    {
-      float rgb[3];
-
-      hsv[2] = 1.0f - y / (RUT_COLOR_PICKER_HS_SIZE - 1.0f);
-
-      hsv_to_rgb (hsv, rgb);
-
-      p[0] = nearbyintf (rgb[0] * 255.0f);
-      p[1] = nearbyintf (rgb[1] * 255.0f);
-      p[2] = nearbyintf (rgb[2] * 255.0f);
 
-      p += rowstride;
-    }
-
-  cogl_buffer_unmap (buffer);
-
-  texture = cogl_texture_2d_new_from_bitmap (bitmap);
-
-  pipeline = cogl_pipeline_copy (picker->v_pipeline);
-  cogl_pipeline_set_layer_texture (pipeline,
-                                   0, /* layer */
-                                   texture);
-  cogl_object_unref (picker->v_pipeline);
-  picker->v_pipeline = pipeline;
+  hsv[0] = hue;
+  hsv[1] = saturation;
+  hsv[2] = 1.0f - t;
 
-  cogl_object_unref (texture);
-  cogl_object_unref (bitmap);
+  hsv_to_rgb (hsv, rgba);
 
-  picker->v_pipeline_dirty = FALSE;
+  rgba[3] = 1.0f;
 }
 
 static void
@@ -464,9 +330,6 @@ _rut_color_picker_paint (RutObject *object,
                                    picker->width,
                                    picker->height);
 
-  ensure_hs_pipeline (picker);
-  ensure_v_pipeline (picker);
-
   cogl_framebuffer_draw_rectangle (fb,
                                    picker->hs_pipeline,
                                    RUT_COLOR_PICKER_HS_X,
@@ -600,25 +463,90 @@ _rut_color_picker_init_type (void)
                           &_rut_color_picker_sizable_vtable);
 }
 
+/* The gradients are generated by replacing the texture lookup of a
+ * layer with a null texture so that we still get texture coordinates
+ * from cogl_framebuffer_draw_rectangle(). The math must match
+ * rut_color_picker_hs_reference() and rut_color_picker_v_reference()
+ */
 static CoglPipeline *
-create_hs_pipeline (CoglContext *context)
+create_gradient_pipeline (CoglContext *context,
+                          const char *declarations,
+                          const char *lookup)
 {
   CoglPipeline *pipeline;
+  CoglSnippet *snippet;
+  char *full_declarations;
 
   pipeline = cogl_pipeline_new (context);
 
   cogl_pipeline_set_layer_null_texture (pipeline, 0, COGL_TEXTURE_TYPE_2D);
-  cogl_pipeline_set_layer_filters (pipeline,
-                                   0, /* layer */
-                                   COGL_PIPELINE_FILTER_NEAREST,
-                                   COGL_PIPELINE_FILTER_NEAREST);
-  cogl_pipeline_set_layer_wrap_mode (pipeline,
-                                     0, /* layer */
-                                     COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
+
+  full_declarations = g_strconcat (hsv_to_rgb_glsl, declarations, NULL);
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
+                              full_declarations,
+                              NULL /* post */);
+  cogl_snippet_set_replace (snippet, lookup);
+  cogl_pipeline_add_layer_snippet (pipeline, 0, snippet);
+  cogl_object_unref (snippet);
+  g_free (full_declarations);
 
   return pipeline;
 }
 
+static void
+create_hs_pipeline (RutColorPicker *picker)
+{
+  picker->hs_pipeline =
+    create_gradient_pipeline (picker->context->cogl_context,
+                              "uniform float hs_value;\n",
+
+                              "vec2 d = cogl_tex_coord.st * 2.0 - 1.0;\n"
+                              "vec3 hsv = vec3 (atan (d.y, d.x) + "
+                              "3.14159265358979323846,\n"
+                              "                 length (d),\n"
+                              "                 hs_value);\n"
+                              "float alpha =\n"
+                              "  clamp ((1.0 - hsv.y) /\n"
+                              "         (1.0 - "
+                              G_STRINGIFY (RUT_COLOR_PICKER_HS_BLEND_EDGE)
+                              "), 0.0, 1.0);\n"
+                              "cogl_texel =\n"
+                              "  vec4 (rut_color_picker_hsv_to_rgb (hsv) * "
+                              "alpha,\n"
+                              "        alpha);\n");
+
+  picker->hs_value_location =
+    cogl_pipeline_get_uniform_location (picker->hs_pipeline, "hs_value");
+  cogl_pipeline_set_uniform_1f (picker->hs_pipeline,
+                                picker->hs_value_location,
+                                picker->value);
+}
+
+static void
+create_v_pipeline (RutColorPicker *picker)
+{
+  float hue_saturation[2] = { picker->hue, picker->saturation };
+
+  picker->v_pipeline =
+    create_gradient_pipeline (picker->context->cogl_context,
+                              "uniform vec2 v_hue_saturation;\n",
+
+                              "vec3 hsv = vec3 (v_hue_saturation,\n"
+                              "                 1.0 - cogl_tex_coord.t);\n"
+                              "cogl_texel =\n"
+                              "  vec4 (rut_color_picker_hsv_to_rgb (hsv), "
+                              "1.0);\n");
+
+  picker->v_hue_saturation_location =
+    cogl_pipeline_get_uniform_location (picker->v_pipeline,
+                                        "v_hue_saturation");
+  cogl_pipeline_set_uniform_float (picker->v_pipeline,
+                                   picker->v_hue_saturation_location,
+                                   2, /* n_components */
+                                   1, /* count */
+                                   hue_saturation);
+}
+
 static void
 create_dot_pipeline (RutColorPicker *picker)
 {
@@ -667,8 +595,10 @@ set_value (RutColorPicker *picker,
 {
   if (picker->value != value)
     {
-      picker->hs_pipeline_dirty = TRUE;
       picker->value = value;
+      cogl_pipeline_set_uniform_1f (picker->hs_pipeline,
+                                    picker->hs_value_location,
+                                    value);
     }
 }
 
@@ -680,9 +610,15 @@ set_hue_saturation (RutColorPicker *picker,
   if (picker->hue != hue ||
       picker->saturation != saturation)
     {
-      picker->v_pipeline_dirty = TRUE;
+      float hue_saturation[2] = { hue, saturation };
+
       picker->hue = hue;
       picker->saturation = saturation;
+      cogl_pipeline_set_uniform_float (picker->v_pipeline,
+                                       picker->v_hue_saturation_location,
+                                       2, /* n_components */
+                                       1, /* count */
+                                       hue_saturation);
     }
 }
 
@@ -867,11 +803,8 @@ rut_color_picker_new (RutContext *context)
 
   rut_object_init (&picker->_parent, &rut_color_picker_type);
 
-  picker->hs_pipeline = create_hs_pipeline (context->cogl_context);
-  picker->hs_pipeline_dirty = TRUE;
-
-  picker->v_pipeline = cogl_pipeline_copy (picker->hs_pipeline);
-  picker->v_pipeline_dirty = TRUE;
+  create_hs_pipeline (picker);
+  create_v_pipeline (picker);
 
   create_dot_pipeline (picker);
 
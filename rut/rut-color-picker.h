@@ -36,4 +36,20 @@ rut_color_picker_set_color (RutObject *picker,
 const CoglColor *
 rut_color_picker_get_color (RutColorPicker *picker);
 
+/* CPU versions of the gradients that the color picker generates in
+ * its shaders, using the same math. @s and @t are the normalized
+ * coordinates within the hue/saturation disc or the value bar and
+ * the resulting colors are premultiplied. The hue is in radians. */
+void
+rut_color_picker_hs_reference (float value,
+                               float s,
+                               float t,
+                               float rgba[4]);
+
+void
+rut_color_picker_v_reference (float hue,
+                              float saturation,
+                              float t,
+                              float rgba[4]);
+
 #endif /* _RUT_COLOR_PICKER_H_ */
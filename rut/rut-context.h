@@ -63,8 +63,46 @@ struct _RutContext
 
   GHashTable *texture_cache;
 
+  /* Textures of assets that can be reloaded are tracked here so that
+   * the least recently used can be evicted when the total size goes
+   * over budget. See rut_asset_collect_textures() */
+  RutList texture_lru;
+  size_t texture_budget;
+  size_t texture_memory;
+  unsigned int texture_eviction_age;
+  unsigned int texture_frame;
+  unsigned int n_texture_evictions;
+  unsigned int n_texture_reloads;
+
+  /* Assets waiting for a thumbnail to be generated and the number of
+   * videos being decoded for a thumbnail. The queue doesn't hold
+   * references on the assets. See rut_asset_process_thumbnails() */
+  GQueue thumbnail_queue;
+  int n_thumbnail_video_decoders;
+
+  /* Render targets for offscreen passes. See rut-render-target.h */
+  RutList render_targets;
+  unsigned int render_target_frame;
+  size_t render_target_memory;
+  size_t render_target_peak_memory;
+  unsigned int n_render_target_allocations;
+  unsigned int n_render_target_reuses;
+
+  /* Text layouts shared between all RutTexts. See
+   * rut-text-layout-cache.h */
+  GHashTable *text_layouts;
+  RutList text_layout_lru;
+  int n_unused_text_layouts;
+
   CoglIndices *nine_slice_indices;
 
+  /* Geometry that is shared between shapes, nine-slices and
+   * pointalism grids of any size. The entries aren't referenced by
+   * the tables. */
+  GHashTable *shape_models;
+  GHashTable *nine_slice_geometries;
+  GHashTable *pointalism_grid_slices;
+
   CoglTexture *circle_texture;
 
   GHashTable *colors_hash;
@@ -77,6 +115,14 @@ struct _RutContext
 
   GHashTable *image_source_wrappers;
 
+  /* Playing video image sources and the state used to pace them. See
+   * rut_image_source_present_videos() */
+  RutList video_sources;
+  int64_t last_video_present_time;
+  int64_t video_frame_interval;
+  unsigned int video_timeout_id;
+  volatile int video_redraw_queued;
+
   CoglPipeline *single_texture_2d_template;
 
   GSList *timelines;
@@ -25,6 +25,7 @@
 #include "rut-dof-effect.h"
 #include "rut-downsampler.h"
 #include "rut-gaussian-blurrer.h"
+#include "rut-render-target.h"
 
 struct _RutDepthOfField
 {
@@ -36,34 +37,41 @@ struct _RutDepthOfField
 
   /* A texture to hold depth-of-field blend factors based
    * on the distance of the geometry from the focal plane.
+   *
+   * The passes are acquired from the context's render target pool
+   * when they are first requested in a frame and given back once
+   * they have been composited.
    */
-  CoglTexture *depth_pass;
-  CoglFramebuffer *depth_pass_fb;
+  RutRenderTarget *depth_pass;
 
-  /* This is our normal, pristine render of the color buffer */
-  CoglTexture *color_pass;
-  CoglFramebuffer *color_pass_fb;
+  /* This is our normal, pristine render of the color buffer. When
+   * depth textures are supported it also keeps its depth buffer which
+   * is used instead of a separate depth pass. */
+  RutRenderTarget *color_pass;
+  CoglBool depth_from_color_pass;
 
   /* This is our color buffer reduced in size and blurred */
   CoglTexture *blur_pass;
 
   CoglPipeline *pipeline;
 
+  /* Used instead of pipeline when depth_from_color_pass is set. This
+   * computes the blend factors from the depth buffer. */
+  CoglPipeline *depth_texture_pipeline;
+
   RutDownsampler *downsampler;
   RutGaussianBlurrer *blurrer;
 };
 
-RutDepthOfField *
-rut_dof_effect_new (RutContext *ctx)
+static CoglPipeline *
+create_composite_pipeline (RutContext *ctx,
+                           const char *declarations,
+                           const char *replace)
 {
-  RutDepthOfField *dof = g_slice_new0 (RutDepthOfField);
   CoglPipeline *pipeline;
   CoglSnippet *snippet;
 
-  dof->ctx = ctx;
-
   pipeline = cogl_pipeline_new (ctx->cogl_context);
-  dof->pipeline = pipeline;
 
   cogl_pipeline_set_layer_texture (pipeline, 0, NULL); /* depth */
   cogl_pipeline_set_layer_texture (pipeline, 1, NULL); /* blurred */
@@ -73,18 +81,69 @@ rut_dof_effect_new (RutContext *ctx)
   cogl_pipeline_set_blend (pipeline, "RGBA=ADD(SRC_COLOR, 0)", NULL);
 
   snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_FRAGMENT,
-                              NULL, /* definitions */
+                              declarations,
                               NULL  /* post */);
 
-  cogl_snippet_set_replace (snippet,
+  cogl_snippet_set_replace (snippet, replace);
+
+  cogl_pipeline_add_snippet (pipeline, snippet);
+  cogl_object_unref (snippet);
+
+  return pipeline;
+}
+
+RutDepthOfField *
+rut_dof_effect_new (RutContext *ctx)
+{
+  RutDepthOfField *dof = g_slice_new0 (RutDepthOfField);
+
+  dof->ctx = ctx;
+
+  dof->pipeline = create_composite_pipeline (ctx,
+      NULL, /* declarations */
       "cogl_texel0 = texture2D (cogl_sampler0, cogl_tex_coord0_in.st);\n"
       "cogl_texel1 = texture2D (cogl_sampler1, cogl_tex_coord1_in.st);\n"
       "cogl_texel2 = texture2D (cogl_sampler2, cogl_tex_coord2_in.st);\n"
       "cogl_color_out = mix (cogl_texel1, cogl_texel2, cogl_texel0.a);\n"
       "cogl_color_out.a = 1.0;\n");
 
-  cogl_pipeline_add_snippet (pipeline, snippet);
-  cogl_object_unref (snippet);
+  dof->depth_from_color_pass =
+    cogl_has_feature (ctx->cogl_context, COGL_FEATURE_ID_DEPTH_TEXTURE);
+
+  if (dof->depth_from_color_pass)
+    {
+      /* The blend factor is the same as the one written by the
+       * renderer's depth pass, but computed from the view space depth
+       * which is recovered by unprojecting the depth buffer value.
+       * Nothing was drawn where the depth is still 1.0 and, as in the
+       * depth pass which is cleared to white, that is left sharp. */
+      dof->depth_texture_pipeline = create_composite_pipeline (ctx,
+          /* definitions */
+          "uniform mat4 dof_inverse_projection;\n"
+          "uniform float dof_focal_distance;\n"
+          "uniform float dof_depth_of_field;\n",
+
+          "cogl_texel0 = texture2D (cogl_sampler0, cogl_tex_coord0_in.st);\n"
+          "cogl_texel1 = texture2D (cogl_sampler1, cogl_tex_coord1_in.st);\n"
+          "cogl_texel2 = texture2D (cogl_sampler2, cogl_tex_coord2_in.st);\n"
+          "vec4 ndc_pos = vec4 (cogl_tex_coord0_in.s * 2.0 - 1.0,\n"
+          "                     1.0 - cogl_tex_coord0_in.t * 2.0,\n"
+          "                     cogl_texel0.r * 2.0 - 1.0,\n"
+          "                     1.0);\n"
+          "vec4 view_pos = dof_inverse_projection * ndc_pos;\n"
+          "float sharpness =\n"
+          "  1.0 - clamp (abs (view_pos.z / view_pos.w - dof_focal_distance) /\n"
+          "               dof_depth_of_field, 0.0, 1.0);\n"
+          "sharpness = max (sharpness, step (1.0, cogl_texel0.r));\n"
+          "cogl_color_out = mix (cogl_texel1, cogl_texel2, sharpness);\n"
+          "cogl_color_out.a = 1.0;\n");
+
+      /* depth values can't be interpolated */
+      cogl_pipeline_set_layer_filters (dof->depth_texture_pipeline,
+                                       0, /* layer_num */
+                                       COGL_PIPELINE_FILTER_NEAREST,
+                                       COGL_PIPELINE_FILTER_NEAREST);
+    }
 
   dof->downsampler = rut_downsampler_new (ctx);
   dof->blurrer = rut_gaussian_blurrer_new (ctx, 7);
@@ -92,12 +151,31 @@ rut_dof_effect_new (RutContext *ctx)
   return dof;
 }
 
+static void
+release_passes (RutDepthOfField *dof)
+{
+  if (dof->depth_pass)
+    {
+      rut_render_target_release (dof->depth_pass);
+      dof->depth_pass = NULL;
+    }
+
+  if (dof->color_pass)
+    {
+      rut_render_target_release (dof->color_pass);
+      dof->color_pass = NULL;
+    }
+}
+
 void
 rut_dof_effect_free (RutDepthOfField *dof)
 {
+  release_passes (dof);
   rut_downsampler_free (dof->downsampler);
   rut_gaussian_blurrer_free (dof->blurrer);
   cogl_object_unref (dof->pipeline);
+  if (dof->depth_texture_pipeline)
+    cogl_object_unref (dof->depth_texture_pipeline);
 
   g_slice_free (RutDepthOfField, dof);
 }
@@ -110,22 +188,7 @@ rut_dof_effect_set_framebuffer_size (RutDepthOfField *dof,
   if (dof->width == width && dof->height == height)
     return;
 
-
-  if (dof->color_pass_fb)
-    {
-      cogl_object_unref (dof->color_pass_fb);
-      dof->color_pass_fb = NULL;
-      cogl_object_unref (dof->color_pass);
-      dof->color_pass = NULL;
-    }
-
-  if (dof->depth_pass_fb)
-    {
-      cogl_object_unref (dof->depth_pass_fb);
-      dof->depth_pass_fb = NULL;
-      cogl_object_unref (dof->depth_pass);
-      dof->depth_pass = NULL;
-    }
+  release_passes (dof);
 
   dof->width = width;
   dof->height = height;
@@ -140,15 +203,55 @@ rut_dof_effect_get_depth_pass_fb (RutDepthOfField *dof)
        * Offscreen render for post-processing
        */
       dof->depth_pass =
-        cogl_texture_2d_new_with_size (dof->ctx->cogl_context,
-                                       dof->width,
-                                       dof->height);
-
-      dof->depth_pass_fb =
-        cogl_offscreen_new_with_texture (dof->depth_pass);
+        rut_render_target_acquire (dof->ctx,
+                                   dof->width,
+                                   dof->height,
+                                   COGL_TEXTURE_COMPONENTS_RGBA,
+                                   0 /* flags */);
     }
 
-  return dof->depth_pass_fb;
+  return rut_render_target_get_framebuffer (dof->depth_pass);
+}
+
+CoglBool
+rut_dof_effect_get_depth_from_color_pass (RutDepthOfField *dof)
+{
+  return dof->depth_from_color_pass;
+}
+
+void
+rut_dof_effect_set_focal_parameters (RutDepthOfField *dof,
+                                     const CoglMatrix *projection,
+                                     float focal_distance,
+                                     float depth_of_field)
+{
+  CoglPipeline *pipeline = dof->depth_texture_pipeline;
+  CoglMatrix inverse_projection;
+  float distance;
+  int location;
+
+  if (!dof->depth_from_color_pass)
+    return;
+
+  cogl_matrix_get_inverse (projection, &inverse_projection);
+  location = cogl_pipeline_get_uniform_location (pipeline,
+                                                 "dof_inverse_projection");
+  cogl_pipeline_set_uniform_matrix (pipeline,
+                                    location,
+                                    4, /* dimensions */
+                                    1, /* count */
+                                    FALSE, /* don't transpose */
+                                    &inverse_projection.xx);
+
+  /* The camera looks down the negative z axis */
+  distance = -focal_distance;
+  location = cogl_pipeline_get_uniform_location (pipeline,
+                                                 "dof_focal_distance");
+  cogl_pipeline_set_uniform_1f (pipeline, location, distance);
+
+  location = cogl_pipeline_get_uniform_location (pipeline,
+                                                 "dof_depth_of_field");
+  cogl_pipeline_set_uniform_1f (pipeline, location, depth_of_field);
 }
 
 CoglFramebuffer *
@@ -156,19 +259,23 @@ rut_dof_effect_get_color_pass_fb (RutDepthOfField *dof)
 {
   if (!dof->color_pass)
     {
+      RutRenderTargetFlags flags = 0;
+
+      if (dof->depth_from_color_pass)
+        flags |= RUT_RENDER_TARGET_FLAG_DEPTH_TEXTURE;
+
       /*
        * Offscreen render for post-processing
        */
       dof->color_pass =
-        cogl_texture_2d_new_with_size (dof->ctx->cogl_context,
-                                       dof->width,
-                                       dof->height);
-
-      dof->color_pass_fb =
-        cogl_offscreen_new_with_texture (dof->color_pass);
+        rut_render_target_acquire (dof->ctx,
+                                   dof->width,
+                                   dof->height,
+                                   COGL_TEXTURE_COMPONENTS_RGBA,
+                                   flags);
     }
 
-  return dof->color_pass_fb;
+  return rut_render_target_get_framebuffer (dof->color_pass);
 }
 
 void
@@ -179,23 +286,43 @@ rut_dof_effect_draw_rectangle (RutDepthOfField *dof,
                                float x2,
                                float y2)
 {
+  CoglTexture *color_pass = rut_render_target_get_texture (dof->color_pass);
+  CoglTexture *depth_pass;
+  CoglPipeline *pipeline;
+
   CoglTexture *downsampled =
-    rut_downsampler_downsample (dof->downsampler, dof->color_pass, 4, 4);
+    rut_downsampler_downsample (dof->downsampler, color_pass, 4, 4);
 
   CoglTexture *blurred =
     rut_gaussian_blurrer_blur (dof->blurrer, downsampled);
 
-  CoglPipeline *pipeline = cogl_pipeline_copy (dof->pipeline);
+  if (dof->depth_from_color_pass)
+    {
+      depth_pass = rut_render_target_get_depth_texture (dof->color_pass);
+      pipeline = cogl_pipeline_copy (dof->depth_texture_pipeline);
+    }
+  else
+    {
+      depth_pass = rut_render_target_get_texture (dof->depth_pass);
+      pipeline = cogl_pipeline_copy (dof->pipeline);
+    }
 
-  cogl_pipeline_set_layer_texture (pipeline, 0, dof->depth_pass);
+  cogl_pipeline_set_layer_texture (pipeline, 0, depth_pass);
   cogl_pipeline_set_layer_texture (pipeline, 1, blurred);
-  cogl_pipeline_set_layer_texture (pipeline, 2, dof->color_pass);
+  cogl_pipeline_set_layer_texture (pipeline, 2, color_pass);
 
-  cogl_framebuffer_draw_rectangle (fb, pipeline,
-                                   x1, y1, x2, y2);
+  rut_render_target_draw_rectangle (fb, pipeline,
+                                    x1, y1, x2, y2);
 
+  cogl_object_unref (pipeline);
   cogl_object_unref (blurred);
   cogl_object_unref (downsampled);
+
+  /* All of the intermediate buffers can now be reused by any later
+   * passes in the frame */
+  rut_downsampler_release (dof->downsampler);
+  rut_gaussian_blurrer_release (dof->blurrer);
+  release_passes (dof);
 }
 
 
@@ -38,6 +38,23 @@ rut_dof_effect_set_framebuffer_size (RutDepthOfField *dof,
                                      int width,
                                      int height);
 
+/* When this returns TRUE the blend factors are computed from the
+ * depth buffer of the color pass so there is no need to render a
+ * depth pass. Otherwise the scene has to be rendered into
+ * rut_dof_effect_get_depth_pass_fb() with the blend factors in the
+ * alpha channel. */
+CoglBool
+rut_dof_effect_get_depth_from_color_pass (RutDepthOfField *dof);
+
+/* Should be called after rendering the color pass with the projection
+ * that it was rendered with. This is only needed when the depth
+ * comes from the color pass. */
+void
+rut_dof_effect_set_focal_parameters (RutDepthOfField *dof,
+                                     const CoglMatrix *projection,
+                                     float focal_distance,
+                                     float depth_of_field);
+
 CoglFramebuffer *
 rut_dof_effect_get_depth_pass_fb (RutDepthOfField *dof);
 
@@ -33,6 +33,11 @@ rut_downsampler_new (RutContext *ctx)
 
   pipeline = cogl_pipeline_new (ctx->cogl_context);
   cogl_pipeline_set_layer_texture (pipeline, 0, NULL);
+  /* A source that isn't a multiple of the scale factor is padded by
+   * repeating its last row and column */
+  cogl_pipeline_set_layer_wrap_mode (pipeline,
+                                     0, /* layer_num */
+                                     COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
   cogl_pipeline_set_blend (pipeline, "RGBA=ADD(SRC_COLOR, 0)", NULL);
 
   downsampler->pipeline = pipeline;
@@ -40,32 +45,26 @@ rut_downsampler_new (RutContext *ctx)
   return downsampler;
 }
 
-static void
-_rut_downsampler_reset (RutDownsampler *downsampler)
+void
+rut_downsampler_release (RutDownsampler *downsampler)
 {
-  if (downsampler->dest)
-    {
-      cogl_object_unref (downsampler->dest);
-      downsampler->dest = NULL;
-    }
-
-  if (downsampler->fb)
+  if (downsampler->target)
     {
-      cogl_object_unref (downsampler->fb);
-      downsampler->fb = NULL;
-    }
-
-  if (downsampler->camera)
-    {
-      rut_refable_unref (downsampler->camera);
-      downsampler->camera = NULL;
+      rut_render_target_release (downsampler->target);
+      downsampler->target = NULL;
     }
 }
 
 void
 rut_downsampler_free (RutDownsampler *downsampler)
 {
-  _rut_downsampler_reset (downsampler);
+  rut_downsampler_release (downsampler);
+
+  if (downsampler->camera)
+    rut_refable_unref (downsampler->camera);
+
+  cogl_object_unref (downsampler->pipeline);
+
   g_slice_free (RutDownsampler, downsampler);
 }
 
@@ -79,69 +78,70 @@ rut_downsampler_downsample (RutDownsampler *downsampler,
   int src_w, src_h;
   int dest_width, dest_height;
   CoglPipeline *pipeline;
+  CoglFramebuffer *fb;
+  const float *viewport = NULL;
 
-  /* validation */
   src_w = cogl_texture_get_width (source);
   src_h = cogl_texture_get_height (source);
 
-  if (src_w % scale_factor_x != 0)
-    {
-      g_warning ("downsample: the width of the texture (%d) is not a "
-                 "multiple of the scale factor (%d)", src_w, scale_factor_x);
-    }
-  if (src_h % scale_factor_y != 0)
-    {
-      g_warning ("downsample: the height of the texture (%d) is not a "
-                 "multiple of the scale factor (%d)", src_h, scale_factor_y);
-    }
-
-  /* create the destination texture up front */
-  dest_width = src_w / scale_factor_x;
-  dest_height = src_h / scale_factor_y;
+  /* create the destination texture up front, rounding up so that the
+   * edges of the source aren't dropped */
+  dest_width = (src_w + scale_factor_x - 1) / scale_factor_x;
+  dest_height = (src_h + scale_factor_y - 1) / scale_factor_y;
   components = cogl_texture_get_components (source);
 
-  if (downsampler->dest == NULL ||
-      cogl_texture_get_width (downsampler->dest) != dest_width ||
-      cogl_texture_get_height (downsampler->dest) != dest_height ||
-      cogl_texture_get_components (downsampler->dest) != components)
-    {
-      CoglOffscreen *offscreen;
-      CoglTexture2D *texture_2d =
-        cogl_texture_2d_new_with_size (downsampler->ctx->cogl_context,
-                                       dest_width,
-                                       dest_height);
-
-      cogl_texture_set_components (texture_2d, components);
+  rut_downsampler_release (downsampler);
 
-      _rut_downsampler_reset (downsampler);
+  downsampler->target = rut_render_target_acquire (downsampler->ctx,
+                                                   dest_width,
+                                                   dest_height,
+                                                   components,
+                                                   0 /* flags */);
+  fb = rut_render_target_get_framebuffer (downsampler->target);
 
-      downsampler->dest = texture_2d;
+  if (downsampler->camera)
+    viewport = rut_camera_get_viewport (downsampler->camera);
 
-      /* create the FBO to render the downsampled texture */
-      offscreen = cogl_offscreen_new_with_texture (downsampler->dest);
-      downsampler->fb = offscreen;
+  if (downsampler->camera == NULL ||
+      viewport[2] != dest_width ||
+      viewport[3] != dest_height)
+    {
+      if (downsampler->camera)
+        rut_refable_unref (downsampler->camera);
 
       /* create the camera that will setup the scene for the render */
-      downsampler->camera = rut_camera_new (downsampler->ctx, downsampler->fb);
+      downsampler->camera = rut_camera_new (downsampler->ctx, fb);
       rut_camera_set_near_plane (downsampler->camera, -1.f);
       rut_camera_set_far_plane (downsampler->camera, 1.f);
     }
+  else
+    rut_camera_set_framebuffer (downsampler->camera, fb);
 
   pipeline = cogl_pipeline_copy (downsampler->pipeline);
   cogl_pipeline_set_layer_texture (pipeline, 0, source);
 
   rut_camera_flush (downsampler->camera);
 
-  cogl_framebuffer_draw_rectangle (downsampler->fb,
-                                   pipeline,
-                                   0,
-                                   0,
-                                   dest_width,
-                                   dest_height);
+  /* The source may be recycled as soon as the caller releases it */
+  /* Each destination texel covers exactly scale_factor texels of the
+   * source so the texture coordinates go past the end of the source
+   * when it has been padded */
+  rut_render_target_draw_textured_rectangle (fb,
+                                             pipeline,
+                                             0,
+                                             0,
+                                             dest_width,
+                                             dest_height,
+                                             0,
+                                             0,
+                                             (float) (dest_width *
+                                                      scale_factor_x) / src_w,
+                                             (float) (dest_height *
+                                                      scale_factor_y) / src_h);
 
   rut_camera_end_frame (downsampler->camera);
 
   cogl_object_unref (pipeline);
 
-  return cogl_object_ref (downsampler->dest);
+  return cogl_object_ref (rut_render_target_get_texture (downsampler->target));
 }
@@ -25,13 +25,13 @@
 
 #include "rut-context.h"
 #include "rut-camera-private.h"
+#include "rut-render-target.h"
 
 typedef struct
 {
   RutContext *ctx;
   CoglPipeline *pipeline;
-  CoglTexture *dest;
-  CoglFramebuffer *fb;
+  RutRenderTarget *target;
   RutCamera *camera;
 } RutDownsampler;
 
@@ -41,10 +41,19 @@ rut_downsampler_new (RutContext *ctx);
 void
 rut_downsampler_free (RutDownsampler *downsampler);
 
+/* The destination is acquired from the context's render target pool
+ * and it's kept until the next downsample or until
+ * rut_downsampler_release() is called. Its size is the size of
+ * @source divided by the scale factors, rounded up. */
 CoglTexture *
 rut_downsampler_downsample (RutDownsampler *downsampler,
                             CoglTexture *source,
                             int scale_factor_x,
                             int scale_factor_y);
 
+/* Gives the destination of the last downsample back to the render
+ * target pool. The texture mustn't be used after this. */
+void
+rut_downsampler_release (RutDownsampler *downsampler);
+
 #endif /* __RUT_DOWNSAMPLER_H__ */
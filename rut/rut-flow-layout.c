@@ -30,6 +30,7 @@
 #include "rut-interfaces.h"
 #include "rut-flow-layout.h"
 #include "rut-transform.h"
+#include "rut-ui-viewport.h"
 
 #include <math.h>
 
@@ -81,6 +82,10 @@ typedef struct
   int flow_width;
   int flow_height;
 
+  /* In virtualised mode this is the index of the item the child is
+   * currently bound to */
+  int index;
+
 } RutFlowLayoutChild;
 
 struct _RutFlowLayout
@@ -111,10 +116,27 @@ struct _RutFlowLayout
 
   int last_flow_line_length;
 
+  /* Virtualised mode. Only the children for visible items are in
+   * the children list and the children for items that have been
+   * scrolled out of view are kept in the pool to be recycled. */
+  RutFlowLayoutItemCallback item_cb;
+  void *item_data;
+  int n_items;
+  int item_width;
+  int item_height;
+  RutList pool;
+  float visible_x;
+  float visible_y;
+  float visible_width;
+  float visible_height;
+  RutUIViewport *viewport;
+  RutPropertyClosure *viewport_closures[4];
+
   RutSimpleIntrospectableProps introspectable;
   RutProperty properties[RUT_FLOW_LAYOUT_N_PROPS];
 
   unsigned int needs_reflow: 1;
+  unsigned int items_dirty: 1;
 };
 
 static RutPropertySpec _rut_flow_layout_prop_specs[] = {
@@ -237,7 +259,8 @@ static void
 rut_flow_layout_remove_child (RutFlowLayout *flow,
                               RutFlowLayoutChild *child)
 {
-  rut_closure_disconnect (child->preferred_size_closure);
+  if (child->preferred_size_closure)
+    rut_closure_disconnect (child->preferred_size_closure);
 
   rut_graphable_remove_child (child->widget);
   rut_graphable_remove_child (child->transform);
@@ -248,6 +271,16 @@ rut_flow_layout_remove_child (RutFlowLayout *flow,
   flow->n_children--;
 }
 
+/* NB: pooled children aren't part of the graph so we hold our own
+ * reference on their transform */
+static void
+free_pooled_child (RutFlowLayoutChild *child)
+{
+  rut_list_remove (&child->link);
+  rut_refable_unref (child->transform);
+  g_slice_free (RutFlowLayoutChild, child);
+}
+
 static void
 _rut_flow_layout_free (void *object)
 {
@@ -263,6 +296,16 @@ _rut_flow_layout_free (void *object)
       rut_flow_layout_remove_child (flow, child);
     }
 
+  while (!rut_list_empty (&flow->pool))
+    {
+      RutFlowLayoutChild *child =
+        rut_container_of (flow->pool.next, child, link);
+
+      free_pooled_child (child);
+    }
+
+  rut_flow_layout_set_viewport (flow, NULL);
+
   rut_shell_remove_pre_paint_callback_by_graphable (flow->ctx->shell, flow);
 
   rut_simple_introspectable_destroy (flow);
@@ -545,6 +588,310 @@ reflow (RutFlowLayout *flow,
   flow->last_flow_line_length = state.line_length;
 }
 
+typedef struct _VirtualLayout
+{
+  float cell_a_size;
+  float cell_b_size;
+  int items_per_line;
+  int n_lines;
+  float line_length;
+} VirtualLayout;
+
+/* In virtualised mode every item has the same size so the position
+ * of any item and the total extent of the layout can be calculated
+ * directly */
+static void
+init_virtual_layout (VirtualLayout *layout,
+                     RutFlowLayout *flow,
+                     ReFlowState *state)
+{
+  switch (flow->packing)
+    {
+    case RUT_FLOW_LAYOUT_PACKING_LEFT_TO_RIGHT:
+    case RUT_FLOW_LAYOUT_PACKING_RIGHT_TO_LEFT:
+      layout->cell_a_size = flow->item_width;
+      layout->cell_b_size = flow->item_height;
+      break;
+    case RUT_FLOW_LAYOUT_PACKING_TOP_TO_BOTTOM:
+    case RUT_FLOW_LAYOUT_PACKING_BOTTOM_TO_TOP:
+      layout->cell_a_size = flow->item_height;
+      layout->cell_b_size = flow->item_width;
+      break;
+    }
+
+  if (state->line_length >= 0)
+    {
+      layout->items_per_line =
+        (state->line_length + state->a_pad) /
+        (layout->cell_a_size + state->a_pad);
+      layout->items_per_line = MAX (layout->items_per_line, 1);
+    }
+  else
+    layout->items_per_line = MAX (flow->n_items, 1);
+
+  layout->n_lines =
+    (flow->n_items + layout->items_per_line - 1) / layout->items_per_line;
+
+  if (state->line_length >= 0)
+    layout->line_length = state->line_length;
+  else
+    layout->line_length = (flow->n_items * layout->cell_a_size +
+                           MAX (flow->n_items - 1, 0) * state->a_pad);
+}
+
+static float
+get_virtual_length (VirtualLayout *layout,
+                    ReFlowState *state)
+{
+  if (layout->n_lines == 0)
+    return 0;
+
+  return (layout->n_lines * layout->cell_b_size +
+          (layout->n_lines - 1) * state->b_pad);
+}
+
+static void
+position_virtual_child (RutFlowLayout *flow,
+                        RutFlowLayoutChild *child,
+                        VirtualLayout *layout,
+                        ReFlowState *state)
+{
+  int line = child->index / layout->items_per_line;
+  int column = child->index % layout->items_per_line;
+  float a_pos = column * (layout->cell_a_size + state->a_pad);
+  float b_pos = line * (layout->cell_b_size + state->b_pad);
+
+  switch (flow->packing)
+    {
+    case RUT_FLOW_LAYOUT_PACKING_LEFT_TO_RIGHT:
+      child->flow_x = a_pos;
+      child->flow_y = b_pos;
+      break;
+    case RUT_FLOW_LAYOUT_PACKING_RIGHT_TO_LEFT:
+      child->flow_x = layout->line_length - layout->cell_a_size - a_pos;
+      child->flow_y = b_pos;
+      break;
+    case RUT_FLOW_LAYOUT_PACKING_TOP_TO_BOTTOM:
+      child->flow_x = b_pos;
+      child->flow_y = a_pos;
+      break;
+    case RUT_FLOW_LAYOUT_PACKING_BOTTOM_TO_TOP:
+      child->flow_x = b_pos;
+      child->flow_y = layout->line_length - layout->cell_a_size - a_pos;
+      break;
+    }
+
+  child->flow_width = flow->item_width;
+  child->flow_height = flow->item_height;
+}
+
+/* Determines the range of items that intersect the visible region
+ * of the layout, including a margin of half the visible size either
+ * side so that widgets are ready before they are scrolled into
+ * view. */
+static void
+get_visible_items (RutFlowLayout *flow,
+                   VirtualLayout *layout,
+                   ReFlowState *state,
+                   int *first_p,
+                   int *end_p)
+{
+  float line_size = layout->cell_b_size + state->b_pad;
+  float b_start, b_size, margin;
+  int first_line, last_line;
+
+  if (flow->visible_width < 0 || line_size <= 0)
+    {
+      *first_p = 0;
+      *end_p = flow->n_items;
+      return;
+    }
+
+  switch (flow->packing)
+    {
+    case RUT_FLOW_LAYOUT_PACKING_LEFT_TO_RIGHT:
+    case RUT_FLOW_LAYOUT_PACKING_RIGHT_TO_LEFT:
+      b_start = flow->visible_y;
+      b_size = flow->visible_height;
+      break;
+    default:
+      b_start = flow->visible_x;
+      b_size = flow->visible_width;
+      break;
+    }
+
+  margin = b_size / 2;
+
+  first_line = floorf ((b_start - margin) / line_size);
+  last_line = floorf ((b_start + b_size + margin) / line_size);
+
+  first_line = MAX (first_line, 0);
+  last_line = MIN (last_line, layout->n_lines - 1);
+
+  if (first_line > last_line)
+    {
+      *first_p = *end_p = 0;
+      return;
+    }
+
+  *first_p = first_line * layout->items_per_line;
+  *end_p = MIN ((last_line + 1) * layout->items_per_line, flow->n_items);
+}
+
+static void
+update_visible_region_from_viewport (RutFlowLayout *flow)
+{
+  CoglMatrix viewport_transform;
+  CoglMatrix flow_transform;
+  CoglMatrix inverse;
+  float x0 = 0, y0 = 0, z0 = 0, w0 = 1;
+  float x1, y1, z1 = 0, w1 = 1;
+
+  if (!flow->viewport)
+    return;
+
+  /* Map the corners of the viewport into the coordinate space of
+   * the flow layout */
+  rut_graphable_get_transform (flow->viewport, &viewport_transform);
+  rut_graphable_get_transform (flow, &flow_transform);
+
+  if (!cogl_matrix_get_inverse (&flow_transform, &inverse))
+    return;
+
+  cogl_matrix_multiply (&inverse, &inverse, &viewport_transform);
+
+  x1 = rut_ui_viewport_get_width (flow->viewport);
+  y1 = rut_ui_viewport_get_height (flow->viewport);
+
+  cogl_matrix_transform_point (&inverse, &x0, &y0, &z0, &w0);
+  cogl_matrix_transform_point (&inverse, &x1, &y1, &z1, &w1);
+
+  flow->visible_x = MIN (x0, x1);
+  flow->visible_y = MIN (y0, y1);
+  flow->visible_width = fabsf (x1 - x0);
+  flow->visible_height = fabsf (y1 - y0);
+}
+
+static RutFlowLayoutChild *
+new_virtual_child (RutFlowLayout *flow,
+                   RutObject *widget)
+{
+  RutFlowLayoutChild *child = g_slice_new0 (RutFlowLayoutChild);
+
+  child->transform = rut_transform_new (flow->ctx);
+
+  child->widget = widget;
+  rut_graphable_add_child (child->transform, widget);
+
+  return child;
+}
+
+static void
+bind_virtual_child (RutFlowLayout *flow,
+                    int index,
+                    RutFlowLayoutChild *child)
+{
+  RutObject *recycle_widget = child ? child->widget : NULL;
+  RutObject *widget =
+    flow->item_cb (flow, index, recycle_widget, flow->item_data);
+
+  if (child && widget == recycle_widget)
+    {
+      /* The callback returns a new reference but the child already
+       * owns one via the transform */
+      rut_refable_unref (widget);
+    }
+  else if (child)
+    {
+      rut_graphable_remove_child (child->widget);
+      child->widget = widget;
+      rut_graphable_add_child (child->transform, widget);
+      rut_refable_unref (widget);
+    }
+  else
+    {
+      child = new_virtual_child (flow, widget);
+      rut_refable_unref (widget);
+    }
+
+  if (rut_graphable_get_parent (child->transform) == NULL)
+    {
+      rut_graphable_add_child (flow, child->transform);
+      rut_refable_unref (child->transform);
+
+      rut_list_insert (flow->children.prev, &child->link);
+      flow->n_children++;
+    }
+
+  child->index = index;
+}
+
+static void
+allocate_virtual (RutFlowLayout *flow)
+{
+  ReFlowState state;
+  VirtualLayout layout;
+  RutFlowLayoutChild *child, *tmp;
+  RutFlowLayoutChild **bound;
+  int first, end;
+  int i;
+
+  update_visible_region_from_viewport (flow);
+
+  init_reflow_state (&state, flow, flow->width, flow->height);
+  init_virtual_layout (&layout, flow, &state);
+  get_visible_items (flow, &layout, &state, &first, &end);
+
+  bound = g_new0 (RutFlowLayoutChild *, MAX (end - first, 1));
+
+  /* Move the children for items that are no longer visible into the
+   * pool so their widgets can be recycled */
+  rut_list_for_each_safe (child, tmp, &flow->children, link)
+    {
+      if (child->index >= first && child->index < end)
+        {
+          bound[child->index - first] = child;
+          continue;
+        }
+
+      rut_list_remove (&child->link);
+      flow->n_children--;
+
+      rut_refable_ref (child->transform);
+      rut_graphable_remove_child (child->transform);
+      child->index = -1;
+
+      rut_list_insert (&flow->pool, &child->link);
+    }
+
+  for (i = first; i < end; i++)
+    {
+      child = bound[i - first];
+
+      if (child)
+        {
+          if (flow->items_dirty)
+            bind_virtual_child (flow, i, child);
+          continue;
+        }
+
+      if (!rut_list_empty (&flow->pool))
+        {
+          child = rut_container_of (flow->pool.next, child, link);
+          rut_list_remove (&child->link);
+        }
+
+      bind_virtual_child (flow, i, child);
+    }
+
+  g_free (bound);
+
+  flow->items_dirty = FALSE;
+
+  rut_list_for_each (child, &flow->children, link)
+    position_virtual_child (flow, child, &layout, &state);
+}
+
 static void
 flush_allocations (RutFlowLayout *flow)
 {
@@ -571,6 +918,12 @@ allocate_cb (RutObject *graphable,
   ReFlowState state;
   float length_ignore;
 
+  if (flow->item_cb)
+    {
+      allocate_virtual (flow);
+      flush_allocations (flow);
+      return;
+    }
 
   if (flow->n_children == 0)
     return;
@@ -623,6 +976,27 @@ rut_flow_layout_get_size (void *object,
   *height = flow->height;
 }
 
+/* Returns the preferred height (if @height is true) or width of a
+ * virtualised layout. Depending on the packing this is either the
+ * length across all of the lines or the length of a line */
+static float
+get_virtual_preferred_length (RutFlowLayout *flow,
+                              ReFlowState *state,
+                              bool height)
+{
+  VirtualLayout layout;
+  bool horizontal =
+    (flow->packing == RUT_FLOW_LAYOUT_PACKING_LEFT_TO_RIGHT ||
+     flow->packing == RUT_FLOW_LAYOUT_PACKING_RIGHT_TO_LEFT);
+
+  init_virtual_layout (&layout, flow, state);
+
+  if (horizontal == height)
+    return get_virtual_length (&layout, state);
+  else
+    return layout.line_length;
+}
+
 static void
 rut_flow_layout_get_preferred_height (void *sizable,
                                       float for_width,
@@ -634,7 +1008,11 @@ rut_flow_layout_get_preferred_height (void *sizable,
   float length;
 
   init_reflow_state (&state, flow, for_width, -1);
-  reflow (flow, &state, &length);
+
+  if (flow->item_cb)
+    length = get_virtual_preferred_length (flow, &state, true);
+  else
+    reflow (flow, &state, &length);
 
   length = floorf (length + 0.5f);
 
@@ -655,7 +1033,11 @@ rut_flow_layout_get_preferred_width (void *sizable,
   float length;
 
   init_reflow_state (&state, flow, -1, for_height);
-  reflow (flow, &state, &length);
+
+  if (flow->item_cb)
+    length = get_virtual_preferred_length (flow, &state, false);
+  else
+    reflow (flow, &state, &length);
 
   if (min_width_p)
     *min_width_p = length;
@@ -751,6 +1133,7 @@ rut_flow_layout_new (RutContext *ctx,
 
   rut_list_init (&flow->preferred_size_cb_list);
   rut_list_init (&flow->children);
+  rut_list_init (&flow->pool);
 
   rut_graphable_init (flow);
 
@@ -767,6 +1150,8 @@ rut_flow_layout_new (RutContext *ctx,
   flow->min_child_width = flow->min_child_height = 0;
   flow->max_child_width = flow->max_child_height = -1;
 
+  flow->visible_width = flow->visible_height = -1;
+
   flow->needs_reflow = TRUE;
   queue_allocation (flow);
 
@@ -799,6 +1184,8 @@ rut_flow_layout_add (RutFlowLayout *flow,
 {
   RutFlowLayoutChild *child = g_slice_new (RutFlowLayoutChild);
 
+  g_return_if_fail (flow->item_cb == NULL);
+
   child->transform = rut_transform_new (flow->ctx);
   rut_graphable_add_child (flow, child->transform);
   rut_refable_unref (child->transform);
@@ -993,3 +1380,113 @@ rut_flow_layout_get_max_child_height (RutFlowLayout *flow)
 {
   return flow->max_child_height;
 }
+
+void
+rut_flow_layout_set_data_source (RutFlowLayout *flow,
+                                 int item_width,
+                                 int item_height,
+                                 RutFlowLayoutItemCallback callback,
+                                 void *user_data)
+{
+  g_return_if_fail (callback != NULL);
+  g_return_if_fail (flow->item_cb != NULL || flow->n_children == 0);
+
+  flow->item_cb = callback;
+  flow->item_data = user_data;
+  flow->item_width = item_width;
+  flow->item_height = item_height;
+
+  rut_flow_layout_items_changed (flow);
+
+  preferred_size_changed (flow);
+}
+
+void
+rut_flow_layout_set_n_items (RutFlowLayout *flow,
+                             int n_items)
+{
+  g_return_if_fail (flow->item_cb != NULL);
+
+  if (flow->n_items == n_items)
+    return;
+
+  flow->n_items = n_items;
+
+  queue_allocation (flow);
+  preferred_size_changed (flow);
+}
+
+int
+rut_flow_layout_get_n_items (RutFlowLayout *flow)
+{
+  return flow->n_items;
+}
+
+void
+rut_flow_layout_items_changed (RutFlowLayout *flow)
+{
+  flow->items_dirty = TRUE;
+  queue_allocation (flow);
+}
+
+void
+rut_flow_layout_set_visible_region (RutFlowLayout *flow,
+                                    float x,
+                                    float y,
+                                    float width,
+                                    float height)
+{
+  flow->visible_x = x;
+  flow->visible_y = y;
+  flow->visible_width = width;
+  flow->visible_height = height;
+
+  if (flow->item_cb)
+    queue_allocation (flow);
+}
+
+static void
+viewport_changed_cb (RutProperty *property, void *user_data)
+{
+  RutFlowLayout *flow = user_data;
+
+  /* NB: the visible region is recalculated while allocating */
+  queue_allocation (flow);
+}
+
+void
+rut_flow_layout_set_viewport (RutFlowLayout *flow,
+                              RutUIViewport *viewport)
+{
+  static const char *property_names[] = {
+      "doc-x", "doc-y", "width", "height"
+  };
+  int i;
+
+  if (flow->viewport == viewport)
+    return;
+
+  if (flow->viewport)
+    {
+      for (i = 0; i < G_N_ELEMENTS (flow->viewport_closures); i++)
+        rut_property_closure_destroy (flow->viewport_closures[i]);
+    }
+
+  flow->viewport = viewport;
+
+  if (viewport)
+    {
+      for (i = 0; i < G_N_ELEMENTS (flow->viewport_closures); i++)
+        {
+          RutProperty *property =
+            rut_introspectable_lookup_property (viewport, property_names[i]);
+
+          flow->viewport_closures[i] =
+            rut_property_connect_callback (property,
+                                           viewport_changed_cb,
+                                           flow);
+        }
+    }
+
+  queue_allocation (flow);
+}
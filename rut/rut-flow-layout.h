@@ -28,6 +28,7 @@
 
 #include "rut-type.h"
 #include "rut-object.h"
+#include "rut-ui-viewport.h"
 
 G_BEGIN_DECLS
 
@@ -300,6 +301,111 @@ rut_flow_layout_set_max_child_height (RutFlowLayout *flow,
 int
 rut_flow_layout_get_max_child_height (RutFlowLayout *flow);
 
+/**
+ * RutFlowLayoutItemCallback:
+ * @flow: a #RutFlowLayout
+ * @index: the index of the item that needs a widget
+ * @recycle_widget: a widget that was previously returned for another
+ *                  item and is no longer visible, or %NULL
+ * @user_data: the private data given to rut_flow_layout_set_data_source()
+ *
+ * Used by a virtualised #RutFlowLayout to request a widget for the
+ * item at @index. To avoid creating a new widget the callback can
+ * update @recycle_widget to represent the item and return that
+ * instead.
+ *
+ * Return value: a new reference to the widget for the item
+ */
+typedef RutObject *(*RutFlowLayoutItemCallback) (RutFlowLayout *flow,
+                                                 int index,
+                                                 RutObject *recycle_widget,
+                                                 void *user_data);
+
+/**
+ * rut_flow_layout_set_data_source:
+ * @flow: a #RutFlowLayout
+ * @item_width: the width of every item
+ * @item_height: the height of every item
+ * @callback: the callback used to get the widget for an item
+ * @user_data: private data to pass to @callback
+ *
+ * Switches @flow into a virtualised mode where instead of adding
+ * children with rut_flow_layout_add() the layout has a number of
+ * items, set with rut_flow_layout_set_n_items(), of a fixed size.
+ * Widgets are only requested via @callback for the items that
+ * intersect the visible region of the layout (plus a margin) and
+ * widgets for items that scroll out of view are recycled.
+ *
+ * Since every item has the same size the extent of the layout can
+ * be calculated without creating any widgets.
+ */
+void
+rut_flow_layout_set_data_source (RutFlowLayout *flow,
+                                 int item_width,
+                                 int item_height,
+                                 RutFlowLayoutItemCallback callback,
+                                 void *user_data);
+
+/**
+ * rut_flow_layout_set_n_items:
+ * @flow: a virtualised #RutFlowLayout
+ * @n_items: the number of items
+ *
+ * Sets the number of items in a virtualised flow layout.
+ */
+void
+rut_flow_layout_set_n_items (RutFlowLayout *flow,
+                             int n_items);
+
+int
+rut_flow_layout_get_n_items (RutFlowLayout *flow);
+
+/**
+ * rut_flow_layout_items_changed:
+ * @flow: a virtualised #RutFlowLayout
+ *
+ * Notifies @flow that the items may have changed so that the widgets
+ * for all visible items will be requested again. Since the previous
+ * widget for each item is passed as the widget to recycle the
+ * callback can cheaply return the same widget for unchanged items.
+ */
+void
+rut_flow_layout_items_changed (RutFlowLayout *flow);
+
+/**
+ * rut_flow_layout_set_visible_region:
+ * @flow: a virtualised #RutFlowLayout
+ * @x: the x position of the visible region
+ * @y: the y position of the visible region
+ * @width: the width of the visible region, or -1 if all items are
+ *         visible
+ * @height: the height of the visible region
+ *
+ * Sets the region of the layout, in the layout's coordinate space,
+ * that is visible. Widgets are only requested for items that
+ * intersect this region.
+ */
+void
+rut_flow_layout_set_visible_region (RutFlowLayout *flow,
+                                    float x,
+                                    float y,
+                                    float width,
+                                    float height);
+
+/**
+ * rut_flow_layout_set_viewport:
+ * @flow: a virtualised #RutFlowLayout
+ * @viewport: a #RutUIViewport that is an ancestor of @flow, or %NULL
+ *
+ * Automatically updates the visible region of @flow whenever
+ * @viewport is scrolled or resized. No reference is taken on
+ * @viewport so it must be unset if the viewport is destroyed before
+ * @flow.
+ */
+void
+rut_flow_layout_set_viewport (RutFlowLayout *flow,
+                              RutUIViewport *viewport);
+
 G_END_DECLS
 
 #endif /* __RUT_FLOW_LAYOUT_H__ */
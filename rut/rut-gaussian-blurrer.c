@@ -28,15 +28,25 @@
 /*
  * RutGaussianBlur
  *
- * What would make sense if you want to animate the bluriness is to give
- * sigma to _init() and compute the number of taps based on that (as
- * discussed with Neil)
+ * The blur is separable so it's done in an x pass followed by a y
+ * pass. Each pass relies on linear filtering to fetch two texels of
+ * the kernel at once: sampling between texels a and b at
  *
- * Being lazy and having already written the code with th number of taps
- * as input, I'll stick with the number of taps, let's say it's because you
- * get a good idea of the performance of the shader this way.
+ *   (a * w(a) + b * w(b)) / (w(a) + w(b))
+ *
+ * and scaling by w(a) + w(b) gives the same result as two separate
+ * fetches, see:
+ *
+ *   http://rastergrid.com/blog/2010/09/efficient-gaussian-blur-with-linear-sampling/
+ *
+ * The size of the kernel grows with sigma so, to keep the cost of wide
+ * blurs down, the source is repeatedly halved until the remaining
+ * sigma is small enough, blurred and then scaled back up.
  */
 
+/* The largest sigma we blur with before halving the source again */
+#define MAX_LEVEL_SIGMA 3.0f
+
 static float
 gaussian (float sigma, float x)
 {
@@ -53,8 +63,146 @@ n_taps_to_sigma (int n_taps)
   return sigma[n_taps / 2 - 2];
 }
 
+static int
+sigma_to_radius (float sigma)
+{
+  int radius;
+
+  if (sigma <= 0)
+    return 0;
+
+  /* Beyond 3 sigma the weights are negligible */
+  radius = ceilf (sigma * 3.0f);
+
+  return CLAMP (radius, 1, (RUT_GAUSSIAN_BLUR_MAX_SAMPLES - 1) * 2);
+}
+
+/* Fills in the normalized weights of texels 0 to radius of the
+ * discrete kernel. Only one side is computed since it's symmetric. */
+static int
+compute_discrete_weights (float sigma, float *weights)
+{
+  int radius = sigma_to_radius (sigma);
+  float sum;
+  int i;
+
+  if (radius == 0)
+    {
+      weights[0] = 1;
+      return 0;
+    }
+
+  sum = 0;
+  for (i = 0; i <= radius; i++)
+    {
+      weights[i] = gaussian (sigma, i);
+      sum += i == 0 ? weights[i] : weights[i] * 2;
+    }
+
+  /* So that we don't loose any brightness when blurring, we
+   * normalized the factors... */
+  for (i = 0; i <= radius; i++)
+    weights[i] /= sum;
+
+  return radius;
+}
+
+int
+rut_gaussian_blur_compute_kernel (float sigma,
+                                  float *weights,
+                                  float *offsets)
+{
+  float discrete[RUT_GAUSSIAN_BLUR_MAX_SAMPLES * 2];
+  int radius = compute_discrete_weights (sigma, discrete);
+  int n_samples = 1;
+  int i;
+
+  weights[0] = discrete[0];
+  offsets[0] = 0;
+
+  for (i = 1; i <= radius; i += 2)
+    {
+      float weight_a = discrete[i];
+      float weight_b = i + 1 <= radius ? discrete[i + 1] : 0;
+      float weight = weight_a + weight_b;
+
+      weights[n_samples] = weight;
+      offsets[n_samples] = (i * weight_a + (i + 1) * weight_b) / weight;
+      n_samples++;
+    }
+
+  return n_samples;
+}
+
+static float
+clamped_texel (const float *src, int len, int x)
+{
+  return src[CLAMP (x, 0, len - 1)];
+}
+
+void
+rut_gaussian_blur_reference (float sigma,
+                             const float *src,
+                             float *dst,
+                             int len)
+{
+  float discrete[RUT_GAUSSIAN_BLUR_MAX_SAMPLES * 2];
+  int radius = compute_discrete_weights (sigma, discrete);
+  int x, i;
+
+  for (x = 0; x < len; x++)
+    {
+      float value = src[x] * discrete[0];
+
+      for (i = 1; i <= radius; i++)
+        {
+          value += (clamped_texel (src, len, x - i) +
+                    clamped_texel (src, len, x + i)) * discrete[i];
+        }
+
+      dst[x] = value;
+    }
+}
+
+/* Emulates a texture2D() lookup on a 1D texture with linear filtering,
+ * where @pos is in texels relative to the center of texel 0 */
+static float
+sample_linear (const float *src, int len, float pos)
+{
+  float floor_pos = floorf (pos);
+  float t = pos - floor_pos;
+  int x = floor_pos;
+
+  return (clamped_texel (src, len, x) * (1 - t) +
+          clamped_texel (src, len, x + 1) * t);
+}
+
+void
+rut_gaussian_blur_kernel_reference (const float *weights,
+                                    const float *offsets,
+                                    int n_samples,
+                                    const float *src,
+                                    float *dst,
+                                    int len)
+{
+  int x, i;
+
+  for (x = 0; x < len; x++)
+    {
+      float value = sample_linear (src, len, x) * weights[0];
+
+      for (i = 1; i < n_samples; i++)
+        {
+          value += (sample_linear (src, len, x - offsets[i]) +
+                    sample_linear (src, len, x + offsets[i])) * weights[i];
+        }
+
+      dst[x] = value;
+    }
+}
+
 static CoglPipeline *
-create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_taps)
+create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_samples)
 {
   static GHashTable *pipeline_cache = NULL;
   CoglPipeline *pipeline;
@@ -64,8 +212,8 @@ create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_taps)
   int i;
 
   /* initialize the pipeline cache. The shaders are only dependent on the
-   * number of taps, not the sigma, so we cache the corresponding pipelines
-   * in a hash table 'n_taps' => 'pipeline' */
+   * number of samples, not the sigma, so we cache the corresponding
+   * pipelines in a hash table 'n_samples' => 'pipeline' */
   if (G_UNLIKELY (pipeline_cache == NULL))
     {
       pipeline_cache =
@@ -75,7 +223,7 @@ create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_taps)
                                (GDestroyNotify) cogl_object_unref);
     }
 
-  pipeline = g_hash_table_lookup (pipeline_cache, GINT_TO_POINTER (n_taps));
+  pipeline = g_hash_table_lookup (pipeline_cache, GINT_TO_POINTER (n_samples));
   if (pipeline)
     return cogl_object_ref (pipeline);
 
@@ -83,8 +231,10 @@ create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_taps)
 
   g_string_append_printf (shader,
                           "uniform vec2 pixel_step;\n"
-                          "uniform float factors[%i];\n",
-                          n_taps);
+                          "uniform float weights[%i];\n"
+                          "uniform float offsets[%i];\n",
+                          n_samples,
+                          n_samples);
 
   snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
                               shader->str,
@@ -99,30 +249,26 @@ create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_taps)
   cogl_pipeline_set_layer_wrap_mode (pipeline,
                                      0, /* layer_num */
                                      COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
+  /* The offsets depend on linear filtering to blend neighbouring
+   * texels together */
   cogl_pipeline_set_layer_filters (pipeline,
                                    0, /* layer_num */
-                                   COGL_PIPELINE_FILTER_NEAREST,
-                                   COGL_PIPELINE_FILTER_NEAREST);
+                                   COGL_PIPELINE_FILTER_LINEAR,
+                                   COGL_PIPELINE_FILTER_LINEAR);
 
-  for (i = 0; i < n_taps; i++)
-    {
-      g_string_append (shader, "cogl_texel ");
-
-      if (i == 0)
-        g_string_append (shader, "=");
-      else
-        g_string_append (shader, "+=");
+  g_string_append (shader,
+                   "cogl_texel = texture2D (cogl_sampler, "
+                   "cogl_tex_coord.st) * weights[0];\n");
 
+  for (i = 1; i < n_samples; i++)
+    {
       g_string_append_printf (shader,
-                              " texture2D (cogl_sampler, "
-                              "cogl_tex_coord.st");
-      if (i != (n_taps - 1) / 2)
-        g_string_append_printf (shader,
-                                " + pixel_step * %f",
-                                (float) (i - ((n_taps - 1) / 2)));
-      g_string_append_printf (shader,
-                              ") * factors[%i];\n",
-                              i);
+                              "cogl_texel += (texture2D (cogl_sampler, "
+                              "cogl_tex_coord.st - pixel_step * offsets[%i]) + "
+                              "texture2D (cogl_sampler, "
+                              "cogl_tex_coord.st + pixel_step * offsets[%i])) "
+                              "* weights[%i];\n",
+                              i, i, i);
     }
 
   cogl_snippet_set_replace (snippet, shader->str);
@@ -140,44 +286,32 @@ create_1d_gaussian_blur_pipeline (RutContext *ctx, int n_taps)
   cogl_depth_state_set_test_enabled (&depth_state, FALSE);
   cogl_pipeline_set_depth_state (pipeline, &depth_state, NULL);
 
-  g_hash_table_insert (pipeline_cache, GINT_TO_POINTER (n_taps), pipeline);
+  g_hash_table_insert (pipeline_cache, GINT_TO_POINTER (n_samples), pipeline);
 
-  return pipeline;
+  return cogl_object_ref (pipeline);
 }
 
 static void
-set_blurrer_pipeline_factors (CoglPipeline *pipeline, int n_taps)
+set_blurrer_pipeline_kernel (CoglPipeline *pipeline,
+                             int n_samples,
+                             const float *weights,
+                             const float *offsets)
 {
-  int i, radius;
-  float *factors, sigma;
   int location;
-  float sum;
-  float scale;
 
-  radius = n_taps / 2; /* which is (n_taps - 1) / 2 as well */
-
-  factors = g_alloca (n_taps * sizeof (float));
-  sigma = n_taps_to_sigma (n_taps);
-
-  sum = 0;
-  for (i = -radius; i <= radius; i++)
-    {
-      factors[i + radius] = gaussian (sigma, i);
-      sum += factors[i + radius];
-    }
-
-  /* So that we don't loose any brightness when blurring, we
-   * normalized the factors... */
-  scale = 1.0 / sum;
-  for (i = -radius; i <= radius; i++)
-    factors[i + radius] *= scale;
+  location = cogl_pipeline_get_uniform_location (pipeline, "weights");
+  cogl_pipeline_set_uniform_float (pipeline,
+                                   location,
+                                   1 /* n_components */,
+                                   n_samples /* count */,
+                                   weights);
 
-  location = cogl_pipeline_get_uniform_location (pipeline, "factors");
+  location = cogl_pipeline_get_uniform_location (pipeline, "offsets");
   cogl_pipeline_set_uniform_float (pipeline,
                                    location,
                                    1 /* n_components */,
-                                   n_taps /* count */,
-                                   factors);
+                                   n_samples /* count */,
+                                   offsets);
 }
 
 static void
@@ -206,12 +340,71 @@ set_blurrer_pipeline_texture (CoglPipeline *pipeline,
                                    pixel_step);
 }
 
+static void
+update_blurrer_kernel (RutGaussianBlurrer *blurrer,
+                       int n_levels)
+{
+  float weights[RUT_GAUSSIAN_BLUR_MAX_SAMPLES];
+  float offsets[RUT_GAUSSIAN_BLUR_MAX_SAMPLES];
+  float scale = 1 << n_levels;
+  float variance;
+  float level_sigma;
+  int n_samples;
+
+  /* Halving with linear filtering averages 2x2 texels so the levels
+   * together act as a box filter of width 'scale', which already
+   * accounts for a variance of (scale² - 1) / 12 */
+  variance = (blurrer->sigma * blurrer->sigma -
+              (scale * scale - 1) / 12.0f);
+  level_sigma = sqrtf (MAX (variance, 0)) / scale;
+
+  if (blurrer->x_pass_pipeline &&
+      blurrer->n_levels == n_levels &&
+      blurrer->level_sigma == level_sigma)
+    return;
+
+  n_samples = rut_gaussian_blur_compute_kernel (level_sigma, weights, offsets);
+
+  if (blurrer->n_samples != n_samples || !blurrer->x_pass_pipeline)
+    {
+      CoglPipeline *base_pipeline =
+        create_1d_gaussian_blur_pipeline (blurrer->ctx, n_samples);
+
+      if (blurrer->x_pass_pipeline)
+        cogl_object_unref (blurrer->x_pass_pipeline);
+      if (blurrer->y_pass_pipeline)
+        cogl_object_unref (blurrer->y_pass_pipeline);
+
+      blurrer->x_pass_pipeline = cogl_pipeline_copy (base_pipeline);
+      blurrer->y_pass_pipeline = cogl_pipeline_copy (base_pipeline);
+
+      cogl_object_unref (base_pipeline);
+    }
+
+  set_blurrer_pipeline_kernel (blurrer->x_pass_pipeline,
+                               n_samples, weights, offsets);
+  set_blurrer_pipeline_kernel (blurrer->y_pass_pipeline,
+                               n_samples, weights, offsets);
+
+  blurrer->n_levels = n_levels;
+  blurrer->level_sigma = level_sigma;
+  blurrer->n_samples = n_samples;
+}
+
 RutGaussianBlurrer *
-rut_gaussian_blurrer_new (RutContext *ctx, int n_taps)
+rut_gaussian_blurrer_new_for_sigma (RutContext *ctx, float sigma)
 {
   RutGaussianBlurrer *blurrer = g_slice_new0 (RutGaussianBlurrer);
-  CoglPipeline *base_pipeline;
 
+  blurrer->ctx = ctx;
+  blurrer->sigma = MAX (sigma, 0);
+
+  return blurrer;
+}
+
+RutGaussianBlurrer *
+rut_gaussian_blurrer_new (RutContext *ctx, int n_taps)
+{
   /* validation */
   if (n_taps < 5 || n_taps > 17 || n_taps % 2 == 0 )
     {
@@ -221,141 +414,219 @@ rut_gaussian_blurrer_new (RutContext *ctx, int n_taps)
       return NULL;
     }
 
-  blurrer->ctx = ctx;
-  blurrer->n_taps = n_taps;
-
-  base_pipeline = create_1d_gaussian_blur_pipeline (ctx, n_taps);
-
-  blurrer->x_pass_pipeline = cogl_pipeline_copy (base_pipeline);
-  set_blurrer_pipeline_factors (blurrer->x_pass_pipeline, n_taps);
-  blurrer->y_pass_pipeline = cogl_pipeline_copy (base_pipeline);
-  set_blurrer_pipeline_factors (blurrer->x_pass_pipeline, n_taps);
-
-  cogl_object_unref (base_pipeline);
+  return rut_gaussian_blurrer_new_for_sigma (ctx, n_taps_to_sigma (n_taps));
+}
 
-  return blurrer;
+void
+rut_gaussian_blurrer_set_sigma (RutGaussianBlurrer *blurrer, float sigma)
+{
+  /* The kernel is updated lazily on the next blur since the number of
+   * levels also depends on the size of the source */
+  blurrer->sigma = MAX (sigma, 0);
 }
 
-static void
-_rut_gaussian_blurrer_free_buffers (RutGaussianBlurrer *blurrer)
+float
+rut_gaussian_blurrer_get_sigma (RutGaussianBlurrer *blurrer)
 {
-  if (blurrer->x_pass)
-    {
-      cogl_object_unref (blurrer->x_pass);
-      blurrer->x_pass = NULL;
-    }
-  if (blurrer->x_pass_fb)
-    {
-      cogl_object_unref (blurrer->x_pass_fb);
-      blurrer->x_pass_fb = NULL;
-    }
+  return blurrer->sigma;
+}
 
-  if (blurrer->y_pass)
-    {
-      cogl_object_unref (blurrer->y_pass);
-      blurrer->y_pass = NULL;
-    }
-  if (blurrer->y_pass_fb)
+void
+rut_gaussian_blurrer_release (RutGaussianBlurrer *blurrer)
+{
+  if (blurrer->result)
     {
-      cogl_object_unref (blurrer->y_pass_fb);
-      blurrer->y_pass_fb = NULL;
+      rut_render_target_release (blurrer->result);
+      blurrer->result = NULL;
     }
 }
 
 void
 rut_gaussian_blurrer_free (RutGaussianBlurrer *blurrer)
 {
-  _rut_gaussian_blurrer_free_buffers (blurrer);
+  int i;
+
+  rut_gaussian_blurrer_release (blurrer);
+
+  for (i = 0; i < RUT_GAUSSIAN_BLUR_MAX_LEVELS; i++)
+    {
+      if (blurrer->downsamplers[i])
+        rut_downsampler_free (blurrer->downsamplers[i]);
+    }
+
+  if (blurrer->x_pass_pipeline)
+    cogl_object_unref (blurrer->x_pass_pipeline);
+  if (blurrer->y_pass_pipeline)
+    cogl_object_unref (blurrer->y_pass_pipeline);
+  if (blurrer->upsample_pipeline)
+    cogl_object_unref (blurrer->upsample_pipeline);
+
   g_slice_free (RutGaussianBlurrer, blurrer);
 }
 
+/* Picks how many times to halve the source so that the remaining blur
+ * is small. The downsampler rounds odd sizes up by repeating the edge
+ * so the size of the source doesn't matter. */
+static int
+choose_n_levels (RutGaussianBlurrer *blurrer)
+{
+  int n_levels = 0;
+
+  while (n_levels < RUT_GAUSSIAN_BLUR_MAX_LEVELS &&
+         blurrer->sigma / (1 << n_levels) > MAX_LEVEL_SIGMA)
+    n_levels++;
+
+  return n_levels;
+}
+
+/* The targets are shared with other passes which may have left any
+ * transform on them */
+static RutRenderTarget *
+acquire_pass_target (RutGaussianBlurrer *blurrer,
+                     int width,
+                     int height,
+                     CoglTextureComponents components)
+{
+  RutRenderTarget *target =
+    rut_render_target_acquire (blurrer->ctx, width, height, components,
+                               0 /* flags */);
+  CoglFramebuffer *fb = rut_render_target_get_framebuffer (target);
+
+  cogl_framebuffer_set_viewport (fb, 0, 0, width, height);
+  cogl_framebuffer_orthographic (fb, 0, 0, width, height, -1, 100);
+  cogl_framebuffer_identity_matrix (fb);
+
+  return target;
+}
+
 CoglTexture *
 rut_gaussian_blurrer_blur (RutGaussianBlurrer *blurrer,
                            CoglTexture *source)
 {
   int src_w, src_h;
+  int level_w, level_h;
   CoglTextureComponents components;
-  CoglOffscreen *offscreen;
+  CoglTexture *level_source;
+  RutRenderTarget *x_pass, *y_pass, *destination;
+  CoglFramebuffer *fb;
+  int n_levels;
+  int i;
+
+  rut_gaussian_blurrer_release (blurrer);
 
-  /* create the first FBO to render the x pass */
   src_w = cogl_texture_get_width (source);
   src_h = cogl_texture_get_height (source);
   components = cogl_texture_get_components (source);
 
-  if (blurrer->width != src_w ||
-      blurrer->height != src_h ||
-      blurrer->components != components)
-    {
-      _rut_gaussian_blurrer_free_buffers (blurrer);
-    }
+  n_levels = choose_n_levels (blurrer);
+
+  update_blurrer_kernel (blurrer, n_levels);
 
-  if (!blurrer->x_pass)
+  /* downsample pyramid. Each level is given back to the pool as soon
+   * as the next one has been drawn from it. */
+  level_source = cogl_object_ref (source);
+  for (i = 0; i < n_levels; i++)
     {
-      CoglError *error = NULL;
-      CoglTexture2D *texture_2d =
-        cogl_texture_2d_new_with_size (blurrer->ctx->cogl_context,
-                                       src_w, src_h);
+      CoglTexture *downsampled;
 
-      cogl_texture_set_components (texture_2d, components);
+      if (!blurrer->downsamplers[i])
+        blurrer->downsamplers[i] = rut_downsampler_new (blurrer->ctx);
 
-      cogl_texture_allocate (texture_2d, &error);
-      if (error)
-        {
-          g_warning ("blurrer: could not create x pass texture: %s",
-                     error->message);
-        }
-      blurrer->x_pass = texture_2d;
-      blurrer->width = src_w;
-      blurrer->height = src_h;
-      blurrer->components = components;
-
-      offscreen = cogl_offscreen_new_with_texture (blurrer->x_pass);
-      blurrer->x_pass_fb = offscreen;
-      cogl_framebuffer_orthographic (blurrer->x_pass_fb,
-                                     0, 0, src_w, src_h, -1, 100);
+      downsampled = rut_downsampler_downsample (blurrer->downsamplers[i],
+                                                level_source, 2, 2);
+      cogl_object_unref (level_source);
+      if (i > 0)
+        rut_downsampler_release (blurrer->downsamplers[i - 1]);
+
+      level_source = downsampled;
     }
 
-  if (!blurrer->y_pass)
-    {
-      /* create the second FBO (final destination) to render the y pass */
-      CoglTexture2D *texture_2d =
-        cogl_texture_2d_new_with_size (blurrer->ctx->cogl_context,
-                                       src_w,
-                                       src_h);
+  level_w = cogl_texture_get_width (level_source);
+  level_h = cogl_texture_get_height (level_source);
+
+  x_pass = acquire_pass_target (blurrer, level_w, level_h, components);
 
-      cogl_texture_set_components (texture_2d, components);
+  set_blurrer_pipeline_texture (blurrer->x_pass_pipeline,
+                                level_source, 1.0f / level_w, 0);
 
-      blurrer->destination = texture_2d;
-      blurrer->y_pass = blurrer->destination;
+  fb = rut_render_target_get_framebuffer (x_pass);
+  rut_render_target_draw_rectangle (fb,
+                                    blurrer->x_pass_pipeline,
+                                    0,
+                                    0,
+                                    level_w,
+                                    level_h);
 
-      offscreen = cogl_offscreen_new_with_texture (blurrer->destination);
-      blurrer->y_pass_fb = offscreen;
-      cogl_framebuffer_orthographic (blurrer->y_pass_fb,
-                                     0, 0, src_w, src_h, -1, 100);
-    }
+  cogl_object_unref (level_source);
+  if (n_levels > 0)
+    rut_downsampler_release (blurrer->downsamplers[n_levels - 1]);
+
+  y_pass = acquire_pass_target (blurrer, level_w, level_h, components);
 
-  set_blurrer_pipeline_texture (blurrer->x_pass_pipeline,
-                                source, 1.0f / src_w, 0);
   set_blurrer_pipeline_texture (blurrer->y_pass_pipeline,
-                                blurrer->x_pass, 0, 1.0f / src_h);
-
-  /* x pass */
-  cogl_framebuffer_draw_rectangle (blurrer->x_pass_fb,
-                                   blurrer->x_pass_pipeline,
-                                   0,
-                                   0,
-                                   blurrer->width,
-                                   blurrer->height);
-
-  /* y pass */
-  cogl_framebuffer_draw_rectangle (blurrer->y_pass_fb,
-                                   blurrer->y_pass_pipeline,
-                                   0,
-                                   0,
-                                   blurrer->width,
-                                   blurrer->height);
-
-  return cogl_object_ref (blurrer->destination);
-}
+                                rut_render_target_get_texture (x_pass),
+                                0, 1.0f / level_h);
 
+  fb = rut_render_target_get_framebuffer (y_pass);
+  rut_render_target_draw_rectangle (fb,
+                                    blurrer->y_pass_pipeline,
+                                    0,
+                                    0,
+                                    level_w,
+                                    level_h);
 
+  rut_render_target_release (x_pass);
+
+  if (n_levels == 0)
+    {
+      blurrer->result = y_pass;
+      return cogl_object_ref (rut_render_target_get_texture (y_pass));
+    }
+
+  /* upsample back to the size of the source */
+  if (!blurrer->upsample_pipeline)
+    {
+      CoglPipeline *pipeline = cogl_pipeline_new (blurrer->ctx->cogl_context);
+
+      cogl_pipeline_set_layer_null_texture (pipeline,
+                                            0, /* layer_num */
+                                            COGL_TEXTURE_TYPE_2D);
+      cogl_pipeline_set_layer_wrap_mode (pipeline,
+                                         0, /* layer_num */
+                                         COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
+      cogl_pipeline_set_layer_filters (pipeline,
+                                       0, /* layer_num */
+                                       COGL_PIPELINE_FILTER_LINEAR,
+                                       COGL_PIPELINE_FILTER_LINEAR);
+      cogl_pipeline_set_blend (pipeline, "RGBA=ADD(SRC_COLOR, 0)", NULL);
+
+      blurrer->upsample_pipeline = pipeline;
+    }
+
+  destination = acquire_pass_target (blurrer, src_w, src_h, components);
+
+  cogl_pipeline_set_layer_texture (blurrer->upsample_pipeline,
+                                   0, /* layer_num */
+                                   rut_render_target_get_texture (y_pass));
+
+  /* The last level may have been padded past the edges of the source
+   * so only the part that covers the source is drawn */
+  fb = rut_render_target_get_framebuffer (destination);
+  rut_render_target_draw_textured_rectangle (fb,
+                                             blurrer->upsample_pipeline,
+                                             0,
+                                             0,
+                                             src_w,
+                                             src_h,
+                                             0,
+                                             0,
+                                             (float) src_w /
+                                             (level_w << n_levels),
+                                             (float) src_h /
+                                             (level_h << n_levels));
+
+  rut_render_target_release (y_pass);
+
+  blurrer->result = destination;
+  return cogl_object_ref (rut_render_target_get_texture (destination));
+}
@@ -25,34 +25,108 @@
 
 #include "rut-context.h"
 #include "rut-camera-private.h"
+#include "rut-downsampler.h"
+#include "rut-render-target.h"
+
+/* The maximum number of samples taken on each side of a 1D pass
+ * including the center sample. Each sample other than the center one
+ * is a bilinear fetch that covers two texels of the kernel. */
+#define RUT_GAUSSIAN_BLUR_MAX_SAMPLES 16
+
+/* The maximum number of times the source is halved before blurring */
+#define RUT_GAUSSIAN_BLUR_MAX_LEVELS 4
 
 typedef struct _RutGaussianBlurrer
 {
   RutContext *ctx;
 
-  int n_taps;
+  float sigma;
 
-  int width, height;
-  CoglTextureComponents components;
+  /* The kernel currently set on the pass pipelines, derived from
+   * sigma and the number of levels */
+  int n_levels;
+  float level_sigma;
+  int n_samples;
 
-  CoglFramebuffer *x_pass_fb;
-  CoglTexture *x_pass;
-  CoglPipeline *x_pass_pipeline;
+  RutDownsampler *downsamplers[RUT_GAUSSIAN_BLUR_MAX_LEVELS];
 
-  CoglFramebuffer *y_pass_fb;
-  CoglTexture *y_pass;
-  CoglTexture *destination;
+  CoglPipeline *x_pass_pipeline;
   CoglPipeline *y_pass_pipeline;
+
+  /* Only used when the blur was done on a downsampled copy */
+  CoglPipeline *upsample_pipeline;
+
+  /* The render target holding the result of the last blur */
+  RutRenderTarget *result;
 } RutGaussianBlurrer;
 
+/* Creates a blurrer whose standard deviation is the one traditionally
+ * associated with a kernel of @n_taps taps which must be an odd
+ * number between 5 and 17 */
 RutGaussianBlurrer *
 rut_gaussian_blurrer_new (RutContext *ctx, int n_taps);
 
+RutGaussianBlurrer *
+rut_gaussian_blurrer_new_for_sigma (RutContext *ctx, float sigma);
+
 void
 rut_gaussian_blurrer_free (RutGaussianBlurrer *blurrer);
 
+/* The standard deviation is in pixels of the source texture. Blurs
+ * wider than a few pixels are done on a downsampled copy of the
+ * source so the cost stays roughly constant whatever the sigma. */
+void
+rut_gaussian_blurrer_set_sigma (RutGaussianBlurrer *blurrer, float sigma);
+
+float
+rut_gaussian_blurrer_get_sigma (RutGaussianBlurrer *blurrer);
+
+/* Returns a new reference to a texture with the same size as @source.
+ * The texture comes from the context's render target pool and it's
+ * kept until the next blur or until rut_gaussian_blurrer_release()
+ * is called. */
 CoglTexture *
 rut_gaussian_blurrer_blur (RutGaussianBlurrer *blurrer,
                            CoglTexture *source);
 
+/* Gives the result of the last blur back to the render target pool.
+ * The texture mustn't be used after this. */
+void
+rut_gaussian_blurrer_release (RutGaussianBlurrer *blurrer);
+
+/*
+ * The following functions don't need a GPU. They are used to build
+ * the shaders and can be used to check the shader weights against a
+ * straightforward implementation of the blur.
+ */
+
+/* Computes the samples of a 1D pass for @sigma, in texels, and returns
+ * how many there are. @weights and @offsets must have room for
+ * %RUT_GAUSSIAN_BLUR_MAX_SAMPLES floats. The first sample is the
+ * center texel and every other sample is fetched at both +offset and
+ * -offset with linear filtering. */
+int
+rut_gaussian_blur_compute_kernel (float sigma,
+                                  float *weights,
+                                  float *offsets);
+
+/* Blurs a row of @len values by sampling every texel of the truncated
+ * and normalized kernel for @sigma, clamping to the edges */
+void
+rut_gaussian_blur_reference (float sigma,
+                             const float *src,
+                             float *dst,
+                             int len);
+
+/* Blurs a row of @len values the way the shader does with the samples
+ * returned by rut_gaussian_blur_compute_kernel(), emulating linear
+ * filtering with clamp to edge wrapping */
+void
+rut_gaussian_blur_kernel_reference (const float *weights,
+                                    const float *offsets,
+                                    int n_samples,
+                                    const float *src,
+                                    float *dst,
+                                    int len);
+
 #endif /* __RUT_GAUSSIAN_BLURRER_H__ */
@@ -18,8 +18,20 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
 #include "rut-image-source.h"
 
+/* The number of decoded video samples that can be queued ahead of
+ * the sample waiting to be presented */
+#define VIDEO_QUEUE_SIZE 3
+
+/* Bounds on the estimated interval between painted frames */
+#define VIDEO_MIN_FRAME_INTERVAL (G_USEC_PER_SEC / 120)
+#define VIDEO_MAX_FRAME_INTERVAL (G_USEC_PER_SEC / 15)
+#define VIDEO_DEFAULT_FRAME_INTERVAL (G_USEC_PER_SEC / 60)
+
 struct _RutImageSource
 {
   RutObjectProps _parent;
@@ -27,6 +39,10 @@ struct _RutImageSource
 
   RutContext *ctx;
 
+  /* NB: for images the texture is owned by the asset and is only
+   * valid until the asset evicts it */
+  RutAsset *asset;
+  RutClosure *texture_evicted_closure;
   CoglTexture *texture;
 
   CoglGstVideoSink *sink;
@@ -34,11 +50,26 @@ struct _RutImageSource
   GstElement *bin;
   CoglBool is_video;
 
+  /* Decoding runs ahead into the appsink and the samples are only
+   * handed to the Cogl sink, via a separate presentation pipeline,
+   * when they are due according to our own frame clock. Samples that
+   * are superseded before they are due are dropped without ever
+   * being uploaded. */
+  GstElement *appsink;
+  GstElement *present_pipeline;
+  GstElement *appsrc;
+  GstSample *next_sample;
+  GstClockTime next_running_time;
+  RutList video_link;
+
+  RutVideoStats video_stats;
+
   int first_layer;
   bool default_sample;
 
   RutList changed_cb_list;
   RutList ready_cb_list;
+  RutList texture_evicted_cb_list;
 };
 
 typedef struct _ImageSourceWrappers
@@ -136,6 +167,16 @@ get_image_source_wrappers (RutContext *ctx, int layer_index)
   return wrappers;
 }
 
+static void
+drop_next_sample (RutImageSource *source)
+{
+  if (source->next_sample)
+    {
+      gst_sample_unref (source->next_sample);
+      source->next_sample = NULL;
+    }
+}
+
 static CoglBool
 _rut_image_source_video_loop (GstBus *bus,
                               GstMessage *msg,
@@ -145,6 +186,9 @@ _rut_image_source_video_loop (GstBus *bus,
   switch (GST_MESSAGE_TYPE(msg))
     {
       case GST_MESSAGE_EOS:
+        /* The running time restarts after a flushing seek so a
+         * sample from before the seek would never become due */
+        drop_next_sample (source);
         gst_element_seek (source->pipeline, 1.0, GST_FORMAT_TIME,
                           GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 0,
                           GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
@@ -158,11 +202,123 @@ _rut_image_source_video_loop (GstBus *bus,
 static void
 _rut_image_source_video_stop (RutImageSource *source)
 {
-  if (source->sink)
+  if (source->pipeline)
     {
       gst_element_set_state (source->pipeline, GST_STATE_NULL);
-      gst_object_unref (source->sink);
+      gst_element_set_state (source->present_pipeline, GST_STATE_NULL);
+
+      drop_next_sample (source);
+      rut_list_remove (&source->video_link);
+
+      gst_object_unref (source->pipeline);
+      gst_object_unref (source->present_pipeline);
+      source->pipeline = NULL;
+      source->present_pipeline = NULL;
+      source->sink = NULL;
+    }
+}
+
+static gboolean
+video_redraw_idle_cb (void *user_data)
+{
+  RutContext *ctx = user_data;
+
+  g_atomic_int_set (&ctx->video_redraw_queued, FALSE);
+  rut_shell_queue_redraw (ctx->shell);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_video_redraw (RutContext *ctx)
+{
+  /* Samples from any number of videos only result in one redraw
+   * being queued before the next frame is painted */
+  if (g_atomic_int_compare_and_exchange (&ctx->video_redraw_queued,
+                                         FALSE, TRUE))
+    g_idle_add (video_redraw_idle_cb, ctx);
+}
+
+/* NB: this is called in a GStreamer streaming thread */
+static GstFlowReturn
+appsink_new_sample_cb (GstAppSink *appsink,
+                       void *user_data)
+{
+  RutImageSource *source = user_data;
+
+  queue_video_redraw (source->ctx);
+
+  return GST_FLOW_OK;
+}
+
+/* Plays the video produced by @decoder and presents the samples with
+ * @present_sink. If @decoder has a "video-sink" property, such as
+ * playbin, then the appsink that the samples are scheduled from is
+ * set as its video sink, otherwise @decoder is linked to the appsink
+ * directly. The source takes ownership of both elements. */
+static void
+_rut_image_source_video_play_pipeline (RutImageSource *source,
+                                       GstElement *decoder,
+                                       GstElement *present_sink)
+{
+  RutContext *ctx = source->ctx;
+  GstAppSinkCallbacks appsink_callbacks = { NULL };
+  GstBus* bus;
+
+  /* The presenting sink shows whatever it is given straight away */
+  g_object_set (G_OBJECT (present_sink),
+                "sync", FALSE,
+                "qos", FALSE,
+                NULL);
+
+  source->present_pipeline = gst_pipeline_new ("presenter");
+  source->appsrc = gst_element_factory_make ("appsrc", NULL);
+  g_object_set (G_OBJECT (source->appsrc),
+                "format", GST_FORMAT_TIME,
+                "max-bytes", (guint64) 0,
+                NULL);
+  gst_bin_add_many (GST_BIN (source->present_pipeline),
+                    source->appsrc, present_sink, NULL);
+  gst_element_link (source->appsrc, present_sink);
+
+  /* NB: the appsink doesn't sync to the clock so that decoding can
+   * run ahead until the queue is full. Synchronization happens
+   * when presenting. */
+  source->appsink = gst_element_factory_make ("appsink", NULL);
+  g_object_set (G_OBJECT (source->appsink),
+                "sync", FALSE,
+                "max-buffers", VIDEO_QUEUE_SIZE,
+                "drop", FALSE,
+                NULL);
+  appsink_callbacks.new_sample = appsink_new_sample_cb;
+  gst_app_sink_set_callbacks (GST_APP_SINK (source->appsink),
+                              &appsink_callbacks, source, NULL);
+
+  source->pipeline = gst_pipeline_new ("renderer");
+  source->bin = decoder;
+  gst_bin_add (GST_BIN (source->pipeline), decoder);
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (decoder),
+                                    "video-sink"))
+    {
+      g_object_set (G_OBJECT (decoder), "video-sink",
+                    source->appsink, NULL);
     }
+  else
+    {
+      gst_bin_add (GST_BIN (source->pipeline), source->appsink);
+      gst_element_link (decoder, source->appsink);
+    }
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (source->pipeline));
+
+  rut_list_insert (&ctx->video_sources, &source->video_link);
+
+  gst_element_set_state (source->present_pipeline, GST_STATE_PLAYING);
+  gst_element_set_state (source->pipeline, GST_STATE_PLAYING);
+  gst_bus_add_watch (bus, _rut_image_source_video_loop, source);
+
+  gst_object_unref (bus);
 }
 
 static void
@@ -172,15 +328,15 @@ _rut_image_source_video_play (RutImageSource *source,
                               const uint8_t *data,
                               size_t len)
 {
-  GstBus* bus;
+  GstElement *bin;
   char *uri;
   char *filename = NULL;
 
   _rut_image_source_video_stop (source);
 
   source->sink = cogl_gst_video_sink_new (ctx->cogl_context);
-  source->pipeline = gst_pipeline_new ("renderer");
-  source->bin = gst_element_factory_make ("playbin", NULL);
+
+  bin = gst_element_factory_make ("playbin", NULL);
 
   if (data && len)
     uri = g_strdup_printf ("mem://%p:%lu", data, (unsigned long)len);
@@ -190,20 +346,179 @@ _rut_image_source_video_play (RutImageSource *source,
       uri = gst_filename_to_uri (filename, NULL);
     }
 
-  g_object_set (G_OBJECT (source->bin), "video-sink",
-                GST_ELEMENT (source->sink), NULL);
-  g_object_set (G_OBJECT (source->bin), "uri", uri, NULL);
-  gst_bin_add (GST_BIN (source->pipeline), source->bin);
+  g_object_set (G_OBJECT (bin), "uri", uri, NULL);
 
-  bus = gst_pipeline_get_bus (GST_PIPELINE (source->pipeline));
-
-  gst_element_set_state (source->pipeline, GST_STATE_PLAYING);
-  gst_bus_add_watch (bus, _rut_image_source_video_loop, source);
+  _rut_image_source_video_play_pipeline (source, bin,
+                                         GST_ELEMENT (source->sink));
 
   g_free (uri);
   if (filename)
     g_free (filename);
-  gst_object_unref (bus);
+}
+
+static GstClockTime
+get_sample_running_time (GstSample *sample)
+{
+  GstBuffer *buffer = gst_sample_get_buffer (sample);
+  GstSegment *segment = gst_sample_get_segment (sample);
+
+  if (!GST_BUFFER_PTS_IS_VALID (buffer))
+    return 0;
+
+  return gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+                                      GST_BUFFER_PTS (buffer));
+}
+
+static GstClockTime
+get_pipeline_running_time (GstElement *pipeline)
+{
+  GstClock *clock = gst_element_get_clock (pipeline);
+  GstClockTime now;
+
+  if (!clock)
+    return GST_CLOCK_TIME_NONE;
+
+  now = gst_clock_get_time (clock) - gst_element_get_base_time (pipeline);
+  gst_object_unref (clock);
+
+  return now;
+}
+
+/* Returns the running time of the next sample that isn't due yet or
+ * GST_CLOCK_TIME_NONE if there are no more queued samples */
+static GstClockTime
+present_video (RutImageSource *source,
+               GstClockTime frame_interval)
+{
+  GstAppSink *appsink = GST_APP_SINK (source->appsink);
+  GstClockTime now = get_pipeline_running_time (source->pipeline);
+  GstClockTime presentation_time;
+  GstSample *present_sample = NULL;
+  GstClockTime present_running_time = 0;
+
+  /* Not playing yet */
+  if (!GST_CLOCK_TIME_IS_VALID (now))
+    return GST_CLOCK_TIME_NONE;
+
+  /* The Cogl sink only uploads a sample once we return to the main
+   * loop so it will be drawn in the frame after the one about to be
+   * painted which will be seen roughly two frame intervals from
+   * now */
+  presentation_time = now + 2 * frame_interval;
+
+  while (TRUE)
+    {
+      if (!source->next_sample)
+        {
+          source->next_sample = gst_app_sink_try_pull_sample (appsink, 0);
+          if (!source->next_sample)
+            break;
+
+          source->next_running_time =
+            get_sample_running_time (source->next_sample);
+        }
+
+      if (source->next_running_time > presentation_time)
+        break;
+
+      /* A later sample is also due so the current candidate would
+       * never be seen */
+      if (present_sample)
+        {
+          gst_sample_unref (present_sample);
+          source->video_stats.n_dropped++;
+        }
+
+      present_sample = source->next_sample;
+      present_running_time = source->next_running_time;
+      source->next_sample = NULL;
+    }
+
+  if (present_sample)
+    {
+      if (presentation_time - present_running_time > frame_interval)
+        source->video_stats.n_late++;
+
+      source->video_stats.n_presented++;
+
+      /* NB: this takes its own reference on the sample's buffer */
+      gst_app_src_push_sample (GST_APP_SRC (source->appsrc), present_sample);
+      gst_sample_unref (present_sample);
+    }
+
+  return source->next_sample ?
+    source->next_running_time - now : GST_CLOCK_TIME_NONE;
+}
+
+static gboolean
+video_due_timeout_cb (void *user_data)
+{
+  RutContext *ctx = user_data;
+
+  ctx->video_timeout_id = 0;
+  rut_shell_queue_redraw (ctx->shell);
+
+  return G_SOURCE_REMOVE;
+}
+
+void
+rut_image_source_present_videos (RutContext *ctx)
+{
+  int64_t now = g_get_monotonic_time ();
+  GstClockTime next_due = GST_CLOCK_TIME_NONE;
+  RutImageSource *source;
+
+  /* Estimate the frame interval from how often we're called while
+   * smoothing out the occasional stall */
+  if (ctx->last_video_present_time)
+    {
+      int64_t interval = now - ctx->last_video_present_time;
+
+      interval = CLAMP (interval,
+                        VIDEO_MIN_FRAME_INTERVAL,
+                        VIDEO_MAX_FRAME_INTERVAL);
+      ctx->video_frame_interval =
+        (ctx->video_frame_interval * 7 + interval) / 8;
+    }
+  else
+    ctx->video_frame_interval = VIDEO_DEFAULT_FRAME_INTERVAL;
+
+  ctx->last_video_present_time = now;
+
+  rut_list_for_each (source, &ctx->video_sources, video_link)
+    {
+      GstClockTime due =
+        present_video (source, ctx->video_frame_interval * GST_USECOND);
+
+      if (GST_CLOCK_TIME_IS_VALID (due))
+        next_due = MIN (next_due, due);
+    }
+
+  /* Samples that were pulled but aren't due yet won't cause another
+   * redraw to be queued by the appsink so we need a timeout */
+  if (ctx->video_timeout_id)
+    {
+      g_source_remove (ctx->video_timeout_id);
+      ctx->video_timeout_id = 0;
+    }
+
+  if (GST_CLOCK_TIME_IS_VALID (next_due))
+    {
+      /* Wake up early so the sample is presented on time */
+      GstClockTime frame = 2 * ctx->video_frame_interval * GST_USECOND;
+      unsigned int ms = next_due > frame ?
+        (unsigned int)((next_due - frame) / GST_MSECOND) : 0;
+
+      ctx->video_timeout_id =
+        g_timeout_add (ms, video_due_timeout_cb, ctx);
+    }
+}
+
+void
+rut_image_source_get_video_stats (RutImageSource *source,
+                                  RutVideoStats *stats)
+{
+  *stats = source->video_stats;
 }
 
 static void
@@ -212,6 +527,13 @@ _rut_image_source_free (void *object)
   RutImageSource *source = object;
 
   _rut_image_source_video_stop (source);
+
+  if (source->texture_evicted_closure)
+    rut_closure_disconnect (source->texture_evicted_closure);
+  if (source->asset)
+    rut_refable_unref (source->asset);
+
+  rut_closure_list_disconnect_all (&source->texture_evicted_cb_list);
 }
 
 RutType rut_image_source_type;
@@ -261,9 +583,23 @@ new_frame_cb (gpointer instance,
                            source);
 }
 
-RutImageSource*
-rut_image_source_new (RutContext *ctx,
-                      RutAsset *asset)
+static void
+asset_texture_evicted_cb (RutAsset *asset,
+                          void *user_data)
+{
+  RutImageSource *source = user_data;
+
+  /* Give anything that has put the texture into a pipeline the
+   * chance to release it before the asset drops its reference */
+  rut_closure_list_invoke (&source->texture_evicted_cb_list,
+                           RutImageSourceTextureEvictedCallback,
+                           source);
+
+  source->texture = NULL;
+}
+
+static RutImageSource *
+image_source_new (RutContext *ctx)
 {
   RutImageSource *source = rut_object_alloc0 (RutImageSource,
                                               &rut_image_source_type,
@@ -280,6 +616,16 @@ rut_image_source_new (RutContext *ctx,
 
   rut_list_init (&source->changed_cb_list);
   rut_list_init (&source->ready_cb_list);
+  rut_list_init (&source->texture_evicted_cb_list);
+
+  return source;
+}
+
+RutImageSource*
+rut_image_source_new (RutContext *ctx,
+                      RutAsset *asset)
+{
+  RutImageSource *source = image_source_new (ctx);
 
   if (rut_asset_get_is_video (asset))
     {
@@ -295,7 +641,27 @@ rut_image_source_new (RutContext *ctx,
                          source);
     }
   else if (rut_asset_get_texture (asset))
-    source->texture = rut_asset_get_texture (asset);
+    {
+      source->asset = rut_refable_ref (asset);
+      source->texture = rut_asset_get_texture (asset);
+      source->texture_evicted_closure =
+        rut_asset_add_texture_evicted_callback (asset,
+                                                asset_texture_evicted_cb,
+                                                source,
+                                                NULL);
+    }
+
+  return source;
+}
+
+RutImageSource *
+_rut_image_source_new_for_video_pipeline (RutContext *ctx,
+                                          GstElement *decoder,
+                                          GstElement *present_sink)
+{
+  RutImageSource *source = image_source_new (ctx);
+
+  _rut_image_source_video_play_pipeline (source, decoder, present_sink);
 
   return source;
 }
@@ -319,9 +685,26 @@ rut_image_source_add_ready_callback (RutImageSource *source,
 CoglTexture*
 rut_image_source_get_texture (RutImageSource *source)
 {
+  /* Reload the texture if it has been evicted */
+  if (!source->texture && source->asset)
+    source->texture = rut_asset_get_texture (source->asset);
+
   return source->texture;
 }
 
+RutClosure *
+rut_image_source_add_texture_evicted_callback (
+                                 RutImageSource *source,
+                                 RutImageSourceTextureEvictedCallback callback,
+                                 void *user_data,
+                                 RutClosureDestroyCallback destroy_cb)
+{
+  return rut_closure_list_add (&source->texture_evicted_cb_list,
+                               callback,
+                               user_data,
+                               destroy_cb);
+}
+
 CoglGstVideoSink*
 rut_image_source_get_sink (RutImageSource *source)
 {
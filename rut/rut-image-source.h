@@ -65,6 +65,19 @@ rut_image_source_add_on_changed_callback (RutImageSource *source,
                                           void *user_data,
                                           RutClosureDestroyCallback destroy_cb);
 
+typedef void (*RutImageSourceTextureEvictedCallback) (RutImageSource *source,
+                                                      void *user_data);
+
+/* Invoked when the asset of an image source evicts its texture. Any
+ * pipelines using the texture should be discarded so the memory can
+ * be freed. rut_image_source_get_texture() will reload it. */
+RutClosure *
+rut_image_source_add_texture_evicted_callback (
+                                 RutImageSource *source,
+                                 RutImageSourceTextureEvictedCallback callback,
+                                 void *user_data,
+                                 RutClosureDestroyCallback destroy_cb);
+
 void
 rut_image_source_set_first_layer (RutImageSource *source,
                                   int first_layer);
@@ -81,6 +94,44 @@ void
 rut_image_source_attach_frame (RutImageSource *source,
                                CoglPipeline *pipeline);
 
+typedef struct _RutVideoStats
+{
+  /* Samples handed to the video sink to be uploaded */
+  unsigned int n_presented;
+
+  /* Samples that were superseded before they could be presented and
+   * so were never uploaded */
+  unsigned int n_dropped;
+
+  /* Samples presented more than a frame after they were due */
+  unsigned int n_late;
+} RutVideoStats;
+
+void
+rut_image_source_get_video_stats (RutImageSource *source,
+                                  RutVideoStats *stats);
+
+/* Should be called once before painting each frame. Decoded video
+ * samples are queued until this picks the latest sample of each video
+ * that is due by the time the frame is predicted to be shown. All the
+ * videos of a context queue at most one redraw per frame. */
+void
+rut_image_source_present_videos (RutContext *ctx);
+
+/* Creates a video source whose samples are decoded by @decoder and
+ * presented by @present_sink instead of being decoded from an asset
+ * and presented by a Cogl sink. This lets the presentation scheduling
+ * be exercised without a GPU, for example with a videotestsrc and a
+ * fakesink. If @decoder has a "video-sink" property then the
+ * scheduler's appsink is set as its video sink, otherwise @decoder is
+ * linked to the appsink directly. The source takes ownership of both
+ * elements. There is no Cogl sink so the source can't be used to set
+ * up a CoglPipeline. */
+RutImageSource *
+_rut_image_source_new_for_video_pipeline (RutContext *ctx,
+                                          GstElement *decoder,
+                                          GstElement *present_sink);
+
 void
 _rut_init_image_source_wrappers_cache (RutContext *ctx);
 
@@ -0,0 +1,1289 @@
+/*
+ * Rut - Rig Utilities
+ *
+ * Copyright (C) 2014  Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rut-mesh-optimize.h"
+#include "rut-interfaces.h"
+
+/* The size of the post-transform cache that triangles are ordered
+ * for. Tipsify isn't very sensitive to the exact size so this is a
+ * conservative guess that should suit most GPUs */
+#define CACHE_SIZE 16
+
+/* Attributes that refer to the same data, such as the texture
+ * coordinate aliases created for models, are only stored once */
+typedef struct _PackedAttribute
+{
+  RutAttribute *attribute;
+  int alias;
+
+  /* The offset of the attribute within a packed vertex */
+  int offset;
+
+  /* The layout used in the optimized mesh */
+  RutAttributeType type;
+  CoglBool normalized;
+  int dst_offset;
+} PackedAttribute;
+
+typedef struct _Optimizer
+{
+  RutMesh *mesh;
+
+  PackedAttribute *attributes;
+
+  /* All the vertex data is packed into a single array of tightly
+   * packed vertices so that vertices can be compared and moved with
+   * a single memcmp or memcpy */
+  uint8_t *vertices;
+  int vertex_size;
+  int n_vertices;
+
+  uint32_t *indices;
+  int n_indices;
+} Optimizer;
+
+static int
+get_sizeof_attribute_type (RutAttributeType type)
+{
+  switch (type)
+    {
+    case RUT_ATTRIBUTE_TYPE_BYTE:
+    case RUT_ATTRIBUTE_TYPE_UNSIGNED_BYTE:
+      return 1;
+    case RUT_ATTRIBUTE_TYPE_SHORT:
+    case RUT_ATTRIBUTE_TYPE_UNSIGNED_SHORT:
+      return 2;
+    case RUT_ATTRIBUTE_TYPE_FLOAT:
+      return 4;
+    }
+
+  g_warn_if_reached ();
+  return 0;
+}
+
+static int
+align_offset (int offset, int alignment)
+{
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+static CoglBool
+is_alias (RutAttribute *a, RutAttribute *b)
+{
+  return (a->buffer == b->buffer &&
+          a->offset == b->offset &&
+          a->stride == b->stride &&
+          a->type == b->type &&
+          a->n_components == b->n_components &&
+          a->normalized == b->normalized);
+}
+
+static void
+pack_vertices (Optimizer *opt)
+{
+  RutMesh *mesh = opt->mesh;
+  int max_component_size = 1;
+  int i, v;
+
+  opt->vertex_size = 0;
+
+  for (i = 0; i < mesh->n_attributes; i++)
+    {
+      RutAttribute *attribute = mesh->attributes[i];
+      PackedAttribute *packed = &opt->attributes[i];
+      int component_size = get_sizeof_attribute_type (attribute->type);
+      int j;
+
+      packed->attribute = attribute;
+      packed->alias = -1;
+      packed->type = attribute->type;
+      packed->normalized = attribute->normalized;
+
+      for (j = 0; j < i; j++)
+        {
+          if (is_alias (attribute, mesh->attributes[j]))
+            {
+              packed->alias = j;
+              packed->offset = opt->attributes[j].offset;
+              break;
+            }
+        }
+
+      if (packed->alias != -1)
+        continue;
+
+      opt->vertex_size = align_offset (opt->vertex_size, component_size);
+      packed->offset = opt->vertex_size;
+      opt->vertex_size += component_size * attribute->n_components;
+
+      max_component_size = MAX (max_component_size, component_size);
+    }
+
+  opt->vertex_size = align_offset (opt->vertex_size, max_component_size);
+
+  /* NB: the vertices are cleared so that any padding between the
+   * attributes can't stop identical vertices being welded */
+  opt->vertices = g_malloc0 ((size_t)opt->vertex_size * opt->n_vertices);
+
+  for (i = 0; i < mesh->n_attributes; i++)
+    {
+      PackedAttribute *packed = &opt->attributes[i];
+      RutAttribute *attribute = packed->attribute;
+      const uint8_t *src = attribute->buffer->data + attribute->offset;
+      uint8_t *dst = opt->vertices + packed->offset;
+      int size = (get_sizeof_attribute_type (attribute->type) *
+                  attribute->n_components);
+
+      if (packed->alias != -1)
+        continue;
+
+      for (v = 0; v < opt->n_vertices; v++)
+        {
+          memcpy (dst, src, size);
+          src += attribute->stride;
+          dst += opt->vertex_size;
+        }
+    }
+}
+
+static void
+unpack_indices (Optimizer *opt)
+{
+  RutMesh *mesh = opt->mesh;
+  void *data;
+  int i;
+
+  if (!mesh->indices_buffer)
+    {
+      opt->n_indices = mesh->n_vertices;
+      opt->indices = g_new (uint32_t, opt->n_indices);
+
+      for (i = 0; i < opt->n_indices; i++)
+        opt->indices[i] = i;
+
+      return;
+    }
+
+  opt->n_indices = mesh->n_indices;
+  opt->indices = g_new (uint32_t, opt->n_indices);
+  data = mesh->indices_buffer->data;
+
+  for (i = 0; i < opt->n_indices; i++)
+    {
+      switch (mesh->indices_type)
+        {
+        case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+          opt->indices[i] = ((uint8_t *)data)[i];
+          break;
+        case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+          opt->indices[i] = ((uint16_t *)data)[i];
+          break;
+        case COGL_INDICES_TYPE_UNSIGNED_INT:
+          opt->indices[i] = ((uint32_t *)data)[i];
+          break;
+        }
+    }
+}
+
+static uint32_t
+hash_vertex (const uint8_t *vertex, int size)
+{
+  uint32_t hash = 2166136261u;
+  int i;
+
+  /* FNV-1a */
+  for (i = 0; i < size; i++)
+    {
+      hash ^= vertex[i];
+      hash *= 16777619u;
+    }
+
+  return hash;
+}
+
+static void
+weld_vertices (Optimizer *opt)
+{
+  int table_size = 1;
+  unsigned int mask;
+  int *table;
+  uint32_t *remap;
+  int n_welded = 0;
+  int v, i;
+
+  while (table_size < opt->n_vertices * 2)
+    table_size *= 2;
+  mask = table_size - 1;
+
+  table = g_new (int, table_size);
+  memset (table, 0xff, sizeof (int) * table_size);
+
+  remap = g_new (uint32_t, opt->n_vertices);
+
+  /* NB: unique vertices are compacted in place as we go. The table
+   * only refers to vertices that have already been compacted so
+   * they never get overwritten */
+  for (v = 0; v < opt->n_vertices; v++)
+    {
+      uint8_t *vertex = opt->vertices + (size_t)v * opt->vertex_size;
+      unsigned int slot = hash_vertex (vertex, opt->vertex_size) & mask;
+
+      while (table[slot] != -1)
+        {
+          uint8_t *other = opt->vertices +
+            (size_t)table[slot] * opt->vertex_size;
+
+          if (memcmp (vertex, other, opt->vertex_size) == 0)
+            break;
+
+          slot = (slot + 1) & mask;
+        }
+
+      if (table[slot] != -1)
+        remap[v] = table[slot];
+      else
+        {
+          if (n_welded != v)
+            memcpy (opt->vertices + (size_t)n_welded * opt->vertex_size,
+                    vertex,
+                    opt->vertex_size);
+
+          table[slot] = n_welded;
+          remap[v] = n_welded++;
+        }
+    }
+
+  for (i = 0; i < opt->n_indices; i++)
+    opt->indices[i] = remap[opt->indices[i]];
+
+  opt->n_vertices = n_welded;
+
+  g_free (remap);
+  g_free (table);
+}
+
+/* This implements the "Tipsify" algorithm described in "Fast
+ * Triangle Reordering for Vertex Locality and Reduced Overdraw" by
+ * Sander, Nehab and Barczak. Triangles are emitted as fans around a
+ * vertex and the next vertex to fan around is picked from the
+ * vertices of the last fan that will still be in the cache. */
+static void
+reorder_triangles (Optimizer *opt)
+{
+  int n_triangles = opt->n_indices / 3;
+  int n_vertices = opt->n_vertices;
+  int *offsets = g_new0 (int, n_vertices + 1);
+  int *fill = g_new (int, n_vertices);
+  int *adjacency = g_new (int, opt->n_indices);
+  int *live = g_new0 (int, n_vertices);
+  int *cache_time = g_new0 (int, n_vertices);
+  uint32_t *dead_end = g_new (uint32_t, opt->n_indices);
+  int n_dead_end = 0;
+  CoglBool *emitted = g_new0 (CoglBool, n_triangles);
+  uint32_t *output = g_new (uint32_t, opt->n_indices);
+  int n_output = 0;
+  int timestamp = CACHE_SIZE + 1;
+  int cursor = 0;
+  int fanning_vertex = -1;
+  int i;
+
+  for (i = 0; i < opt->n_indices; i++)
+    live[opt->indices[i]]++;
+
+  for (i = 0; i < n_vertices; i++)
+    {
+      offsets[i + 1] = offsets[i] + live[i];
+      fill[i] = offsets[i];
+    }
+
+  for (i = 0; i < n_triangles * 3; i++)
+    adjacency[fill[opt->indices[i]]++] = i / 3;
+
+  while (cursor < n_vertices && live[cursor] == 0)
+    cursor++;
+  if (cursor < n_vertices)
+    fanning_vertex = cursor;
+
+  while (fanning_vertex >= 0)
+    {
+      int candidates = n_dead_end;
+      int best_priority = -1;
+      int k;
+
+      for (k = offsets[fanning_vertex]; k < offsets[fanning_vertex + 1]; k++)
+        {
+          int t = adjacency[k];
+          int j;
+
+          if (emitted[t])
+            continue;
+
+          for (j = 0; j < 3; j++)
+            {
+              uint32_t v = opt->indices[t * 3 + j];
+
+              output[n_output++] = v;
+              dead_end[n_dead_end++] = v;
+              live[v]--;
+
+              if (timestamp - cache_time[v] > CACHE_SIZE)
+                cache_time[v] = timestamp++;
+            }
+
+          emitted[t] = TRUE;
+        }
+
+      /* Pick the candidate that will stay in the cache the longest
+       * while still having triangles left to emit... */
+      fanning_vertex = -1;
+      for (k = candidates; k < n_dead_end; k++)
+        {
+          uint32_t v = dead_end[k];
+          int priority = 0;
+
+          if (live[v] <= 0)
+            continue;
+
+          if (timestamp - cache_time[v] + 2 * live[v] <= CACHE_SIZE)
+            priority = timestamp - cache_time[v];
+
+          if (priority > best_priority)
+            {
+              best_priority = priority;
+              fanning_vertex = v;
+            }
+        }
+
+      /* ...otherwise we've reached a dead end so we first try
+       * recently used vertices and then fall back to scanning */
+      while (fanning_vertex == -1 && n_dead_end > 0)
+        {
+          uint32_t v = dead_end[--n_dead_end];
+          if (live[v] > 0)
+            fanning_vertex = v;
+        }
+
+      while (fanning_vertex == -1 && cursor < n_vertices)
+        {
+          if (live[cursor] > 0)
+            fanning_vertex = cursor;
+          else
+            cursor++;
+        }
+    }
+
+  g_warn_if_fail (n_output == n_triangles * 3);
+
+  memcpy (opt->indices, output, sizeof (uint32_t) * n_output);
+
+  g_free (output);
+  g_free (emitted);
+  g_free (dead_end);
+  g_free (cache_time);
+  g_free (live);
+  g_free (adjacency);
+  g_free (fill);
+  g_free (offsets);
+}
+
+/* Lays out the vertices in the order they are first referenced so
+ * that vertex fetches are as sequential as possible. Vertices that
+ * aren't referenced at all are dropped. */
+static void
+reorder_vertices (Optimizer *opt)
+{
+  int *remap = g_new (int, opt->n_vertices);
+  uint8_t *vertices = g_malloc ((size_t)opt->vertex_size * opt->n_vertices);
+  int n_vertices = 0;
+  int i;
+
+  memset (remap, 0xff, sizeof (int) * opt->n_vertices);
+
+  for (i = 0; i < opt->n_indices; i++)
+    {
+      uint32_t v = opt->indices[i];
+
+      if (remap[v] == -1)
+        {
+          memcpy (vertices + (size_t)n_vertices * opt->vertex_size,
+                  opt->vertices + (size_t)v * opt->vertex_size,
+                  opt->vertex_size);
+          remap[v] = n_vertices++;
+        }
+
+      opt->indices[i] = remap[v];
+    }
+
+  g_free (opt->vertices);
+  opt->vertices = vertices;
+  opt->n_vertices = n_vertices;
+
+  g_free (remap);
+}
+
+static CoglBool
+is_unit_range (Optimizer *opt, PackedAttribute *packed)
+{
+  int n_components = packed->attribute->n_components;
+  int v, i;
+
+  for (v = 0; v < opt->n_vertices; v++)
+    {
+      const float *value = (const float *)(opt->vertices +
+                                           (size_t)v * opt->vertex_size +
+                                           packed->offset);
+
+      for (i = 0; i < n_components; i++)
+        if (!(value[i] >= 0 && value[i] <= 1))
+          return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+choose_quantized_types (Optimizer *opt)
+{
+  RutMesh *mesh = opt->mesh;
+  int i;
+
+  for (i = 0; i < mesh->n_attributes; i++)
+    {
+      PackedAttribute *packed = &opt->attributes[i];
+      RutAttribute *attribute = packed->attribute;
+
+      if (packed->alias != -1 ||
+          attribute->type != RUT_ATTRIBUTE_TYPE_FLOAT ||
+          attribute->normalized)
+        continue;
+
+      if (strcmp (attribute->name, "cogl_normal_in") == 0 ||
+          strcmp (attribute->name, "tangent_in") == 0)
+        {
+          packed->type = RUT_ATTRIBUTE_TYPE_SHORT;
+          packed->normalized = TRUE;
+        }
+      else if (g_str_has_prefix (attribute->name, "cogl_tex_coord") &&
+               is_unit_range (opt, packed))
+        {
+          packed->type = RUT_ATTRIBUTE_TYPE_UNSIGNED_SHORT;
+          packed->normalized = TRUE;
+        }
+    }
+}
+
+static void
+write_attribute (Optimizer *opt,
+                 PackedAttribute *packed,
+                 uint8_t *dst,
+                 int dst_stride)
+{
+  RutAttribute *attribute = packed->attribute;
+  int n_components = attribute->n_components;
+  const uint8_t *src = opt->vertices + packed->offset;
+  int v, i;
+
+  if (packed->type == attribute->type)
+    {
+      int size = get_sizeof_attribute_type (attribute->type) * n_components;
+
+      for (v = 0; v < opt->n_vertices; v++)
+        {
+          memcpy (dst, src, size);
+          src += opt->vertex_size;
+          dst += dst_stride;
+        }
+
+      return;
+    }
+
+  for (v = 0; v < opt->n_vertices; v++)
+    {
+      const float *value = (const float *)src;
+
+      for (i = 0; i < n_components; i++)
+        {
+          float f = value[i];
+
+          if (packed->type == RUT_ATTRIBUTE_TYPE_SHORT)
+            ((int16_t *)dst)[i] = floorf (CLAMP (f, -1, 1) * 32767 + 0.5f);
+          else
+            ((uint16_t *)dst)[i] = floorf (CLAMP (f, 0, 1) * 65535 + 0.5f);
+        }
+
+      src += opt->vertex_size;
+      dst += dst_stride;
+    }
+}
+
+static CoglIndicesType
+get_narrowest_indices_type (int n_vertices)
+{
+  if (n_vertices <= 0x100)
+    return COGL_INDICES_TYPE_UNSIGNED_BYTE;
+  else if (n_vertices <= 0x10000)
+    return COGL_INDICES_TYPE_UNSIGNED_SHORT;
+  else
+    return COGL_INDICES_TYPE_UNSIGNED_INT;
+}
+
+static RutBuffer *
+create_indices_buffer (Optimizer *opt, CoglIndicesType type)
+{
+  RutBuffer *buffer;
+  int i;
+
+  switch (type)
+    {
+    case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+      buffer = rut_buffer_new (opt->n_indices);
+      for (i = 0; i < opt->n_indices; i++)
+        ((uint8_t *)buffer->data)[i] = opt->indices[i];
+      break;
+    case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+      buffer = rut_buffer_new (opt->n_indices * sizeof (uint16_t));
+      for (i = 0; i < opt->n_indices; i++)
+        ((uint16_t *)buffer->data)[i] = opt->indices[i];
+      break;
+    case COGL_INDICES_TYPE_UNSIGNED_INT:
+      buffer = rut_buffer_new (opt->n_indices * sizeof (uint32_t));
+      memcpy (buffer->data, opt->indices, buffer->size);
+      break;
+    }
+
+  return buffer;
+}
+
+static RutMesh *
+create_mesh (Optimizer *opt,
+             CoglBool indexed,
+             RutMeshOptimizeFlags flags)
+{
+  RutMesh *mesh = opt->mesh;
+  RutAttribute **attributes = g_alloca (sizeof (void *) * mesh->n_attributes);
+  RutBuffer *vertex_buffer;
+  RutMesh *optimized;
+  int stride = 0;
+  int max_component_size = 1;
+  int i;
+
+  for (i = 0; i < mesh->n_attributes; i++)
+    {
+      PackedAttribute *packed = &opt->attributes[i];
+      int component_size;
+
+      if (packed->alias != -1)
+        continue;
+
+      component_size = get_sizeof_attribute_type (packed->type);
+      stride = align_offset (stride, component_size);
+      packed->dst_offset = stride;
+      stride += component_size * packed->attribute->n_components;
+
+      max_component_size = MAX (max_component_size, component_size);
+    }
+
+  stride = align_offset (stride, max_component_size);
+
+  vertex_buffer = rut_buffer_new ((size_t)stride * opt->n_vertices);
+  memset (vertex_buffer->data, 0, vertex_buffer->size);
+
+  for (i = 0; i < mesh->n_attributes; i++)
+    {
+      PackedAttribute *packed = &opt->attributes[i];
+      PackedAttribute *layout =
+        packed->alias != -1 ? &opt->attributes[packed->alias] : packed;
+
+      if (packed->alias == -1)
+        write_attribute (opt, packed,
+                         vertex_buffer->data + packed->dst_offset,
+                         stride);
+
+      attributes[i] = rut_attribute_new (vertex_buffer,
+                                         packed->attribute->name,
+                                         stride,
+                                         layout->dst_offset,
+                                         packed->attribute->n_components,
+                                         layout->type);
+      rut_attribute_set_normalized (attributes[i], layout->normalized);
+    }
+
+  optimized = rut_mesh_new (mesh->mode,
+                            opt->n_vertices,
+                            attributes,
+                            mesh->n_attributes);
+
+  for (i = 0; i < mesh->n_attributes; i++)
+    rut_refable_unref (attributes[i]);
+
+  rut_refable_unref (vertex_buffer);
+
+  if (indexed)
+    {
+      CoglIndicesType type;
+      RutBuffer *indices_buffer;
+
+      if ((flags & RUT_MESH_OPTIMIZE_NARROW_INDICES) ||
+          !mesh->indices_buffer)
+        type = get_narrowest_indices_type (opt->n_vertices);
+      else
+        type = mesh->indices_type;
+
+      indices_buffer = create_indices_buffer (opt, type);
+      rut_mesh_set_indices (optimized, type, indices_buffer, opt->n_indices);
+      rut_refable_unref (indices_buffer);
+    }
+
+  return optimized;
+}
+
+RutMesh *
+rut_mesh_optimize (RutMesh *mesh,
+                   RutMeshOptimizeFlags flags)
+{
+  Optimizer opt;
+  CoglBool indexed = mesh->indices_buffer != NULL;
+  RutMesh *optimized;
+
+  if (mesh->mode != COGL_VERTICES_MODE_TRIANGLES)
+    flags &= ~(RUT_MESH_OPTIMIZE_WELD | RUT_MESH_OPTIMIZE_REORDER);
+
+  memset (&opt, 0, sizeof (opt));
+  opt.mesh = mesh;
+  opt.attributes = g_alloca (sizeof (PackedAttribute) * mesh->n_attributes);
+  opt.n_vertices = mesh->n_vertices;
+
+  pack_vertices (&opt);
+
+  if (indexed || (flags & (RUT_MESH_OPTIMIZE_WELD |
+                           RUT_MESH_OPTIMIZE_REORDER)))
+    {
+      unpack_indices (&opt);
+      indexed = TRUE;
+    }
+
+  if (flags & RUT_MESH_OPTIMIZE_WELD)
+    weld_vertices (&opt);
+
+  if (flags & RUT_MESH_OPTIMIZE_REORDER &&
+      opt.n_indices % 3 == 0)
+    {
+      reorder_triangles (&opt);
+      reorder_vertices (&opt);
+    }
+
+  if (flags & RUT_MESH_OPTIMIZE_QUANTIZE)
+    choose_quantized_types (&opt);
+
+  optimized = create_mesh (&opt, indexed, flags);
+
+  /* The levels of detail are only still valid if the vertices haven't
+   * moved and the indices still have the same type */
+  if (!(flags & (RUT_MESH_OPTIMIZE_WELD | RUT_MESH_OPTIMIZE_REORDER)) &&
+      mesh->indices_buffer &&
+      optimized->indices_type == mesh->indices_type)
+    {
+      int i;
+
+      for (i = 0; i < mesh->n_lods; i++)
+        rut_mesh_add_lod (optimized,
+                          mesh->lods[i].indices_buffer,
+                          mesh->lods[i].n_indices);
+    }
+
+  g_free (opt.indices);
+  g_free (opt.vertices);
+
+  return optimized;
+}
+
+/* Levels of detail are generated by edge collapses ordered by the
+ * quadric error metric described in "Surface Simplification Using
+ * Quadric Error Metrics" by Garland and Heckbert.
+ *
+ * Collapses are done in terms of positions rather than vertices so
+ * that seams where vertices share a position but have different
+ * normals or texture coordinates don't tear apart. Collapsing a
+ * position moves all of its triangle corners onto one representative
+ * vertex of the target position. This loses some accuracy for the
+ * attributes along seams but that isn't noticeable at the distances
+ * the simplified levels are used. Positions on the border of the
+ * mesh are never moved so that open edges keep their shape. */
+
+/* Each level of detail has roughly this fraction of the triangles of
+ * the previous level */
+#define LOD_REDUCTION 0.5
+
+/* Meshes with fewer triangles than this aren't simplified further */
+#define LOD_MIN_TRIANGLES 64
+
+typedef struct _Quadric
+{
+  /* The upper triangle of the symmetric 4x4 matrix */
+  double a2, ab, ac, ad;
+  double b2, bc, bd;
+  double c2, cd;
+  double d2;
+} Quadric;
+
+typedef struct _Collapse
+{
+  double cost;
+  int src;
+  int dst;
+} Collapse;
+
+typedef struct _Simplifier
+{
+  int n_vertices;
+
+  /* Maps each vertex to a unique position */
+  int *position_ids;
+  int n_positions;
+
+  /* For each position... */
+  float *points;
+  int *representatives;
+  Quadric *quadrics;
+  CoglBool *border;
+  int *collapsed_to;
+
+  uint32_t *indices;
+  int n_indices;
+} Simplifier;
+
+static void
+quadric_add_plane (Quadric *q,
+                   double a, double b, double c, double d,
+                   double weight)
+{
+  q->a2 += weight * a * a;
+  q->ab += weight * a * b;
+  q->ac += weight * a * c;
+  q->ad += weight * a * d;
+  q->b2 += weight * b * b;
+  q->bc += weight * b * c;
+  q->bd += weight * b * d;
+  q->c2 += weight * c * c;
+  q->cd += weight * c * d;
+  q->d2 += weight * d * d;
+}
+
+static void
+quadric_add (Quadric *q, const Quadric *other)
+{
+  q->a2 += other->a2;
+  q->ab += other->ab;
+  q->ac += other->ac;
+  q->ad += other->ad;
+  q->b2 += other->b2;
+  q->bc += other->bc;
+  q->bd += other->bd;
+  q->c2 += other->c2;
+  q->cd += other->cd;
+  q->d2 += other->d2;
+}
+
+static double
+quadric_error (const Quadric *q0, const Quadric *q1, const float *p)
+{
+  double x = p[0], y = p[1], z = p[2];
+  Quadric q = *q0;
+
+  quadric_add (&q, q1);
+
+  return (q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x +
+          q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y +
+          q.c2 * z * z + 2 * q.cd * z +
+          q.d2);
+}
+
+static void
+triangle_normal (const float *p0, const float *p1, const float *p2,
+                 float *normal)
+{
+  float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+  float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+  normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+  normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+  normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static int
+resolve_position (Simplifier *simplifier, int position)
+{
+  while (simplifier->collapsed_to[position] != position)
+    position = simplifier->collapsed_to[position];
+
+  return position;
+}
+
+static int
+corner_position (Simplifier *simplifier, int corner)
+{
+  return resolve_position (simplifier,
+                           simplifier->position_ids[
+                             simplifier->indices[corner]]);
+}
+
+static void
+init_positions (Simplifier *simplifier,
+                RutAttribute *attribute)
+{
+  const uint8_t *data = attribute->buffer->data + attribute->offset;
+  int table_size = 1;
+  unsigned int mask;
+  int *table;
+  int v;
+
+  while (table_size < simplifier->n_vertices * 2)
+    table_size *= 2;
+  mask = table_size - 1;
+
+  table = g_new (int, table_size);
+  memset (table, 0xff, sizeof (int) * table_size);
+
+  simplifier->position_ids = g_new (int, simplifier->n_vertices);
+  simplifier->points = g_new (float, simplifier->n_vertices * 3);
+  simplifier->representatives = g_new (int, simplifier->n_vertices);
+  simplifier->n_positions = 0;
+
+  for (v = 0; v < simplifier->n_vertices; v++)
+    {
+      const float *point = (const float *)(data + v * attribute->stride);
+      unsigned int slot = hash_vertex ((const uint8_t *)point,
+                                       sizeof (float) * 3) & mask;
+
+      while (table[slot] != -1 &&
+             memcmp (simplifier->points + table[slot] * 3, point,
+                     sizeof (float) * 3) != 0)
+        slot = (slot + 1) & mask;
+
+      if (table[slot] == -1)
+        {
+          int id = simplifier->n_positions++;
+
+          memcpy (simplifier->points + id * 3, point, sizeof (float) * 3);
+          simplifier->representatives[id] = v;
+          table[slot] = id;
+        }
+
+      simplifier->position_ids[v] = table[slot];
+    }
+
+  g_free (table);
+}
+
+static int
+compare_edges (const void *a, const void *b)
+{
+  uint64_t edge0 = *(const uint64_t *)a;
+  uint64_t edge1 = *(const uint64_t *)b;
+
+  return edge0 < edge1 ? -1 : edge0 > edge1 ? 1 : 0;
+}
+
+static int
+compare_collapses (const void *a, const void *b)
+{
+  const Collapse *collapse0 = a;
+  const Collapse *collapse1 = b;
+
+  if (collapse0->cost < collapse1->cost)
+    return -1;
+  else if (collapse0->cost > collapse1->cost)
+    return 1;
+  else
+    return 0;
+}
+
+/* Returns the unique edges of the current triangles sorted with the
+ * smallest position in the high bits */
+static uint64_t *
+collect_edges (Simplifier *simplifier, int *n_edges_out)
+{
+  uint64_t *edges = g_new (uint64_t, simplifier->n_indices);
+  int n_edges = 0;
+  int t, i, j;
+
+  for (t = 0; t < simplifier->n_indices; t += 3)
+    {
+      for (i = 0; i < 3; i++)
+        {
+          uint32_t p0 = corner_position (simplifier, t + i);
+          uint32_t p1 = corner_position (simplifier, t + (i + 1) % 3);
+
+          edges[n_edges++] = (p0 < p1 ?
+                              ((uint64_t)p0 << 32 | p1) :
+                              ((uint64_t)p1 << 32 | p0));
+        }
+    }
+
+  qsort (edges, n_edges, sizeof (uint64_t), compare_edges);
+
+  for (i = 0, j = 0; i < n_edges; i++)
+    if (j == 0 || edges[j - 1] != edges[i])
+      edges[j++] = edges[i];
+
+  *n_edges_out = j;
+
+  return edges;
+}
+
+static void
+init_quadrics (Simplifier *simplifier)
+{
+  uint64_t *edges = g_new (uint64_t, simplifier->n_indices);
+  int n_edges = 0;
+  int t, i;
+
+  simplifier->quadrics = g_new0 (Quadric, simplifier->n_positions);
+  simplifier->border = g_new0 (CoglBool, simplifier->n_positions);
+  simplifier->collapsed_to = g_new (int, simplifier->n_positions);
+
+  for (i = 0; i < simplifier->n_positions; i++)
+    simplifier->collapsed_to[i] = i;
+
+  for (t = 0; t < simplifier->n_indices; t += 3)
+    {
+      int p[3];
+      float normal[3];
+      float length;
+
+      for (i = 0; i < 3; i++)
+        p[i] = corner_position (simplifier, t + i);
+
+      triangle_normal (simplifier->points + p[0] * 3,
+                       simplifier->points + p[1] * 3,
+                       simplifier->points + p[2] * 3,
+                       normal);
+      length = sqrtf (normal[0] * normal[0] +
+                      normal[1] * normal[1] +
+                      normal[2] * normal[2]);
+
+      /* NB: the cross product's length is twice the triangle's area
+       * which is used to weight the planes */
+      if (length > 0)
+        {
+          float *p0 = simplifier->points + p[0] * 3;
+          double a = normal[0] / length;
+          double b = normal[1] / length;
+          double c = normal[2] / length;
+          double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+
+          for (i = 0; i < 3; i++)
+            quadric_add_plane (&simplifier->quadrics[p[i]],
+                               a, b, c, d, length * 0.5);
+        }
+
+      for (i = 0; i < 3; i++)
+        {
+          uint32_t p0 = p[i];
+          uint32_t p1 = p[(i + 1) % 3];
+
+          edges[n_edges++] = (p0 < p1 ?
+                              ((uint64_t)p0 << 32 | p1) :
+                              ((uint64_t)p1 << 32 | p0));
+        }
+    }
+
+  /* Edges that are only used by one triangle are on the border */
+  qsort (edges, n_edges, sizeof (uint64_t), compare_edges);
+
+  for (i = 0; i < n_edges; )
+    {
+      int run = 1;
+
+      while (i + run < n_edges && edges[i + run] == edges[i])
+        run++;
+
+      if (run == 1)
+        {
+          simplifier->border[edges[i] >> 32] = TRUE;
+          simplifier->border[edges[i] & 0xffffffff] = TRUE;
+        }
+
+      i += run;
+    }
+
+  g_free (edges);
+}
+
+static CoglBool
+collapse_flips_triangle (Simplifier *simplifier,
+                         int t,
+                         int src,
+                         int dst)
+{
+  const float *before[3];
+  const float *after[3];
+  float normal_before[3];
+  float normal_after[3];
+  int i;
+
+  for (i = 0; i < 3; i++)
+    {
+      int p = corner_position (simplifier, t + i);
+
+      /* Triangles that contain the edge are removed */
+      if (p == dst)
+        return FALSE;
+
+      before[i] = simplifier->points + p * 3;
+      after[i] = simplifier->points + (p == src ? dst : p) * 3;
+    }
+
+  triangle_normal (before[0], before[1], before[2], normal_before);
+  triangle_normal (after[0], after[1], after[2], normal_after);
+
+  return (normal_before[0] * normal_after[0] +
+          normal_before[1] * normal_after[1] +
+          normal_before[2] * normal_after[2]) <= 0;
+}
+
+/* Removes triangles that have collapsed and updates the indices so
+ * that each corner refers to a vertex for its current position */
+static void
+compact_triangles (Simplifier *simplifier)
+{
+  int n_indices = 0;
+  int t, i;
+
+  for (t = 0; t < simplifier->n_indices; t += 3)
+    {
+      int p[3];
+
+      for (i = 0; i < 3; i++)
+        p[i] = corner_position (simplifier, t + i);
+
+      if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0])
+        continue;
+
+      for (i = 0; i < 3; i++)
+        {
+          uint32_t v = simplifier->indices[t + i];
+
+          if (simplifier->position_ids[v] != p[i])
+            v = simplifier->representatives[p[i]];
+
+          simplifier->indices[n_indices++] = v;
+        }
+    }
+
+  simplifier->n_indices = n_indices;
+}
+
+/* Does one round of collapses where each position is only touched
+ * once. Returns FALSE if nothing could be collapsed. */
+static CoglBool
+simplify_pass (Simplifier *simplifier, int target_n_triangles)
+{
+  int n_triangles = simplifier->n_indices / 3;
+  int n_positions = simplifier->n_positions;
+  uint64_t *edges;
+  int n_edges;
+  Collapse *collapses;
+  int n_collapses = 0;
+  int *offsets;
+  int *fill;
+  int *adjacency;
+  CoglBool *touched;
+  CoglBool progress = FALSE;
+  int i, t;
+
+  edges = collect_edges (simplifier, &n_edges);
+  collapses = g_new (Collapse, n_edges);
+
+  for (i = 0; i < n_edges; i++)
+    {
+      int p0 = edges[i] >> 32;
+      int p1 = edges[i] & 0xffffffff;
+      const Quadric *q0 = &simplifier->quadrics[p0];
+      const Quadric *q1 = &simplifier->quadrics[p1];
+      double cost01 = quadric_error (q0, q1, simplifier->points + p1 * 3);
+      double cost10 = quadric_error (q0, q1, simplifier->points + p0 * 3);
+      Collapse *collapse = &collapses[n_collapses];
+
+      if (simplifier->border[p0] && simplifier->border[p1])
+        continue;
+      else if (simplifier->border[p0] ||
+               (!simplifier->border[p1] && cost10 < cost01))
+        {
+          collapse->src = p1;
+          collapse->dst = p0;
+          collapse->cost = cost10;
+        }
+      else
+        {
+          collapse->src = p0;
+          collapse->dst = p1;
+          collapse->cost = cost01;
+        }
+
+      n_collapses++;
+    }
+
+  g_free (edges);
+
+  qsort (collapses, n_collapses, sizeof (Collapse), compare_collapses);
+
+  /* Map each position to the triangles that use it */
+  offsets = g_new0 (int, n_positions + 1);
+  fill = g_new (int, n_positions);
+  adjacency = g_new (int, simplifier->n_indices);
+
+  for (i = 0; i < simplifier->n_indices; i++)
+    offsets[corner_position (simplifier, i) + 1]++;
+  for (i = 0; i < n_positions; i++)
+    {
+      offsets[i + 1] += offsets[i];
+      fill[i] = offsets[i];
+    }
+  for (i = 0; i < simplifier->n_indices; i++)
+    adjacency[fill[corner_position (simplifier, i)]++] = i - i % 3;
+
+  touched = g_new0 (CoglBool, n_positions);
+
+  for (i = 0; i < n_collapses && n_triangles > target_n_triangles; i++)
+    {
+      int src = collapses[i].src;
+      int dst = collapses[i].dst;
+      int n_removed = 0;
+      int k;
+
+      if (touched[src] || touched[dst])
+        continue;
+
+      for (k = offsets[src]; k < offsets[src + 1]; k++)
+        if (collapse_flips_triangle (simplifier, adjacency[k], src, dst))
+          break;
+      if (k < offsets[src + 1])
+        continue;
+
+      for (k = offsets[src]; k < offsets[src + 1]; k++)
+        {
+          t = adjacency[k];
+
+          if (corner_position (simplifier, t) == dst ||
+              corner_position (simplifier, t + 1) == dst ||
+              corner_position (simplifier, t + 2) == dst)
+            n_removed++;
+        }
+
+      simplifier->collapsed_to[src] = dst;
+      quadric_add (&simplifier->quadrics[dst], &simplifier->quadrics[src]);
+
+      touched[src] = TRUE;
+      touched[dst] = TRUE;
+
+      n_triangles -= n_removed;
+      progress = TRUE;
+    }
+
+  g_free (touched);
+  g_free (adjacency);
+  g_free (fill);
+  g_free (offsets);
+  g_free (collapses);
+
+  compact_triangles (simplifier);
+
+  return progress;
+}
+
+void
+rut_mesh_generate_lods (RutMesh *mesh)
+{
+  RutAttribute *position = rut_mesh_find_attribute (mesh, "cogl_position_in");
+  Simplifier simplifier;
+  Optimizer opt;
+  int n_triangles;
+
+  rut_mesh_clear_lods (mesh);
+
+  if (mesh->mode != COGL_VERTICES_MODE_TRIANGLES ||
+      !mesh->indices_buffer ||
+      mesh->n_indices % 3 != 0 ||
+      !position ||
+      position->type != RUT_ATTRIBUTE_TYPE_FLOAT ||
+      position->n_components != 3)
+    return;
+
+  memset (&opt, 0, sizeof (opt));
+  opt.mesh = mesh;
+  opt.n_vertices = mesh->n_vertices;
+  unpack_indices (&opt);
+
+  memset (&simplifier, 0, sizeof (simplifier));
+  simplifier.n_vertices = mesh->n_vertices;
+  simplifier.indices = opt.indices;
+  simplifier.n_indices = opt.n_indices;
+
+  init_positions (&simplifier, position);
+  init_quadrics (&simplifier);
+
+  n_triangles = simplifier.n_indices / 3;
+
+  while (mesh->n_lods < RUT_MESH_MAX_LODS &&
+         n_triangles * LOD_REDUCTION >= LOD_MIN_TRIANGLES)
+    {
+      int target = n_triangles * LOD_REDUCTION;
+      RutBuffer *indices_buffer;
+
+      while (simplifier.n_indices / 3 > target &&
+             simplify_pass (&simplifier, target))
+        ;
+
+      /* If the mesh is too constrained to get anywhere near the
+       * target then further levels wouldn't save anything */
+      if (simplifier.n_indices / 3 > n_triangles * 0.75)
+        break;
+
+      n_triangles = simplifier.n_indices / 3;
+
+      /* Each level is written out in vertex cache order. NB: the
+       * vertices themselves are shared with the full mesh so they
+       * can't be reordered */
+      opt.n_indices = simplifier.n_indices;
+      reorder_triangles (&opt);
+
+      indices_buffer = create_indices_buffer (&opt, mesh->indices_type);
+      rut_mesh_add_lod (mesh, indices_buffer, opt.n_indices);
+      rut_refable_unref (indices_buffer);
+
+      /* NB: reorder_triangles() rewrote the indices in place so
+       * the simplifier continues from the reordered triangles */
+    }
+
+  g_free (simplifier.collapsed_to);
+  g_free (simplifier.border);
+  g_free (simplifier.quadrics);
+  g_free (simplifier.representatives);
+  g_free (simplifier.points);
+  g_free (simplifier.position_ids);
+  g_free (opt.indices);
+}
@@ -0,0 +1,86 @@
+/*
+ * Rut - Rig Utilities
+ *
+ * Copyright (C) 2014  Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RUT_MESH_OPTIMIZE_H_
+#define _RUT_MESH_OPTIMIZE_H_
+
+#include <glib.h>
+
+#include "rut-mesh.h"
+
+G_BEGIN_DECLS
+
+typedef enum _RutMeshOptimizeFlags
+{
+  /* Merge vertices whose attributes are bitwise identical */
+  RUT_MESH_OPTIMIZE_WELD = 1<<0,
+
+  /* Reorder the triangles for the GPU's post-transform vertex cache
+   * and then reorder the vertices in the order they are first
+   * referenced by the indices */
+  RUT_MESH_OPTIMIZE_REORDER = 1<<1,
+
+  /* Use the smallest index type that can address all the vertices */
+  RUT_MESH_OPTIMIZE_NARROW_INDICES = 1<<2,
+
+  /* Store normals and tangents as normalized shorts and texture
+   * coordinates in the range [0,1] as normalized unsigned shorts.
+   * This is lossy so it should only be used for meshes that won't
+   * be processed further on the CPU. */
+  RUT_MESH_OPTIMIZE_QUANTIZE = 1<<3
+} RutMeshOptimizeFlags;
+
+#define RUT_MESH_OPTIMIZE_LOSSLESS \
+  (RUT_MESH_OPTIMIZE_WELD | \
+   RUT_MESH_OPTIMIZE_REORDER | \
+   RUT_MESH_OPTIMIZE_NARROW_INDICES)
+
+/**
+ * rut_mesh_optimize:
+ * @mesh: A #RutMesh
+ * @flags: The optimizations to apply
+ *
+ * Creates a new mesh with the same attributes as @mesh where the data
+ * has been rearranged for rendering according to @flags. All of the
+ * vertex data of the new mesh is interleaved into a single buffer.
+ * Welding and reordering are only applied to meshes using
+ * %COGL_VERTICES_MODE_TRIANGLES.
+ *
+ * Return value: A new #RutMesh
+ */
+RutMesh *
+rut_mesh_optimize (RutMesh *mesh,
+                   RutMeshOptimizeFlags flags);
+
+/**
+ * rut_mesh_generate_lods:
+ * @mesh: An indexed triangle #RutMesh
+ *
+ * Replaces any levels of detail of @mesh with a chain of simplified
+ * index buffers that each have roughly half the triangles of the
+ * previous level. The levels share the vertices of @mesh so they
+ * should be regenerated if the vertices are reordered.
+ */
+void
+rut_mesh_generate_lods (RutMesh *mesh);
+
+G_END_DECLS
+
+#endif /* _RUT_MESH_OPTIMIZE_H_ */
@@ -69,6 +69,13 @@ typedef struct _Loader
   GArray *faces;
   CoglIndicesType indices_type;
 
+  RutBuffer *indices_buffer;
+  int n_indices;
+
+  /* The complete PLY data, used by the binary fast path */
+  const uint8_t *data;
+  size_t data_len;
+
 } Loader;
 
 GQuark
@@ -311,6 +318,623 @@ init_indices_array (Loader *loader,
   return TRUE;
 }
 
+/* For binary little-endian files where the vertices have a fixed size
+ * we can bypass rply and the per-property callbacks and instead copy
+ * the vertex data directly from the file according to a plan that's
+ * only computed once. */
+
+typedef struct _GatherOp
+{
+  int src_offset;
+  int dst_offset;
+
+  /* If convert is FALSE this is a plain copy of size bytes. Otherwise
+   * a single component of src_type is converted to a float */
+  CoglBool convert;
+  e_ply_type src_type;
+  int size;
+} GatherOp;
+
+/* The number of vertices gathered for each op at a time. This is
+ * chosen so that a block of source and destination vertices should
+ * stay in the cache while all the ops are applied */
+#define GATHER_BLOCK_SIZE 256
+
+static int
+get_sizeof_ply_type (e_ply_type type)
+{
+  switch (type)
+    {
+    case PLY_INT8:
+    case PLY_UINT8:
+    case PLY_CHAR:
+    case PLY_UCHAR:
+      return 1;
+    case PLY_INT16:
+    case PLY_UINT16:
+    case PLY_SHORT:
+    case PLY_USHORT:
+      return 2;
+    case PLY_INT32:
+    case PLY_UIN32:
+    case PLY_FLOAT32:
+    case PLY_INT:
+    case PLY_UINT:
+    case PLY_FLOAT:
+      return 4;
+    case PLY_FLOAT64:
+    case PLY_DOUBLE:
+      return 8;
+    case PLY_LIST:
+      break;
+    }
+
+  return -1;
+}
+
+/* Returns the size of each instance of the element or -1 if the
+ * instances aren't a fixed size because the element has a list
+ * property */
+static int
+get_element_stride (p_ply_element element)
+{
+  p_ply_property property = NULL;
+  int stride = 0;
+
+  while ((property = ply_get_next_property (element, property)))
+    {
+      e_ply_type type;
+
+      ply_get_property_info (property, NULL, &type, NULL, NULL);
+
+      if (type == PLY_LIST)
+        return -1;
+
+      stride += get_sizeof_ply_type (type);
+    }
+
+  return stride;
+}
+
+static int
+get_property_offset (p_ply_element element,
+                     const char *property_name,
+                     e_ply_type *type_out)
+{
+  p_ply_property property = NULL;
+  int offset = 0;
+
+  while ((property = ply_get_next_property (element, property)))
+    {
+      const char *name;
+      e_ply_type type;
+
+      ply_get_property_info (property, &name, &type, NULL, NULL);
+
+      if (strcmp (name, property_name) == 0)
+        {
+          *type_out = type;
+          return offset;
+        }
+
+      offset += get_sizeof_ply_type (type);
+    }
+
+  return -1;
+}
+
+static const uint8_t *
+find_ply_body (const uint8_t *data, size_t len)
+{
+  const char *end = (const char *)data + len;
+  const char *pos = g_strstr_len ((const char *)data, len, "\nend_header");
+
+  if (!pos)
+    return NULL;
+
+  pos += strlen ("\nend_header");
+  if (pos < end && *pos == '\r')
+    pos++;
+  if (pos >= end || *pos != '\n')
+    return NULL;
+
+  return (const uint8_t *)pos + 1;
+}
+
+static uint32_t
+read_ply_uint (const uint8_t *pos, e_ply_type type)
+{
+  switch (type)
+    {
+    case PLY_INT8:
+    case PLY_UINT8:
+    case PLY_CHAR:
+    case PLY_UCHAR:
+      return *pos;
+    case PLY_INT16:
+    case PLY_UINT16:
+    case PLY_SHORT:
+    case PLY_USHORT:
+      {
+        uint16_t value;
+        memcpy (&value, pos, sizeof (value));
+        return value;
+      }
+    case PLY_INT32:
+    case PLY_UIN32:
+    case PLY_INT:
+    case PLY_UINT:
+      {
+        uint32_t value;
+        memcpy (&value, pos, sizeof (value));
+        return value;
+      }
+    case PLY_FLOAT32:
+    case PLY_FLOAT:
+      {
+        float value;
+        memcpy (&value, pos, sizeof (value));
+        return value;
+      }
+    case PLY_FLOAT64:
+    case PLY_DOUBLE:
+      {
+        double value;
+        memcpy (&value, pos, sizeof (value));
+        return value;
+      }
+    case PLY_LIST:
+      break;
+    }
+
+  g_warn_if_reached ();
+  return 0;
+}
+
+static void
+store_index (void *indices, CoglIndicesType type, int i, uint32_t value)
+{
+  switch (type)
+    {
+    case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+      ((uint8_t *)indices)[i] = value;
+      break;
+    case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+      ((uint16_t *)indices)[i] = value;
+      break;
+    case COGL_INDICES_TYPE_UNSIGNED_INT:
+      ((uint32_t *)indices)[i] = value;
+      break;
+    }
+}
+
+static void
+convert_run (const GatherOp *op,
+             const uint8_t *src,
+             int src_stride,
+             uint8_t *dst,
+             int dst_stride,
+             int n_vertices)
+{
+  int i;
+
+  src += op->src_offset;
+  dst += op->dst_offset;
+
+  /* NB: the switch is outside of the loops so that each loop is
+   * simple enough for the compiler to unroll and vectorize. The
+   * source is typically unaligned so memcpy() is used to load
+   * the values */
+  switch (op->src_type)
+    {
+    case PLY_INT32:
+    case PLY_INT:
+      for (i = 0; i < n_vertices; i++)
+        {
+          int32_t value;
+          float f;
+          memcpy (&value, src + i * src_stride, sizeof (value));
+          f = value;
+          memcpy (dst + i * dst_stride, &f, sizeof (f));
+        }
+      break;
+    case PLY_UIN32:
+    case PLY_UINT:
+      for (i = 0; i < n_vertices; i++)
+        {
+          uint32_t value;
+          float f;
+          memcpy (&value, src + i * src_stride, sizeof (value));
+          f = value;
+          memcpy (dst + i * dst_stride, &f, sizeof (f));
+        }
+      break;
+    case PLY_FLOAT64:
+    case PLY_DOUBLE:
+      for (i = 0; i < n_vertices; i++)
+        {
+          double value;
+          float f;
+          memcpy (&value, src + i * src_stride, sizeof (value));
+          f = value;
+          memcpy (dst + i * dst_stride, &f, sizeof (f));
+        }
+      break;
+    default:
+      g_warn_if_reached ();
+    }
+}
+
+static void
+copy_run (const GatherOp *op,
+          const uint8_t *src,
+          int src_stride,
+          uint8_t *dst,
+          int dst_stride,
+          int n_vertices)
+{
+  int i;
+
+  src += op->src_offset;
+  dst += op->dst_offset;
+
+  for (i = 0; i < n_vertices; i++)
+    memcpy (dst + i * dst_stride, src + i * src_stride, op->size);
+}
+
+static int
+plan_vertex_gather (Loader *loader,
+                    p_ply_element vertex_element,
+                    int n_loader_attributes,
+                    GatherOp *ops)
+{
+  int n_ops = 0;
+  int i, j;
+
+  for (i = 0; i < n_loader_attributes; i++)
+    {
+      LoaderAttribute *loader_attribute = &loader->loader_attributes[i];
+      int component_size = get_sizeof_attribute_type (loader_attribute->type);
+
+      if (loader_attribute->padding)
+        continue;
+
+      for (j = 0; j < loader_attribute->n_components; j++)
+        {
+          int p = i * RUT_PLY_MAX_ATTRIBUTE_PROPERTIES + j;
+          LoaderProperty *loader_property = &loader->loader_properties[p];
+          GatherOp *op = &ops[n_ops];
+          e_ply_type type;
+
+          op->src_offset = get_property_offset (vertex_element,
+                                                loader_property->name,
+                                                &type);
+          op->dst_offset = loader_attribute->offset + j * component_size;
+          op->src_type = type;
+
+          /* The attribute type always has the same size as the PLY
+           * type except for 32-bit integers and doubles which are
+           * converted to floats */
+          op->convert =
+            (get_sizeof_ply_type (type) != component_size ||
+             (loader_attribute->type == RUT_ATTRIBUTE_TYPE_FLOAT &&
+              type != PLY_FLOAT32 && type != PLY_FLOAT));
+          op->size = component_size;
+
+          /* Merge consecutive components into a single copy */
+          if (!op->convert && n_ops > 0)
+            {
+              GatherOp *prev = &ops[n_ops - 1];
+
+              if (!prev->convert &&
+                  prev->src_offset + prev->size == op->src_offset &&
+                  prev->dst_offset + prev->size == op->dst_offset)
+                {
+                  prev->size += op->size;
+                  continue;
+                }
+            }
+
+          n_ops++;
+        }
+    }
+
+  return n_ops;
+}
+
+static CoglBool
+gather_vertices (Loader *loader,
+                 p_ply_element vertex_element,
+                 int n_loader_attributes,
+                 const uint8_t *src,
+                 int src_stride,
+                 int n_vertices)
+{
+  GatherOp ops[n_loader_attributes * RUT_PLY_MAX_ATTRIBUTE_PROPERTIES];
+  uint8_t *dst = loader->vertex_buffer->data;
+  int dst_stride = loader->n_vertex_bytes;
+  int n_ops;
+  int i, j;
+
+  n_ops = plan_vertex_gather (loader, vertex_element,
+                              n_loader_attributes, ops);
+
+  /* If the file's vertex layout exactly matches the layout we want
+   * then the data can be copied in one go */
+  if (n_ops == 1 && !ops[0].convert &&
+      ops[0].src_offset == 0 && ops[0].dst_offset == 0 &&
+      ops[0].size == src_stride && src_stride == dst_stride)
+    {
+      memcpy (dst, src, (size_t)n_vertices * src_stride);
+      return TRUE;
+    }
+
+  for (i = 0; i < n_vertices; i += GATHER_BLOCK_SIZE)
+    {
+      int n = MIN (GATHER_BLOCK_SIZE, n_vertices - i);
+      const uint8_t *src_block = src + (size_t)i * src_stride;
+      uint8_t *dst_block = dst + (size_t)i * dst_stride;
+
+      for (j = 0; j < n_ops; j++)
+        {
+          if (ops[j].convert)
+            convert_run (&ops[j], src_block, src_stride,
+                         dst_block, dst_stride, n);
+          else
+            copy_run (&ops[j], src_block, src_stride,
+                      dst_block, dst_stride, n);
+        }
+    }
+
+  return TRUE;
+}
+
+/* Decodes the face lists into a triangle list in two passes. The
+ * first pass validates the data and counts the number of triangles
+ * so that the indices can be written directly into a buffer of
+ * the right size in the second pass. */
+static CoglBool
+decode_faces (Loader *loader,
+              p_ply_element face_element,
+              const uint8_t *pos,
+              const uint8_t *end,
+              const char *display_name)
+{
+  p_ply_property property = NULL;
+  int32_t n_faces;
+  e_ply_type length_type = PLY_LIST, value_type = PLY_LIST;
+  int pre_size = 0, post_size = 0;
+  int length_size, value_size;
+  size_t n_indices = 0;
+  const uint8_t *start = pos;
+  void *indices;
+  int index_size;
+  int i;
+
+  ply_get_element_info (face_element, NULL, &n_faces);
+
+  /* Any scalar properties before or after the list are skipped */
+  while ((property = ply_get_next_property (face_element, property)))
+    {
+      const char *name;
+      e_ply_type type, list_length_type, list_value_type;
+
+      ply_get_property_info (property, &name, &type,
+                             &list_length_type, &list_value_type);
+
+      if (type != PLY_LIST)
+        {
+          if (value_type == PLY_LIST)
+            pre_size += get_sizeof_ply_type (type);
+          else
+            post_size += get_sizeof_ply_type (type);
+        }
+      else if (strcmp (name, "vertex_indices") == 0 &&
+               value_type == PLY_LIST)
+        {
+          length_type = list_length_type;
+          value_type = list_value_type;
+        }
+      else
+        return FALSE;
+    }
+
+  if (value_type == PLY_LIST)
+    return FALSE;
+
+  length_size = get_sizeof_ply_type (length_type);
+  value_size = get_sizeof_ply_type (value_type);
+
+  for (i = 0; i < n_faces; i++)
+    {
+      uint32_t length;
+
+      if (pos + pre_size + length_size > end)
+        goto TRUNCATED;
+
+      length = read_ply_uint (pos + pre_size, length_type);
+      pos += pre_size + length_size + (size_t)length * value_size + post_size;
+
+      if (pos > end)
+        goto TRUNCATED;
+
+      if (length >= 3)
+        n_indices += (length - 2) * 3;
+    }
+
+  loader->indices_buffer =
+    rut_buffer_new (n_indices * (loader->indices_type ==
+                                 COGL_INDICES_TYPE_UNSIGNED_INT ? 4 :
+                                 loader->indices_type ==
+                                 COGL_INDICES_TYPE_UNSIGNED_SHORT ? 2 : 1));
+  loader->n_indices = n_indices;
+  indices = loader->indices_buffer->data;
+  index_size = value_size;
+
+  pos = start;
+
+  /* Fast path for the common case of 32-bit indices with a byte
+   * for the length of each face */
+  if (loader->indices_type == COGL_INDICES_TYPE_UNSIGNED_INT &&
+      length_size == 1 && index_size == 4 &&
+      pre_size == 0 && post_size == 0)
+    {
+      uint32_t *out = indices;
+
+      for (i = 0; i < n_faces; i++)
+        {
+          int length = *(pos++);
+          uint32_t first, last;
+          int j;
+
+          if (length < 3)
+            {
+              pos += length * 4;
+              continue;
+            }
+
+          memcpy (&first, pos, 4);
+          memcpy (&last, pos + 4, 4);
+          pos += 8;
+
+          for (j = 2; j < length; j++)
+            {
+              uint32_t next;
+
+              memcpy (&next, pos, 4);
+              pos += 4;
+
+              out[0] = first;
+              out[1] = last;
+              out[2] = next;
+              out += 3;
+
+              last = next;
+            }
+        }
+
+      return TRUE;
+    }
+
+  n_indices = 0;
+  for (i = 0; i < n_faces; i++)
+    {
+      uint32_t length = read_ply_uint (pos + pre_size, length_type);
+      uint32_t first, last;
+      int j;
+
+      pos += pre_size + length_size;
+
+      if (length >= 3)
+        {
+          first = read_ply_uint (pos, value_type);
+          last = read_ply_uint (pos + index_size, value_type);
+
+          for (j = 2; j < length; j++)
+            {
+              uint32_t next = read_ply_uint (pos + j * index_size, value_type);
+
+              store_index (indices, loader->indices_type, n_indices++, first);
+              store_index (indices, loader->indices_type, n_indices++, last);
+              store_index (indices, loader->indices_type, n_indices++, next);
+
+              last = next;
+            }
+        }
+
+      pos += (size_t)length * index_size + post_size;
+    }
+
+  return TRUE;
+
+TRUNCATED:
+  g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
+               RUT_MESH_PLY_ERROR_INVALID,
+               "Truncated face data in PLY file %s", display_name);
+  return TRUE;
+}
+
+/* Returns FALSE if the data can't be loaded by the fast path and so
+ * rply should be used instead. Errors while loading are reported
+ * via loader->error. */
+static CoglBool
+load_binary_ply (Loader *loader,
+                 int n_loader_attributes,
+                 const char *display_name)
+{
+  p_ply_element element = NULL;
+  p_ply_element vertex_element = NULL;
+  const uint8_t *end = loader->data + loader->data_len;
+  const uint8_t *pos;
+  const uint8_t *vertices = NULL;
+  int vertex_stride = 0;
+  int32_t n_vertices = 0;
+
+  if (!loader->data ||
+      G_BYTE_ORDER != G_LITTLE_ENDIAN ||
+      ply_get_storage_mode (loader->ply) != PLY_LITTLE_ENDIAN)
+    return FALSE;
+
+  pos = find_ply_body (loader->data, loader->data_len);
+  if (!pos)
+    return FALSE;
+
+  /* Find the vertex and face data. Any elements that come before the
+   * faces must have a fixed size so we can skip over them */
+  while ((element = ply_get_next_element (loader->ply, element)))
+    {
+      const char *name;
+      int32_t n_instances;
+      int stride;
+
+      ply_get_element_info (element, &name, &n_instances);
+
+      if (strcmp (name, "face") == 0)
+        {
+          if (!vertices)
+            return FALSE;
+
+          if (!decode_faces (loader, element, pos, end, display_name))
+            return FALSE;
+
+          if (loader->error)
+            return TRUE;
+
+          break;
+        }
+
+      stride = get_element_stride (element);
+      if (stride < 0)
+        return FALSE;
+
+      if (strcmp (name, "vertex") == 0)
+        {
+          vertex_element = element;
+          vertices = pos;
+          vertex_stride = stride;
+          n_vertices = n_instances;
+        }
+
+      if ((size_t)(end - pos) < (size_t)n_instances * stride)
+        {
+          g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
+                       RUT_MESH_PLY_ERROR_INVALID,
+                       "Truncated data in PLY file %s", display_name);
+          return TRUE;
+        }
+
+      pos += (size_t)n_instances * stride;
+    }
+
+  if (!loader->indices_buffer)
+    return FALSE;
+
+  gather_vertices (loader, vertex_element, n_loader_attributes,
+                   vertices, vertex_stride, n_vertices);
+
+  return TRUE;
+}
+
 static RutMesh *
 _rut_mesh_new_from_p_ply (RutContext *ctx,
                           Loader *loader,
@@ -327,11 +951,11 @@ _rut_mesh_new_from_p_ply (RutContext *ctx,
                                    RUT_PLY_MAX_ATTRIBUTE_PROPERTIES];
   RutAttribute *rut_attributes[n_attributes];
   p_ply_element vertex_element;
-  RutBuffer *indices_buffer;
   RutMesh *mesh = NULL;
   int i;
   int32_t n_vertices;
   int max_component_size = 1;
+  CoglBool loaded;
 
   memset (rut_attributes, 0, sizeof (void *) * n_attributes);
 
@@ -482,6 +1106,15 @@ _rut_mesh_new_from_p_ply (RutContext *ctx,
   loader->vertex_buffer = rut_buffer_new (loader->n_vertex_bytes * n_vertices);
   loader->current_vertex_pos = loader->vertex_buffer->data;
 
+  /* Padded attributes and the gaps between attributes are never
+   * written so we clear them to keep the vertices deterministic,
+   * otherwise identical vertices couldn't be welded */
+  memset (loader->vertex_buffer->data, 0, loader->vertex_buffer->size);
+
+  loaded = load_binary_ply (loader, n_loader_attributes, display_name);
+  if (loader->error)
+    goto EXIT;
+
   /* Now that we know what attributes we are loading and their size we
    * know the full vertex size so we can create corresponding
    * RutAttributes */
@@ -492,7 +1125,7 @@ _rut_mesh_new_from_p_ply (RutContext *ctx,
       RutAttribute *rut_attribute;
       int j;
 
-      if (!loader_attribute->padding)
+      if (!loader_attribute->padding && !loaded)
         {
             for (j = 0; j < loader_attribute->n_components; j++)
               {
@@ -524,29 +1157,40 @@ _rut_mesh_new_from_p_ply (RutContext *ctx,
       rut_attributes[i] = rut_attribute;
     }
 
-  if (!ply_set_read_cb (loader->ply, "face", "vertex_indices",
-                        rut_mesh_ply_loader_face_read_cb,
-                        loader, i))
+  if (!loaded)
     {
-      g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
-                   RUT_MESH_PLY_ERROR_MISSING_PROPERTY,
-                   "PLY file %s is missing face property "
-                   "'vertex_indices'",
-                   display_name);
-      goto EXIT;
-    }
+      if (!ply_set_read_cb (loader->ply, "face", "vertex_indices",
+                            rut_mesh_ply_loader_face_read_cb,
+                            loader, i))
+        {
+          g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
+                       RUT_MESH_PLY_ERROR_MISSING_PROPERTY,
+                       "PLY file %s is missing face property "
+                       "'vertex_indices'",
+                       display_name);
+          goto EXIT;
+        }
 
-  if (!ply_read (loader->ply))
-    {
-      g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
-                   RUT_MESH_PLY_ERROR_UNKNOWN,
-                   "Unknown error loading PLY file %s", display_name);
-      goto EXIT;
+      if (!ply_read (loader->ply))
+        {
+          g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
+                       RUT_MESH_PLY_ERROR_UNKNOWN,
+                       "Unknown error loading PLY file %s", display_name);
+          goto EXIT;
+        }
+
+      loader->n_indices = loader->faces->len;
+      loader->indices_buffer =
+        rut_buffer_new (loader->faces->len *
+                        g_array_get_element_size (loader->faces));
+      memcpy (loader->indices_buffer->data,
+              loader->faces->data,
+              loader->indices_buffer->size);
     }
 
   ply_close (loader->ply);
 
-  if (loader->faces->len == 0)
+  if (loader->n_indices == 0)
     {
       g_set_error (&loader->error, RUT_MESH_PLY_ERROR,
                    RUT_MESH_PLY_ERROR_INVALID,
@@ -560,16 +1204,10 @@ _rut_mesh_new_from_p_ply (RutContext *ctx,
                        rut_attributes,
                        n_loader_attributes);
 
-  indices_buffer = rut_buffer_new (loader->faces->len *
-                                   g_array_get_element_size (loader->faces));
-  memcpy (indices_buffer->data, loader->faces->data, indices_buffer->size);
-
   rut_mesh_set_indices (mesh,
                         loader->indices_type,
-                        indices_buffer,
-                        loader->faces->len);
-
-  rut_refable_unref (indices_buffer);
+                        loader->indices_buffer,
+                        loader->n_indices);
 
 EXIT:
 
@@ -579,6 +1217,9 @@ EXIT:
   if (loader->vertex_buffer)
     rut_refable_unref (loader->vertex_buffer);
 
+  if (loader->indices_buffer)
+    rut_refable_unref (loader->indices_buffer);
+
   for (i = 0; i < n_loader_attributes; i++)
     if (rut_attributes[i])
       rut_refable_unref (rut_attributes[i]);
@@ -589,13 +1230,15 @@ EXIT:
   return mesh;
 }
 
-RutMesh *
-rut_mesh_new_from_ply (RutContext *ctx,
-                       const char *filename,
-                       RutPLYAttribute *attributes,
-                       int n_attributes,
-                       RutPLYAttributeStatus *load_status,
-                       GError **error)
+static RutMesh *
+mesh_new_from_ply_data (RutContext *ctx,
+                        const uint8_t *data,
+                        size_t len,
+                        const char *filename,
+                        RutPLYAttribute *attributes,
+                        int n_attributes,
+                        RutPLYAttributeStatus *load_status,
+                        GError **error)
 {
   Loader loader;
   p_ply ply;
@@ -604,12 +1247,18 @@ rut_mesh_new_from_ply (RutContext *ctx,
 
   memset (&loader, 0, sizeof (Loader));
 
-  ply = ply_open (filename, rut_mesh_ply_loader_error_cb, error);
+  ply = ply_start (data, len, rut_mesh_ply_loader_error_cb, error);
 
   if (!ply)
     return NULL;
 
-  display_name = g_filename_display_name (filename);
+  if (filename)
+    display_name = g_filename_display_name (filename);
+  else
+    display_name = g_strdup_printf ("<serialized asset %p>", data);
+
+  loader.data = data;
+  loader.data_len = len;
 
   mesh = _rut_mesh_new_from_p_ply (ctx,
                                    &loader,
@@ -626,38 +1275,52 @@ rut_mesh_new_from_ply (RutContext *ctx,
 }
 
 RutMesh *
-rut_mesh_new_from_ply_data (RutContext *ctx,
-                            const uint8_t *data,
-                            size_t len,
-                            RutPLYAttribute *attributes,
-                            int n_attributes,
-                            RutPLYAttributeStatus *load_status,
-                            GError **error)
+rut_mesh_new_from_ply (RutContext *ctx,
+                       const char *filename,
+                       RutPLYAttribute *attributes,
+                       int n_attributes,
+                       RutPLYAttributeStatus *load_status,
+                       GError **error)
 {
-  Loader loader;
-  p_ply ply;
+  GMappedFile *mapped_file;
   RutMesh *mesh;
-  char *display_name;
-
-  memset (&loader, 0, sizeof (Loader));
-
-  ply = ply_start (data, len, rut_mesh_ply_loader_error_cb, error);
 
-  if (!ply)
+  /* NB: the file is mapped so that binary files can be loaded without
+   * going through rply's buffered reads */
+  mapped_file = g_mapped_file_new (filename, FALSE, error);
+  if (!mapped_file)
     return NULL;
 
-  display_name = g_strdup_printf ("<serialized asset %p>", data);
+  mesh = mesh_new_from_ply_data (ctx,
+                                 (const uint8_t *)
+                                 g_mapped_file_get_contents (mapped_file),
+                                 g_mapped_file_get_length (mapped_file),
+                                 filename,
+                                 attributes,
+                                 n_attributes,
+                                 load_status,
+                                 error);
 
-  mesh = _rut_mesh_new_from_p_ply (ctx,
-                                   &loader,
-                                   ply,
-                                   display_name,
-                                   attributes,
-                                   n_attributes,
-                                   load_status,
-                                   error);
-
-  g_free (display_name);
+  g_mapped_file_unref (mapped_file);
 
   return mesh;
 }
+
+RutMesh *
+rut_mesh_new_from_ply_data (RutContext *ctx,
+                            const uint8_t *data,
+                            size_t len,
+                            RutPLYAttribute *attributes,
+                            int n_attributes,
+                            RutPLYAttributeStatus *load_status,
+                            GError **error)
+{
+  return mesh_new_from_ply_data (ctx,
+                                 data,
+                                 len,
+                                 NULL, /* filename */
+                                 attributes,
+                                 n_attributes,
+                                 load_status,
+                                 error);
+}
@@ -20,6 +20,12 @@
 
 #include <config.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "rut-mesh.h"
 #include "rut-interfaces.h"
 
@@ -28,7 +34,13 @@ _rut_buffer_free (void *object)
 {
   RutBuffer *buffer = object;
 
-  g_free (buffer->data);
+  if (buffer->data_owner)
+    rut_refable_unref (buffer->data_owner);
+  else if (buffer->mapped)
+    munmap (buffer->data, buffer->size);
+  else
+    g_free (buffer->data);
+
   g_slice_free (RutBuffer, buffer);
 }
 
@@ -57,6 +69,86 @@ rut_buffer_new (size_t buffer_size)
 
   buffer->size = buffer_size;
   buffer->data = g_malloc (buffer_size);
+  buffer->data_owner = NULL;
+  buffer->mapped = false;
+
+  return buffer;
+}
+
+RutBuffer *
+rut_buffer_new_for_data (uint8_t *data,
+                         size_t size,
+                         RutObject *data_owner)
+{
+  RutBuffer *buffer = g_slice_new (RutBuffer);
+
+  g_return_val_if_fail (data_owner != NULL, NULL);
+
+  rut_object_init (&buffer->_parent, &rut_buffer_type);
+
+  buffer->ref_count = 1;
+
+  buffer->size = size;
+  buffer->data = data;
+  buffer->data_owner = rut_refable_ref (data_owner);
+  buffer->mapped = false;
+
+  return buffer;
+}
+
+RutBuffer *
+rut_buffer_new_from_file (const char *filename,
+                          GError **error)
+{
+  RutBuffer *buffer;
+  struct stat sb;
+  int fd;
+  uint8_t *contents;
+  size_t len;
+
+  fd = open (filename, O_RDONLY | O_CLOEXEC);
+  if (fd >= 0 && fstat (fd, &sb) == 0 && sb.st_size > 0)
+    {
+      /* NB: The mapping is private and writable so that anything
+       * modifying the data will get its own copy of the pages it
+       * touches instead of modifying the file. */
+      contents = mmap (NULL, sb.st_size,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                       fd, 0);
+      close (fd);
+
+      if (contents != MAP_FAILED)
+        {
+          buffer = g_slice_new (RutBuffer);
+
+          rut_object_init (&buffer->_parent, &rut_buffer_type);
+
+          buffer->ref_count = 1;
+
+          buffer->size = sb.st_size;
+          buffer->data = contents;
+          buffer->data_owner = NULL;
+          buffer->mapped = true;
+
+          return buffer;
+        }
+    }
+  else if (fd >= 0)
+    close (fd);
+
+  if (!g_file_get_contents (filename, (char **)&contents, &len, error))
+    return NULL;
+
+  buffer = g_slice_new (RutBuffer);
+
+  rut_object_init (&buffer->_parent, &rut_buffer_type);
+
+  buffer->ref_count = 1;
+
+  buffer->size = len;
+  buffer->data = contents;
+  buffer->data_owner = NULL;
+  buffer->mapped = false;
 
   return buffer;
 }
@@ -121,6 +213,8 @@ _rut_mesh_free (RutObject *object)
   for (i = 0; i < mesh->n_attributes; i++)
     rut_refable_unref (mesh->attributes[i]);
 
+  rut_mesh_clear_lods (mesh);
+
   g_slice_free1 (mesh->n_attributes * sizeof (void *), mesh->attributes);
   g_slice_free (RutMesh, mesh);
 }
@@ -268,6 +362,32 @@ rut_mesh_set_indices (RutMesh *mesh,
   mesh->n_indices = n_indices;
 }
 
+void
+rut_mesh_add_lod (RutMesh *mesh,
+                  RutBuffer *buffer,
+                  int n_indices)
+{
+  RutMeshLod *lod;
+
+  g_return_if_fail (mesh->indices_buffer != NULL);
+  g_return_if_fail (mesh->n_lods < RUT_MESH_MAX_LODS);
+
+  lod = &mesh->lods[mesh->n_lods++];
+  lod->indices_buffer = rut_refable_ref (buffer);
+  lod->n_indices = n_indices;
+}
+
+void
+rut_mesh_clear_lods (RutMesh *mesh)
+{
+  int i;
+
+  for (i = 0; i < mesh->n_lods; i++)
+    rut_refable_unref (mesh->lods[i].indices_buffer);
+
+  mesh->n_lods = 0;
+}
+
 void
 rut_mesh_set_attributes (RutMesh *mesh,
                          RutAttribute **attributes,
@@ -290,68 +410,177 @@ rut_mesh_set_attributes (RutMesh *mesh,
   mesh->n_attributes = n_attributes;
 }
 
+/* The number of indices that the foreach functions unpack at a time */
+#define INDEX_BLOCK_SIZE 768
+
+bool
+rut_mesh_get_attribute_view (RutMesh *mesh,
+                             const char *attribute_name,
+                             RutAttributeView *view)
+{
+  RutAttribute *attribute = rut_mesh_find_attribute (mesh, attribute_name);
+
+  if (!attribute)
+    return false;
+
+  view->data = attribute->buffer->data + attribute->offset;
+  view->stride = attribute->stride;
+  view->n_components = attribute->n_components;
+  view->type = attribute->type;
+
+  return true;
+}
+
+void
+rut_mesh_get_indices (RutMesh *mesh,
+                      int first,
+                      int n_indices,
+                      uint32_t *indices)
+{
+  int i;
+
+  if (!mesh->indices_buffer)
+    {
+      for (i = 0; i < n_indices; i++)
+        indices[i] = first + i;
+      return;
+    }
+
+  switch (mesh->indices_type)
+    {
+    case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+      {
+        uint8_t *src = (uint8_t *)mesh->indices_buffer->data + first;
+        for (i = 0; i < n_indices; i++)
+          indices[i] = src[i];
+        break;
+      }
+    case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+      {
+        uint16_t *src = (uint16_t *)mesh->indices_buffer->data + first;
+        for (i = 0; i < n_indices; i++)
+          indices[i] = src[i];
+        break;
+      }
+    case COGL_INDICES_TYPE_UNSIGNED_INT:
+      memcpy (indices,
+              (uint32_t *)mesh->indices_buffer->data + first,
+              sizeof (uint32_t) * n_indices);
+      break;
+    }
+}
+
+int
+rut_mesh_get_n_triangles (RutMesh *mesh)
+{
+  int n_vertices = mesh->indices_buffer ? mesh->n_indices : mesh->n_vertices;
+
+  switch (mesh->mode)
+    {
+    case COGL_VERTICES_MODE_TRIANGLES:
+      return n_vertices / 3;
+    case COGL_VERTICES_MODE_TRIANGLE_FAN:
+    case COGL_VERTICES_MODE_TRIANGLE_STRIP:
+      return MAX (n_vertices - 2, 0);
+    default:
+      return 0;
+    }
+}
+
+static uint32_t
+get_index (RutMesh *mesh, int i)
+{
+  uint32_t index;
+
+  rut_mesh_get_indices (mesh, i, 1, &index);
+
+  return index;
+}
+
+void
+rut_mesh_get_triangles (RutMesh *mesh,
+                        int first_triangle,
+                        int n_triangles,
+                        uint32_t *indices)
+{
+  int i;
+
+  switch (mesh->mode)
+    {
+    case COGL_VERTICES_MODE_TRIANGLES:
+      rut_mesh_get_indices (mesh, first_triangle * 3, n_triangles * 3,
+                            indices);
+      break;
+
+    case COGL_VERTICES_MODE_TRIANGLE_FAN:
+      {
+        uint32_t center = get_index (mesh, 0);
+
+        for (i = 0; i < n_triangles; i++)
+          {
+            indices[i * 3] = center;
+            rut_mesh_get_indices (mesh, first_triangle + i + 1, 2,
+                                  indices + i * 3 + 1);
+          }
+        break;
+      }
+
+    case COGL_VERTICES_MODE_TRIANGLE_STRIP:
+      /* NB: the winding isn't flipped for every other triangle */
+      for (i = 0; i < n_triangles; i++)
+        rut_mesh_get_indices (mesh, first_triangle + i, 3, indices + i * 3);
+      break;
+
+    default:
+      g_warn_if_reached ();
+    }
+}
+
 static void
 foreach_vertex (RutMesh *mesh,
                 RutMeshVertexCallback callback,
                 void *user_data,
                 CoglBool ignore_indices,
-                uint8_t **bases,
-                int *strides,
+                RutAttributeView *views,
                 int n_attributes)
 {
-  if (mesh->indices_buffer && !ignore_indices)
+  bool use_indices = mesh->indices_buffer && !ignore_indices;
+  int n_vertices = use_indices ? mesh->n_indices : mesh->n_vertices;
+  uint32_t indices[INDEX_BLOCK_SIZE];
+  void **data;
+  int first;
+
+  data = g_alloca (sizeof (void *) * n_attributes);
+
+  for (first = 0; first < n_vertices; first += INDEX_BLOCK_SIZE)
     {
-      void *indices_data = mesh->indices_buffer->data;
-      CoglIndicesType indices_type = mesh->indices_type;
-      void **data;
+      int n_block = MIN (INDEX_BLOCK_SIZE, n_vertices - first);
       int i;
-      int v;
-
-      data = g_alloca (sizeof (void *) * n_attributes);
 
-      for (i = 0; i < mesh->n_indices; i++)
+      if (use_indices)
+        rut_mesh_get_indices (mesh, first, n_block, indices);
+      else
         {
-          int j;
-
-          switch (indices_type)
-            {
-            case COGL_INDICES_TYPE_UNSIGNED_BYTE:
-              v = ((uint8_t *)indices_data)[i];
-              break;
-            case COGL_INDICES_TYPE_UNSIGNED_SHORT:
-              v = ((uint16_t *)indices_data)[i];
-              break;
-            case COGL_INDICES_TYPE_UNSIGNED_INT:
-              v = ((uint32_t *)indices_data)[i];
-              break;
-            }
-
-          for (j = 0; j < n_attributes; j++)
-            data[j] = bases[j] + v * strides[j];
-
-          callback (data, v, user_data);
+          for (i = 0; i < n_block; i++)
+            indices[i] = first + i;
         }
-    }
-  else
-    {
-      int i;
 
-      for (i = 0; i < mesh->n_vertices; i++)
+      for (i = 0; i < n_block; i++)
         {
+          int v = indices[i];
           int j;
 
-          callback ( (void **)bases, i, user_data);
-
           for (j = 0; j < n_attributes; j++)
-            bases[j] += strides[j];
+            data[j] = views[j].data + v * views[j].stride;
+
+          callback (data, v, user_data);
         }
     }
 }
 
 static CoglBool
-collect_attribute_state (RutMesh *mesh,
-                         uint8_t **bases,
-                         int *strides,
+collect_attribute_views (RutMesh *mesh,
+                         RutAttributeView *views,
                          const char *first_attribute,
                          va_list ap)
 {
@@ -360,19 +589,7 @@ collect_attribute_state (RutMesh *mesh,
 
   for (i = 0; attribute_name; i++)
     {
-      int j;
-
-      for (j = 0; j < mesh->n_attributes; j++)
-        {
-          if (strcmp (mesh->attributes[j]->name, attribute_name) == 0)
-            {
-              bases[i] = mesh->attributes[j]->buffer->data + mesh->attributes[j]->offset;
-              strides[i] = mesh->attributes[j]->stride;
-              break;
-            }
-        }
-
-      if (j == mesh->n_attributes)
+      if (!rut_mesh_get_attribute_view (mesh, attribute_name, &views[i]))
         return FALSE;
 
       attribute_name = va_arg (ap, const char *);
@@ -390,8 +607,8 @@ rut_mesh_foreach_vertex (RutMesh *mesh,
 {
   va_list ap;
   int n_attributes = 0;
-  uint8_t **bases;
-  int *strides;
+  RutAttributeView *views;
+  CoglBool found;
 
   va_start (ap, first_attribute);
   do {
@@ -399,15 +616,15 @@ rut_mesh_foreach_vertex (RutMesh *mesh,
   } while (va_arg (ap, const char *));
   va_end (ap);
 
-  bases = g_alloca (sizeof (void *) * n_attributes);
-  strides = g_alloca (sizeof (int) * n_attributes);
+  views = g_alloca (sizeof (RutAttributeView) * n_attributes);
 
   va_start (ap, first_attribute);
-  collect_attribute_state (mesh, bases, strides, first_attribute, ap);
+  found = collect_attribute_views (mesh, views, first_attribute, ap);
   va_end (ap);
 
-  foreach_vertex (mesh, callback, user_data, FALSE,
-                  bases, strides, n_attributes);
+  g_return_if_fail (found);
+
+  foreach_vertex (mesh, callback, user_data, FALSE, views, n_attributes);
 }
 
 void
@@ -419,8 +636,8 @@ rut_mesh_foreach_index (RutMesh *mesh,
 {
   va_list ap;
   int n_attributes = 0;
-  uint8_t **bases;
-  int *strides;
+  RutAttributeView *views;
+  CoglBool found;
 
   va_start (ap, first_attribute);
   do {
@@ -428,65 +645,15 @@ rut_mesh_foreach_index (RutMesh *mesh,
   } while (va_arg (ap, const char *));
   va_end (ap);
 
-  bases = g_alloca (sizeof (void *) * n_attributes);
-  strides = g_alloca (sizeof (int) * n_attributes);
+  views = g_alloca (sizeof (RutAttributeView) * n_attributes);
 
   va_start (ap, first_attribute);
-  collect_attribute_state (mesh, bases, strides, first_attribute, ap);
+  found = collect_attribute_views (mesh, views, first_attribute, ap);
   va_end (ap);
 
-  foreach_vertex (mesh, callback, user_data, TRUE,
-                  bases, strides, n_attributes);
-}
+  g_return_if_fail (found);
 
-typedef struct _IndexState
-{
-  int n_attributes;
-  uint8_t **bases;
-  int *strides;
-  int stride;
-  CoglIndicesType indices_type;
-  void *indices;
-} IndexState;
-
-static inline int
-move_to_i (int index,
-           IndexState *state,
-           void **data)
-{
-  uint32_t v;
-  int i;
-
-  switch (state->indices_type)
-    {
-    case COGL_INDICES_TYPE_UNSIGNED_BYTE:
-      v = ((uint8_t *)state->indices)[index];
-      break;
-    case COGL_INDICES_TYPE_UNSIGNED_SHORT:
-      v = ((uint16_t *)state->indices)[index];
-      break;
-    case COGL_INDICES_TYPE_UNSIGNED_INT:
-      v = ((uint32_t *)state->indices)[index];
-      break;
-    }
-
-  for (i = 0; i < state->n_attributes; i++)
-    data[i] = state->bases[i] + v * state->strides[i];
-
-  return v;
-}
-
-static inline int
-move_to (int index,
-         int n_attributes,
-         uint8_t **bases,
-         int *strides,
-         void **data)
-{
-  int i;
-  for (i = 0; i < n_attributes; i++)
-    data[i] = bases[i] + index * strides[i];
-  return index;
+  foreach_vertex (mesh, callback, user_data, TRUE, views, n_attributes);
 }
 
 void
@@ -497,28 +664,17 @@ rut_mesh_foreach_triangle (RutMesh *mesh,
                            ...)
 {
   va_list ap;
-  int n_vertices;
   int n_attributes = 0;
-  uint8_t **bases;
-  int *strides;
-  void **data0;
-  void **data1;
-  void **data2;
-  void **tri_v[3];
-  int tri_i[3];
-
-  switch (mesh->mode)
-    {
-    case COGL_VERTICES_MODE_LINES:
-    case COGL_VERTICES_MODE_LINE_STRIP:
-    case COGL_VERTICES_MODE_LINE_LOOP:
-      return;
-    default:
-      break;
-    }
+  int n_triangles;
+  RutAttributeView *views;
+  uint32_t indices[INDEX_BLOCK_SIZE];
+  void **data[3];
+  CoglBool found;
+  int first;
+  int i;
 
-  n_vertices = mesh->indices_buffer ? mesh->n_indices : mesh->n_vertices;
-  if (n_vertices < 3)
+  n_triangles = rut_mesh_get_n_triangles (mesh);
+  if (n_triangles == 0)
     return;
 
   va_start (ap, first_attribute);
@@ -527,124 +683,36 @@ rut_mesh_foreach_triangle (RutMesh *mesh,
   } while (va_arg (ap, const char *));
   va_end (ap);
 
-  bases = g_alloca (sizeof (void *) * n_attributes);
-  strides = g_alloca (sizeof (int) * n_attributes);
-  data0 = g_alloca (sizeof (void *) * n_attributes);
-  data1 = g_alloca (sizeof (void *) * n_attributes);
-  data2 = g_alloca (sizeof (void *) * n_attributes);
-
-  tri_v[0] = data0;
-  tri_v[1] = data1;
-  tri_v[2] = data2;
+  views = g_alloca (sizeof (RutAttributeView) * n_attributes);
+  for (i = 0; i < 3; i++)
+    data[i] = g_alloca (sizeof (void *) * n_attributes);
 
   va_start (ap, first_attribute);
-  collect_attribute_state (mesh, bases, strides, first_attribute, ap);
+  found = collect_attribute_views (mesh, views, first_attribute, ap);
   va_end (ap);
 
-#define SWAP_TRIANGLE_VERTICES(V0, V1) \
-  do { \
-    void **tmp_v; \
-    int tmp_i; \
-    tmp_v = tri_v[V0]; \
-    tri_v[V0] = tri_v[V1]; \
-    tri_v[V1] = tmp_v; \
-    \
-    tmp_i = tri_i[V0]; \
-    tri_i[V0] = tri_i[V1]; \
-    tri_i[V1] = tmp_i; \
-  } while (1)
-
-  /* Make sure we don't overrun the vertices if we don't have a
-   * multiple of three vertices in triangle list mode */
-  if (mesh->mode == COGL_VERTICES_MODE_TRIANGLES)
-    n_vertices -= 2;
+  g_return_if_fail (found);
 
-  if (mesh->indices_buffer)
+  for (first = 0; first < n_triangles; first += INDEX_BLOCK_SIZE / 3)
     {
-      IndexState state;
-      CoglVerticesMode mode = mesh->mode;
-      int i = 0;
+      int n_block = MIN (INDEX_BLOCK_SIZE / 3, n_triangles - first);
 
-      state.n_attributes = n_attributes;
-      state.bases = bases;
-      state.strides = strides;
-      state.indices_type = mesh->indices_type;
-      state.indices = mesh->indices_buffer->data;
+      rut_mesh_get_triangles (mesh, first, n_block, indices);
 
-      tri_i[0] = move_to_i (i++, &state, tri_v[0]);
-      tri_i[1] = move_to_i (i++, &state, tri_v[1]);
-      tri_i[2] = move_to_i (i++, &state, tri_v[2]);
-
-      while (TRUE)
+      for (i = 0; i < n_block; i++)
         {
-          if (!callback (tri_v[0], tri_v[1], tri_v[2],
-                         tri_i[0], tri_i[1], tri_i[2], user_data))
-            return;
-
-          if (i >= n_vertices)
-            break;
-
-          switch (mode)
-            {
-            case COGL_VERTICES_MODE_TRIANGLES:
-              tri_i[0] = move_to_i (i++, &state, tri_v[0]);
-              tri_i[1] = move_to_i (i++, &state, tri_v[1]);
-              tri_i[2] = move_to_i (i++, &state, tri_v[2]);
-              break;
-            case COGL_VERTICES_MODE_TRIANGLE_FAN:
-              SWAP_TRIANGLE_VERTICES (1, 2);
-              tri_i[2] = move_to_i (i++, &state, tri_v[2]);
-              break;
-            case COGL_VERTICES_MODE_TRIANGLE_STRIP:
-              SWAP_TRIANGLE_VERTICES (0, 1);
-              SWAP_TRIANGLE_VERTICES (1, 2);
-              tri_i[2] = move_to_i (i++, &state, tri_v[2]);
-              break;
-            default:
-              g_warn_if_reached ();
-            }
-        }
-    }
-  else
-    {
-      CoglVerticesMode mode = mesh->mode;
-      int i = 0;
+          uint32_t *tri = indices + i * 3;
+          int j, k;
 
-      tri_i[0] = move_to (i++, n_attributes, bases, strides, tri_v[0]);
-      tri_i[1] = move_to (i++, n_attributes, bases, strides, tri_v[1]);
-      tri_i[2] = move_to (i++, n_attributes, bases, strides, tri_v[2]);
+          for (j = 0; j < 3; j++)
+            for (k = 0; k < n_attributes; k++)
+              data[j][k] = views[k].data + tri[j] * views[k].stride;
 
-      while (TRUE)
-        {
-          if (!callback (tri_v[0], tri_v[1], tri_v[2],
-                         tri_i[0], tri_i[1], tri_i[2], user_data))
+          if (!callback (data[0], data[1], data[2],
+                         tri[0], tri[1], tri[2], user_data))
             return;
-
-          if (i >= n_vertices)
-            break;
-
-          switch (mode)
-            {
-            case COGL_VERTICES_MODE_TRIANGLES:
-              tri_i[0] = move_to (i++, n_attributes, bases, strides, tri_v[0]);
-              tri_i[1] = move_to (i++, n_attributes, bases, strides, tri_v[1]);
-              tri_i[2] = move_to (i++, n_attributes, bases, strides, tri_v[2]);
-              break;
-            case COGL_VERTICES_MODE_TRIANGLE_FAN:
-              SWAP_TRIANGLE_VERTICES (1, 2);
-              tri_i[2] = move_to (i++, n_attributes, bases, strides, tri_v[2]);
-              break;
-            case COGL_VERTICES_MODE_TRIANGLE_STRIP:
-              SWAP_TRIANGLE_VERTICES (0, 1);
-              SWAP_TRIANGLE_VERTICES (1, 2);
-              tri_i[2] = move_to (i++, n_attributes, bases, strides, tri_v[2]);
-              break;
-            default:
-              g_warn_if_reached ();
-            }
         }
     }
-#undef SWAP_TRIANGLE_VERTICES
 }
 
 static CoglAttributeType
@@ -819,6 +887,8 @@ rut_mesh_copy (RutMesh *mesh)
                                          mesh->attributes[i]->offset,
                                          mesh->attributes[i]->n_components,
                                          mesh->attributes[i]->type);
+      rut_attribute_set_normalized (attributes[i],
+                                    mesh->attributes[i]->normalized);
     }
 
   copy = rut_mesh_new (mesh->mode,
@@ -842,5 +912,12 @@ rut_mesh_copy (RutMesh *mesh)
       rut_refable_unref (indices_buffer);
     }
 
+  /* NB: levels of detail are never modified after they have been
+   * added so they can be shared with the copy */
+  for (i = 0; i < mesh->n_lods; i++)
+    rut_mesh_add_lod (copy,
+                      mesh->lods[i].indices_buffer,
+                      mesh->lods[i].n_indices);
+
   return copy;
 }
@@ -67,6 +67,14 @@ struct _RutBuffer
 
   uint8_t *data;
   size_t size;
+
+  /* If not NULL then @data isn't owned by the buffer but instead
+   * points into memory that is kept alive by this object. */
+  RutObject *data_owner;
+
+  /* Set if @data is a mapping of a file that should be unmapped
+   * when the buffer is freed */
+  bool mapped;
 };
 
 struct _RutAttribute
@@ -85,6 +93,16 @@ struct _RutAttribute
 
 extern RutType rut_mesh_type;
 
+#define RUT_MESH_MAX_LODS 4
+
+/* A level of detail is a simplified set of indices that refers to the
+ * same vertices as the full mesh */
+typedef struct _RutMeshLod
+{
+  RutBuffer *indices_buffer;
+  int n_indices;
+} RutMeshLod;
+
 /* This kind of mesh is optimized for size and use by a GPU */
 struct _RutMesh
 {
@@ -106,6 +124,11 @@ struct _RutMesh
   CoglIndicesType indices_type;
   int n_indices;
   RutBuffer *indices_buffer;
+
+  /* optional, ordered from the most to the least detailed. These use
+   * the same indices_type as the full mesh */
+  RutMeshLod lods[RUT_MESH_MAX_LODS];
+  int n_lods;
 };
 
 void
@@ -114,6 +137,40 @@ _rut_buffer_init_type (void);
 RutBuffer *
 rut_buffer_new (size_t buffer_size);
 
+/**
+ * rut_buffer_new_for_data:
+ * @data: Externally owned memory to wrap
+ * @size: The size of @data in bytes
+ * @data_owner: An object that keeps @data alive
+ *
+ * Creates a buffer that points directly at @data without copying it.
+ * A reference will be taken on @data_owner for as long as the buffer
+ * exists. @data_owner would typically be another #RutBuffer, such as
+ * one returned by rut_buffer_new_from_file(), that @data points into.
+ */
+RutBuffer *
+rut_buffer_new_for_data (uint8_t *data,
+                         size_t size,
+                         RutObject *data_owner);
+
+/**
+ * rut_buffer_new_from_file:
+ * @filename: The file to load
+ * @error: Return location for an error
+ *
+ * Creates a buffer for the contents of @filename. Where possible the
+ * file is mapped into memory as a private mapping which means pages
+ * are only read from disk when they are accessed and writes to the
+ * buffer will transparently copy the affected pages without
+ * modifying the file.
+ *
+ * Return value: A new #RutBuffer or %NULL if the file couldn't be
+ *   read.
+ */
+RutBuffer *
+rut_buffer_new_from_file (const char *filename,
+                          GError **error);
+
 void
 _rut_attribute_init_type (void);
 
@@ -164,6 +221,17 @@ rut_mesh_set_indices (RutMesh *mesh,
                       RutBuffer *buffer,
                       int n_indices);
 
+/* Appends a level of detail that is less detailed than any existing
+ * levels of detail. @buffer should contain indices of the same type
+ * as the mesh's full indices. */
+void
+rut_mesh_add_lod (RutMesh *mesh,
+                  RutBuffer *buffer,
+                  int n_indices);
+
+void
+rut_mesh_clear_lods (RutMesh *mesh);
+
 /* Performs a deep copy of all the buffers */
 RutMesh *
 rut_mesh_copy (RutMesh *mesh);
@@ -176,6 +244,85 @@ RutAttribute *
 rut_mesh_find_attribute (RutMesh *mesh,
                          const char *attribute_name);
 
+/* A typed view of an attribute where the data for vertex N is found
+ * at (data + N * stride). Views are only valid until the mesh's
+ * attributes or buffers are changed. */
+typedef struct _RutAttributeView
+{
+  uint8_t *data;
+  size_t stride;
+  int n_components;
+  RutAttributeType type;
+} RutAttributeView;
+
+/**
+ * rut_mesh_get_attribute_view:
+ * @mesh: A #RutMesh
+ * @attribute_name: The name of the attribute to look up
+ * @view: Return location for the view
+ *
+ * Resolves the named attribute of @mesh into a view that can be used
+ * to address the attribute of any vertex without any further
+ * lookups. This should be called once outside of any loops over the
+ * vertices.
+ *
+ * Return value: %TRUE if @mesh has the attribute or %FALSE otherwise
+ */
+bool
+rut_mesh_get_attribute_view (RutMesh *mesh,
+                             const char *attribute_name,
+                             RutAttributeView *view);
+
+static inline float *
+rut_attribute_view_get_floats (const RutAttributeView *view,
+                               int vertex)
+{
+  return (float *)(view->data + (size_t)vertex * view->stride);
+}
+
+/**
+ * rut_mesh_get_indices:
+ * @mesh: A #RutMesh
+ * @first: The first index to read
+ * @n_indices: The number of indices to read
+ * @indices: An array of at least @n_indices to write to
+ *
+ * Reads the vertex indices from @first to (@first + @n_indices - 1)
+ * of @mesh into @indices as 32-bit integers regardless of the mesh's
+ * index type. For meshes without indices the vertex numbers
+ * themselves are written. Large meshes can be processed in fixed
+ * size blocks to avoid allocating a copy of all the indices.
+ */
+void
+rut_mesh_get_indices (RutMesh *mesh,
+                      int first,
+                      int n_indices,
+                      uint32_t *indices);
+
+/* Returns the number of triangles drawn by @mesh, taking the
+ * vertices mode into account. Meshes of points or lines have no
+ * triangles. */
+int
+rut_mesh_get_n_triangles (RutMesh *mesh);
+
+/**
+ * rut_mesh_get_triangles:
+ * @mesh: A #RutMesh
+ * @first_triangle: The first triangle to read
+ * @n_triangles: The number of triangles to read
+ * @indices: An array of at least (3 * @n_triangles) to write to
+ *
+ * Writes three vertex indices for each of the requested triangles to
+ * @indices. Triangle fans and strips are expanded so that the
+ * indices can always be consumed as a list of independent
+ * triangles.
+ */
+void
+rut_mesh_get_triangles (RutMesh *mesh,
+                        int first_triangle,
+                        int n_triangles,
+                        uint32_t *indices);
+
 typedef CoglBool (*RutMeshVertexCallback) (void **attribute_data,
                                            int vertex_index,
                                            void *user_data);
@@ -0,0 +1,343 @@
+/*
+ * Rut
+ *
+ * Copyright (C) 2014  Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stddef.h>
+
+#include "rut-render-target.h"
+
+/* The number of texture coordinate attributes given to the pipeline
+ * in rut_render_target_draw_textured_rectangle() */
+#define MAX_DRAW_LAYERS 8
+
+struct _RutRenderTarget
+{
+  RutContext *ctx;
+
+  RutList link;
+
+  int width;
+  int height;
+  CoglTextureComponents components;
+  RutRenderTargetFlags flags;
+
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+
+  /* The size of the color and depth buffers */
+  size_t size;
+
+  CoglBool in_use;
+  unsigned int last_used;
+};
+
+static size_t
+get_target_size (int width,
+                 int height,
+                 CoglTextureComponents components)
+{
+  size_t bytes_per_pixel;
+
+  switch (components)
+    {
+    case COGL_TEXTURE_COMPONENTS_A:
+      bytes_per_pixel = 1;
+      break;
+    case COGL_TEXTURE_COMPONENTS_RG:
+      bytes_per_pixel = 2;
+      break;
+    default:
+      bytes_per_pixel = 4;
+      break;
+    }
+
+  /* Offscreen framebuffers also get a packed depth and stencil
+   * buffer */
+  return (size_t)width * height * (bytes_per_pixel + 4);
+}
+
+static RutRenderTarget *
+create_target (RutContext *ctx,
+               int width,
+               int height,
+               CoglTextureComponents components,
+               RutRenderTargetFlags flags)
+{
+  RutRenderTarget *target = g_slice_new0 (RutRenderTarget);
+  CoglTexture2D *texture_2d;
+  CoglError *error = NULL;
+
+  target->ctx = ctx;
+  target->width = width;
+  target->height = height;
+  target->components = components;
+  target->flags = flags;
+
+  texture_2d = cogl_texture_2d_new_with_size (ctx->cogl_context,
+                                              width, height);
+  cogl_texture_set_components (texture_2d, components);
+  target->texture = texture_2d;
+
+  target->fb = cogl_offscreen_new_with_texture (target->texture);
+
+  /* This has to be requested before the framebuffer is allocated */
+  if (flags & RUT_RENDER_TARGET_FLAG_DEPTH_TEXTURE)
+    cogl_framebuffer_set_depth_texture_enabled (target->fb, TRUE);
+
+  if (!cogl_framebuffer_allocate (target->fb, &error))
+    {
+      g_warning ("Failed to allocate %dx%d render target: %s",
+                 width, height, error->message);
+      cogl_error_free (error);
+    }
+
+  target->size = get_target_size (width, height, components);
+
+  ctx->render_target_memory += target->size;
+  if (ctx->render_target_memory > ctx->render_target_peak_memory)
+    ctx->render_target_peak_memory = ctx->render_target_memory;
+  ctx->n_render_target_allocations++;
+
+  rut_list_insert (&ctx->render_targets, &target->link);
+
+  return target;
+}
+
+static void
+destroy_target (RutRenderTarget *target)
+{
+  target->ctx->render_target_memory -= target->size;
+
+  rut_list_remove (&target->link);
+
+  cogl_object_unref (target->fb);
+  cogl_object_unref (target->texture);
+
+  g_slice_free (RutRenderTarget, target);
+}
+
+RutRenderTarget *
+rut_render_target_acquire (RutContext *ctx,
+                           int width,
+                           int height,
+                           CoglTextureComponents components,
+                           RutRenderTargetFlags flags)
+{
+  RutRenderTarget *target;
+
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  rut_list_for_each (target, &ctx->render_targets, link)
+    {
+      if (!target->in_use &&
+          target->width == width &&
+          target->height == height &&
+          target->components == components &&
+          target->flags == flags)
+        {
+          ctx->n_render_target_reuses++;
+          goto found;
+        }
+    }
+
+  target = create_target (ctx, width, height, components, flags);
+
+found:
+  target->in_use = TRUE;
+  target->last_used = ctx->render_target_frame;
+
+  return target;
+}
+
+void
+rut_render_target_release (RutRenderTarget *target)
+{
+  g_return_if_fail (target->in_use);
+
+  target->in_use = FALSE;
+  target->last_used = target->ctx->render_target_frame;
+}
+
+CoglTexture *
+rut_render_target_get_texture (RutRenderTarget *target)
+{
+  return target->texture;
+}
+
+CoglFramebuffer *
+rut_render_target_get_framebuffer (RutRenderTarget *target)
+{
+  return target->fb;
+}
+
+CoglTexture *
+rut_render_target_get_depth_texture (RutRenderTarget *target)
+{
+  g_return_val_if_fail (target->flags & RUT_RENDER_TARGET_FLAG_DEPTH_TEXTURE,
+                        NULL);
+
+  return cogl_framebuffer_get_depth_texture (target->fb);
+}
+
+int
+rut_render_target_get_width (RutRenderTarget *target)
+{
+  return target->width;
+}
+
+int
+rut_render_target_get_height (RutRenderTarget *target)
+{
+  return target->height;
+}
+
+void
+rut_render_target_draw_textured_rectangle (CoglFramebuffer *fb,
+                                           CoglPipeline *pipeline,
+                                           float x1,
+                                           float y1,
+                                           float x2,
+                                           float y2,
+                                           float s1,
+                                           float t1,
+                                           float s2,
+                                           float t2)
+{
+  static const char *tex_coord_names[MAX_DRAW_LAYERS] = {
+    "cogl_tex_coord0_in", "cogl_tex_coord1_in",
+    "cogl_tex_coord2_in", "cogl_tex_coord3_in",
+    "cogl_tex_coord4_in", "cogl_tex_coord5_in",
+    "cogl_tex_coord6_in", "cogl_tex_coord7_in"
+  };
+  CoglVertexP2T2 vertices[4] = {
+    { x1, y1, s1, t1 },
+    { x1, y2, s1, t2 },
+    { x2, y1, s2, t1 },
+    { x2, y2, s2, t2 }
+  };
+  CoglAttribute *attributes[MAX_DRAW_LAYERS + 1];
+  CoglAttributeBuffer *attribute_buffer;
+  CoglPrimitive *primitive;
+  int n_layers;
+  int i;
+
+  n_layers = MIN (cogl_pipeline_get_n_layers (pipeline), MAX_DRAW_LAYERS);
+
+  attribute_buffer =
+    cogl_attribute_buffer_new (cogl_framebuffer_get_context (fb),
+                               sizeof (vertices),
+                               vertices);
+
+  attributes[0] = cogl_attribute_new (attribute_buffer,
+                                      "cogl_position_in",
+                                      sizeof (CoglVertexP2T2),
+                                      offsetof (CoglVertexP2T2, x),
+                                      2, /* n_components */
+                                      COGL_ATTRIBUTE_TYPE_FLOAT);
+
+  for (i = 0; i < n_layers; i++)
+    {
+      attributes[i + 1] = cogl_attribute_new (attribute_buffer,
+                                              tex_coord_names[i],
+                                              sizeof (CoglVertexP2T2),
+                                              offsetof (CoglVertexP2T2, s),
+                                              2, /* n_components */
+                                              COGL_ATTRIBUTE_TYPE_FLOAT);
+    }
+
+  /* Unlike rectangles, primitives aren't batched in the journal */
+  primitive =
+    cogl_primitive_new_with_attributes (COGL_VERTICES_MODE_TRIANGLE_STRIP,
+                                        4, /* n_vertices */
+                                        attributes,
+                                        n_layers + 1);
+  cogl_primitive_draw (primitive, fb, pipeline);
+
+  cogl_object_unref (primitive);
+  for (i = 0; i < n_layers + 1; i++)
+    cogl_object_unref (attributes[i]);
+  cogl_object_unref (attribute_buffer);
+}
+
+void
+rut_render_target_draw_rectangle (CoglFramebuffer *fb,
+                                  CoglPipeline *pipeline,
+                                  float x1,
+                                  float y1,
+                                  float x2,
+                                  float y2)
+{
+  rut_render_target_draw_textured_rectangle (fb, pipeline,
+                                             x1, y1, x2, y2,
+                                             0, 0, 1, 1);
+}
+
+void
+rut_render_target_collect (RutContext *ctx)
+{
+  RutRenderTarget *target, *tmp;
+
+  rut_list_for_each_safe (target, tmp, &ctx->render_targets, link)
+    {
+      if (!target->in_use &&
+          ctx->render_target_frame - target->last_used >=
+          RUT_RENDER_TARGET_MAX_AGE)
+        destroy_target (target);
+    }
+
+  ctx->render_target_frame++;
+}
+
+void
+rut_render_target_get_stats (RutContext *ctx,
+                             RutRenderTargetStats *stats)
+{
+  RutRenderTarget *target;
+
+  stats->n_targets = 0;
+  stats->n_in_use = 0;
+
+  rut_list_for_each (target, &ctx->render_targets, link)
+    {
+      stats->n_targets++;
+      if (target->in_use)
+        stats->n_in_use++;
+    }
+
+  stats->memory = ctx->render_target_memory;
+  stats->peak_memory = ctx->render_target_peak_memory;
+  stats->n_allocations = ctx->n_render_target_allocations;
+  stats->n_reuses = ctx->n_render_target_reuses;
+}
+
+void
+_rut_render_target_pool_destroy (RutContext *ctx)
+{
+  RutRenderTarget *target, *tmp;
+
+  rut_list_for_each_safe (target, tmp, &ctx->render_targets, link)
+    {
+      if (target->in_use)
+        g_warning ("Render target destroyed while still in use");
+
+      destroy_target (target);
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * Rut
+ *
+ * Copyright (C) 2014  Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RUT_RENDER_TARGET_H__
+#define __RUT_RENDER_TARGET_H__
+
+#include <cogl/cogl.h>
+
+#include "rut-context.h"
+
+/*
+ * RutRenderTarget
+ *
+ * Offscreen passes that only need their results for part of a frame
+ * acquire a render target from a pool on the RutContext and release
+ * it as soon as the result has been consumed. A released target can
+ * be handed out again to a later pass of the same frame that needs
+ * the same size and format so passes that don't overlap share their
+ * memory. Targets that go unused for %RUT_RENDER_TARGET_MAX_AGE frames
+ * are freed by rut_render_target_collect().
+ */
+
+/* The number of frames a released target is kept around for */
+#define RUT_RENDER_TARGET_MAX_AGE 10
+
+typedef struct _RutRenderTarget RutRenderTarget;
+
+typedef enum _RutRenderTargetFlags
+{
+  /* The depth buffer of the target can be sampled as a texture */
+  RUT_RENDER_TARGET_FLAG_DEPTH_TEXTURE = 1<<0
+} RutRenderTargetFlags;
+
+typedef struct _RutRenderTargetStats
+{
+  int n_targets;
+  int n_in_use;
+  size_t memory;
+  size_t peak_memory;
+  unsigned int n_allocations;
+  unsigned int n_reuses;
+} RutRenderTargetStats;
+
+/* Returns a target that isn't used by anything else until it is
+ * released. The contents are undefined. */
+RutRenderTarget *
+rut_render_target_acquire (RutContext *ctx,
+                           int width,
+                           int height,
+                           CoglTextureComponents components,
+                           RutRenderTargetFlags flags);
+
+/* The texture and framebuffer of the target mustn't be used after
+ * this, even if a reference was taken on them, since a later pass may
+ * render over them. */
+void
+rut_render_target_release (RutRenderTarget *target);
+
+CoglTexture *
+rut_render_target_get_texture (RutRenderTarget *target);
+
+CoglFramebuffer *
+rut_render_target_get_framebuffer (RutRenderTarget *target);
+
+/* Only valid for targets acquired with
+ * %RUT_RENDER_TARGET_FLAG_DEPTH_TEXTURE */
+CoglTexture *
+rut_render_target_get_depth_texture (RutRenderTarget *target);
+
+int
+rut_render_target_get_width (RutRenderTarget *target);
+
+int
+rut_render_target_get_height (RutRenderTarget *target);
+
+/* Cogl batches rectangles drawn with cogl_framebuffer_draw_rectangle()
+ * and may only submit them after a later pass has already rendered
+ * over a recycled target. Passes that sample the texture of a target
+ * which is going to be released should draw with this instead, which
+ * submits the rectangle straight away. Each layer of @pipeline gets
+ * texture coordinates from (0,0) to (1,1). */
+void
+rut_render_target_draw_rectangle (CoglFramebuffer *fb,
+                                  CoglPipeline *pipeline,
+                                  float x1,
+                                  float y1,
+                                  float x2,
+                                  float y2);
+
+/* Like rut_render_target_draw_rectangle() but each layer gets the
+ * texture coordinates (@s1,@t1) to (@s2,@t2) */
+void
+rut_render_target_draw_textured_rectangle (CoglFramebuffer *fb,
+                                           CoglPipeline *pipeline,
+                                           float x1,
+                                           float y1,
+                                           float x2,
+                                           float y2,
+                                           float s1,
+                                           float t1,
+                                           float s2,
+                                           float t2);
+
+/* Should be called once at the end of each frame */
+void
+rut_render_target_collect (RutContext *ctx);
+
+void
+rut_render_target_get_stats (RutContext *ctx,
+                             RutRenderTargetStats *stats);
+
+/* Frees all of the targets when the context is destroyed */
+void
+_rut_render_target_pool_destroy (RutContext *ctx);
+
+#endif /* __RUT_RENDER_TARGET_H__ */
@@ -49,6 +49,7 @@
 #include "rut-transform-private.h"
 #include "rut-shell.h"
 #include "rut-util.h"
+#include "rut-memory-stack.h"
 #include "rut-ui-viewport.h"
 #include "rut-inputable.h"
 #include "rut-pickable.h"
@@ -139,6 +140,14 @@ struct _RutShell
   RutList input_queue;
   int input_queue_len;
 
+  /* Headless stream events are carried in this per-frame arena which
+   * is rewound each time the input queue has been drained. */
+  RutMemoryStack *input_stack;
+
+  /* Whether to record the positions of pointer motion events that
+   * get coalesced into the latest queued motion event */
+  bool motion_history_enabled;
+
   RutContext *rut_ctx;
 
   RutShellInitCallback init_cb;
@@ -191,6 +200,18 @@ struct _RutShell
   RutObject *selection;
 };
 
+/* The native data for headless input events */
+typedef struct _RutStreamInputEvent
+{
+  RutStreamEvent stream_event;
+
+  /* (x, y) pairs of any earlier pointer positions that were coalesced
+   * into this event, oldest first. */
+  float *history;
+  int n_history;
+  int history_size;
+} RutStreamInputEvent;
+
 typedef enum _RutInputTransformType
 {
   RUT_INPUT_TRANSFORM_TYPE_NONE,
@@ -884,6 +905,39 @@ rut_motion_event_get_y (RutInputEvent *event)
   return y;
 }
 
+int
+rut_motion_event_get_n_history (RutInputEvent *event)
+{
+  RutShell *shell = event->shell;
+
+  if (shell->headless)
+    {
+      RutStreamInputEvent *stream_input_event = event->native;
+      return stream_input_event->n_history;
+    }
+
+  return 0;
+}
+
+void
+rut_motion_event_get_history (RutInputEvent *event,
+                              int index,
+                              float *x,
+                              float *y)
+{
+  RutShell *shell = event->shell;
+  RutStreamInputEvent *stream_input_event;
+
+  g_return_if_fail (shell->headless);
+
+  stream_input_event = event->native;
+
+  g_return_if_fail (index >= 0 && index < stream_input_event->n_history);
+
+  *x = stream_input_event->history[index * 2];
+  *y = stream_input_event->history[index * 2 + 1];
+}
+
 CoglBool
 rut_motion_event_unproject (RutInputEvent *event,
                             RutObject *graphable,
@@ -1403,6 +1457,9 @@ _rut_shell_free (void *object)
 
   _rut_shell_fini (shell);
 
+  if (shell->input_stack)
+    rut_memory_stack_free (shell->input_stack);
+
   g_free (shell);
 }
 
@@ -1457,6 +1514,9 @@ rut_shell_new (bool headless,
 
   shell->headless = headless;
 
+  if (headless)
+    shell->input_stack = rut_memory_stack_new (4096);
+
   rut_list_init (&shell->input_cb_list);
   rut_list_init (&shell->grabs);
   rut_list_init (&shell->onscreens);
@@ -1490,8 +1550,9 @@ _rut_shell_associate_context (RutShell *shell,
 void
 _rut_shell_init (RutShell *shell)
 {
-#ifdef USE_SDL
   rut_list_init (&shell->input_queue);
+
+#ifdef USE_SDL
   shell->sdl_keymod = SDL_GetModState ();
   shell->sdl_buttons = SDL_GetMouseState (NULL, NULL);
 #endif
@@ -1737,19 +1798,25 @@ rut_shell_update_timelines (RutShell *shell)
 static void
 free_input_event (RutShell *shell, RutInputEvent *event)
 {
+  /* Headless events live in the input_stack which gets rewound once
+   * the whole queue has been drained */
   if (shell->headless)
-    {
-      g_slice_free (RutStreamEvent, event->native);
-      g_slice_free (RutInputEvent, event);
-    }
-  else
-    {
+    return;
+
 #ifdef USE_SDL
-      g_slice_free1 (sizeof (RutInputEvent) + sizeof (RutSDLEvent), event);
+  g_slice_free1 (sizeof (RutInputEvent) + sizeof (RutSDLEvent), event);
 #else
-      g_slice_free (RutInputEvent, event);
+  g_slice_free (RutInputEvent, event);
 #endif
-    }
+}
+
+static void
+input_queue_drained (RutShell *shell)
+{
+  shell->input_queue_len = 0;
+
+  if (shell->headless)
+    rut_memory_stack_rewind (shell->input_stack);
 }
 
 void
@@ -1764,7 +1831,7 @@ rut_shell_dispatch_input_events (RutShell *shell)
       free_input_event (shell, event);
     }
 
-  shell->input_queue_len = 0;
+  input_queue_drained (shell);
 }
 
 RutList *
@@ -1787,22 +1854,111 @@ rut_shell_clear_input_queue (RutShell *shell)
       free_input_event (shell, event);
     }
 
-  shell->input_queue_len = 0;
+  input_queue_drained (shell);
+}
+
+void
+rut_shell_set_motion_history_enabled (RutShell *shell,
+                                      bool enabled)
+{
+  shell->motion_history_enabled = enabled;
+}
+
+static void
+append_motion_history (RutShell *shell,
+                       RutStreamInputEvent *stream_input_event,
+                       float x,
+                       float y)
+{
+  if (stream_input_event->n_history == stream_input_event->history_size)
+    {
+      int size = MAX (stream_input_event->history_size * 2, 8);
+      float *history =
+        rut_memory_stack_memalign (shell->input_stack,
+                                   sizeof (float) * 2 * size,
+                                   RUT_UTIL_ALIGNOF (float));
+
+      /* NB: the old array is simply abandoned in the arena */
+      if (stream_input_event->n_history)
+        memcpy (history, stream_input_event->history,
+                sizeof (float) * 2 * stream_input_event->n_history);
+
+      stream_input_event->history = history;
+      stream_input_event->history_size = size;
+    }
+
+  stream_input_event->history[stream_input_event->n_history * 2] = x;
+  stream_input_event->history[stream_input_event->n_history * 2 + 1] = y;
+  stream_input_event->n_history++;
+}
+
+/* If the last queued event is also a pointer move then a new pointer
+ * move can be folded into it since nothing in between could have
+ * changed the button or key state. This way we only do one pick for
+ * all the motion that happened between two frames. */
+static bool
+coalesce_pointer_move (RutShell *shell,
+                       const RutStreamEvent *stream_event)
+{
+  RutInputEvent *last;
+  RutStreamInputEvent *last_stream_input_event;
+  RutStreamEvent *last_stream_event;
+
+  if (stream_event->type != RUT_STREAM_EVENT_POINTER_MOVE ||
+      rut_list_empty (&shell->input_queue))
+    return false;
+
+  last = rut_container_of (shell->input_queue.prev, last, list_node);
+  last_stream_input_event = last->native;
+  last_stream_event = &last_stream_input_event->stream_event;
+
+  if (last_stream_event->type != RUT_STREAM_EVENT_POINTER_MOVE ||
+      last_stream_event->pointer_move.state != stream_event->pointer_move.state)
+    return false;
+
+  if (shell->motion_history_enabled)
+    append_motion_history (shell,
+                           last_stream_input_event,
+                           last_stream_event->pointer_move.x,
+                           last_stream_event->pointer_move.y);
+
+  *last_stream_event = *stream_event;
+
+  return true;
 }
 
 void
 rut_shell_handle_stream_event (RutShell *shell,
-                               RutStreamEvent *stream_event)
+                               const RutStreamEvent *stream_event)
 {
+  RutInputEvent *event;
+  RutStreamInputEvent *stream_input_event;
+
   /* XXX: it's assumed that any process that's handling stream events
    * is not handling any other native events. I.e stream events
    * are effectively the native events.
    */
 
-  RutInputEvent *event = g_slice_alloc (sizeof (RutInputEvent));
-  event->native = stream_event;
+  if (coalesce_pointer_move (shell, stream_event))
+    return;
+
+  event = rut_memory_stack_memalign (shell->input_stack,
+                                     sizeof (RutInputEvent),
+                                     RUT_UTIL_ALIGNOF (RutInputEvent));
+  stream_input_event =
+    rut_memory_stack_memalign (shell->input_stack,
+                               sizeof (RutStreamInputEvent),
+                               RUT_UTIL_ALIGNOF (RutStreamInputEvent));
+
+  stream_input_event->stream_event = *stream_event;
+  stream_input_event->history = NULL;
+  stream_input_event->n_history = 0;
+  stream_input_event->history_size = 0;
+
+  event->native = stream_input_event;
 
   event->shell = shell;
+  event->camera = NULL;
   event->input_transform = NULL;
 
   switch (stream_event->type)
@@ -245,9 +245,36 @@ rut_shell_run_pre_paint_callbacks (RutShell *shell);
 bool
 rut_shell_check_timelines (RutShell *shell);
 
+/**
+ * rut_shell_handle_stream_event:
+ * @shell: A headless #RutShell
+ * @event: The event to queue
+ *
+ * Queues a copy of @event to be dispatched with the next call to
+ * rut_shell_dispatch_input_events(). The copy is carried in a
+ * per-frame arena so the caller can pass a stack allocated event.
+ *
+ * Consecutive pointer move events are coalesced so that only the
+ * latest position is dispatched. See
+ * rut_shell_set_motion_history_enabled() for how to still see the
+ * intermediate positions.
+ */
 void
 rut_shell_handle_stream_event (RutShell *shell,
-                               RutStreamEvent *event);
+                               const RutStreamEvent *event);
+
+/**
+ * rut_shell_set_motion_history_enabled:
+ * @shell: A headless #RutShell
+ * @enabled: Whether to track motion history
+ *
+ * Determines whether the positions of pointer move events that get
+ * coalesced together should be recorded so they can be queried with
+ * rut_motion_event_get_history(). This is disabled by default.
+ */
+void
+rut_shell_set_motion_history_enabled (RutShell *shell,
+                                      bool enabled);
 
 void
 rut_shell_add_input_camera (RutShell *shell,
@@ -366,6 +393,34 @@ rut_motion_event_get_x (RutInputEvent *event);
 float
 rut_motion_event_get_y (RutInputEvent *event);
 
+/**
+ * rut_motion_event_get_n_history:
+ * @event: A motion event
+ *
+ * Return value: The number of earlier pointer positions that were
+ *   coalesced into this event. This will always be 0 unless motion
+ *   history has been enabled with
+ *   rut_shell_set_motion_history_enabled().
+ */
+int
+rut_motion_event_get_n_history (RutInputEvent *event);
+
+/**
+ * rut_motion_event_get_history:
+ * @event: A motion event
+ * @index: The index of a historical position, where 0 is the oldest
+ * @x: Output location for the x coordinate
+ * @y: Output location for the y coordinate
+ *
+ * Retrieves one of the earlier pointer positions that were coalesced
+ * into @event before its current position.
+ */
+void
+rut_motion_event_get_history (RutInputEvent *event,
+                              int index,
+                              float *x,
+                              float *y);
+
 /**
  * rut_motion_event_unproject:
  * @event: A motion event
@@ -0,0 +1,249 @@
+/*
+ * Rut
+ *
+ * Copyright (C) 2014  Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "rut-text-layout-cache.h"
+#include "rut-util.h"
+
+struct _RutTextLayout
+{
+  int ref_count;
+
+  /* NULL if the layout isn't in the cache */
+  RutContext *ctx;
+
+  RutTextLayoutKey key;
+
+  /* Only linked into RutContext::text_layout_lru while there are no
+   * references to the layout */
+  RutList link;
+
+  PangoLayout *layout;
+};
+
+static unsigned int
+key_hash (const void *data)
+{
+  const RutTextLayoutKey *key = data;
+  unsigned int hash;
+
+  hash = rut_util_one_at_a_time_hash (0, key->text, strlen (key->text));
+  hash ^= pango_font_description_hash (key->font_desc);
+  hash = rut_util_one_at_a_time_hash (hash, &key->attrs, sizeof (key->attrs));
+  hash = rut_util_one_at_a_time_hash (hash,
+                                      &key->alignment,
+                                      sizeof (key->alignment));
+  hash = rut_util_one_at_a_time_hash (hash,
+                                      &key->wrap_mode,
+                                      sizeof (key->wrap_mode));
+  hash = rut_util_one_at_a_time_hash (hash,
+                                      &key->ellipsize,
+                                      sizeof (key->ellipsize));
+  hash = rut_util_one_at_a_time_hash (hash,
+                                      &key->single_paragraph,
+                                      sizeof (key->single_paragraph));
+  hash = rut_util_one_at_a_time_hash (hash,
+                                      &key->justify,
+                                      sizeof (key->justify));
+  hash = rut_util_one_at_a_time_hash (hash, &key->width, sizeof (key->width));
+  hash = rut_util_one_at_a_time_hash (hash,
+                                      &key->height,
+                                      sizeof (key->height));
+
+  return rut_util_one_at_a_time_mix (hash);
+}
+
+static gboolean
+key_equal (const void *a, const void *b)
+{
+  const RutTextLayoutKey *key_a = a;
+  const RutTextLayoutKey *key_b = b;
+
+  return (key_a->attrs == key_b->attrs &&
+          key_a->alignment == key_b->alignment &&
+          key_a->wrap_mode == key_b->wrap_mode &&
+          key_a->ellipsize == key_b->ellipsize &&
+          key_a->single_paragraph == key_b->single_paragraph &&
+          key_a->justify == key_b->justify &&
+          key_a->width == key_b->width &&
+          key_a->height == key_b->height &&
+          strcmp (key_a->text, key_b->text) == 0 &&
+          pango_font_description_equal (key_a->font_desc,
+                                        key_b->font_desc));
+}
+
+static void
+free_text_layout (RutTextLayout *text_layout)
+{
+  /* Unshared layouts don't have a key */
+  if (text_layout->key.text)
+    {
+      g_free ((char *)text_layout->key.text);
+      pango_font_description_free ((PangoFontDescription *)
+                                   text_layout->key.font_desc);
+      if (text_layout->key.attrs)
+        pango_attr_list_unref (text_layout->key.attrs);
+    }
+
+  g_object_unref (text_layout->layout);
+
+  g_slice_free (RutTextLayout, text_layout);
+}
+
+static void
+evict_unused (RutContext *ctx,
+              int max_unused)
+{
+  while (ctx->n_unused_text_layouts > max_unused)
+    {
+      RutTextLayout *oldest =
+        rut_container_of (ctx->text_layout_lru.next, oldest, link);
+
+      rut_list_remove (&oldest->link);
+      ctx->n_unused_text_layouts--;
+
+      g_hash_table_remove (ctx->text_layouts, &oldest->key);
+
+      free_text_layout (oldest);
+    }
+}
+
+RutTextLayout *
+rut_text_layout_cache_lookup (RutContext *ctx,
+                              const RutTextLayoutKey *key)
+{
+  RutTextLayout *text_layout;
+
+  if (!ctx->text_layouts)
+    return NULL;
+
+  text_layout = g_hash_table_lookup (ctx->text_layouts, key);
+  if (!text_layout)
+    return NULL;
+
+  return rut_text_layout_ref (text_layout);
+}
+
+RutTextLayout *
+rut_text_layout_cache_insert (RutContext *ctx,
+                              const RutTextLayoutKey *key,
+                              PangoLayout *layout)
+{
+  RutTextLayout *text_layout = g_slice_new (RutTextLayout);
+
+  text_layout->ref_count = 1;
+  text_layout->ctx = ctx;
+  text_layout->layout = layout;
+
+  text_layout->key = *key;
+  text_layout->key.text = g_strdup (key->text);
+  text_layout->key.font_desc = pango_font_description_copy (key->font_desc);
+  if (key->attrs)
+    pango_attr_list_ref (key->attrs);
+
+  if (!ctx->text_layouts)
+    ctx->text_layouts = g_hash_table_new (key_hash, key_equal);
+
+  /* NB: if there is already a layout for the key it's still in use so
+   * the new one simply replaces it for future lookups */
+  g_hash_table_replace (ctx->text_layouts, &text_layout->key, text_layout);
+
+  return text_layout;
+}
+
+RutTextLayout *
+rut_text_layout_new_unshared (PangoLayout *layout)
+{
+  RutTextLayout *text_layout = g_slice_new0 (RutTextLayout);
+
+  text_layout->ref_count = 1;
+  text_layout->layout = layout;
+
+  return text_layout;
+}
+
+PangoLayout *
+rut_text_layout_get_layout (RutTextLayout *text_layout)
+{
+  return text_layout->layout;
+}
+
+RutTextLayout *
+rut_text_layout_ref (RutTextLayout *text_layout)
+{
+  if (text_layout->ref_count++ == 0)
+    {
+      rut_list_remove (&text_layout->link);
+      text_layout->ctx->n_unused_text_layouts--;
+    }
+
+  return text_layout;
+}
+
+void
+rut_text_layout_unref (RutTextLayout *text_layout)
+{
+  RutContext *ctx = text_layout->ctx;
+
+  if (--text_layout->ref_count)
+    return;
+
+  /* Keep the layout in case another text wants the same layout
+   * later but only if it is still the one that would be found */
+  if (ctx &&
+      g_hash_table_lookup (ctx->text_layouts,
+                           &text_layout->key) == text_layout)
+    {
+      rut_list_insert (ctx->text_layout_lru.prev, &text_layout->link);
+      ctx->n_unused_text_layouts++;
+
+      evict_unused (ctx, RUT_TEXT_LAYOUT_CACHE_MAX_UNUSED);
+    }
+  else
+    free_text_layout (text_layout);
+}
+
+static void
+orphan_layout_cb (void *key,
+                  void *value,
+                  void *user_data)
+{
+  RutTextLayout *text_layout = value;
+
+  /* Layouts that are still referenced are freed along with their last
+   * reference instead */
+  text_layout->ctx = NULL;
+}
+
+void
+_rut_text_layout_cache_destroy (RutContext *ctx)
+{
+  if (!ctx->text_layouts)
+    return;
+
+  evict_unused (ctx, 0);
+
+  g_hash_table_foreach (ctx->text_layouts, orphan_layout_cb, NULL);
+  g_hash_table_destroy (ctx->text_layouts);
+  ctx->text_layouts = NULL;
+}
@@ -0,0 +1,97 @@
+/*
+ * Rut
+ *
+ * Copyright (C) 2014  Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RUT_TEXT_LAYOUT_CACHE_H__
+#define __RUT_TEXT_LAYOUT_CACHE_H__
+
+#include <stdbool.h>
+#include <pango/pango.h>
+
+#include "rut-context.h"
+
+/*
+ * RutTextLayout
+ *
+ * Labels tend to repeat the same strings with the same fonts so
+ * instead of each RutText shaping its own copy of a string the
+ * layouts are shared through a cache on the RutContext. A cached
+ * PangoLayout must be treated as immutable. Since CoglPango keeps
+ * the vertices it batches for a layout with the layout itself, all
+ * the texts sharing a layout also share its draw data on the glyph
+ * atlas.
+ *
+ * Layouts that are no longer referenced by any text are kept around
+ * in least recently used order, up to
+ * %RUT_TEXT_LAYOUT_CACHE_MAX_UNUSED, so that scrolling labels in and
+ * out of view doesn't need to shape them again.
+ */
+
+#define RUT_TEXT_LAYOUT_CACHE_MAX_UNUSED 256
+
+typedef struct _RutTextLayout RutTextLayout;
+
+/* Everything that affects the result of laying out some text. The
+ * attributes are compared by identity so a cached layout holds a
+ * reference on them. */
+typedef struct _RutTextLayoutKey
+{
+  const char *text;
+  const PangoFontDescription *font_desc;
+  PangoAttrList *attrs;
+  PangoAlignment alignment;
+  PangoWrapMode wrap_mode;
+  PangoEllipsizeMode ellipsize;
+  bool single_paragraph;
+  bool justify;
+  int width;
+  int height;
+} RutTextLayoutKey;
+
+/* Returns a new reference to a cached layout matching @key or NULL */
+RutTextLayout *
+rut_text_layout_cache_lookup (RutContext *ctx,
+                              const RutTextLayoutKey *key);
+
+/* Adds @layout to the cache for @key, which is copied, and returns a
+ * reference to it. The cache takes ownership of @layout. */
+RutTextLayout *
+rut_text_layout_cache_insert (RutContext *ctx,
+                              const RutTextLayoutKey *key,
+                              PangoLayout *layout);
+
+/* Wraps a layout that depends on state that can't be part of a key,
+ * such as preedit text, so it can be used in place of a cached
+ * layout. The layout is freed with the last reference. */
+RutTextLayout *
+rut_text_layout_new_unshared (PangoLayout *layout);
+
+PangoLayout *
+rut_text_layout_get_layout (RutTextLayout *text_layout);
+
+RutTextLayout *
+rut_text_layout_ref (RutTextLayout *text_layout);
+
+void
+rut_text_layout_unref (RutTextLayout *text_layout);
+
+void
+_rut_text_layout_cache_destroy (RutContext *ctx);
+
+#endif /* __RUT_TEXT_LAYOUT_CACHE_H__ */
@@ -892,17 +892,74 @@ rut_text_create_layout_no_cache (RutText  *text,
   return layout;
 }
 
+/*
+ * rut_text_get_shared_layout:
+ *
+ * Looks up a layout with the same contents and properties as
+ * rut_text_create_layout_no_cache() would create in the layout cache
+ * shared with all other texts and only creates a new one if there
+ * isn't one already.
+ */
+static RutTextLayout *
+rut_text_get_shared_layout (RutText *text,
+                            int width,
+                            int height,
+                            PangoEllipsizeMode ellipsize)
+{
+  RutContext *ctx = text->ctx;
+  RutTextLayoutKey key;
+  RutTextLayout *text_layout;
+  PangoLayout *layout;
+  char *contents;
+
+  /* The preedit string and its attributes are too transient to be
+   * worth sharing */
+  if (text->editable && text->preedit_set)
+    {
+      layout = rut_text_create_layout_no_cache (text, width, height, ellipsize);
+      return rut_text_layout_new_unshared (layout);
+    }
+
+  if (!text->editable)
+    rut_text_ensure_effective_attributes (text);
+
+  contents = rut_text_get_display_text (text);
+
+  key.text = contents;
+  key.font_desc = text->font_desc;
+  key.attrs = text->editable ? NULL : text->effective_attrs;
+  key.alignment = text->alignment;
+  key.wrap_mode = text->wrap_mode;
+  key.ellipsize = ellipsize;
+  key.single_paragraph = text->single_line_mode;
+  key.justify = text->justify;
+  key.width = width;
+  key.height = height;
+
+  text_layout = rut_text_layout_cache_lookup (ctx, &key);
+  if (!text_layout)
+    {
+      layout = rut_text_create_layout_no_cache (text, width, height, ellipsize);
+      text_layout = rut_text_layout_cache_insert (ctx, &key, layout);
+    }
+
+  g_free (contents);
+
+  return text_layout;
+}
+
 static void
 rut_text_dirty_cache (RutText *text)
 {
   int i;
 
-  /* Delete the cached layouts so they will be recreated the next time
-     they are needed */
+  /* Drop the cached layouts so they will be looked up again the next
+     time they are needed */
   for (i = 0; i < N_CACHED_LAYOUTS; i++)
-    if (text->cached_layouts[i].layout)
+    if (text->cached_layouts[i].text_layout)
       {
-	g_object_unref (text->cached_layouts[i].layout);
+	rut_text_layout_unref (text->cached_layouts[i].text_layout);
+	text->cached_layouts[i].text_layout = NULL;
 	text->cached_layouts[i].layout = NULL;
       }
 }
@@ -1175,12 +1232,14 @@ rut_text_create_layout (RutText *text,
   RUT_COUNTER_INC (_rut_uprof_context, text_cache_miss_counter);
 
   /* If we make it here then we didn't have a cached version so we
-     need to recreate the layout */
-  if (oldest_cache->layout)
-    g_object_unref (oldest_cache->layout);
+     need to find a shared layout or recreate it */
+  if (oldest_cache->text_layout)
+    rut_text_layout_unref (oldest_cache->text_layout);
 
+  oldest_cache->text_layout =
+    rut_text_get_shared_layout (text, width, height, ellipsize);
   oldest_cache->layout =
-    rut_text_create_layout_no_cache (text, width, height, ellipsize);
+    rut_text_layout_get_layout (oldest_cache->text_layout);
 
   cogl_pango_ensure_glyph_cache_for_layout (oldest_cache->layout);
 
@@ -3278,7 +3337,10 @@ rut_text_new_full (RutContext *ctx,
   text->pick_mesh = pick_mesh;
 
   for (i = 0; i < N_CACHED_LAYOUTS; i++)
-    text->cached_layouts[i].layout = NULL;
+    {
+      text->cached_layouts[i].text_layout = NULL;
+      text->cached_layouts[i].layout = NULL;
+    }
 
   /* default to "" so that rut_text_get_text() will
    * return a valid string and we can safely call strlen()
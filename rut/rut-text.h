@@ -32,6 +32,7 @@
 #include "rut-closure.h"
 #include "rut-paintable.h"
 #include "rut-entity.h"
+#include "rut-text-layout-cache.h"
 
 #include <pango/pango.h>
 
@@ -60,8 +61,10 @@ typedef struct _LayoutCache
 {
   /* Cached layout. Pango internally caches the computed extents
    * when they are requested so there is no need to cache that as
-   * well
+   * well. The layout may be shared with other texts so it mustn't
+   * be modified.
    */
+  RutTextLayout *text_layout;
   PangoLayout *layout;
 
   /* A number representing the age of this cache (so that when a
@@ -270,50 +270,7 @@ rut_util_intersect_triangle (float v0[3], float v1[3], float v2[3],
   return TRUE;
 }
 
-typedef struct _IntersectState
-{
-  float *ray_origin;
-  float *ray_direction;
-  float min_t;
-  int index;
-  int hit_index;
-  bool found;
-} IntersectState;
-
-static CoglBool
-intersect_triangle_cb (void **attributes_v0,
-                       void **attributes_v1,
-                       void **attributes_v2,
-                       int index_v0,
-                       int index_v1,
-                       int index_v2,
-                       void *user_data)
-{
-  IntersectState *state = user_data;
-  float *pos_v0 = attributes_v0[0];
-  float *pos_v1 = attributes_v1[0];
-  float *pos_v2 = attributes_v2[0];
-  float u, v, t;
-  bool hit;
-
-  hit = rut_util_intersect_triangle (pos_v0, pos_v1, pos_v2,
-                                     state->ray_origin,
-                                     state->ray_direction,
-                                     &u, &v, &t);
-
-  /* found a closer triangle. t > 0 means that we don't want results
-   * behind the ray origin */
-  if (hit && t > 0 && t < state->min_t)
-    {
-      state->min_t = t;
-      state->found = TRUE;
-      state->hit_index = state->index;
-    }
-
-  state->index++;
-
-  return TRUE;
-}
+#define INTERSECT_BLOCK_SIZE 256
 
 bool
 rut_util_intersect_mesh (RutMesh *mesh,
@@ -322,27 +279,60 @@ rut_util_intersect_mesh (RutMesh *mesh,
                          int *index,
                          float *t_out)
 {
-  IntersectState state;
+  RutAttributeView positions;
+  uint32_t indices[INTERSECT_BLOCK_SIZE * 3];
+  int n_triangles;
+  float min_t = G_MAXFLOAT;
+  int hit_index = 0;
+  bool found = FALSE;
+  int first;
+
+  if (!rut_mesh_get_attribute_view (mesh, "cogl_position_in", &positions))
+    return FALSE;
 
-  state.ray_origin = ray_origin;
-  state.ray_direction = ray_direction;
-  state.min_t = G_MAXFLOAT;
-  state.found = FALSE;
-  state.index = 0;
+  g_return_val_if_fail (positions.type == RUT_ATTRIBUTE_TYPE_FLOAT &&
+                        positions.n_components >= 3, FALSE);
 
-  rut_mesh_foreach_triangle (mesh,
-                             intersect_triangle_cb,
-                             &state,
-                             "cogl_position_in",
-                             NULL);
+  n_triangles = rut_mesh_get_n_triangles (mesh);
+
+  for (first = 0; first < n_triangles; first += INTERSECT_BLOCK_SIZE)
+    {
+      int n_block = MIN (INTERSECT_BLOCK_SIZE, n_triangles - first);
+      int i;
+
+      rut_mesh_get_triangles (mesh, first, n_block, indices);
+
+      for (i = 0; i < n_block; i++)
+        {
+          float *pos_v0 = rut_attribute_view_get_floats (&positions,
+                                                         indices[i * 3]);
+          float *pos_v1 = rut_attribute_view_get_floats (&positions,
+                                                         indices[i * 3 + 1]);
+          float *pos_v2 = rut_attribute_view_get_floats (&positions,
+                                                         indices[i * 3 + 2]);
+          float u, v, t;
+
+          /* found a closer triangle. t > 0 means that we don't want
+           * results behind the ray origin */
+          if (rut_util_intersect_triangle (pos_v0, pos_v1, pos_v2,
+                                           ray_origin, ray_direction,
+                                           &u, &v, &t) &&
+              t > 0 && t < min_t)
+            {
+              min_t = t;
+              found = TRUE;
+              hit_index = first + i;
+            }
+        }
+    }
 
-  if (state.found)
+  if (found)
     {
       if (t_out)
-        *t_out = state.min_t;
+        *t_out = min_t;
 
       if (index)
-        *index = state.hit_index;
+        *index = hit_index;
 
       return TRUE;
     }
@@ -350,6 +340,32 @@ rut_util_intersect_mesh (RutMesh *mesh,
   return FALSE;
 }
 
+bool
+rut_util_intersect_z_plane (float ray_origin[3],
+                            float ray_direction[3],
+                            float *x,
+                            float *y,
+                            float *t_out)
+{
+  float t;
+
+  /* if the direction is near zero, the ray lies in the plane */
+  if (ray_direction[2] > -EPSILON && ray_direction[2] < EPSILON)
+    return FALSE;
+
+  t = -ray_origin[2] / ray_direction[2];
+  if (t <= 0)
+    return FALSE;
+
+  *x = ray_origin[0] + ray_direction[0] * t;
+  *y = ray_origin[1] + ray_direction[1] * t;
+
+  if (t_out)
+    *t_out = t;
+
+  return TRUE;
+}
+
 unsigned int
 rut_util_one_at_a_time_mix (unsigned int hash)
 {
@@ -150,6 +150,17 @@ rut_util_intersect_mesh (RutMesh *mesh,
                          int *index,
                          float *t_out);
 
+/* Intersects a ray with the z = 0 plane and returns the x and y
+ * coordinates of the intersection. Intersections behind the ray's
+ * origin aren't counted. This can be used to analytically pick flat
+ * geometry that is centered on the origin. */
+bool
+rut_util_intersect_z_plane (float ray_origin[3],
+                            float ray_direction[3],
+                            float *x,
+                            float *y,
+                            float *t_out);
+
 /**
  * @extra_space: Extra space to redistribute among children after
  *               subtracting minimum sizes and any child padding from
@@ -42,6 +42,8 @@
 #include "rut-geometry.h"
 #include "rut-scroll-bar.h"
 #include "rut-image-source.h"
+#include "rut-render-target.h"
+#include "rut-text-layout-cache.h"
 
 typedef struct _RutTextureCacheEntry
 {
@@ -168,6 +170,10 @@ _rut_context_free (void *object)
 
   _rut_destroy_image_source_wrappers (ctx);
 
+  _rut_render_target_pool_destroy (ctx);
+
+  _rut_text_layout_cache_destroy (ctx);
+
   rut_property_context_destroy (&ctx->property_ctx);
 
   g_object_unref (ctx->pango_context);
@@ -176,6 +182,13 @@ _rut_context_free (void *object)
 
   g_hash_table_destroy (ctx->texture_cache);
 
+  if (ctx->shape_models)
+    g_hash_table_destroy (ctx->shape_models);
+  if (ctx->nine_slice_geometries)
+    g_hash_table_destroy (ctx->nine_slice_geometries);
+  if (ctx->pointalism_grid_slices)
+    g_hash_table_destroy (ctx->pointalism_grid_slices);
+
   if (rut_cogl_context == ctx->cogl_context)
     {
       cogl_object_unref (rut_cogl_context);
@@ -318,6 +331,7 @@ rut_context_new (RutShell *shell)
 {
   RutContext *context = g_new0 (RutContext, 1);
   CoglError *error = NULL;
+  const char *budget_str;
 
   g_return_val_if_fail (shell != NULL, NULL);
 
@@ -332,6 +346,20 @@ rut_context_new (RutShell *shell)
 
   context->headless = rut_shell_get_headless (shell);
 
+  rut_list_init (&context->texture_lru);
+  rut_list_init (&context->video_sources);
+  rut_list_init (&context->render_targets);
+  rut_list_init (&context->text_layout_lru);
+  g_queue_init (&context->thumbnail_queue);
+
+  /* The texture budget is unlimited by default but it can be set
+   * for a particular class of device with an environment variable */
+  budget_str = g_getenv ("RUT_TEXTURE_BUDGET_MB");
+  if (budget_str)
+    context->texture_budget =
+      (size_t)g_ascii_strtoull (budget_str, NULL, 10) * 1024 * 1024;
+  context->texture_eviction_age = RUT_TEXTURE_EVICTION_AGE;
+
   if (!context->headless)
     {
 #ifdef USE_SDL
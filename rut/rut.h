@@ -29,6 +29,7 @@
 #include "rut-util.h"
 #include "rut-text-buffer.h"
 #include "rut-text.h"
+#include "rut-text-layout-cache.h"
 #include "rut-geometry.h"
 #include "rut-paintable.h"
 #include "rut-color.h"
@@ -36,12 +37,14 @@
 #include "rut-stack.h"
 #include "rut-entry.h"
 #include "rut-downsampler.h"
+#include "rut-render-target.h"
 #include "rut-gaussian-blurrer.h"
 #include "rut-toggle.h"
 #include "rut-dof-effect.h"
 #include "rut-inspector.h"
 #include "rut-mesh.h"
 #include "rut-mesh-ply.h"
+#include "rut-mesh-optimize.h"
 #include "rut-ui-viewport.h"
 #include "rut-image.h"
 #include "rut-box-layout.h"